@@ -54,6 +54,7 @@
 #define LINUX_KERNEL_SYMBOL_FILE        "/proc/" LINUX_KERNEL_SYMBOL_FILE_SHORT
 #define LINUX_PERF_EVENTS_FILE          "/proc/sys/kernel/perf_event_paranoid"
 #define LINUX_PERF_EVENTS_MAX_RATE      "/proc/sys/kernel/perf_event_max_sample_rate"
+#define LINUX_PERF_EVENTS_MAX_STACK     "/proc/sys/kernel/perf_event_max_stack"
 #define LINUX_KERNEL_KPTR_RESTICT       "/proc/sys/kernel/kptr_restrict"
 
 // measurement subdirectory where kallsyms files from compute nodes will be recorded
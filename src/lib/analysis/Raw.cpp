@@ -160,7 +160,8 @@ Analysis::Raw::writeAsText_profiledb(const char* filenm, bool easygrep)
       case fmt_version_invalid:
         DIAG_Throw("Not a profile.db file");
       case fmt_version_backward:
-        DIAG_Throw("Incompatible profile.db version (too old)");
+        // Older minor versions are a subset of this one
+        break;
       case fmt_version_major:
         DIAG_Throw("Incompatible profile.db version (major version mismatch)");
       case fmt_version_forward:
@@ -220,6 +221,7 @@ Analysis::Raw::writeAsText_profiledb(const char* filenm, bool easygrep)
           "    ]\n"
           "    (pIdTuple: 0x" << pi.pIdTuple << ")\n"
           "    (isSummary: " << (pi.isSummary ? 1 : 0) << ")\n"
+          "    (isCompressed: " << (pi.isCompressed ? 1 : 0) << ")\n"
           "  ]\n";
       }
       std::cout << "]\n" << std::dec;
@@ -282,6 +284,26 @@ Analysis::Raw::writeAsText_profiledb(const char* filenm, bool easygrep)
         continue;
       }
 
+      if(pi.isCompressed) {
+        // Only list the blocks, decompressing is left to hpcprof
+        const uint64_t nBlks = FMT_PROFILEDB_N_CBlks(psvb.nValues);
+        std::vector<char> buf(nBlks * FMT_PROFILEDB_SZ_CBlk);
+        if(fseeko(fs, psvb.pValues, SEEK_SET) < 0)
+          DIAG_Throw("error seeking to profile.db profile data segment");
+        if(fread(buf.data(), 1, buf.size(), fs) < buf.size())
+          DIAG_Throw("eof reading profile.db compressed block table");
+
+        std::cout << std::hex << "(0x" << psvb.pValues << ") [compressed profile data:\n";
+        for(uint64_t i = 0; i < nBlks; i++) {
+          fmt_profiledb_cBlk_t blk;
+          fmt_profiledb_cBlk_read(&blk, &buf[i * FMT_PROFILEDB_SZ_CBlk]);
+          std::cout << "  [" << std::dec << i << std::hex << "] (pData: +0x" << blk.pData
+                    << ") (szData: 0x" << blk.szData << ") (szRaw: 0x" << blk.szRaw << ")\n";
+        }
+        std::cout << "]\n" << std::dec;
+        continue;
+      }
+
       if(fseeko(fs, psvb.pValues, SEEK_SET) < 0)
         DIAG_Throw("error seeking to profile.db profile data segment");
       std::vector<char> buf(psvb.pCtxIndices + psvb.nCtxs*FMT_PROFILEDB_SZ_CIdx - psvb.pValues);
@@ -360,17 +382,18 @@ Analysis::Raw::writeAsText_cctdb(const char* filenm, bool easygrep)
       DIAG_Throw("error opening cct.db file '" << filenm << "'");
     }
 
+    uint8_t minor;
     {
       char buf[16];
       if(fread(buf, 1, sizeof buf, fs) < sizeof buf)
         DIAG_Throw("eof/error reading cct.db format header");
-      uint8_t minor;
       auto ver = fmt_cctdb_check(buf, &minor);
       switch(ver) {
       case fmt_version_invalid:
         DIAG_Throw("Not a cct.db file");
       case fmt_version_backward:
-        DIAG_Throw("Incompatible cct.db version (too old)");
+        // Older minor versions are a subset of this one
+        break;
       case fmt_version_major:
         DIAG_Throw("Incompatible cct.db version (major version mismatch)");
       case fmt_version_forward:
@@ -393,10 +416,11 @@ Analysis::Raw::writeAsText_cctdb(const char* filenm, bool easygrep)
       char buf[FMT_CCTDB_SZ_FHdr];
       if(fread(buf, 1, sizeof buf, fs) < sizeof buf)
         DIAG_Throw("eof reading cct.db file header");
-      fmt_cctdb_fHdr_read(&fhdr, buf);
+      fmt_cctdb_fHdr_read(&fhdr, buf, minor);
       std::cout << std::hex <<
         "[file header:\n"
         "  (szCtxInfo: 0x" << fhdr.szCtxInfo << ") (pCtxInfo: 0x" << fhdr.pCtxInfo << ")\n"
+        "  (szCtxBlocks: 0x" << fhdr.szCtxBlocks << ") (pCtxBlocks: 0x" << fhdr.pCtxBlocks << ")\n"
         "]\n" << std::dec;
     }
 
@@ -432,6 +456,25 @@ Analysis::Raw::writeAsText_cctdb(const char* filenm, bool easygrep)
       std::cout << "]\n" << std::dec;
     }
 
+    if(fhdr.szCtxBlocks > 0) { // Compressed Context Blocks section
+      // Only list the blocks, decompressing is left to hpcprof
+      if(fseeko(fs, fhdr.pCtxBlocks, SEEK_SET) < 0)
+        DIAG_Throw("error seeking to cct.db Compressed Context Blocks section");
+      std::vector<char> buf(fhdr.szCtxBlocks);
+      if(fread(buf.data(), 1, buf.size(), fs) < buf.size())
+        DIAG_Throw("eof reading cct.db Compressed Context Blocks section");
+
+      std::cout << "[compressed context blocks:\n" << std::hex;
+      for(uint64_t i = 0; i < fhdr.szCtxBlocks / FMT_CCTDB_SZ_CBlk; i++) {
+        fmt_cctdb_cBlk_t blk;
+        fmt_cctdb_cBlk_read(&blk, &buf[i * FMT_CCTDB_SZ_CBlk]);
+        std::cout << "  [" << std::dec << i << std::hex << "] (pData: +0x" << blk.pData
+                  << ") (szData: 0x" << blk.szData << ") (szRaw: 0x" << blk.szRaw << ")\n";
+      }
+      std::cout << "]\n" << std::dec;
+      cis.clear();
+    }
+
     // Rest of the file is context metric data. Pointers are listed in the CIs,
     // we output in file order.
     std::sort(cis.begin(), cis.end(), [](const auto& a, const auto& b){
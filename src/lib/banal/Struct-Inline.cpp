@@ -78,9 +78,13 @@
 
 #include <string.h>
 
+#include <atomic>
 #include <list>
+#include <mutex>
 #include <set>
+#include <shared_mutex>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -108,6 +112,111 @@ static Symtab *the_symtab = NULL;
 
 #define DEBUG_INLINE_SEQNS  0
 
+// Memoized inline sequences, keyed by the innermost Symtab function
+// node.  Every address inside one inlined node has the same sequence,
+// so we only walk the parents, demangle and realpath once per node
+// instead of once per instruction.  The cache is shared by all of the
+// struct threads and is mostly read, so use a reader/writer lock.
+//
+// The keys are Symtab pointers, so the cache must be emptied whenever
+// the_symtab changes.
+typedef unordered_map <FunctionBase *, Inline::InlineSeqn> SeqnCache;
+
+static SeqnCache seqnCache;
+static shared_mutex seqnCacheMtx;
+
+// Each thread also keeps the span of addresses around its last lookup
+// that lie in the same innermost node, outside any of the node's own
+// inlined children.  A thread mostly looks up the addresses of one
+// function in order, so the next few lookups usually fall in the span
+// and skip getContainingInlinedFunction() as well as the cache.  The
+// generation says which symtab the span belongs to.
+struct SeqnSpan {
+  long generation = -1;
+  VMA low = 0;
+  VMA high = 0;
+  Inline::InlineSeqn seqn;
+};
+
+static atomic <long> cacheGeneration(0);
+static thread_local SeqnSpan lastSpan;
+
+// Lookup and hit counts, one pair per thread so that counting does not
+// contend.  Each pair is only written by its own thread and is summed
+// once the struct threads are done.
+struct CacheStats {
+  atomic <long> lookups{0};
+  atomic <long> hits{0};
+};
+
+static list <CacheStats> allStats;
+static mutex allStatsMtx;
+static thread_local CacheStats * myStats = NULL;
+
+static void
+countLookup(bool hit)
+{
+  if (myStats == NULL) {
+    lock_guard <mutex> lock(allStatsMtx);
+    myStats = &allStats.emplace_back();
+  }
+  auto bump = [](atomic <long> & n) {
+    n.store(n.load(memory_order_relaxed) + 1, memory_order_relaxed);
+  };
+  bump(myStats->lookups);
+  if (hit) { bump(myStats->hits); }
+}
+
+static void
+clearSeqnCache()
+{
+  unique_lock <shared_mutex> lock(seqnCacheMtx);
+
+  seqnCache.clear();
+  cacheGeneration++;
+
+  lock_guard <mutex> stats_lock(allStatsMtx);
+  for (auto & stats : allStats) {
+    stats.lookups = 0;
+    stats.hits = 0;
+  }
+}
+
+// The span of addresses around addr that lie in func's range and not in
+// any of its inlined children, or an empty span if func's ranges do not
+// cover addr.
+static void
+innermostSpan(FunctionBase * func, VMA addr, VMA & low, VMA & high)
+{
+  low = high = 0;
+  for (auto & range : func->getRanges()) {
+    if (range.low() <= addr && addr < range.high()) {
+      low = range.low();
+      high = range.high();
+      break;
+    }
+  }
+  if (low == high) {
+    return;
+  }
+
+  for (auto * child : func->getInlines()) {
+    for (auto & range : child->getRanges()) {
+      if (range.high() <= addr) {
+        low = max <VMA> (low, range.high());
+      }
+      else if (range.low() > addr) {
+        high = min <VMA> (high, range.low());
+      }
+      else {
+        // func is the innermost node at addr, so this cannot happen
+        low = high = 0;
+        return;
+      }
+    }
+  }
+}
+
 //***************************************************************************
 
 namespace Inline {
@@ -116,6 +225,8 @@ namespace Inline {
 Symtab *
 openSymtab(ElfFile *elfFile)
 {
+  clearSeqnCache();
+
   bool ret = Symtab::openFile(the_symtab, elfFile->getMemory(),
                               elfFile->getLength(), elfFile->getFileName());
 
@@ -145,10 +256,26 @@ closeSymtab()
     ret = Symtab::closeSymtab(the_symtab);
   }
   the_symtab = NULL;
+  clearSeqnCache();
 
   return ret;
 }
 
+// Returns the number of analyzeAddr() lookups and the number that
+// were answered from the sequence cache since the symtab was opened.
+//
+void
+getCacheStats(long & lookups, long & hits)
+{
+  lock_guard <mutex> lock(allStatsMtx);
+
+  lookups = hits = 0;
+  for (auto & stats : allStats) {
+    lookups += stats.lookups;
+    hits += stats.hits;
+  }
+}
+
 //***************************************************************************
 
 // Returns nodelist as a list of InlineNodes for the inlined sequence
@@ -166,10 +293,34 @@ analyzeAddr(InlineSeqn & nodelist, VMA addr, RealPathMgr * realPath)
   }
   nodelist.clear();
 
+  long generation = cacheGeneration;
+  if (lastSpan.generation == generation
+      && lastSpan.low <= addr && addr < lastSpan.high) {
+    nodelist = lastSpan.seqn;
+    countLookup(true);
+    return true;
+  }
+
   if (the_symtab->getContainingInlinedFunction(addr, func) && func != NULL)
   {
     ret = true;
 
+    FunctionBase *inner = func;
+    VMA low, high;
+    innermostSpan(inner, addr, low, high);
+    {
+      shared_lock <shared_mutex> lock(seqnCacheMtx);
+      auto it = seqnCache.find(inner);
+
+      if (it != seqnCache.end()) {
+        nodelist = it->second;
+        lastSpan = { generation, low, high, nodelist };
+        countLookup(true);
+        return true;
+      }
+    }
+    countLookup(false);
+
     parent = func->getInlinedParent();
     while (parent != NULL) {
       //
@@ -199,6 +350,13 @@ analyzeAddr(InlineSeqn & nodelist, VMA addr, RealPathMgr * realPath)
       func = parent;
       parent = func->getInlinedParent();
     }
+
+    lastSpan = { generation, low, high, nodelist };
+
+    // two threads may race to fill the same entry, but they compute
+    // the same sequence, so the first one wins.
+    unique_lock <shared_mutex> lock(seqnCacheMtx);
+    seqnCache.emplace(inner, nodelist);
   }
 
   return ret;
@@ -360,6 +360,8 @@ bool closeSymtab();
 
 bool analyzeAddr(InlineSeqn & nodelist, VMA addr, RealPathMgr *);
 
+void getCacheStats(long & lookups, long & hits);
+
 void
 addStmtToTree(TreeNode * root, HPC::StringTable & strTab, RealPathMgr *,
               VMA vma, int len, string & filenm, SrcFile::ln line,
@@ -887,9 +887,15 @@ makeStructure(string filename,
     Output::printLoadModuleEnd(outFile);
 
     if (opts.show_time) {
+      long lookups, hits;
+      Inline::getCacheStats(lookups, hits);
+
       printTime("struct:", &tv_parse, &ru_parse, &tv_fini, &ru_fini);
       printTime("total: ", &tv_init, &ru_init, &tv_fini, &ru_fini);
-      cout << "\nnum funcs: " << wlPrint.size() << "\n" << endl;
+      cout << "\nnum funcs: " << wlPrint.size() << "\n"
+           << "inline lookups: " << lookups << "  cache hits: " << hits
+           << "  (" << ((lookups > 0) ? (100 * hits / lookups) : 0) << "%)\n"
+           << endl;
     }
 
 #if DEBUG_NEW_GAPS
@@ -78,9 +78,17 @@ enum fmt_version_t fmt_cctdb_check(const char hdr[16], uint8_t* minorVer) {
          ? fmt_version_forward : fmt_version_exact;
 }
 
-void fmt_cctdb_fHdr_read(fmt_cctdb_fHdr_t* hdr, const char d[FMT_CCTDB_SZ_FHdr]) {
+void fmt_cctdb_fHdr_read(fmt_cctdb_fHdr_t* hdr, const char d[FMT_CCTDB_SZ_FHdr], uint8_t minorVer) {
   hdr->szCtxInfo = fmt_u64_read(d+0x10);
   hdr->pCtxInfo = fmt_u64_read(d+0x18);
+  // In v4.0 the header ends at 0x20, these bytes are the Context Info section
+  if(minorVer >= 1) {
+    hdr->szCtxBlocks = fmt_u64_read(d+0x20);
+    hdr->pCtxBlocks = fmt_u64_read(d+0x28);
+  } else {
+    hdr->szCtxBlocks = 0;
+    hdr->pCtxBlocks = 0;
+  }
 }
 void fmt_cctdb_fHdr_write(char d[FMT_CCTDB_SZ_FHdr], const fmt_cctdb_fHdr_t* hdr) {
   memcpy(d, fmt_cctdb_magic, sizeof fmt_cctdb_magic);
@@ -88,6 +96,8 @@ void fmt_cctdb_fHdr_write(char d[FMT_CCTDB_SZ_FHdr], const fmt_cctdb_fHdr_t* hdr
   d[0x0f] = FMT_CCTDB_MinorVersion;
   fmt_u64_write(d+0x10, hdr->szCtxInfo);
   fmt_u64_write(d+0x18, hdr->pCtxInfo);
+  fmt_u64_write(d+0x20, hdr->szCtxBlocks);
+  fmt_u64_write(d+0x28, hdr->pCtxBlocks);
 }
 
 void fmt_cctdb_ctxInfoSHdr_read(fmt_cctdb_ctxInfoSHdr_t* hdr, const char d[FMT_CCTDB_SZ_CtxInfoSHdr]) {
@@ -133,3 +143,14 @@ void fmt_cctdb_mIdx_write(char d[FMT_CCTDB_SZ_MIdx], const fmt_cctdb_mIdx_t* idx
   fmt_u16_write(d+0x00, idx->metricId);
   fmt_u64_write(d+0x02, idx->startIndex);
 }
+
+void fmt_cctdb_cBlk_read(fmt_cctdb_cBlk_t* blk, const char d[FMT_CCTDB_SZ_CBlk]) {
+  blk->pData = fmt_u64_read(d+0x00);
+  blk->szData = fmt_u64_read(d+0x08);
+  blk->szRaw = fmt_u64_read(d+0x10);
+}
+void fmt_cctdb_cBlk_write(char d[FMT_CCTDB_SZ_CBlk], const fmt_cctdb_cBlk_t* blk) {
+  fmt_u64_write(d+0x00, blk->pData);
+  fmt_u64_write(d+0x08, blk->szData);
+  fmt_u64_write(d+0x10, blk->szRaw);
+}
@@ -56,7 +56,7 @@ extern "C" {
 #endif
 
 /// Minor version of the cct.db format implemented here
-enum { FMT_CCTDB_MinorVersion = 0 };
+enum { FMT_CCTDB_MinorVersion = 1 };
 
 /// Check the given file start bytes for the cct.db format.
 /// If minorVer != NULL, also returns the exact minor version.
@@ -77,10 +77,13 @@ typedef struct fmt_cctdb_fHdr_t {
   // NOTE: magic and versions are constant and cannot be adjusted
   uint64_t szCtxInfo;
   uint64_t pCtxInfo;
+  uint64_t szCtxBlocks;
+  uint64_t pCtxBlocks;
 } fmt_cctdb_fHdr_t;
 
-/// Read a cct.db file header from a byte array
-void fmt_cctdb_fHdr_read(fmt_cctdb_fHdr_t*, const char[FMT_CCTDB_SZ_FHdr]);
+/// Read a cct.db file header from a byte array, of the given minor version
+/// (from fmt_cctdb_check). Fields added after that version are zeroed.
+void fmt_cctdb_fHdr_read(fmt_cctdb_fHdr_t*, const char[FMT_CCTDB_SZ_FHdr], uint8_t minorVer);
 
 /// Write a cct.db file header into a byte array
 void fmt_cctdb_fHdr_write(char[FMT_CCTDB_SZ_FHdr], const fmt_cctdb_fHdr_t*);
@@ -135,6 +138,27 @@ typedef struct fmt_cctdb_mIdx_t {
 void fmt_cctdb_mIdx_read(fmt_cctdb_mIdx_t*, const char[FMT_CCTDB_SZ_MIdx]);
 void fmt_cctdb_mIdx_write(char[FMT_CCTDB_SZ_MIdx], const fmt_cctdb_mIdx_t*);
 
+//
+// Compressed Context Blocks section
+//
+
+// Compressed Block descriptor {CBlk}
+enum { FMT_CCTDB_SZ_CBlk = 0x18 };
+typedef struct fmt_cctdb_cBlk_t {
+  uint64_t pData;  // NOTE: Relative to the start of the {CBlk} array
+  uint64_t szData;
+  uint64_t szRaw;
+} fmt_cctdb_cBlk_t;
+
+void fmt_cctdb_cBlk_read(fmt_cctdb_cBlk_t*, const char[FMT_CCTDB_SZ_CBlk]);
+void fmt_cctdb_cBlk_write(char[FMT_CCTDB_SZ_CBlk], const fmt_cctdb_cBlk_t*);
+
+/// Number of consecutive contexts compressed together in a single {CBlk}
+enum { FMT_CCTDB_CBlkCtxs = 0x400 };
+
+#define FMT_CCTDB_N_CBlks(nCtxs) \
+  (((nCtxs) + FMT_CCTDB_CBlkCtxs - 1) / FMT_CCTDB_CBlkCtxs)
+
 #if defined(__cplusplus)
 }  // extern "C"
 #endif
@@ -113,6 +113,7 @@ void fmt_profiledb_profInfo_read(fmt_profiledb_profInfo_t* pi, const char d[FMT_
   pi->pIdTuple = fmt_u64_read(d+0x20);
   uint32_t flags = fmt_u32_read(d+0x28);
   pi->isSummary = (flags & 0x1) != 0;
+  pi->isCompressed = (flags & 0x2) != 0;
 }
 void fmt_profiledb_profInfo_write(char d[FMT_PROFILEDB_SZ_ProfInfo], const fmt_profiledb_profInfo_t* pi) {
   fmt_u64_write(d+0x00, pi->valueBlock.nValues);
@@ -122,6 +123,7 @@ void fmt_profiledb_profInfo_write(char d[FMT_PROFILEDB_SZ_ProfInfo], const fmt_p
   fmt_u64_write(d+0x18, pi->valueBlock.pCtxIndices);
   fmt_u64_write(d+0x20, pi->pIdTuple);
   fmt_u32_write(d+0x28, (pi->isSummary ? 0x1 : 0) |
+                        (pi->isCompressed ? 0x2 : 0) |
                         0);
   memset(d+0x2c, 0, FMT_PROFILEDB_SZ_ProfInfo - 0x2c);
 }
@@ -144,6 +146,62 @@ void fmt_profiledb_cIdx_write(char d[FMT_PROFILEDB_SZ_CIdx], const fmt_profiledb
   fmt_u64_write(d+0x04, ci->startIndex);
 }
 
+void fmt_profiledb_cBlk_read(fmt_profiledb_cBlk_t* blk, const char d[FMT_PROFILEDB_SZ_CBlk]) {
+  blk->pData = fmt_u64_read(d+0x00);
+  blk->szData = fmt_u64_read(d+0x08);
+  blk->szRaw = fmt_u64_read(d+0x10);
+}
+void fmt_profiledb_cBlk_write(char d[FMT_PROFILEDB_SZ_CBlk], const fmt_profiledb_cBlk_t* blk) {
+  fmt_u64_write(d+0x00, blk->pData);
+  fmt_u64_write(d+0x08, blk->szData);
+  fmt_u64_write(d+0x10, blk->szRaw);
+}
+
+// Packed {Val} arrays list all the metricIds first, then all the values.
+void fmt_profiledb_mVals_pack(char* out, const char* in, uint64_t n) {
+  char* ids = out;
+  char* vals = out + n * 2;
+  for(uint64_t i = 0; i < n; i++, in += FMT_PROFILEDB_SZ_MVal) {
+    memcpy(ids + i * 2, in + 0x00, 2);
+    memcpy(vals + i * 8, in + 0x02, 8);
+  }
+}
+void fmt_profiledb_mVals_unpack(char* out, const char* in, uint64_t n) {
+  const char* ids = in;
+  const char* vals = in + n * 2;
+  for(uint64_t i = 0; i < n; i++, out += FMT_PROFILEDB_SZ_MVal) {
+    memcpy(out + 0x00, ids + i * 2, 2);
+    memcpy(out + 0x02, vals + i * 8, 8);
+  }
+}
+
+// Packed {Idx} arrays list all the ctxIds first, then all the startIndices.
+// Both are sorted, so each is stored as the difference from the previous.
+void fmt_profiledb_cIdxs_pack(char* out, const char* in, uint32_t n) {
+  char* ids = out;
+  char* idxs = out + (uint64_t)n * 4;
+  uint32_t prevId = 0;
+  uint64_t prevIdx = 0;
+  for(uint32_t i = 0; i < n; i++, in += FMT_PROFILEDB_SZ_CIdx) {
+    fmt_profiledb_cIdx_t ci;
+    fmt_profiledb_cIdx_read(&ci, in);
+    fmt_u32_write(ids + (uint64_t)i * 4, ci.ctxId - prevId);
+    fmt_u64_write(idxs + (uint64_t)i * 8, ci.startIndex - prevIdx);
+    prevId = ci.ctxId;
+    prevIdx = ci.startIndex;
+  }
+}
+void fmt_profiledb_cIdxs_unpack(char* out, const char* in, uint32_t n) {
+  const char* ids = in;
+  const char* idxs = in + (uint64_t)n * 4;
+  fmt_profiledb_cIdx_t ci = {.ctxId = 0, .startIndex = 0};
+  for(uint32_t i = 0; i < n; i++, out += FMT_PROFILEDB_SZ_CIdx) {
+    ci.ctxId += fmt_u32_read(ids + (uint64_t)i * 4);
+    ci.startIndex += fmt_u64_read(idxs + (uint64_t)i * 8);
+    fmt_profiledb_cIdx_write(out, &ci);
+  }
+}
+
 void fmt_profiledb_idTupleHdr_read(fmt_profiledb_idTupleHdr_t* hdr, const char d[FMT_PROFILEDB_SZ_IdTupleHdr]) {
   hdr->nIds = fmt_u16_read(d+0x00);
 }
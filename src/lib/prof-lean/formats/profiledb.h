@@ -56,7 +56,7 @@ extern "C" {
 #endif
 
 /// Minor version of the profile.db format implemented here
-enum { FMT_PROFILEDB_MinorVersion = 0 };
+enum { FMT_PROFILEDB_MinorVersion = 1 };
 
 /// Check the given file start bytes for the profile.db format.
 /// If minorVer != NULL, also returns the exact minor version.
@@ -115,6 +115,7 @@ typedef struct fmt_profiledb_profInfo_t {
   } valueBlock;
   uint64_t pIdTuple;
   bool isSummary : 1;
+  bool isCompressed : 1;
 } fmt_profiledb_profInfo_t;
 
 void fmt_profiledb_profInfo_read(fmt_profiledb_profInfo_t*, const char[FMT_PROFILEDB_SZ_ProfInfo]);
@@ -140,6 +141,33 @@ typedef struct fmt_profiledb_cIdx_t {
 void fmt_profiledb_cIdx_read(fmt_profiledb_cIdx_t*, const char[FMT_PROFILEDB_SZ_CIdx]);
 void fmt_profiledb_cIdx_write(char[FMT_PROFILEDB_SZ_CIdx], const fmt_profiledb_cIdx_t*);
 
+// Compressed Block descriptor {CBlk}, only present if isCompressed
+enum { FMT_PROFILEDB_SZ_CBlk = 0x18 };
+typedef struct fmt_profiledb_cBlk_t {
+  uint64_t pData;  // NOTE: Relative to the start of the {CBlk} array
+  uint64_t szData;
+  uint64_t szRaw;
+} fmt_profiledb_cBlk_t;
+
+void fmt_profiledb_cBlk_read(fmt_profiledb_cBlk_t*, const char[FMT_PROFILEDB_SZ_CBlk]);
+void fmt_profiledb_cBlk_write(char[FMT_PROFILEDB_SZ_CBlk], const fmt_profiledb_cBlk_t*);
+
+/// Number of {Val} pairs compressed together in a single {CBlk}
+enum { FMT_PROFILEDB_CBlkValues = 0x4000 };
+
+#define FMT_PROFILEDB_N_CBlks(nValues) \
+  (((nValues) + FMT_PROFILEDB_CBlkValues - 1) / FMT_PROFILEDB_CBlkValues)
+
+/// Convert an array of {Val} pairs to and from the column-wise layout used
+/// within compressed blocks. The in and out arrays must not overlap.
+void fmt_profiledb_mVals_pack(char* out, const char* in, uint64_t nValues);
+void fmt_profiledb_mVals_unpack(char* out, const char* in, uint64_t nValues);
+
+/// Convert an array of {Idx} pairs to and from the delta-coded column-wise
+/// layout used within compressed blocks. The in and out arrays must not overlap.
+void fmt_profiledb_cIdxs_pack(char* out, const char* in, uint32_t nCtxs);
+void fmt_profiledb_cIdxs_unpack(char* out, const char* in, uint32_t nCtxs);
+
 //
 // profile.db Hierarchical Identifier Tuple section
 //
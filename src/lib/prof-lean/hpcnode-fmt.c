@@ -0,0 +1,171 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2023, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+
+//***************************************************************************
+//
+// Purpose:
+//   Low-level types and functions for reading/writing the node container
+//   (.hpcnode). See hpcnode-fmt.h.
+//
+//***************************************************************************
+
+//************************* System Include Files ****************************
+
+#include <stdlib.h>
+#include <string.h>
+
+//*************************** User Include Files ****************************
+
+#include "hpcio.h"
+#include "hpcnode-fmt.h"
+
+//***************************************************************************
+
+size_t
+hpcnode_fmt_hdr_swrite(char* buf)
+{
+  memcpy(buf, HPCNODE_FMT_Magic, HPCNODE_FMT_MagicLen);
+  return HPCNODE_FMT_MagicLen;
+}
+
+
+size_t
+hpcnode_fmt_entry_swrite(const char* name, uint64_t offset, uint64_t size, char* buf)
+{
+  uint32_t len = strlen(name);
+  char* p = buf;
+  p = hpcio_be8_swrite(offset, p);
+  p = hpcio_be8_swrite(size, p);
+  p = hpcio_be4_swrite(len, p);
+  memcpy(p, name, len);
+  return (p - buf) + len;
+}
+
+
+size_t
+hpcnode_fmt_trailer_swrite(uint64_t index_offset, uint64_t len, char* buf)
+{
+  char* p = buf;
+  p = hpcio_be8_swrite(index_offset, p);
+  p = hpcio_be8_swrite(len, p);
+  p = hpcio_be8_swrite(HPCNODEmagic, p);
+  return p - buf;
+}
+
+
+bool
+hpcnode_fmt_hdr_check(FILE* fs)
+{
+  char magic[HPCNODE_FMT_MagicLen];
+  if (fseek(fs, 0, SEEK_SET) != 0
+      || fread(magic, 1, HPCNODE_FMT_MagicLen, fs) != HPCNODE_FMT_MagicLen) {
+    return false;
+  }
+  return memcmp(magic, HPCNODE_FMT_Magic, HPCNODE_FMT_MagicLen) == 0;
+}
+
+
+int
+hpcnode_fmt_index_fread(hpcnode_fmt_index_t* x, FILE* fs, hpcfmt_alloc_fn alloc)
+{
+  uint64_t index_offset, magic;
+
+  x->len = 0;
+  x->lst = NULL;
+
+  if (!hpcnode_fmt_hdr_check(fs)) {
+    return HPCFMT_ERR;
+  }
+
+  if (fseek(fs, -(long) HPCNODE_FMT_TrailerLen, SEEK_END) != 0) {
+    return HPCFMT_ERR;
+  }
+  long end = ftell(fs);
+  HPCFMT_ThrowIfError(hpcfmt_int8_fread(&index_offset, fs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fread(&x->len, fs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fread(&magic, fs));
+  if (magic != HPCNODEmagic || index_offset > (uint64_t) end) {
+    return HPCFMT_ERR;
+  }
+
+  // every entry takes at least 20 bytes, which bounds a corrupt count
+  if (x->len > ((uint64_t) end - index_offset) / 20) {
+    return HPCFMT_ERR;
+  }
+
+  x->lst = alloc(x->len * sizeof(hpcnode_fmt_entry_t));
+  if (x->lst == NULL) {
+    return HPCFMT_ERR;
+  }
+
+  fseek(fs, index_offset, SEEK_SET);
+  for (uint64_t i = 0; i < x->len; i++) {
+    hpcnode_fmt_entry_t* e = &x->lst[i];
+    e->name = NULL;
+    if (hpcfmt_int8_fread(&e->offset, fs) != HPCFMT_OK
+        || hpcfmt_int8_fread(&e->size, fs) != HPCFMT_OK
+        || hpcfmt_str_fread(&e->name, fs, alloc) != HPCFMT_OK
+        || e->offset + e->size > index_offset) {
+      x->len = i + (e->name != NULL);
+      return HPCFMT_ERR;
+    }
+  }
+
+  return HPCFMT_OK;
+}
+
+
+void
+hpcnode_fmt_index_free(hpcnode_fmt_index_t* x, hpcfmt_free_fn dealloc)
+{
+  for (uint64_t i = 0; i < x->len; i++) {
+    hpcfmt_str_free(x->lst[i].name, dealloc);
+  }
+  dealloc(x->lst);
+  x->lst = NULL;
+  x->len = 0;
+}
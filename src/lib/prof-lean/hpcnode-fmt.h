@@ -0,0 +1,146 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2023, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+
+//***************************************************************************
+//
+// Purpose:
+//   Low-level types and functions for reading/writing the node container
+//   (.hpcnode), which holds the measurement files that all hpcrun
+//   processes on one node handed to the node-local aggregator.
+//
+//   See hpcrun-fmt.h for the profiles and traces held inside.
+//
+//***************************************************************************
+
+#ifndef HPCNODE_FMT_H
+#define HPCNODE_FMT_H
+
+//************************* System Include Files ****************************
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+//*************************** User Include Files ****************************
+
+#include "hpcfmt.h"
+
+//*************************** Forward Declarations **************************
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+//***************************************************************************
+//
+//   <file>    ::= <header> <data>* <index> <trailer>
+//
+//   <header>  ::= HPCNODE_FMT_Magic
+//   <data>    ::= the bytes of one measurement file, exactly as hpcrun
+//                 would have written it on its own
+//   <index>   ::= { <offset: 8> <size: 8> <name: hpcfmt_str> }*
+//   <trailer> ::= <index offset: 8> <number of entries: 8> HPCNODEmagic
+//
+//   Integers are big-endian. The data of each file is contiguous, but the
+//   files appear in the order they were started, not by name. The index
+//   is written last, when the aggregator shuts down.
+//
+//***************************************************************************
+
+static const char HPCNODE_FMT_Magic[] = "HPCNODE_v01.00__";
+#define HPCNODE_FMT_MagicLen (sizeof(HPCNODE_FMT_Magic) - 1)
+
+static const uint64_t HPCNODEmagic = 0x4850434E4F44456D; // "HPCNODEm"
+
+static const char HPCNODE_FnmSfx[] = "hpcnode";
+
+#define HPCNODE_FMT_TrailerLen (3 * 8)
+
+typedef struct hpcnode_fmt_entry_t {
+  char* name;       // name of the file hpcrun would have written
+  uint64_t offset;  // byte offset of its data in the container
+  uint64_t size;
+} hpcnode_fmt_entry_t;
+
+typedef struct hpcnode_fmt_index_t {
+  uint64_t len;
+  hpcnode_fmt_entry_t* lst;
+} hpcnode_fmt_index_t;
+
+
+// Write the header, an index entry or the trailer to buf, which must be
+// large enough. Returns the number of bytes written.
+size_t
+hpcnode_fmt_hdr_swrite(char* buf);
+
+size_t
+hpcnode_fmt_entry_swrite(const char* name, uint64_t offset, uint64_t size, char* buf);
+
+size_t
+hpcnode_fmt_trailer_swrite(uint64_t index_offset, uint64_t len, char* buf);
+
+
+// Whether fs starts with a node container header
+bool
+hpcnode_fmt_hdr_check(FILE* fs);
+
+// Read the index of the container in fs. Free x with
+// hpcnode_fmt_index_free afterwards, even if reading failed.
+int
+hpcnode_fmt_index_fread(hpcnode_fmt_index_t* x, FILE* fs, hpcfmt_alloc_fn alloc);
+
+void
+hpcnode_fmt_index_free(hpcnode_fmt_index_t* x, hpcfmt_free_fn dealloc);
+
+//***************************************************************************
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif
+
+#endif /* HPCNODE_FMT_H */
@@ -1208,6 +1208,64 @@ void hpcrun_sparse_footer_update_w_start(hpcrun_fmt_footer_t *f, size_t start_po
 
 }
 
+// hpcrun may append the profiles of all the threads of a process to one
+// file, each laid out as a standalone file with offsets relative to its own
+// start. The footer at the end of one profile locates its start, which is
+// where the profile before it ends.
+/* succeed: return 0 and set *start_pos; not a profile: return -1 */
+int hpcrun_sparse_segment_start(FILE* fs, size_t end_pos, size_t* start_pos)
+{
+  if(end_pos < (size_t) SF_footer_SIZE) return SF_ERR;
+  size_t footer_position = end_pos - SF_footer_SIZE;
+  if(fseek(fs, footer_position, SEEK_SET) != 0) return SF_ERR;
+
+  hpcrun_fmt_footer_t footer;
+  if(hpcrun_fmt_footer_fread(&footer, fs) != HPCFMT_OK) return SF_ERR;
+  if(footer.footer_start > footer_position) return SF_ERR;
+
+  *start_pos = footer_position - footer.footer_start;
+  return SF_SUCCEED;
+}
+
+// A profile that failed to be appended leaves bytes that are not a profile,
+// which stops the walk back through the footers. The complete profiles before
+// them are found by scanning forward for a footer whose profile starts with
+// the file magic, no earlier than pos.
+/* succeed: return 0 and set *start_pos, *seg_end; none left: return 1 */
+int hpcrun_sparse_segment_next(FILE* fs, size_t pos, size_t end_pos,
+                               size_t* start_pos, size_t* seg_end)
+{
+  static const char footer_magic[] = "HPCRUNsm";  // HPCRUNsm, big endian
+  const size_t magic_len = sizeof(footer_magic) - 1;
+  char buf[1 << 16];
+
+  size_t off = pos;
+  while(off + magic_len <= end_pos) {
+    size_t n = end_pos - off < sizeof(buf) ? end_pos - off : sizeof(buf);
+    if(fseek(fs, off, SEEK_SET) != 0) return SF_ERR;
+    n = fread(buf, 1, n, fs);
+    if(n < magic_len) return SF_FAIL;
+
+    for(size_t i = 0; i + magic_len <= n; i++) {
+      if(memcmp(buf + i, footer_magic, magic_len) != 0) continue;
+      size_t end = off + i + magic_len;
+      size_t start;
+      char tag[HPCRUN_FMT_MagicLen];
+      if(hpcrun_sparse_segment_start(fs, end, &start) == SF_SUCCEED && start >= pos
+         && fseek(fs, start, SEEK_SET) == 0
+         && fread(tag, 1, HPCRUN_FMT_MagicLen, fs) == (size_t) HPCRUN_FMT_MagicLen
+         && memcmp(tag, HPCRUN_FMT_Magic, HPCRUN_FMT_MagicLen) == 0) {
+        *start_pos = start;
+        *seg_end = end;
+        return SF_SUCCEED;
+      }
+    }
+    // keep the bytes that could begin a magic split across the boundary
+    off += n - (magic_len - 1);
+  }
+  return SF_FAIL;
+}
+
 /* succeed: return 0; fail: return 1; */
 int hpcrun_sparse_pause(hpcrun_sparse_file_t* sparse_fs)
 {
@@ -163,6 +163,9 @@ hpcrun_fmt_hdr_free(hpcrun_fmt_hdr_t* hdr, hpcfmt_free_fn dealloc);
 #define HPCRUN_FMT_NV_traceMinTime "trace-min-time"
 #define HPCRUN_FMT_NV_traceMaxTime "trace-max-time"
 #define HPCRUN_FMT_NV_traceDisorder "trace-disorder"
+// Value of trace-disorder when the trace was more disordered than could be
+// measured, so a reader cannot sort it with any bounded buffer
+#define HPCRUN_FMT_TraceDisorderUnbounded "unbounded"
 
 #define HPCRUN_FMT_METRIC_HIDE            0
 #define HPCRUN_FMT_METRIC_SHOW            1
@@ -764,6 +767,9 @@ typedef struct hpcrun_sparse_file {
 } hpcrun_sparse_file_t;
 
 void hpcrun_sparse_footer_update_w_start(hpcrun_fmt_footer_t *f, size_t start_pos);
+int hpcrun_sparse_segment_start(FILE* fs, size_t end_pos, size_t* start_pos);
+int hpcrun_sparse_segment_next(FILE* fs, size_t pos, size_t end_pos,
+                               size_t* start_pos, size_t* seg_end);
 
 hpcrun_sparse_file_t* hpcrun_sparse_open(const char* path, size_t start_pos, size_t end_pos);
 int hpcrun_sparse_pause(hpcrun_sparse_file_t* sparse_fs);
@@ -811,6 +817,10 @@ typedef struct hpctrace_hdr_flags_bitfield {
 #define HPCTRACE_HDR_FLAGS_DATA_CENTRIC_BIT_POS 0U
 #define HPCTRACE_HDR_FLAGS_LCA_RECORDED_BIT_POS 1U
 #define HPCTRACE_HDR_FLAGS_CALL_TRACE_BIT_POS 2U
+// Records with the same call path, metric and dLCA as the record before
+// them were left out, so each record starts a run that lasts until the next record. If
+// the last run was longer than one record, its last record is kept too.
+#define HPCTRACE_HDR_FLAGS_COALESCED_BIT_POS 3U
 
 #define HPCTRACE_HDR_FLAGS_GET_BIT(flag, pos) \
   ((flag >> pos) & 1U)
@@ -984,6 +994,8 @@ hpcmetricDB_fmt_hdr_fprint(hpcmetricDB_fmt_hdr_t* hdr, FILE* outfs);
 // --------------------------------------------------------------------------
 
 typedef struct sampling_info_s {
+  // time the sample was taken, in nanoseconds since the epoch like the
+  // trace records, or 0 if it is being taken now
   uint64_t  sample_clock;
   void     *sample_data;
 
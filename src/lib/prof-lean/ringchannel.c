@@ -0,0 +1,178 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2023, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+
+//*****************************************************************************
+// system includes
+//*****************************************************************************
+
+#include <string.h>
+
+
+
+//*****************************************************************************
+// local includes
+//*****************************************************************************
+
+#include "ringchannel.h"
+
+
+
+//*****************************************************************************
+// private operations
+//*****************************************************************************
+
+static inline char *
+ringchannel_slot
+(
+ ringchannel_t *ch,
+ size_t index
+)
+{
+  return ch->slots + (index & ch->mask) * ch->elem_size;
+}
+
+
+
+//*****************************************************************************
+// interface operations
+//*****************************************************************************
+
+void
+ringchannel_init
+(
+ ringchannel_t *ch,
+ void *slots,
+ size_t capacity,
+ size_t elem_size
+)
+{
+  atomic_init(&ch->head, 0);
+  atomic_init(&ch->tail, 0);
+  ch->tail_cache = 0;
+  ch->head_cache = 0;
+  ch->mask = capacity - 1;
+  ch->elem_size = elem_size;
+  ch->slots = (char *) slots;
+}
+
+
+size_t
+ringchannel_capacity
+(
+ ringchannel_t *ch
+)
+{
+  return ch->mask + 1;
+}
+
+
+size_t
+ringchannel_produce
+(
+ ringchannel_t *ch,
+ const void *elems,
+ size_t n
+)
+{
+  size_t tail = atomic_load_explicit(&ch->tail, memory_order_relaxed);
+  size_t capacity = ch->mask + 1;
+
+  // only look at the consumer's index when the cached view is too stale
+  // to admit the whole batch
+  if (capacity - (tail - ch->head_cache) < n) {
+    ch->head_cache = atomic_load_explicit(&ch->head, memory_order_acquire);
+  }
+  size_t space = capacity - (tail - ch->head_cache);
+  if (n > space) n = space;
+  if (n == 0) return 0;
+
+  // copy in at most two pieces, split where the ring wraps around
+  size_t first = capacity - (tail & ch->mask);
+  if (first > n) first = n;
+  memcpy(ringchannel_slot(ch, tail), elems, first * ch->elem_size);
+  memcpy(ringchannel_slot(ch, tail + first),
+         (const char *) elems + first * ch->elem_size,
+         (n - first) * ch->elem_size);
+
+  atomic_store_explicit(&ch->tail, tail + n, memory_order_release);
+  return n;
+}
+
+
+size_t
+ringchannel_peek
+(
+ ringchannel_t *ch,
+ void **first,
+ size_t max
+)
+{
+  size_t head = atomic_load_explicit(&ch->head, memory_order_relaxed);
+
+  if (ch->tail_cache - head < max) {
+    ch->tail_cache = atomic_load_explicit(&ch->tail, memory_order_acquire);
+  }
+  size_t n = ch->tail_cache - head;
+  size_t contiguous = ch->mask + 1 - (head & ch->mask);
+  if (n > contiguous) n = contiguous;
+  if (n > max) n = max;
+
+  *first = ringchannel_slot(ch, head);
+  return n;
+}
+
+
+void
+ringchannel_consume
+(
+ ringchannel_t *ch,
+ size_t n
+)
+{
+  size_t head = atomic_load_explicit(&ch->head, memory_order_relaxed);
+  atomic_store_explicit(&ch->head, head + n, memory_order_release);
+}
@@ -0,0 +1,164 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2023, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+
+#ifndef ringchannel_h
+#define ringchannel_h
+
+//*****************************************************************************
+// Description:
+//
+//   a bounded channel from one producer to one consumer. elements are
+//   copied by value into a power-of-two ring of fixed-size slots, so
+//   neither side allocates or frees per element. the producer and the
+//   consumer each write only their own index, and the two indices live
+//   on separate cache lines. both sides operate on batches of elements.
+//
+//*****************************************************************************
+
+
+
+//*****************************************************************************
+// system includes
+//*****************************************************************************
+
+#include <stddef.h>
+
+
+
+//*****************************************************************************
+// local includes
+//*****************************************************************************
+
+#include "stdatomic.h"
+
+
+
+//*****************************************************************************
+// macros
+//*****************************************************************************
+
+#define RINGCHANNEL_CACHE_LINE 64
+
+
+
+//*****************************************************************************
+// type declarations
+//*****************************************************************************
+
+typedef struct ringchannel_t {
+  // written only by the consumer
+  _Alignas(RINGCHANNEL_CACHE_LINE) atomic_size_t head;
+  size_t tail_cache;   // consumer's most recent view of tail
+
+  // written only by the producer
+  _Alignas(RINGCHANNEL_CACHE_LINE) atomic_size_t tail;
+  size_t head_cache;   // producer's most recent view of head
+
+  // immutable after initialization
+  _Alignas(RINGCHANNEL_CACHE_LINE) size_t mask;
+  size_t elem_size;
+  char *slots;
+} ringchannel_t;
+
+
+
+//*****************************************************************************
+// interface operations
+//*****************************************************************************
+
+// initialize a channel over storage for capacity elements of elem_size
+// bytes each. capacity must be a power of two.
+void
+ringchannel_init
+(
+ ringchannel_t *ch,
+ void *slots,
+ size_t capacity,
+ size_t elem_size
+);
+
+
+size_t
+ringchannel_capacity
+(
+ ringchannel_t *ch
+);
+
+
+// producer: copy up to n elements into the channel and return the
+// number copied, which is less than n only if the channel filled up
+size_t
+ringchannel_produce
+(
+ ringchannel_t *ch,
+ const void *elems,
+ size_t n
+);
+
+
+// consumer: return the number of elements, at most max, that can be
+// read in place starting at *first. the elements remain in the channel
+// until they are released with ringchannel_consume.
+size_t
+ringchannel_peek
+(
+ ringchannel_t *ch,
+ void **first,
+ size_t max
+);
+
+
+// consumer: release the first n elements returned by ringchannel_peek
+void
+ringchannel_consume
+(
+ ringchannel_t *ch,
+ size_t n
+);
+
+
+#endif
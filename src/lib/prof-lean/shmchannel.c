@@ -0,0 +1,294 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2023, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+
+//*****************************************************************************
+// system includes
+//*****************************************************************************
+
+#include <stddef.h>
+
+
+
+//*****************************************************************************
+// local includes
+//*****************************************************************************
+
+#include "shmchannel.h"
+
+
+
+//*****************************************************************************
+// macros
+//*****************************************************************************
+
+#define SHMCHANNEL_ROUND_UP(n) \
+  (((n) + SHMCHANNEL_CACHE_LINE - 1) & ~((size_t) SHMCHANNEL_CACHE_LINE - 1))
+
+// the header of a slot sits at its start, the message after it
+#define SHMCHANNEL_MSG_OFFSET SHMCHANNEL_ROUND_UP(sizeof(shmchannel_slot_t))
+
+
+
+//*****************************************************************************
+// type declarations
+//*****************************************************************************
+
+typedef struct shmchannel_slot_t {
+  atomic_uint_least64_t seq;
+  atomic_int owner;             // pid of the producer that claimed it, or 0
+} shmchannel_slot_t;
+
+
+
+//*****************************************************************************
+// private operations
+//*****************************************************************************
+
+static inline shmchannel_slot_t *
+shmchannel_slot
+(
+ shmchannel_t *ch,
+ uint64_t index
+)
+{
+  return (shmchannel_slot_t *) (ch->slots + (index & ch->mask) * ch->slot_size);
+}
+
+
+static inline atomic_uint_least64_t *
+shmchannel_seq
+(
+ shmchannel_t *ch,
+ uint64_t index
+)
+{
+  return &shmchannel_slot(ch, index)->seq;
+}
+
+
+// free the slot at head for the producer that claims it on the next lap,
+// provided its sequence number is still expected
+static int
+shmchannel_free_head
+(
+ shmchannel_t *ch,
+ uint64_t head,
+ uint64_t expected
+)
+{
+  atomic_store_explicit(&shmchannel_slot(ch, head)->owner, 0, memory_order_relaxed);
+  if (!atomic_compare_exchange_strong_explicit(shmchannel_seq(ch, head), &expected,
+                                               head + ch->mask + 1,
+                                               memory_order_release,
+                                               memory_order_relaxed)) {
+    return -1;
+  }
+  atomic_store_explicit(&ch->head, head + 1, memory_order_relaxed);
+  return 0;
+}
+
+
+static inline void *
+shmchannel_msg
+(
+ shmchannel_t *ch,
+ uint64_t index
+)
+{
+  return ch->slots + (index & ch->mask) * ch->slot_size + SHMCHANNEL_MSG_OFFSET;
+}
+
+
+
+//*****************************************************************************
+// interface operations
+//*****************************************************************************
+
+size_t
+shmchannel_size
+(
+ size_t capacity,
+ size_t msg_size
+)
+{
+  size_t slot_size = SHMCHANNEL_ROUND_UP(SHMCHANNEL_MSG_OFFSET + msg_size);
+  return sizeof(shmchannel_t) + capacity * slot_size;
+}
+
+
+void
+shmchannel_init
+(
+ shmchannel_t *ch,
+ size_t capacity,
+ size_t msg_size
+)
+{
+  ch->mask = capacity - 1;
+  ch->msg_size = msg_size;
+  ch->slot_size = SHMCHANNEL_ROUND_UP(SHMCHANNEL_MSG_OFFSET + msg_size);
+  atomic_init(&ch->tail, 0);
+  atomic_init(&ch->head, 0);
+
+  // slot i is free for the producer that claims ticket i
+  for (uint64_t i = 0; i < capacity; i++) {
+    atomic_init(shmchannel_seq(ch, i), i);
+    atomic_init(&shmchannel_slot(ch, i)->owner, 0);
+  }
+}
+
+
+void *
+shmchannel_claim
+(
+ shmchannel_t *ch,
+ uint64_t *ticket,
+ int32_t owner
+)
+{
+  uint64_t tail = atomic_load_explicit(&ch->tail, memory_order_relaxed);
+  for (;;) {
+    uint64_t seq = atomic_load_explicit(shmchannel_seq(ch, tail), memory_order_acquire);
+    int64_t dif = (int64_t) (seq - tail);
+    if (dif == 0) {
+      // the slot is free, race the other producers for it
+      if (atomic_compare_exchange_weak_explicit(&ch->tail, &tail, tail + 1,
+                                                memory_order_relaxed,
+                                                memory_order_relaxed)) {
+        atomic_store_explicit(&shmchannel_slot(ch, tail)->owner, owner,
+                              memory_order_relaxed);
+        *ticket = tail;
+        return shmchannel_msg(ch, tail);
+      }
+    } else if (dif < 0) {
+      // the slot still holds a message from a lap ago
+      return NULL;
+    } else {
+      // another producer claimed the slot first
+      tail = atomic_load_explicit(&ch->tail, memory_order_relaxed);
+    }
+  }
+}
+
+
+int
+shmchannel_publish
+(
+ shmchannel_t *ch,
+ uint64_t ticket
+)
+{
+  // fails only if the consumer discarded the slot first
+  uint64_t expected = ticket;
+  return atomic_compare_exchange_strong_explicit(shmchannel_seq(ch, ticket), &expected,
+                                                 ticket + 1, memory_order_release,
+                                                 memory_order_relaxed) ? 0 : -1;
+}
+
+
+void *
+shmchannel_peek
+(
+ shmchannel_t *ch
+)
+{
+  uint64_t head = atomic_load_explicit(&ch->head, memory_order_relaxed);
+  uint64_t seq = atomic_load_explicit(shmchannel_seq(ch, head), memory_order_acquire);
+  return seq == head + 1 ? shmchannel_msg(ch, head) : NULL;
+}
+
+
+void
+shmchannel_release
+(
+ shmchannel_t *ch
+)
+{
+  uint64_t head = atomic_load_explicit(&ch->head, memory_order_relaxed);
+  shmchannel_free_head(ch, head, head + 1);
+}
+
+
+int
+shmchannel_stalled
+(
+ shmchannel_t *ch,
+ uint64_t *ticket,
+ int32_t *owner
+)
+{
+  uint64_t head = atomic_load_explicit(&ch->head, memory_order_relaxed);
+  if (atomic_load_explicit(&ch->tail, memory_order_acquire) == head
+      || atomic_load_explicit(shmchannel_seq(ch, head), memory_order_acquire) != head) {
+    return 0;
+  }
+  *ticket = head;
+  *owner = atomic_load_explicit(&shmchannel_slot(ch, head)->owner, memory_order_relaxed);
+  return 1;
+}
+
+
+int
+shmchannel_discard
+(
+ shmchannel_t *ch
+)
+{
+  uint64_t head = atomic_load_explicit(&ch->head, memory_order_relaxed);
+  return shmchannel_free_head(ch, head, head);
+}
+
+
+int
+shmchannel_empty
+(
+ shmchannel_t *ch
+)
+{
+  return atomic_load_explicit(&ch->tail, memory_order_acquire)
+    == atomic_load_explicit(&ch->head, memory_order_relaxed);
+}
@@ -0,0 +1,216 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2023, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+
+#ifndef shmchannel_h
+#define shmchannel_h
+
+//*****************************************************************************
+// Description:
+//
+//   a bounded channel of fixed-size messages from many producers to one
+//   consumer, laid out to live in memory shared between processes. the
+//   channel and its slots are one contiguous block that holds no
+//   pointers, so each process may map it at a different address.
+//
+//   every slot carries a sequence number that tells producers when it is
+//   free and the consumer when it is full. a producer claims a slot by
+//   advancing the shared tail, fills it in place, then publishes it.
+//   messages from any one producer are consumed in the order produced.
+//
+//   a producer that dies between claiming a slot and publishing it would
+//   stall the consumer forever, so each slot also records the process
+//   that claimed it. the consumer may discard a slot that stays claimed,
+//   after which its producer's publish fails instead of corrupting the
+//   slot for the next lap.
+//
+//*****************************************************************************
+
+
+
+//*****************************************************************************
+// system includes
+//*****************************************************************************
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+
+//*****************************************************************************
+// local includes
+//*****************************************************************************
+
+#include "stdatomic.h"
+
+
+
+//*****************************************************************************
+// macros
+//*****************************************************************************
+
+#define SHMCHANNEL_CACHE_LINE 64
+
+
+
+//*****************************************************************************
+// type declarations
+//*****************************************************************************
+
+typedef struct shmchannel_t {
+  // immutable after initialization
+  uint64_t mask;
+  uint64_t msg_size;
+  uint64_t slot_size;
+
+  // advanced by producers
+  _Alignas(SHMCHANNEL_CACHE_LINE) atomic_uint_least64_t tail;
+
+  // advanced only by the consumer
+  _Alignas(SHMCHANNEL_CACHE_LINE) atomic_uint_least64_t head;
+
+  // capacity slots of slot_size bytes follow
+  _Alignas(SHMCHANNEL_CACHE_LINE) char slots[];
+} shmchannel_t;
+
+
+
+//*****************************************************************************
+// interface operations
+//*****************************************************************************
+
+// bytes of shared memory needed for a channel of capacity messages of up
+// to msg_size bytes each. capacity must be a power of two.
+size_t
+shmchannel_size
+(
+ size_t capacity,
+ size_t msg_size
+);
+
+
+// initialize a channel in a block of shmchannel_size(capacity, msg_size)
+// bytes, before any other process uses it
+void
+shmchannel_init
+(
+ shmchannel_t *ch,
+ size_t capacity,
+ size_t msg_size
+);
+
+
+// producer: claim the next free slot for process owner and return its
+// message buffer of ch->msg_size bytes, or NULL if the channel is full.
+// *ticket identifies the slot to shmchannel_publish.
+void *
+shmchannel_claim
+(
+ shmchannel_t *ch,
+ uint64_t *ticket,
+ int32_t owner
+);
+
+
+// producer: make a claimed slot visible to the consumer. returns 0, or
+// -1 if the consumer discarded the slot and the message is lost.
+int
+shmchannel_publish
+(
+ shmchannel_t *ch,
+ uint64_t ticket
+);
+
+
+// consumer: return the message buffer of the oldest published message,
+// or NULL if there is none. the message stays in the channel until it
+// is released with shmchannel_release.
+void *
+shmchannel_peek
+(
+ shmchannel_t *ch
+);
+
+
+// consumer: release the message returned by shmchannel_peek
+void
+shmchannel_release
+(
+ shmchannel_t *ch
+);
+
+
+// consumer: whether the oldest slot is claimed but not yet published.
+// if so, *ticket identifies the slot and *owner is the process that
+// claimed it, or 0 if the producer has not recorded itself yet.
+int
+shmchannel_stalled
+(
+ shmchannel_t *ch,
+ uint64_t *ticket,
+ int32_t *owner
+);
+
+
+// consumer: give up on the oldest slot, claimed but not published, and
+// move past it. returns 0, or -1 if it was published meanwhile and can
+// be read with shmchannel_peek.
+int
+shmchannel_discard
+(
+ shmchannel_t *ch
+);
+
+
+// consumer: whether every claimed slot has been consumed
+int
+shmchannel_empty
+(
+ shmchannel_t *ch
+);
+
+
+#endif
@@ -0,0 +1,429 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2023, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+
+
+//*****************************************************************************
+// system includes
+//*****************************************************************************
+
+#include <stdint.h>
+
+
+
+//*****************************************************************************
+// local includes
+//*****************************************************************************
+
+#include "sizeclass.h"
+
+
+
+//*****************************************************************************
+// macros
+//*****************************************************************************
+
+#define SPAN_HEADER_SIZE 64
+
+#define SPAN_MASK (~((uintptr_t) SIZECLASS_SPAN_SIZE - 1))
+
+#define ALIGN_UP(x, a) (((uintptr_t) (x) + (a) - 1) & ~((uintptr_t) (a) - 1))
+
+
+
+//*****************************************************************************
+// type declarations
+//*****************************************************************************
+
+// the header at the start of every span. a large block has a span of its
+// own, with class_size 0, that records the mapping to release.
+typedef struct span_t {
+  sizeclass_heap_t *owner;
+  size_t class_size;
+  int class_index;
+  void *map_base;
+  size_t map_size;
+  size_t large_size;
+} span_t;
+
+_Static_assert(sizeof(span_t) <= SPAN_HEADER_SIZE, "span header too large");
+
+
+
+//*****************************************************************************
+// private operations
+//*****************************************************************************
+
+static inline span_t *
+span_of
+(
+ void *ptr
+)
+{
+  return (span_t *) ((uintptr_t) ptr & SPAN_MASK);
+}
+
+
+static inline int
+class_index
+(
+ size_t size
+)
+{
+  if (size <= 128) return (int) ((size + 15) >> 4) - 1;
+
+  // above 128 bytes, four classes per power of two
+  int lg = 63 - __builtin_clzl(size - 1);
+  size_t step = (size_t) 1 << (lg - 2);
+  return 8 + (lg - 7) * 4 + (int) ((size - 1 - ((size_t) 1 << lg)) / step);
+}
+
+
+static inline size_t
+class_size
+(
+ int index
+)
+{
+  if (index < 8) return (size_t) (index + 1) << 4;
+
+  int group = (index - 8) >> 2;
+  int step = (index - 8) & 3;
+  return ((size_t) 128 << group) + (size_t) (step + 1) * ((size_t) 32 << group);
+}
+
+
+// map size bytes aligned to SIZECLASS_SPAN_SIZE. on success, *base and
+// *length describe the whole mapping, to be passed back to unmap.
+static char *
+map_aligned
+(
+ sizeclass_heap_t *heap,
+ size_t size,
+ void **base,
+ size_t *length
+)
+{
+  *length = size + SIZECLASS_SPAN_SIZE;
+  *base = heap->map(*length);
+  if (*base == NULL) return NULL;
+  heap->bytes_mapped += *length;
+  return (char *) ALIGN_UP(*base, SIZECLASS_SPAN_SIZE);
+}
+
+
+static void *
+alloc_large
+(
+ sizeclass_heap_t *heap,
+ size_t size
+)
+{
+  void *base;
+  size_t length;
+  span_t *span = (span_t *) map_aligned(heap, SPAN_HEADER_SIZE + size, &base, &length);
+  if (span == NULL) return NULL;
+
+  span->owner = heap;
+  span->class_size = 0;
+  span->class_index = -1;
+  span->map_base = base;
+  span->map_size = length;
+  span->large_size = size;
+
+  heap->allocs++;
+  heap->bytes_in_use += size;
+  return (char *) span + SPAN_HEADER_SIZE;
+}
+
+
+// give class index a fresh span to bump-allocate from
+static int
+new_span
+(
+ sizeclass_heap_t *heap,
+ int index
+)
+{
+  if (heap->chunk + SIZECLASS_SPAN_SIZE > heap->chunk_end) {
+    void *base;
+    size_t length;
+    char *chunk = map_aligned(heap, SIZECLASS_CHUNK_SIZE, &base, &length);
+    if (chunk == NULL) return 0;
+    heap->chunk = chunk;
+    heap->chunk_end = (char *) base + length;
+  }
+
+  span_t *span = (span_t *) heap->chunk;
+  heap->chunk += SIZECLASS_SPAN_SIZE;
+
+  span->owner = heap;
+  span->class_size = class_size(index);
+  span->class_index = index;
+  span->map_base = NULL;
+  span->map_size = 0;
+  span->large_size = 0;
+
+  heap->bump[index] = (char *) span + SPAN_HEADER_SIZE;
+  heap->bump_end[index] = (char *) span + SIZECLASS_SPAN_SIZE;
+  return 1;
+}
+
+
+// return a block to its owner, which must be the calling thread
+static void
+free_local
+(
+ sizeclass_heap_t *heap,
+ span_t *span,
+ void *ptr
+)
+{
+  heap->frees++;
+
+  if (span->class_size == 0) {
+    heap->bytes_in_use -= span->large_size;
+    heap->bytes_mapped -= span->map_size;
+    heap->unmap(span->map_base, span->map_size);
+    return;
+  }
+
+  heap->bytes_in_use -= span->class_size;
+  *(void **) ptr = heap->free[span->class_index];
+  heap->free[span->class_index] = ptr;
+}
+
+
+// mark the owner as inside an operation on the heap, for a signal
+// handler that interrupts it on the same thread
+static inline void
+heap_enter
+(
+ sizeclass_heap_t *heap
+)
+{
+  heap->busy = 1;
+  atomic_signal_fence(memory_order_seq_cst);
+}
+
+
+static inline void
+heap_leave
+(
+ sizeclass_heap_t *heap
+)
+{
+  atomic_signal_fence(memory_order_seq_cst);
+  heap->busy = 0;
+}
+
+
+static void
+collect_remote
+(
+ sizeclass_heap_t *heap
+)
+{
+  void *block = atomic_exchange_explicit(&heap->remote, NULL, memory_order_acquire);
+  while (block != NULL) {
+    void *next = *(void **) block;
+    free_local(heap, span_of(block), block);
+    block = next;
+  }
+}
+
+
+static void *
+alloc_small
+(
+ sizeclass_heap_t *heap,
+ size_t size
+)
+{
+  int index = class_index(size);
+  void *block = heap->free[index];
+
+  if (block == NULL
+      && atomic_load_explicit(&heap->remote, memory_order_relaxed) != NULL) {
+    collect_remote(heap);
+    block = heap->free[index];
+  }
+
+  if (block != NULL) {
+    heap->free[index] = *(void **) block;
+  } else {
+    size_t bytes = class_size(index);
+    if (heap->bump[index] + bytes > heap->bump_end[index]) {
+      if (!new_span(heap, index)) return NULL;
+    }
+    block = heap->bump[index];
+    heap->bump[index] += bytes;
+  }
+
+  heap->allocs++;
+  heap->bytes_in_use += class_size(index);
+  return block;
+}
+
+
+
+//*****************************************************************************
+// interface operations
+//*****************************************************************************
+
+void
+sizeclass_heap_init
+(
+ sizeclass_heap_t *heap,
+ sizeclass_map_fn_t map,
+ sizeclass_unmap_fn_t unmap
+)
+{
+  for (int i = 0; i < SIZECLASS_COUNT; i++) {
+    heap->free[i] = NULL;
+    heap->bump[i] = NULL;
+    heap->bump_end[i] = NULL;
+  }
+  heap->chunk = NULL;
+  heap->chunk_end = NULL;
+  heap->map = map;
+  heap->unmap = unmap;
+  heap->busy = 0;
+  heap->allocs = 0;
+  heap->frees = 0;
+  heap->bytes_mapped = 0;
+  heap->bytes_in_use = 0;
+  atomic_init(&heap->remote, NULL);
+  atomic_init(&heap->remote_frees, 0);
+}
+
+
+void *
+sizeclass_alloc
+(
+ sizeclass_heap_t *heap,
+ size_t size
+)
+{
+  if (size == 0 || heap->busy) return NULL;
+
+  heap_enter(heap);
+  void *block = size > SIZECLASS_MAX ? alloc_large(heap, size) : alloc_small(heap, size);
+  heap_leave(heap);
+  return block;
+}
+
+
+void
+sizeclass_free
+(
+ sizeclass_heap_t *heap,
+ void *ptr
+)
+{
+  if (ptr == NULL) return;
+
+  span_t *span = span_of(ptr);
+  sizeclass_heap_t *owner = span->owner;
+  if (owner == heap && !heap->busy) {
+    heap_enter(heap);
+    free_local(heap, span, ptr);
+    heap_leave(heap);
+    return;
+  }
+
+  // push onto the owner's remote-free stack, also when this free
+  // interrupted the owner's own operation on the heap. the owner only
+  // ever takes the whole stack, so there is no ABA hazard.
+  void *head = atomic_load_explicit(&owner->remote, memory_order_relaxed);
+  do {
+    *(void **) ptr = head;
+  } while (!atomic_compare_exchange_weak_explicit(&owner->remote, &head, ptr,
+                                                  memory_order_release,
+                                                  memory_order_relaxed));
+  atomic_fetch_add_explicit(&owner->remote_frees, 1, memory_order_relaxed);
+}
+
+
+void
+sizeclass_heap_collect
+(
+ sizeclass_heap_t *heap
+)
+{
+  if (heap->busy) return;
+
+  heap_enter(heap);
+  collect_remote(heap);
+  heap_leave(heap);
+}
+
+
+size_t
+sizeclass_usable_size
+(
+ void *ptr
+)
+{
+  span_t *span = span_of(ptr);
+  return span->class_size ? span->class_size : span->large_size;
+}
+
+
+void
+sizeclass_heap_stats
+(
+ sizeclass_heap_t *heap,
+ sizeclass_stats_t *stats
+)
+{
+  stats->allocs += heap->allocs;
+  stats->frees += heap->frees;
+  stats->remote_frees +=
+    atomic_load_explicit(&heap->remote_frees, memory_order_relaxed);
+  stats->bytes_mapped += heap->bytes_mapped;
+  stats->bytes_in_use += heap->bytes_in_use;
+}
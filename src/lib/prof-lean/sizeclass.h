@@ -0,0 +1,218 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2023, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+
+
+#ifndef sizeclass_h
+#define sizeclass_h
+
+//*****************************************************************************
+// Description:
+//
+//   a size-class allocator with freeable blocks. each thread owns a heap
+//   with a free list and a bump region per size class; blocks come from
+//   fixed-size, aligned spans whose header records the owning heap, so a
+//   block can be returned to its owner from any thread. a block freed by
+//   its owner goes straight onto a local free list; a block freed by any
+//   other thread is pushed onto the owner's remote-free stack, which the
+//   owner drains in one exchange the next time a local list runs dry.
+//
+//   a heap notes when its owner is inside an operation on it, so a signal
+//   handler that interrupts the owner can still free into the same heap:
+//   such a free is deferred to the remote-free stack, and an allocation
+//   in the handler fails with NULL. pushing onto a remote-free stack is
+//   lock free, so frees are async-signal safe from any thread. no
+//   operation calls malloc; fresh memory comes only from the map callback.
+//
+//*****************************************************************************
+
+
+
+//*****************************************************************************
+// system includes
+//*****************************************************************************
+
+#include <stddef.h>
+
+
+
+//*****************************************************************************
+// local includes
+//*****************************************************************************
+
+#include "stdatomic.h"
+
+
+
+//*****************************************************************************
+// macros
+//*****************************************************************************
+
+#define SIZECLASS_CACHE_LINE 64
+
+// sixteen-byte steps up to 128 bytes, then four classes per power of two
+#define SIZECLASS_COUNT 24
+#define SIZECLASS_MAX 2048
+
+// spans are aligned to their size, so a block's span is found by masking
+#define SIZECLASS_SPAN_SIZE (64 * 1024)
+
+// spans are carved from chunks of this many bytes obtained from the map
+// callback. the size is a multiple of the 2MB huge page size, so a chunk
+// can be backed by transparent huge pages.
+#define SIZECLASS_CHUNK_SIZE (2 * 1024 * 1024)
+
+
+
+//*****************************************************************************
+// type declarations
+//*****************************************************************************
+
+// return size bytes of zero-filled memory, or NULL on failure. the
+// callback is only called by a heap's owner, from inside an allocation.
+typedef void *(*sizeclass_map_fn_t)(size_t size);
+
+// release memory obtained from a map callback
+typedef void (*sizeclass_unmap_fn_t)(void *addr, size_t size);
+
+
+typedef struct sizeclass_heap_t {
+  // written only by the owner
+  _Alignas(SIZECLASS_CACHE_LINE) void *free[SIZECLASS_COUNT];
+  char *bump[SIZECLASS_COUNT];
+  char *bump_end[SIZECLASS_COUNT];
+  char *chunk;       // next unused span in the current chunk
+  char *chunk_end;
+  sizeclass_map_fn_t map;
+  sizeclass_unmap_fn_t unmap;
+  volatile int busy; // the owner is inside an operation on the heap
+
+  // statistics, written only by the owner
+  size_t allocs;
+  size_t frees;
+  size_t bytes_mapped;
+  size_t bytes_in_use;
+
+  // pushed by other threads, drained by the owner
+  _Alignas(SIZECLASS_CACHE_LINE) _Atomic(void *) remote;
+  atomic_size_t remote_frees;
+} sizeclass_heap_t;
+
+
+typedef struct sizeclass_stats_t {
+  size_t allocs;
+  size_t frees;
+  size_t remote_frees;
+  size_t bytes_mapped;
+  size_t bytes_in_use;
+} sizeclass_stats_t;
+
+
+
+//*****************************************************************************
+// interface operations
+//*****************************************************************************
+
+void
+sizeclass_heap_init
+(
+ sizeclass_heap_t *heap,
+ sizeclass_map_fn_t map,
+ sizeclass_unmap_fn_t unmap
+);
+
+
+// owner: allocate size bytes, aligned to 16 bytes. requests larger than
+// SIZECLASS_MAX are mapped individually and unmapped when freed. returns
+// NULL if size is 0, the map callback fails, or the call interrupted
+// another operation on the heap.
+void *
+sizeclass_alloc
+(
+ sizeclass_heap_t *heap,
+ size_t size
+);
+
+
+// free a block allocated from any heap. heap is the caller's own heap,
+// or NULL if the caller has none, in which case the block is always
+// returned to its owner as a remote free.
+void
+sizeclass_free
+(
+ sizeclass_heap_t *heap,
+ void *ptr
+);
+
+
+// owner: move blocks freed by other threads onto the local free lists
+void
+sizeclass_heap_collect
+(
+ sizeclass_heap_t *heap
+);
+
+
+// the number of bytes usable in a block, at least the size requested
+size_t
+sizeclass_usable_size
+(
+ void *ptr
+);
+
+
+// add the statistics of heap into stats. may be called from any thread;
+// the counts written by the owner are read without synchronization and
+// are approximate while the owner is running.
+void
+sizeclass_heap_stats
+(
+ sizeclass_heap_t *heap,
+ sizeclass_stats_t *stats
+);
+
+
+#endif
@@ -57,6 +57,7 @@
 
 #include "stdshim/filesystem.hpp"
 #include <functional>
+#include <limits>
 #include <optional>
 #include <thread>
 #include <unordered_map>
@@ -92,6 +93,9 @@ public:
   const std::vector<pms_id_t>& idTuple() const noexcept;
   void idTuple(std::vector<pms_id_t>);
 
+  /// Disorder of timepoints that cannot be sorted with any bounded buffer.
+  static constexpr unsigned int unboundedDisorder = std::numeric_limits<unsigned int>::max();
+
   /// Get or set the vital statistics (maximum count and expected disorder) for
   /// the Context-type timepoints in this Thread.
   // MT: Externally Synchronized
@@ -62,84 +62,79 @@ using namespace hpctoolkit;
 //
 
 Context::Context(ud_t::struct_t& rs, util::optional_ref<Context> p, NestedScope s)
-  : userdata(rs, std::ref(*this)), children_p(new children_t()),
-    reconsts_p(new reconsts_t()), m_parent(p), u_scope(s) {};
-Context::Context(Context&& c)
-  : userdata(std::move(c.userdata), std::ref(*this)),
-    children_p(new children_t()), reconsts_p(new reconsts_t()),
-    m_parent(c.m_parent), u_scope(c.u_scope) {};
+  : userdata(rs, std::ref(*this)), m_ownedArena(new arena_t()),
+    m_arena(*m_ownedArena), m_firstChild(nullptr), m_nextSibling(nullptr),
+    m_nChildren(0), m_childIndex(nullptr), m_reconsts(nullptr), m_parent(p),
+    m_scope(std::move(s)) {};
+Context::Context(arena_t& a, ud_t::struct_t& rs, Context& p, NestedScope s)
+  : userdata(rs, std::ref(*this)), m_arena(a), m_firstChild(nullptr),
+    m_nextSibling(nullptr), m_nChildren(0), m_childIndex(nullptr),
+    m_reconsts(nullptr), m_parent(p), m_scope(std::move(s)) {};
 
 Context::~Context() noexcept {
-  // C++ generates a recursive algorithm for this by default
-  // So we replace it with a post-order tree traversal
-  try {
-    iterate(nullptr, [](Context& c) { c.children_p.reset(nullptr); });
-  } catch(...) {};  // If we run into errors, just let the recursion handle it.
+  // Descendants live in the arena and are destroyed with it, so no recursion
+  delete m_childIndex.load(std::memory_order_relaxed);
+  delete m_reconsts.load(std::memory_order_relaxed);
 }
 
-void Context::iterate(const std::function<void(Context&)>& pre,
-                      const std::function<void(Context&)>& post) {
-  struct frame_t {
-    frame_t(Context& c)
-      : ctx(c), iter(c.children_p->iterate()),
-        here(iter.begin()), end(iter.end()) {};
-    Context& ctx;
-    using iter_t = decltype(children_p->iterate());
-    iter_t iter;
-    decltype(iter.begin()) here;
-    decltype(iter.end()) end;
-  };
-  std::stack<frame_t, std::vector<frame_t>> stack;
-  if(pre) pre(*this);
-  if(children_p) stack.emplace(*this);
-  while(!stack.empty()) {
-    if(stack.top().here != stack.top().end) {
-      // We have more children to handle
-      Context& c = *stack.top().here++;
-      if(pre) pre(c);
-      if(c.children_p) stack.emplace(c);
-      continue;
-    }
-
-    Context& c = stack.top().ctx;
-    stack.pop();
-    if(post) post(c);
+Context* Context::find_child(const NestedScope& s, Context* from,
+                             const Context* until) const noexcept {
+  for(Context* c = from; c != until; c = c->m_nextSibling) {
+    if(c->m_scope == s) return c;
   }
+  return nullptr;
 }
 
-void Context::citerate(const std::function<void(const Context&)>& pre,
-                       const std::function<void(const Context&)>& post) const {
-  struct frame_t {
-    frame_t(const Context& c)
-      : ctx(c), iter(c.children_p->citerate()),
-        here(iter.begin()), end(iter.end()) {};
-    const Context& ctx;
-    using iter_t = decltype(children_p->citerate());
-    iter_t iter;
-    decltype(iter.begin()) here;
-    decltype(iter.end()) end;
-  };
-  std::stack<frame_t, std::vector<frame_t>> stack;
-  if(pre) pre(*this);
-  if(children_p) stack.emplace(*this);
-  while(!stack.empty()) {
-    if(stack.top().here != stack.top().end) {
-      // We have more children to handle
-      const Context& c = *stack.top().here++;
-      if(pre) pre(c);
-      if(c.children_p) stack.emplace(c);
-      continue;
-    }
+std::pair<Context&,bool> Context::ensure(NestedScope s) {
+  // Fast path: the child already exists, find it without taking any locks
+  Context* head = m_firstChild.load(std::memory_order_acquire);
+  if(child_index* idx = m_childIndex.load(std::memory_order_acquire)) {
+    std::shared_lock<stdshim::shared_mutex> l(idx->lock);
+    auto it = idx->map.find(s);
+    if(it != idx->map.end()) return {*it->second, false};
+  } else if(Context* c = find_child(s, head, nullptr)) {
+    return {*c, false};
+  }
+
+  std::unique_lock<std::mutex> l(m_childLock);
+  // Someone else may have added it in the meantime. We're the only writer now,
+  // so the index can be read without its lock.
+  Context* newhead = m_firstChild.load(std::memory_order_relaxed);
+  child_index* idx = m_childIndex.load(std::memory_order_relaxed);
+  if(idx != nullptr) {
+    auto it = idx->map.find(s);
+    if(it != idx->map.end()) return {*it->second, false};
+  } else if(Context* c = find_child(s, newhead, head)) {
+    return {*c, false};
+  }
 
-    const Context& c = stack.top().ctx;
-    stack.pop();
-    if(post) post(c);
+  Context& c = m_arena.emplace(m_arena, userdata.base(), *this, std::move(s));
+  c.m_nextSibling = newhead;
+  m_firstChild.store(&c, std::memory_order_release);
+  ++m_nChildren;
+
+  if(idx != nullptr) {
+    std::unique_lock<stdshim::shared_mutex> il(idx->lock);
+    idx->map.emplace(c.m_scope, &c);
+  } else if(m_nChildren > childIndexThreshold) {
+    // This Context is wide, switch to an index for future lookups
+    idx = new child_index;
+    idx->map.reserve(m_nChildren * 2);
+    for(Context* cc = &c; cc != nullptr; cc = cc->m_nextSibling)
+      idx->map.emplace(cc->m_scope, cc);
+    m_childIndex.store(idx, std::memory_order_release);
   }
+  return {c, true};
 }
 
-std::pair<Context&,bool> Context::ensure(NestedScope s) {
-  auto x = children_p->emplace(userdata.base(), *this, std::move(s));
-  return {x.first(), x.second};
+Context::reconsts_t& Context::reconstructions() {
+  reconsts_t* r = m_reconsts.load(std::memory_order_acquire);
+  if(r == nullptr) {
+    auto n = std::make_unique<reconsts_t>();
+    if(m_reconsts.compare_exchange_strong(r, n.get(), std::memory_order_acq_rel))
+      r = n.release();
+  }
+  return *r;
 }
 
 using mvals_t = util::locked_unordered_map<util::reference_index<const Metric>,
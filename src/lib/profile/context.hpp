@@ -50,14 +50,21 @@
 #include "accumulators.hpp"
 #include "attributes.hpp"
 
+#include "util/arena.hpp"
 #include "util/locked_unordered.hpp"
 #include "scope.hpp"
 #include "util/ragged_vector.hpp"
 #include "util/ref_wrappers.hpp"
 #include "util/uniqable.hpp"
+#include "stdshim/shared_mutex.hpp"
 
+#include <atomic>
 #include <deque>
 #include <functional>
+#include <iterator>
+#include <mutex>
+#include <type_traits>
+#include <unordered_map>
 #include <unordered_set>
 
 namespace hpctoolkit {
@@ -79,14 +86,59 @@ public:
   Context() = delete;
   ~Context() noexcept;
 
+  Context(const Context&) = delete;
+  Context(Context&&) = delete;
+  Context& operator=(const Context&) = delete;
+  Context& operator=(Context&&) = delete;
+
 private:
-  using children_t = util::locked_unordered_uniqued_set<Context>;
   using reconsts_t = util::locked_unordered_uniqued_set<ContextReconstruction>;
 
 public:
+  /// Range over the direct children of a Context. Children are listed in no
+  /// particular order.
+  template<class C>
+  class children_range {
+  public:
+    class iterator {
+    public:
+      using iterator_category = std::forward_iterator_tag;
+      using value_type = C;
+      using difference_type = std::ptrdiff_t;
+      using pointer = C*;
+      using reference = C&;
+
+      iterator() = default;
+      C& operator*() const noexcept { return *cur; }
+      C* operator->() const noexcept { return cur; }
+      iterator& operator++() noexcept { cur = cur->m_nextSibling; return *this; }
+      iterator operator++(int) noexcept { iterator o = *this; ++*this; return o; }
+      bool operator==(const iterator& o) const noexcept { return cur == o.cur; }
+      bool operator!=(const iterator& o) const noexcept { return cur != o.cur; }
+
+    private:
+      friend class children_range;
+      iterator(C* c) : cur(c) {};
+      C* cur = nullptr;
+    };
+
+    iterator begin() const noexcept { return first; }
+    iterator end() const noexcept { return {}; }
+    const children_range& citerate() const noexcept { return *this; }
+    bool empty() const noexcept { return first == nullptr; }
+    std::size_t size() const noexcept { return std::distance(begin(), end()); }
+
+  private:
+    friend class Context;
+    children_range(C* c) : first(c) {};
+    C* first;
+  };
+
   /// List the Context children of this Context.
-  // MT: Safe (const)
-  const children_t& children() const noexcept { return *children_p; }
+  // MT: Safe (const), Unstable
+  children_range<const Context> children() const noexcept {
+    return m_firstChild.load(std::memory_order_acquire);
+  }
 
   /// Parent Context, or std::nullopt if this Context does not have one.
   // MT: Safe (const)
@@ -95,7 +147,7 @@ public:
 
   /// The full NestedScope that this Context represents.
   // MT: Safe (const)
-  const NestedScope& scope() const noexcept { return u_scope(); }
+  const NestedScope& scope() const noexcept { return m_scope; }
 
   /// Userdata storage and access.
   // MT: See ragged_vector.
@@ -107,19 +159,77 @@ public:
   auto& data() noexcept { return m_data; }
 
   /// Iterate over the Context sub-tree rooted at this Context. The given
-  /// functions are called before and after every Context.
+  /// functions are called before and after every Context, either may be
+  /// nullptr. The traversal does not recurse, so arbitrarily deep trees can be
+  /// walked without growing the stack.
   // MT: Safe (const), Unstable (before `contexts` wavefront)
-  void iterate(const std::function<void(Context&)>& pre,
-               const std::function<void(Context&)>& post);
-  void citerate(const std::function<void(const Context&)>& pre,
-                const std::function<void(const Context&)>& post) const;
+  template<class Pre, class Post>
+  void iterate(const Pre& pre, const Post& post) {
+    iterate_impl(*this, pre, post);
+  }
+  template<class Pre, class Post>
+  void citerate(const Pre& pre, const Post& post) const {
+    iterate_impl(*this, pre, post);
+  }
 
 private:
-  std::unique_ptr<children_t> children_p;
-  std::unique_ptr<reconsts_t> reconsts_p;
+  // Every Context in a tree is allocated from a single arena owned by the
+  // root, so nodes are packed densely and freed all at once.
+  using arena_t = util::arena<Context>;
+  std::unique_ptr<arena_t> m_ownedArena;
+  arena_t& m_arena;
+
+  // Children form an intrusive singly-linked list, new children are pushed
+  // onto the front. Lookups walk the list without locking; once a Context
+  // has many children an index is built to keep lookups fast.
+  struct child_index {
+    stdshim::shared_mutex lock;
+    std::unordered_map<NestedScope, Context*> map;
+  };
+  static constexpr std::size_t childIndexThreshold = 16;
+  std::atomic<Context*> m_firstChild;
+  Context* m_nextSibling;
+  std::mutex m_childLock;
+  std::size_t m_nChildren;
+  std::atomic<child_index*> m_childIndex;
+
+  // Reconstructions are rare, so they are only allocated when needed
+  std::atomic<reconsts_t*> m_reconsts;
+  reconsts_t& reconstructions();
+
+  template<class C, class Pre, class Post>
+  static void iterate_impl(C& top, const Pre& pre, const Post& post) {
+    const auto call = [](const auto& f, C& c) {
+      using F = std::decay_t<decltype(f)>;
+      if constexpr(std::is_same_v<F, std::nullptr_t>) return;
+      else if constexpr(std::is_constructible_v<bool, const F&>) { if(f) f(c); }
+      else f(c);
+    };
+    C* c = &top;
+    call(pre, *c);
+    while(true) {
+      if(C* child = c->m_firstChild.load(std::memory_order_acquire)) {
+        c = child;
+        call(pre, *c);
+        continue;
+      }
+      // Climb back up until we find a sibling we haven't visited yet
+      while(true) {
+        call(post, *c);
+        if(c == &top) return;
+        if(C* sib = c->m_nextSibling) {
+          c = sib;
+          call(pre, *c);
+          break;
+        }
+        c = &*c->direct_parent();
+      }
+    }
+  }
 
   Context(ud_t::struct_t&, util::optional_ref<Context>, NestedScope);
-  Context(Context&& c);
+  Context(arena_t&, ud_t::struct_t&, Context&, NestedScope);
+  friend arena_t;
 
   friend class PerThreadTemporary;
   PerContextAccumulators m_data;
@@ -130,11 +240,12 @@ private:
   // MT: Internally Synchronized
   std::pair<Context&, bool> ensure(NestedScope);
 
-  const util::optional_ref<Context> m_parent;
-  util::uniqable_key<NestedScope> u_scope;
+  /// Look for an existing child Context starting from the given child.
+  // MT: Internally Synchronized
+  Context* find_child(const NestedScope&, Context* from, const Context* until) const noexcept;
 
-  friend class util::uniqued<Context>;
-  util::uniqable_key<NestedScope>& uniqable_key() { return u_scope; }
+  const util::optional_ref<Context> m_parent;
+  const NestedScope m_scope;
 };
 
 /// Reconstruction of a potentially missing sequence of calling Contexts.
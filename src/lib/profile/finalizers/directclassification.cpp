@@ -46,6 +46,8 @@
 
 #include "directclassification.hpp"
 
+#include "lib/prof-lean/elf-hash.h"
+#include "lib/prof-lean/formats/primitive.h"
 #include "lib/support-lean/demangle.h"
 #include "pipeline.hpp"
 
@@ -53,11 +55,18 @@
 #include <elfutils/libdwelf.h>
 #include <dwarf.h>
 #include <libelf.h>
+#include <omp.h>
 
+#include <atomic>
 #include <stdexcept>
+#include <system_error>
 #include <unordered_map>
 #include <limits>
 #include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -68,8 +77,9 @@
 using namespace hpctoolkit;
 using namespace finalizers;
 
-DirectClassification::DirectClassification(uintmax_t dt)
-  : dwarfThreshold(dt) {
+DirectClassification::DirectClassification(uintmax_t dt, stdshim::filesystem::path cd,
+                                           unsigned int threads)
+  : dwarfThreshold(dt), cacheDir(std::move(cd)), dwarfThreads(threads) {
   elf_version(EV_CURRENT);  // We always assume the current ELF version.
 }
 
@@ -87,8 +97,10 @@ DirectClassification::classify(Context& c, NestedScope& ns) noexcept {
     const auto& udm = mo.first.userdata[ud];
 
     // First attempt: DWARF data
-    auto leafit = udm.leaves.find({mo.second, mo.second});
-    if(leafit != udm.leaves.end()) {
+    auto leafit = std::upper_bound(udm.leaves.begin(), udm.leaves.end(), mo.second,
+        [](uint64_t addr, const auto& leaf){ return addr < leaf.first.begin; });
+    if(leafit != udm.leaves.begin() && mo.second < std::prev(leafit)->first.end) {
+      --leafit;
       util::optional_ref<Context> cr;
       std::reference_wrapper<Context> cc = c;
 
@@ -102,7 +114,7 @@ DirectClassification::classify(Context& c, NestedScope& ns) noexcept {
           if(!cr) cr = cc;
           ns.relation() = tn.first.second;
         };
-      handle(leafit->second);
+      handle(*leafit->second);
 
       // Add an inner (line) Scope if we can
       auto lineit = udm.lines.find(mo.second);
@@ -182,10 +194,45 @@ static stdshim::filesystem::path altfile(const stdshim::filesystem::path& path,
 #define HPC_ELF_C_READ ELF_C_READ
 #endif
 
+// Key of the cache entry for a binary: hashes of the contents of the binary
+// and of the separate debug file holding its DWARF, if any, and the build ID
+// of the supplementary (dwz) file that DWARF refers to, if any. Returns
+// nullopt if the binary should not be cached.
+static std::optional<std::string> cacheKey(const stdshim::filesystem::path& path,
+    const stdshim::filesystem::path& dbgpath, Dwarf* dbg) {
+  std::string key;
+  for(const auto* p: {&path, &dbgpath}) {
+    if(p->empty()) continue;
+    char* hash = elf_hash(p->c_str());
+    if(hash == nullptr) return std::nullopt;
+    if(!key.empty()) key += '-';
+    key += hash;
+    std::free(hash);
+  }
+
+  if(dbg != nullptr) {
+    const char* altname;
+    const void* altid;
+    ssize_t altid_len = dwelf_dwarf_gnu_debugaltlink(dbg, &altname, &altid);
+    if(altid_len > 0) {
+      // The results depend on whether the supplementary file was found
+      if(dwarf_getalt(dbg) == nullptr) return std::nullopt;
+      std::ostringstream ss;
+      for(ssize_t i = 0; i < altid_len; i++)
+        ss << std::hex << std::setw(2) << std::setfill('0')
+           << (int)((const std::uint8_t*)altid)[i];
+      key += '-';
+      key += std::move(ss).str();
+    }
+  }
+  return key;
+}
+
 void DirectClassification::load(const Module& m, udModule& ud) noexcept {
   int fd = -1;
   const auto& rpath = m.userdata[sink.resolvedPath()];
   const auto& mpath = rpath.empty() ? m.path() : rpath;
+
   fd = open(mpath.c_str(), O_RDONLY);
   if(fd == -1) {  // Can't do anything if we can't open it.
     // TODO: ERROR or something in this case?
@@ -204,44 +251,352 @@ void DirectClassification::load(const Module& m, udModule& ud) noexcept {
     return;  // We only work with ELF files.
   }
 
+  // The DWARF is either in the binary itself or in a separate debug file
+  Dwarf* dbg = dwarf_begin_elf(elf, DWARF_C_READ, nullptr);
+  stdshim::filesystem::path altpath;
+  int altfd = -1;
+  if(dbg == nullptr) {
+    altpath = altfile(mpath, elf);
+    if(!altpath.empty()) {
+      altfd = open(altpath.c_str(), O_RDONLY);
+      if(altfd != -1) dbg = dwarf_begin(altfd, DWARF_C_READ);
+    }
+    if(dbg == nullptr) altpath.clear();
+  }
+
+  // If we have a cache, check there first. Entries are keyed by the contents
+  // of the binary and of its debug info, so they remain valid if the binary
+  // moves but not if its debug info is installed or changes.
+  stdshim::filesystem::path cachePath;
+  bool cacheable = true;
+  if(!cacheDir.empty()) {
+    if(auto key = cacheKey(mpath, altpath, dbg)) {
+      cachePath = cacheDir / "classification" / *key;
+      if(readCache(cachePath, m, ud)) {
+        if(dbg != nullptr) dwarf_end(dbg);
+        if(altfd != -1) close(altfd);
+        elf_end(elf);
+        close(fd);
+        return;
+      }
+    }
+  }
+
   // Process the DWARF, but only if its small enough
   auto baseweight = stdshim::filesystem::file_size(mpath);
-  Dwarf* dbg = dwarf_begin_elf(elf, DWARF_C_READ, nullptr);
   if(dbg != nullptr) {
+    auto altweight = altpath.empty() ? 0 : stdshim::filesystem::file_size(altpath);
     if(dwarfThreshold == std::numeric_limits<uintmax_t>::max()
-       || baseweight < dwarfThreshold) {
-      if(!fullDwarf(dbg, m, ud))
+       || baseweight + altweight < dwarfThreshold) {
+      if(!fullDwarf(dbg, altpath.empty() ? fd : altfd, m, ud)) {
         util::log::error{} << "Error parsing DWARF for " << mpath.string();
-    } else util::log::warning{} << "Skipping DWARF for " << mpath.string() << ","
-        " over threshold (" << baseweight << " > " << dwarfThreshold << ")";
-    dwarf_end(dbg);
-  } else {
-    auto altpath = altfile(mpath, elf);
-    if(!altpath.empty()) {
-      int altfd = -1;
-      altfd = open(altpath.c_str(), O_RDONLY);
-      if(altfd != -1) {
-        auto altweight = stdshim::filesystem::file_size(altpath);
-        Dwarf* altdbg = dwarf_begin(altfd, DWARF_C_READ);
-        if(altdbg != nullptr) {
-          if(dwarfThreshold == std::numeric_limits<uintmax_t>::max()
-             || baseweight + altweight < dwarfThreshold)
-            fullDwarf(altdbg, m, ud);
-          else util::log::warning{} << "Skipping DWARF for " << mpath.string()
-            << ", over threshold (" << baseweight << " + " << altweight << " ="
-            " " << (baseweight + altweight) << " > " << dwarfThreshold << ")";
-          dwarf_end(altdbg);
-        }
-        close(altfd);
+        cacheable = false;
       }
+    } else if(altpath.empty()) {
+      util::log::warning{} << "Skipping DWARF for " << mpath.string() << ","
+        " over threshold (" << baseweight << " > " << dwarfThreshold << ")";
+      cacheable = false;
+    } else {
+      util::log::warning{} << "Skipping DWARF for " << mpath.string()
+        << ", over threshold (" << baseweight << " + " << altweight << " ="
+        " " << (baseweight + altweight) << " > " << dwarfThreshold << ")";
+      cacheable = false;
     }
+    dwarf_end(dbg);
   }
+  if(altfd != -1) close(altfd);
 
-  if(!symtab(elf, m, ud))
+  if(!symtab(elf, m, ud)) {
     util::log::error{} << "Error parsing ELF symbols for " << mpath.string();
+    cacheable = false;
+  }
 
   elf_end(elf);
   close(fd);
+
+  // Save the results for later runs, if they are complete
+  if(!cachePath.empty() && cacheable)
+    writeCache(cachePath, ud);
+}
+
+// Cache file layout. All values are little-endian, offsets are relative to
+// the start of the file and every table is an array of fixed-size records,
+// so the file can be used directly from an mmap.
+//   Header:       magic[8], version u32, pad u32,
+//                 then {u64 offset, u64 count} for each table below
+//   Strings:      NUL-terminated strings, referenced by offset in this table
+//   Files:        {u64 pPath}
+//   Functions:    {u64 pName, u64 offset, u64 line, u32 file+1, u32 flags}
+//                 flags bit 0 is set if the offset is valid
+//   Trie:         {u32 function+1 (0 for a call site), u32 file+1, u64 line,
+//                  u64 parent+1}
+//   Leaves:       {u64 begin, u64 end, u64 trienode}
+//   Lines:        {u64 address, u64 line, u32 file+1 (0 for no line), u32 pad}
+//   Symbols:      {u64 begin, u64 end, u64 function}
+namespace {
+constexpr char cacheMagic[8] = {'H','P','C','P','C','L','S','C'};
+constexpr uint32_t cacheVersion = 1;
+enum cacheTable { ctStrings, ctFiles, ctFunctions, ctTrie, ctLeaves, ctLines,
+                  ctSymbols, ctCount };
+constexpr std::size_t cacheHdrSize = 0x10 + ctCount * 0x10;
+constexpr std::size_t cacheRecSize[ctCount] = {1, 0x08, 0x20, 0x18, 0x18, 0x18, 0x18};
+constexpr uint64_t align8(uint64_t v) { return (v + 7) & ~(uint64_t)7; }
+}
+
+bool DirectClassification::readCache(const stdshim::filesystem::path& path,
+                                     const Module& m, udModule& out) noexcept try {
+  int fd = open(path.c_str(), O_RDONLY);
+  if(fd == -1) return false;
+  struct stat sb;
+  if(fstat(fd, &sb) != 0 || (std::size_t)sb.st_size < cacheHdrSize) {
+    close(fd);
+    return false;
+  }
+  const std::size_t size = sb.st_size;
+  void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(map == MAP_FAILED) return false;
+  const char* const base = (const char*)map;
+  struct unmapper {
+    void* map; std::size_t size;
+    ~unmapper() { munmap(map, size); }
+  } unmap{map, size};
+
+  // Validate the header and the bounds of every table
+  if(std::memcmp(base, cacheMagic, sizeof cacheMagic) != 0
+     || fmt_u32_read(base + 8) != cacheVersion)
+    return false;
+  const char* tables[ctCount];
+  uint64_t counts[ctCount];
+  for(int t = 0; t < ctCount; t++) {
+    uint64_t off = fmt_u64_read(base + 0x10 + t * 0x10);
+    counts[t] = fmt_u64_read(base + 0x18 + t * 0x10);
+    if(off > size || counts[t] > (size - off) / cacheRecSize[t]) return false;
+    tables[t] = base + off;
+  }
+  const auto str = [&](uint64_t p) -> std::string {
+    if(p >= counts[ctStrings]) throw std::out_of_range("Invalid string in cache");
+    const char* s = tables[ctStrings] + p;
+    const char* e = (const char*)std::memchr(s, '\0', counts[ctStrings] - p);
+    if(e == nullptr) throw std::out_of_range("Unterminated string in cache");
+    return std::string(s, e);
+  };
+  const auto idx = [](uint64_t i, std::size_t n) -> std::size_t {
+    if(i >= n) throw std::out_of_range("Invalid index in cache");
+    return i;
+  };
+
+  udModule ud;
+
+  std::vector<const File*> files;
+  files.reserve(counts[ctFiles]);
+  for(uint64_t i = 0; i < counts[ctFiles]; i++)
+    files.push_back(&sink.file(str(fmt_u64_read(tables[ctFiles] + i * 0x08))));
+  const auto file = [&](uint32_t f) -> const File* {
+    return f == 0 ? nullptr : files[idx(f - 1, files.size())];
+  };
+
+  std::vector<Function> funcs;
+  funcs.reserve(counts[ctFunctions]);
+  for(uint64_t i = 0; i < counts[ctFunctions]; i++) {
+    const char* r = tables[ctFunctions] + i * 0x20;
+    std::optional<uint64_t> offset;
+    if(fmt_u32_read(r + 0x1c) & 0x1) offset = fmt_u64_read(r + 0x08);
+    std::string name = str(fmt_u64_read(r));
+    if(const File* f = file(fmt_u32_read(r + 0x18)))
+      funcs.emplace_back(m, offset, std::move(name), *f, fmt_u64_read(r + 0x10));
+    else
+      funcs.emplace_back(m, offset, std::move(name));
+  }
+
+  // DWARF Functions need stable addresses, the symbols get copies
+  std::vector<const Function*> dwarfFuncs(funcs.size(), nullptr);
+  const auto dwarfFunc = [&](std::size_t i) -> const Function& {
+    if(dwarfFuncs[i] == nullptr)
+      dwarfFuncs[i] = &ud.functions.try_emplace(i, funcs[i]).first->second;
+    return *dwarfFuncs[i];
+  };
+
+  std::vector<const udModule::trienode*> nodes;
+  nodes.reserve(counts[ctTrie]);
+  for(uint64_t i = 0; i < counts[ctTrie]; i++) {
+    const char* r = tables[ctTrie] + i * 0x18;
+    uint32_t func = fmt_u32_read(r);
+    uint64_t parent = fmt_u64_read(r + 0x10);
+    const void* par = parent == 0 ? nullptr : nodes[idx(parent - 1, nodes.size())];
+    if(func != 0) {
+      ud.trie.push_back({{Scope(dwarfFunc(idx(func - 1, funcs.size()))),
+                          Relation::enclosure}, par});
+    } else {
+      const File* f = file(fmt_u32_read(r + 0x04));
+      if(f == nullptr) throw std::out_of_range("Call site without a file in cache");
+      ud.trie.push_back({{Scope(*f, fmt_u64_read(r + 0x08)), Relation::inlined_call}, par});
+    }
+    nodes.push_back(&ud.trie.back());
+  }
+
+  ud.leaves.reserve(counts[ctLeaves]);
+  for(uint64_t i = 0; i < counts[ctLeaves]; i++) {
+    const char* r = tables[ctLeaves] + i * 0x18;
+    ud.leaves.emplace_back(util::interval<uint64_t>(fmt_u64_read(r), fmt_u64_read(r + 0x08)),
+                           nodes[idx(fmt_u64_read(r + 0x10), nodes.size())]);
+  }
+
+  for(uint64_t i = 0; i < counts[ctLines]; i++) {
+    const char* r = tables[ctLines] + i * 0x18;
+    if(const File* f = file(fmt_u32_read(r + 0x10)))
+      ud.lines.try_emplace(fmt_u64_read(r), udModule::line(*f, fmt_u64_read(r + 0x08)));
+    else
+      ud.lines.try_emplace(fmt_u64_read(r), std::nullopt);
+  }
+  ud.lines.make_consistent();
+
+  for(uint64_t i = 0; i < counts[ctSymbols]; i++) {
+    const char* r = tables[ctSymbols] + i * 0x18;
+    ud.symbols.emplace(util::interval<uint64_t>(fmt_u64_read(r), fmt_u64_read(r + 0x08)),
+                       funcs[idx(fmt_u64_read(r + 0x10), funcs.size())]);
+  }
+
+  out = std::move(ud);
+  return true;
+} catch(std::exception& e) {
+  util::log::warning{} << "Ignoring invalid cache entry " << path.string()
+                       << ": " << e.what();
+  return false;
+}
+
+void DirectClassification::writeCache(const stdshim::filesystem::path& path,
+                                      const udModule& ud) noexcept try {
+  std::string strings;
+  std::unordered_map<std::string, uint64_t> stringIdx;
+  const auto str = [&](const std::string& s) -> uint64_t {
+    auto [it, first] = stringIdx.try_emplace(s, strings.size());
+    if(first) {
+      strings += s;
+      strings += '\0';
+    }
+    return it->second;
+  };
+
+  std::vector<char> files;
+  std::unordered_map<const File*, uint32_t> fileIdx;
+  const auto file = [&](const File& f) -> uint32_t {
+    auto [it, first] = fileIdx.try_emplace(&f, fileIdx.size() + 1);
+    if(first) {
+      files.resize(files.size() + 0x08);
+      fmt_u64_write(&files[files.size() - 0x08], str(f.path().string()));
+    }
+    return it->second;
+  };
+
+  std::vector<char> funcs;
+  std::unordered_map<const Function*, uint64_t> funcIdx;
+  const auto func = [&](const Function& f) -> uint64_t {
+    auto [it, first] = funcIdx.try_emplace(&f, funcIdx.size());
+    if(first) {
+      funcs.resize(funcs.size() + 0x20);
+      char* r = &funcs[funcs.size() - 0x20];
+      auto sl = f.sourceLocation();
+      fmt_u64_write(r, str(f.name()));
+      fmt_u64_write(r + 0x08, f.offset().value_or(0));
+      fmt_u64_write(r + 0x10, sl ? sl->second : 0);
+      fmt_u32_write(r + 0x18, sl ? file(sl->first) : 0);
+      fmt_u32_write(r + 0x1c, f.offset() ? 0x1 : 0);
+    }
+    return it->second;
+  };
+
+  std::vector<char> trie(ud.trie.size() * 0x18);
+  std::unordered_map<const void*, uint64_t> nodeIdx;
+  for(const auto& tn: ud.trie) {
+    char* r = &trie[nodeIdx.size() * 0x18];
+    const Scope& s = tn.first.first;
+    if(s.type() == Scope::Type::function) {
+      fmt_u32_write(r, func(s.function_data()) + 1);
+      fmt_u32_write(r + 0x04, 0);
+      fmt_u64_write(r + 0x08, 0);
+    } else {
+      auto [f, l] = s.line_data();
+      fmt_u32_write(r, 0);
+      fmt_u32_write(r + 0x04, file(f));
+      fmt_u64_write(r + 0x08, l);
+    }
+    // Parents always come before their children in the trie
+    fmt_u64_write(r + 0x10, tn.second == nullptr ? 0 : nodeIdx.at(tn.second) + 1);
+    nodeIdx.emplace(&tn, nodeIdx.size());
+  }
+
+  std::vector<char> leaves(ud.leaves.size() * 0x18);
+  for(std::size_t i = 0; i < ud.leaves.size(); i++) {
+    char* r = &leaves[i * 0x18];
+    fmt_u64_write(r, ud.leaves[i].first.begin);
+    fmt_u64_write(r + 0x08, ud.leaves[i].first.end);
+    fmt_u64_write(r + 0x10, nodeIdx.at(ud.leaves[i].second));
+  }
+
+  std::vector<char> lines;
+  for(const auto& [addr, l]: ud.lines) {
+    lines.resize(lines.size() + 0x18, 0);
+    char* r = &lines[lines.size() - 0x18];
+    fmt_u64_write(r, addr);
+    fmt_u64_write(r + 0x08, l ? l->second : 0);
+    fmt_u32_write(r + 0x10, l ? file(l->first) : 0);
+  }
+
+  std::vector<char> symbols(ud.symbols.size() * 0x18);
+  std::size_t nSymbols = 0;
+  for(const auto& [range, f]: ud.symbols) {
+    char* r = &symbols[nSymbols++ * 0x18];
+    fmt_u64_write(r, range.begin);
+    fmt_u64_write(r + 0x08, range.end);
+    fmt_u64_write(r + 0x10, func(f));
+  }
+
+  // Lay out the tables after the header
+  std::array<std::pair<const char*, std::size_t>, ctCount> data = {{
+    {strings.data(), strings.size()}, {files.data(), files.size()},
+    {funcs.data(), funcs.size()}, {trie.data(), trie.size()},
+    {leaves.data(), leaves.size()}, {lines.data(), lines.size()},
+    {symbols.data(), symbols.size()},
+  }};
+  std::array<char, cacheHdrSize> hdr = {0};
+  std::memcpy(hdr.data(), cacheMagic, sizeof cacheMagic);
+  fmt_u32_write(hdr.data() + 8, cacheVersion);
+  uint64_t off = align8(cacheHdrSize);
+  for(int t = 0; t < ctCount; t++) {
+    fmt_u64_write(hdr.data() + 0x10 + t * 0x10, off);
+    fmt_u64_write(hdr.data() + 0x18 + t * 0x10, data[t].second / cacheRecSize[t]);
+    off = align8(off + data[t].second);
+  }
+
+  // Write to a temporary and rename it into place, so that concurrent runs
+  // never see a partial entry.
+  stdshim::filesystem::create_directories(path.parent_path());
+  std::string tmp = path.string() + ".tmp.XXXXXX";
+  int tmpfd = mkstemp(tmp.data());
+  if(tmpfd == -1) throw std::system_error(errno, std::generic_category(), "mkstemp");
+  close(tmpfd);
+  try {
+    std::ofstream f(tmp, std::ios_base::binary | std::ios_base::trunc);
+    f.write(hdr.data(), hdr.size());
+    std::size_t pos = hdr.size();
+    for(int t = 0; t < ctCount; t++) {
+      const char zeros[8] = {0};
+      f.write(zeros, align8(pos) - pos);
+      pos = align8(pos);
+      f.write(data[t].first, data[t].second);
+      pos += data[t].second;
+    }
+    f.close();
+    if(!f) throw std::runtime_error("write failed");
+    stdshim::filesystem::rename(tmp, path);
+  } catch(...) {
+    unlink(tmp.c_str());
+    throw;
+  }
+} catch(std::exception& e) {
+  util::log::warning{} << "Failed to write cache entry " << path.string()
+                       << ": " << e.what();
 }
 
 template<class Elf_Shdr, class Elf_Sym, auto elf_getshdr, class F>
@@ -303,9 +658,8 @@ bool DirectClassification::symtab(void* elf_vp, const Module& m, udModule& ud) {
 }
 
 // Helper recursive thing
-template<class T>
-void dwarfwalk(Dwarf_Die die, const std::function<T(Dwarf_Die&, T)>& pre,
-               const std::function<void(Dwarf_Die&, T, T)>& post, const T& t) {
+template<class T, class Pre, class Post>
+static void dwarfwalk(Dwarf_Die die, const Pre& pre, const Post& post, const T& t) {
   do {
     Dwarf_Die child;
     T subt = pre(die, t);
@@ -334,7 +688,27 @@ void dwarfwalk(Dwarf_Die die, const std::function<T(Dwarf_Die&, T)>& pre,
   } while(dwarf_siblingof(&die, &die) == 0);
 }
 
-bool DirectClassification::fullDwarf(void* dbg_vp, const Module& m, udModule& ud) try {
+// Data decoded from a single DWARF CU, independently of every other CU.
+// Functions are referenced by the offset of their (abstract) DIE and trie
+// nodes by index, so that CUs can be decoded in parallel and merged after.
+struct DirectClassification::cuData final {
+  static constexpr std::size_t npos = std::numeric_limits<std::size_t>::max();
+  struct node {
+    // Function for normal nodes, call site for inlined calls
+    std::optional<Dwarf_Off> func;
+    const File* file;
+    uint64_t line;
+    std::size_t parent;
+  };
+
+  std::unordered_map<Dwarf_Off, Function> functions;
+  std::vector<node> trie;
+  std::map<util::interval<uint64_t>, std::size_t> leaves;
+  std::vector<std::pair<uint64_t, std::optional<udModule::line>>> lines;
+};
+
+bool DirectClassification::dwarfUnits(void* dbg_vp, std::size_t first,
+    std::size_t stride, const Module& m, std::vector<cuData>& cus) try {
   Dwarf* dbg = (Dwarf*)dbg_vp;
 
   // Cache Files so that we don't hammer the maps too much
@@ -374,12 +748,17 @@ bool DirectClassification::fullDwarf(void* dbg_vp, const Module& m, udModule& ud
     return getFile(nullptr, cudie, 0, allowUnknown);
   };
 
-  // Process the bits one CU at a time
+  // Process every stride'th CU, starting from first
   Dwarf_CU* cu = nullptr;
   Dwarf_Die root;
-  while(dwarf_get_units(dbg, cu, &cu, nullptr, nullptr, &root, nullptr) == 0) {
-    dwarfwalk<udModule::trienode*>(root,
-      [&](Dwarf_Die& die, udModule::trienode* par) -> udModule::trienode* {
+  for(std::size_t cuIdx = 0;
+      dwarf_get_units(dbg, cu, &cu, nullptr, nullptr, &root, nullptr) == 0
+      && cuIdx < cus.size(); ++cuIdx) {
+    if(cuIdx % stride != first) continue;
+    cuData& ud = cus[cuIdx];
+
+    dwarfwalk<std::size_t>(root,
+      [&](Dwarf_Die& die, std::size_t par) -> std::size_t {
         // Check that the DIE is a function-like thing. Skip if not.
         int tag = dwarf_tag(&die);
         if(tag != DW_TAG_subprogram && tag != DW_TAG_inlined_subroutine)
@@ -436,13 +815,12 @@ bool DirectClassification::fullDwarf(void* dbg_vp, const Module& m, udModule& ud
           Dwarf_Die* fdie = dwarf_formref_die(attr, &fdie_mem);
           if(fdie != nullptr) offsetid = dwarf_dieoffset(fdie);
         }
-        Function& func = ud.functions.try_emplace(offsetid, m).first->second;
-        func += std::move(myfunc);
+        ud.functions.try_emplace(offsetid, m).first->second += std::move(myfunc);
 
         // If this is not an inlined call, just emit as a normal Scope
         if(tag != DW_TAG_inlined_subroutine) {
-          ud.trie.push_back({{Scope(func), Relation::enclosure}, par});
-          return &ud.trie.back();
+          ud.trie.push_back({offsetid, nullptr, 0, par});
+          return ud.trie.size() - 1;
         }
 
         // Try to find the file for this inlined call.
@@ -461,12 +839,12 @@ bool DirectClassification::fullDwarf(void* dbg_vp, const Module& m, udModule& ud
           if(dwarf_formudata(attr, &word) == 0) linenum = word;
         }
 
-        ud.trie.push_back({{Scope(*srcf, linenum), Relation::inlined_call}, par});
-        ud.trie.push_back({{Scope(func), Relation::enclosure}, &ud.trie.back()});
-        return &ud.trie.back();
-      }, [&](Dwarf_Die& die, udModule::trienode* here, udModule::trienode* par) {
+        ud.trie.push_back({std::nullopt, srcf, linenum, par});
+        ud.trie.push_back({offsetid, nullptr, 0, ud.trie.size() - 1});
+        return ud.trie.size() - 1;
+      }, [&](Dwarf_Die& die, std::size_t here, std::size_t par) {
         // If we have no trienode, skip without doing anything
-        if(here == nullptr) return;
+        if(here == cuData::npos) return;
 
         // Mark all remaining ranges as being from this tail
         ptrdiff_t offset = 0;
@@ -478,23 +856,24 @@ bool DirectClassification::fullDwarf(void* dbg_vp, const Module& m, udModule& ud
               it != end; ++it) {
             auto [before, after] = mine - it->first;
             if(!before.empty()) {
-              [[maybe_unused]] bool first = ud.leaves.try_emplace(before, *here).second;
+              [[maybe_unused]] bool first = ud.leaves.try_emplace(before, here).second;
               assert(first);
             }
             mine = after;
             if(mine.empty()) break;
           }
           if(!mine.empty()) {
-            [[maybe_unused]] bool first = ud.leaves.try_emplace(mine, *here).second;
+            [[maybe_unused]] bool first = ud.leaves.try_emplace(mine, here).second;
             assert(first);
           }
         }
-      }, nullptr);
+      }, cuData::npos);
 
     // Now that the scopes are in place for this CU, load in the line info.
     Dwarf_Lines* lines = nullptr;
     std::size_t cnt = 0;
     dwarf_getsrclines(&root, &lines, &cnt);
+    ud.lines.reserve(cnt);
     for(std::size_t i = 0; i < cnt; i++) {
       Dwarf_Line* line = dwarf_onesrcline(lines, i);
       Dwarf_Addr addr = 0;
@@ -508,16 +887,113 @@ bool DirectClassification::fullDwarf(void* dbg_vp, const Module& m, udModule& ud
         int lineno = 0;
         dwarf_lineno(line, &lineno);
 
-        ud.lines.try_emplace(addr, udModule::line(*file, lineno));
+        ud.lines.emplace_back(addr, udModule::line(*file, lineno));
       } else
-        ud.lines.try_emplace(addr, std::nullopt);
+        ud.lines.emplace_back(addr, std::nullopt);
     }
   }
+  return true;
+} catch(std::exception& e) {
+  const auto& rpath = m.userdata[sink.resolvedPath()];
+  util::log::info{} << "Exception caught during DWARF parsing for "
+    << m.path().filename().string() << "\n"
+       "  what(): " << e.what() << "\n"
+       "  Full path: " << (rpath.empty() ? m.path() : rpath).string();
+  return false;
+}
+
+bool DirectClassification::fullDwarf(void* dbg_vp, int fd, const Module& m,
+                                     udModule& ud) try {
+  Dwarf* dbg = (Dwarf*)dbg_vp;
+
+  // Count the CUs, so that the work can be split up among the threads
+  std::size_t nCUs = 0;
+  for(Dwarf_CU* cu = nullptr;
+      dwarf_get_units(dbg, cu, &cu, nullptr, nullptr, nullptr, nullptr) == 0;)
+    ++nCUs;
+  std::vector<cuData> cus(nCUs);
+
+  // Decode the CUs in parallel, as tasks for the Pipeline's thread team to pick
+  // up when it is otherwise idle. Outside of a parallel region the tasks run
+  // right away, one after the other. libdw is not thread-safe within a single
+  // Dwarf, so every task but the one run here reads the same file through a
+  // Dwarf of its own. Those would each need their own copy of the
+  // supplementary (dwz) file as well, so DWARF that refers to one is decoded
+  // serially.
+  std::size_t nTasks = std::min<std::size_t>(omp_get_num_threads(), nCUs);
+  if(dwarfThreads > 0) nTasks = std::min<std::size_t>(nTasks, dwarfThreads);
+  {
+    const char* altname;
+    const void* altid;
+    if(dwelf_dwarf_gnu_debugaltlink(dbg, &altname, &altid) > 0) nTasks = 1;
+  }
+  nTasks = std::max<std::size_t>(nTasks, 1);
+  std::atomic<bool> ok = true;
+  #pragma omp taskgroup
+  {
+    for(std::size_t t = 1; t < nTasks; ++t) {
+      #pragma omp task default(shared) firstprivate(t)
+      {
+        Dwarf* tdbg = dwarf_begin(fd, DWARF_C_READ);
+        if(tdbg != nullptr) {
+          if(!dwarfUnits(tdbg, t, nTasks, m, cus)) ok.store(false, std::memory_order_relaxed);
+          dwarf_end(tdbg);
+        } else ok.store(false, std::memory_order_relaxed);
+      }
+    }
+    if(!dwarfUnits(dbg, 0, nTasks, m, cus)) ok.store(false, std::memory_order_relaxed);
+  }
+
+  // Merge the CUs together, in order. This matches the result of processing
+  // the CUs in sequence, except where the ranges of different CUs overlap.
+  std::vector<std::pair<util::interval<uint64_t>, const udModule::trienode*>> leaves;
+  std::vector<const udModule::trienode*> nodes;
+  for(auto& cu: cus) {
+    for(auto& [off, func]: cu.functions)
+      ud.functions.try_emplace(off, m).first->second += std::move(func);
+
+    nodes.clear();
+    nodes.reserve(cu.trie.size());
+    for(const auto& n: cu.trie) {
+      const void* par = n.parent == cuData::npos ? nullptr : nodes[n.parent];
+      if(n.func)
+        ud.trie.push_back({{Scope(ud.functions.at(*n.func)), Relation::enclosure}, par});
+      else
+        ud.trie.push_back({{Scope(*n.file, n.line), Relation::inlined_call}, par});
+      nodes.push_back(&ud.trie.back());
+    }
+
+    for(const auto& [range, idx]: cu.leaves) {
+      if(!range.empty()) leaves.emplace_back(range, nodes[idx]);
+    }
+    for(auto& [addr, l]: cu.lines)
+      ud.lines.try_emplace(addr, std::move(l));
+
+    cu = cuData();  // Release the memory early
+  }
+
+  // Sort the leaves into a flat interval vector. Where ranges overlap, the one
+  // that begins first wins, and of those that begin at the same address the
+  // one from the earlier CU.
+  std::stable_sort(leaves.begin(), leaves.end(), [](const auto& a, const auto& b){
+    return a.first.begin < b.first.begin;
+  });
+  ud.leaves.clear();
+  ud.leaves.reserve(leaves.size());
+  for(auto& [range, tn]: leaves) {
+    if(!ud.leaves.empty()) {
+      auto covered = ud.leaves.back().first.end;
+      if(range.end <= covered) continue;
+      if(range.begin < covered) range.begin = covered;
+    }
+    ud.leaves.emplace_back(range, tn);
+  }
+  ud.leaves.shrink_to_fit();
 
   // Make sure the linemap is consistent before returning, since we use it in
   // const mode just about everywhere else.
   ud.lines.make_consistent();
-  return true;
+  return ok.load(std::memory_order_relaxed);
 } catch(std::exception& e) {
   const auto& rpath = m.userdata[sink.resolvedPath()];
   util::log::info{} << "Exception caught during DWARF parsing for "
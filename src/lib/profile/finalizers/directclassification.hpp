@@ -52,6 +52,7 @@
 #include "../util/range_map.hpp"
 
 #include <map>
+#include <vector>
 
 namespace hpctoolkit::finalizers {
 
@@ -61,7 +62,13 @@ class DirectClassification final : public ProfileFinalizer {
 public:
   // `dwarfThreshold` is in the units of bytes.
   // If dwarfThreshold == std::numeric_limits<uintmax_t>::max(), no limit.
-  DirectClassification(uintmax_t dwarfThreshold);
+  // If `cacheDir` is not empty, the results of analyzing each binary are
+  // cached there and reused by later instances.
+  // The DWARF of each binary is decoded by up to `dwarfThreads` threads of the
+  // Pipeline's team, or by as many as it has if `dwarfThreads` is 0.
+  DirectClassification(uintmax_t dwarfThreshold,
+                       stdshim::filesystem::path cacheDir = {},
+                       unsigned int dwarfThreads = 0);
 
   void notifyPipeline() noexcept override;
   ExtensionClass provides() const noexcept override { return ExtensionClass::classification; }
@@ -76,7 +83,8 @@ private:
     std::unordered_map<uint64_t, Function> functions;
     using trienode = std::pair<std::pair<Scope, Relation>, const void* /* const trienode* */>;
     std::deque<trienode> trie;
-    std::map<util::interval<uint64_t>, const trienode&> leaves;
+    // Sorted, non-overlapping ranges mapped to the innermost trienode
+    std::vector<std::pair<util::interval<uint64_t>, const trienode*>> leaves;
 
     // Storage for DWARF linemap data
     using line = std::pair<util::reference_index<const File>, uint64_t>;
@@ -89,9 +97,16 @@ private:
   };
 
   uintmax_t dwarfThreshold;
+  stdshim::filesystem::path cacheDir;
+  unsigned int dwarfThreads;
   Module::ud_t::typed_member_t<udModule> ud;
   void load(const Module&, udModule&) noexcept;
-  bool fullDwarf(void* dw, const Module&, udModule&);
+  bool readCache(const stdshim::filesystem::path&, const Module&, udModule&) noexcept;
+  void writeCache(const stdshim::filesystem::path&, const udModule&) noexcept;
+  struct cuData;
+  bool fullDwarf(void* dw, int fd, const Module&, udModule&);
+  bool dwarfUnits(void* dw, std::size_t first, std::size_t stride, const Module&,
+                  std::vector<cuData>&);
   bool symtab(void* elf, const Module&, udModule&);
 };
 
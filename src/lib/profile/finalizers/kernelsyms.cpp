@@ -52,10 +52,13 @@
 
 #include "include/linux_info.h"
 
-#include <limits>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
 #include <fstream>
-#include <sstream>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 
 using namespace hpctoolkit;
 using namespace finalizers;
@@ -75,9 +78,24 @@ KernelSymbols::classify(Context& c, NestedScope& ns) noexcept {
   if(ns.flat().type() == Scope::Type::point) {
     auto mo = ns.flat().point_data();
     const auto& udm = mo.first.userdata[ud];
-    auto symit = udm.symbols.find(mo.second);
-    if(symit != udm.symbols.end()) {
-      auto& cc = sink.context(c, {ns.relation(), Scope(symit->second)}).second;
+    // Symbols extend from their address up to the next symbol's
+    auto it = std::upper_bound(udm.addrs.begin(), udm.addrs.end(), mo.second);
+    if(it != udm.addrs.begin()) {
+      std::size_t idx = std::distance(udm.addrs.begin(), it) - 1;
+      auto func = udm.functions.find(idx);
+      if(!func) {
+        // Stitch together the full name of the function
+        const auto& sym = udm.syms[idx];
+        std::string fname(udm.names, sym.name, sym.nameLen);
+        if(sym.moduleLen > 0) {
+          fname += ' ';
+          fname.append(udm.names, sym.module, sym.moduleLen);
+        }
+        fname += " " LINUX_KERNEL_NAME;
+        func = udm.functions.try_emplace(idx, mo.first, udm.addrs[idx],
+                                         std::move(fname)).first;
+      }
+      auto& cc = sink.context(c, {ns.relation(), Scope(*func)}).second;
       ns.relation() = Relation::enclosure;
       return std::make_pair(std::ref(cc), std::ref(cc));
     }
@@ -99,62 +117,105 @@ void KernelSymbols::load(const Module& m, udModule& ud) noexcept {
 
   // Give it a shot, catch any errors if things go south
   try {
-    std::ifstream symsfile_base(syms);
-    util::ilzmastream symsfile(symsfile_base.rdbuf());
-
-    bool sawBadLine = false;
-
-    // Keep reading lines until we run into really bad problems
-    std::string linestr;
-    while(std::getline(symsfile, linestr)) {
-      if(linestr.empty()) continue;  // Skip over blank lines
-      std::istringstream line(std::move(linestr));
-
-      // Parse the required fields on this line first, if we fail we skip
-      uint64_t addr;
-      std::string typestr;
-      std::string name;
-      line >> std::hex >> addr >> typestr >> name;
-      if(!line || typestr.size() != 1) {
-        if(!sawBadLine) {
-          sawBadLine = true;
-          util::log::error{} << "Failed to parse entry from symbols file " << syms.string()
-            << ", some functions within " << name << " will be extended across the corrupted entries";
-        }
-        continue;
+    // Read the whole file in one go, and decompress it if needed
+    std::vector<char> raw(stdshim::filesystem::file_size(syms));
+    {
+      std::ifstream symsfile(syms, std::ios_base::binary);
+      if(!symsfile.read(raw.data(), raw.size())) {
+        util::log::error{} << "I/O failure while reading from symbols file " << syms.string();
+        return;
       }
-      if(typestr.front() != 't' && typestr.front() != 'T') continue;
-
-      // The module name is optional
-      std::string modulename;
-      line >> modulename;
-
-      // Stitch together the full name of the function
-      std::string fname;
-      {
-        std::ostringstream ss;
-        ss << name;
-        if(!modulename.empty()) ss << " " << modulename;
-        ss << " " << LINUX_KERNEL_NAME;
-        fname = ss.str();
-      }
-
-      // Log this entry
-      ud.symbols.emplace(addr, Function(m, addr, std::move(fname)));
-
-      // Nom the end-of-line and any other whitespace until the next (real) line
-      symsfile >> std::ws;
-    }
-    if(symsfile.bad()) {
-      util::log::error{} << "I/O failure while reading from symbols file " << syms.string();
     }
+    if(util::isXZ(raw.data(), raw.size()))
+      raw = util::lzmaDecompress(raw.data(), raw.size());
 
-    // Make sure this is consistent before continuing along
-    ud.symbols.make_consistent();
+    parse(raw.data(), raw.data() + raw.size(), syms, ud);
   } catch(std::exception& e) {
     util::log::vwarning{} << "Exception caught while parsing symbols data from "
       << syms << " for " << name << "\n"
          "  what(): " << e.what();
-    ud.symbols.clear();
+    ud = udModule();
+  }
+}
+
+// Parse an nm-like symbol listing (/proc/kallsyms), lines of the form:
+//   <hex address> <type> <name> [<module>]
+// Only text (t/T) symbols are kept.
+void KernelSymbols::parse(const char* p, const char* const end,
+                          const stdshim::filesystem::path& syms, udModule& ud) {
+  const auto isspace = [](char c) { return c == ' ' || c == '\t' || c == '\r'; };
+  const auto token = [&](const char*& q) -> std::string_view {
+    while(q != end && isspace(*q)) ++q;
+    const char* s = q;
+    while(q != end && !isspace(*q) && *q != '\n') ++q;
+    return {s, (std::size_t)(q - s)};
+  };
+
+  // Module names repeat a lot, so they are only stored once. The keys point
+  // into the input buffer, which outlives this function call.
+  std::unordered_map<std::string_view, uint32_t> modules;
+  std::vector<std::pair<uint64_t, udModule::symbol>> entries;
+  // A kallsyms line is usually around 40 bytes, most of which are text symbols
+  entries.reserve((end - p) / 48);
+  ud.names.reserve((end - p) / 3);
+  bool sawBadLine = false;
+
+  while(p != end) {
+    const char* eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+    if(eol == nullptr) eol = end;
+    const char* q = p;
+    p = eol == end ? end : eol + 1;
+
+    // Parse the required fields on this line first, if we fail we skip
+    while(q != eol && isspace(*q)) ++q;
+    if(q == eol) continue;  // Skip over blank lines
+    uint64_t addr;
+    auto res = std::from_chars(q, eol, addr, 16);
+    q = res.ptr;
+    std::string_view type, name;
+    if(res.ec == std::errc()) {
+      type = token(q);
+      name = token(q);
+    }
+    if(res.ec != std::errc() || type.size() != 1 || name.empty()) {
+      if(!sawBadLine) {
+        sawBadLine = true;
+        util::log::error{} << "Failed to parse entry from symbols file " << syms.string()
+          << ", some functions will be extended across the corrupted entries";
+      }
+      continue;
+    }
+    if(type.front() != 't' && type.front() != 'T') continue;
+
+    udModule::symbol sym;
+    sym.name = ud.names.size();
+    sym.nameLen = name.size();
+    ud.names.append(name);
+
+    // The module name is optional
+    auto module = token(q);
+    sym.moduleLen = module.size();
+    sym.module = 0;
+    if(!module.empty()) {
+      auto [it, first] = modules.try_emplace(module, ud.names.size());
+      if(first) ud.names.append(module);
+      sym.module = it->second;
+    }
+
+    entries.emplace_back(addr, sym);
+  }
+
+  // kallsyms is normally sorted already, but don't depend on it. For duplicate
+  // addresses the first symbol listed wins.
+  if(!std::is_sorted(entries.begin(), entries.end(),
+      [](const auto& a, const auto& b){ return a.first < b.first; }))
+    std::stable_sort(entries.begin(), entries.end(),
+      [](const auto& a, const auto& b){ return a.first < b.first; });
+  ud.addrs.reserve(entries.size());
+  ud.syms.reserve(entries.size());
+  for(const auto& [addr, sym]: entries) {
+    if(!ud.addrs.empty() && ud.addrs.back() == addr) continue;
+    ud.addrs.push_back(addr);
+    ud.syms.push_back(sym);
   }
 }
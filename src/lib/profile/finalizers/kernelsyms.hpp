@@ -49,10 +49,11 @@
 
 #include "../finalizer.hpp"
 
-#include "../util/range_map.hpp"
+#include "../util/locked_unordered.hpp"
 
 #include "../stdshim/filesystem.hpp"
-#include <map>
+#include <string>
+#include <vector>
 
 namespace hpctoolkit::finalizers {
 
@@ -71,17 +72,26 @@ public:
   classify(Context&, NestedScope&) noexcept override;
 
 private:
-  struct first final {
-    void operator()(Function&, const Function&) const noexcept {}
-  };
-
+  // Symbols are stored as flat arrays sorted by address, with the names packed
+  // into a single arena. Functions are only created for symbols that are used.
   struct udModule final {
-    util::range_map<uint64_t, Function, first> symbols;
+    struct symbol final {
+      uint32_t name;
+      uint32_t nameLen;
+      uint32_t module;  // 0 if no module
+      uint32_t moduleLen;
+    };
+    std::vector<uint64_t> addrs;
+    std::vector<symbol> syms;
+    std::string names;
+    mutable util::locked_unordered_map<std::size_t, Function> functions;
   };
 
   stdshim::filesystem::path root;
   Module::ud_t::typed_member_t<udModule> ud;
   void load(const Module&, udModule&) noexcept;
+  static void parse(const char*, const char*, const stdshim::filesystem::path&,
+                    udModule&);
 };
 
 }
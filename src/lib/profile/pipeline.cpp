@@ -421,6 +421,8 @@ void ProfilePipeline::run() {
       sl.threads.clear();
       assert(sl.thawedMetrics.empty() && "Source exited before freezing all of its referenced Metrics!");
       sl.thawedMetrics.clear();
+      contextMemoHits.fetch_add(sl.contextMemoHits, std::memory_order_relaxed);
+      contextMemoMisses.fetch_add(sl.contextMemoMisses, std::memory_order_relaxed);
     }
 
     // Make sure everything has been read before we handle the merged threads
@@ -496,6 +498,14 @@ void ProfilePipeline::run() {
     ANNOTATE_HAPPENS_BEFORE(&end_arc);
   }
   ANNOTATE_HAPPENS_AFTER(&end_arc);
+
+  const auto hits = contextMemoHits.load(std::memory_order_relaxed);
+  const auto lookups = hits + contextMemoMisses.load(std::memory_order_relaxed);
+  if(lookups > 0) {
+    util::log::info{} << "Context memo: " << hits << " of " << lookups
+      << " lookups hit (" << std::fixed << std::setprecision(1)
+      << (100. * hits / lookups) << "%)";
+  }
 }
 
 Source::Source() : pipe(nullptr), finalizeContexts(false) {};
@@ -609,8 +619,28 @@ void Source::notifyContext(Context& c) {
     if(s.dataLimit.hasContexts()) s().notifyContext(c);
   }
 }
+std::size_t ProfilePipeline::ContextMemoHash::operator()(const ContextMemoKey& k) const noexcept {
+  std::size_t h = h_ctx(k.first);
+  return h ^ (h_ns(k.second) + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2));
+}
+
 std::pair<Context&, Context&> Source::context(Context& p, const NestedScope& ns) {
   SRC_ASSERT_LIMITS(contexts);
+
+  // Check whether we've seen this exact query before, from any Source
+  std::optional<ProfilePipeline::ContextMemoKey> memoKey;
+  util::optional_ref<decltype(pipe->contextMemo)::value_type> memoShard;
+  if(finalizeContexts) {
+    memoKey.emplace(&p, ns);
+    memoShard = pipe->contextMemo[ProfilePipeline::ContextMemoHash{}(*memoKey)
+                                  % ProfilePipeline::contextMemoShards];
+    if(auto hit = memoShard->find(*memoKey)) {
+      slocal->contextMemoHits++;
+      return {*hit->first, *hit->second};
+    }
+    slocal->contextMemoMisses++;
+  }
+
   util::optional_ref<Context> res_rel;
   std::reference_wrapper<Context> res_flat = p;
   NestedScope res_ns = ns;
@@ -632,7 +662,10 @@ std::pair<Context&, Context&> Source::context(Context& p, const NestedScope& ns)
   std::tie(res_flat, first) = res_flat.get().ensure(res_ns);
   if(first) notifyContext(res_flat);
 
-  return {res_rel ? *res_rel : res_flat.get(), res_flat};
+  Context& rel = res_rel ? *res_rel : res_flat.get();
+  if(memoShard)
+    memoShard->try_emplace(std::move(*memoKey), &rel, &res_flat.get());
+  return {rel, res_flat};
 }
 
 util::optional_ref<ContextFlowGraph> Source::contextFlowGraph(const Scope& s) {
@@ -655,7 +688,7 @@ util::optional_ref<ContextFlowGraph> Source::contextFlowGraph(const Scope& s) {
 ContextReconstruction& Source::contextReconstruction(ContextFlowGraph& g, Context& r) {
   SRC_ASSERT_LIMITS(contexts);
   assert(!g.empty() && "FlowGraph obtained when it shouldn't have been?");
-  auto x = r.reconsts_p->emplace(r, g);
+  auto x = r.reconstructions().emplace(r, g);
   ContextReconstruction& rc = x.first;
   if(x.second) {
     rc.instantiate(
@@ -751,7 +784,10 @@ Thread& Source::newThread(ThreadAttributes o) {
 
 PerThreadTemporary& Source::setup(PerThreadTemporary& tt) {
   tt.ctxTpData.staging.reserve(4096);
-  if(tt.thread().attributes.ctxTimepointDisorder() > 0) {
+  if(tt.thread().attributes.ctxTimepointDisorder() == ThreadAttributes::unboundedDisorder) {
+    // Skip straight to the in-memory sort, a bounded one would only overflow
+    tt.ctxTpData.unboundedDisorder = true;
+  } else if(tt.thread().attributes.ctxTimepointDisorder() > 0) {
     // We need K+1 to detect the case when it was >K-disordered
     // Then another +1 to so disorder is treated properly by the algorithm
     tt.ctxTpData.sortBuf = decltype(tt.ctxTpData.sortBuf)(
@@ -867,7 +903,9 @@ Source::TimepointStatus Source::timepoint(PerThreadTemporary& tt, Metric& m, dou
   if(x.second) {
     tpd.staging.reserve(4096);
     auto dis = tt.thread().attributes.metricTimepointDisorder(m);
-    if(dis > 0) {
+    if(dis == ThreadAttributes::unboundedDisorder) {
+      tpd.unboundedDisorder = true;
+    } else if(dis > 0) {
       // We need K+1 to detect the case when it was >K-disordered
       // Then another +1 to so disorder is treated properly by the algorithm
       tpd.sortBuf = decltype(tpd.sortBuf)(dis + 2);
@@ -57,6 +57,8 @@
 #include "util/locked_unordered.hpp"
 #include "util/once.hpp"
 
+#include <array>
+#include <atomic>
 #include <map>
 #include <bitset>
 #include <optional>
@@ -229,6 +231,8 @@ private:
     std::forward_list<PerThreadTemporary> threads;
     std::unordered_set<Metric*> thawedMetrics;
     bool lastWave = false;
+    std::uint64_t contextMemoHits = 0;
+    std::uint64_t contextMemoMisses = 0;
 #ifndef NDEBUG
     DataClass disabled;
 #endif
@@ -606,6 +610,21 @@ private:
   std::unique_ptr<Context> cct;
   util::locked_unordered_uniqued_set<ContextFlowGraph> cgraphs;
 
+  // Memo of Source::context results, keyed by parent Context and Scope. Most
+  // profiles in a run share the bulk of their calling contexts, repeats skip
+  // classification and insertion entirely. Sharded to reduce lock contention.
+  using ContextMemoKey = std::pair<const Context*, NestedScope>;
+  struct ContextMemoHash {
+    std::hash<const Context*> h_ctx;
+    std::hash<NestedScope> h_ns;
+    std::size_t operator()(const ContextMemoKey&) const noexcept;
+  };
+  static constexpr std::size_t contextMemoShards = 64;
+  std::array<util::locked_unordered_map<ContextMemoKey, std::pair<Context*, Context*>,
+      stdshim::shared_mutex, ContextMemoHash>, contextMemoShards> contextMemo;
+  std::atomic<std::uint64_t> contextMemoHits = 0;
+  std::atomic<std::uint64_t> contextMemoMisses = 0;
+
   struct TupleHash {
     std::hash<uint16_t> h_u16;
     std::hash<uint64_t> h_u64;
@@ -0,0 +1,655 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2023, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+#include "database.hpp"
+
+#include "../util/lzmastream.hpp"
+
+#include "lib/prof-lean/formats/metadb.h"
+#include "lib/prof-lean/formats/profiledb.h"
+#include "lib/prof-lean/formats/cctdb.h"
+#include "lib/prof-lean/formats/tracedb.h"
+#include "lib/prof-lean/formats/primitive.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <sstream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace hpctoolkit;
+using namespace hpctoolkit::query;
+namespace fs = stdshim::filesystem;
+
+// Maximum number of decompressed blocks kept around between queries
+static constexpr std::size_t maxCachedBlocks = 64;
+
+//
+// MappedFile
+//
+
+MappedFile::MappedFile(const fs::path& path) : m_data(nullptr), m_size(0) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if(fd == -1)
+    throw std::runtime_error("Unable to open " + path.string() + ": " + std::strerror(errno));
+  struct stat sb;
+  if(fstat(fd, &sb) != 0) {
+    close(fd);
+    throw std::runtime_error("Unable to stat " + path.string() + ": " + std::strerror(errno));
+  }
+  m_size = sb.st_size;
+  if(m_size > 0) {
+    void* map = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(map == MAP_FAILED) {
+      close(fd);
+      throw std::runtime_error("Unable to map " + path.string() + ": " + std::strerror(errno));
+    }
+    // Queries jump around the file, readahead would only waste I/O
+    madvise(map, m_size, MADV_RANDOM);
+    m_data = (const char*)map;
+  }
+  close(fd);
+}
+
+MappedFile::~MappedFile() {
+  if(m_data != nullptr) munmap((void*)m_data, m_size);
+}
+
+const char* MappedFile::at(std::uint64_t off, std::uint64_t len) const {
+  if(off > m_size || len > m_size - off)
+    throw std::out_of_range("Database reference beyond the end of the file");
+  return m_data + off;
+}
+
+std::string_view MappedFile::string(std::uint64_t off) const {
+  const char* s = at(off, 0);
+  const char* e = (const char*)std::memchr(s, '\0', m_size - off);
+  if(e == nullptr) throw std::out_of_range("Unterminated string in database");
+  return std::string_view(s, e - s);
+}
+
+//
+// Database
+//
+
+// Check the magic and version of a database file, and return the start of its
+// header. Throws if the file is incompatible.
+static const char* checkHeader(const MappedFile& f, std::size_t hdrSize,
+    enum fmt_version_t (*check)(const char[16], uint8_t*), const char* name,
+    uint8_t* minorVer = nullptr) {
+  const char* hdr = f.at(0, hdrSize);
+  switch(check(hdr, minorVer)) {
+  case fmt_version_exact:
+  case fmt_version_forward:
+  case fmt_version_backward:  // Older minor versions are a subset of this one
+    return hdr;
+  case fmt_version_invalid:
+    throw std::runtime_error(std::string("Not a valid ") + name + " file");
+  default:
+    throw std::runtime_error(std::string("Unsupported version of ") + name);
+  }
+}
+
+static std::string_view basename(std::string_view p) {
+  const auto slash = p.rfind('/');
+  return slash == std::string_view::npos ? p : p.substr(slash + 1);
+}
+
+Database::Database(const fs::path& dir)
+  : m_meta(dir / "meta.db"), m_profile(dir / "profile.db"), m_cct(dir / "cct.db"),
+    m_summaryProf(UINT32_MAX) {
+  if(fs::exists(dir / "trace.db"))
+    m_trace = std::make_unique<MappedFile>(dir / "trace.db");
+
+  fmt_metadb_fHdr_t fhdr;
+  fmt_metadb_fHdr_read(&fhdr, checkHeader(m_meta, FMT_METADB_SZ_FHdr,
+                                          fmt_metadb_check, "meta.db"));
+
+  // General Properties
+  {
+    fmt_metadb_generalSHdr_t gs;
+    fmt_metadb_generalSHdr_read(&gs, m_meta.at(fhdr.pGeneral, FMT_METADB_SZ_GeneralSHdr));
+    m_title = m_meta.string(gs.pTitle);
+  }
+
+  // Identifier Names
+  {
+    fmt_metadb_idNamesSHdr_t is;
+    fmt_metadb_idNamesSHdr_read(&is, m_meta.at(fhdr.pIdNames, FMT_METADB_SZ_IdNamesSHdr));
+    const char* names = m_meta.at(is.ppNames, is.nKinds * 8);
+    for(unsigned int k = 0; k < is.nKinds; k++)
+      m_kindNames.emplace_back(m_meta.string(fmt_u64_read(names + k * 8)));
+  }
+
+  // Performance Metrics
+  {
+    fmt_metadb_metricsSHdr_t ms;
+    fmt_metadb_metricsSHdr_read(&ms, m_meta.at(fhdr.pMetrics, FMT_METADB_SZ_MetricsSHdr));
+    const auto scopeName = [&](std::uint64_t pScope) {
+      fmt_metadb_propScope_t ps;
+      fmt_metadb_propScope_read(&ps, m_meta.at(pScope, FMT_METADB_SZ_PropScope));
+      return std::string(m_meta.string(ps.pScopeName));
+    };
+    for(std::uint32_t i = 0; i < ms.nMetrics; i++) {
+      fmt_metadb_metricDesc_t md;
+      fmt_metadb_metricDesc_read(&md, m_meta.at(ms.pMetrics + i * ms.szMetric,
+                                                FMT_METADB_SZ_MetricDesc));
+      const std::string name(m_meta.string(md.pName));
+      for(std::uint16_t j = 0; j < md.nScopeInsts; j++) {
+        fmt_metadb_propScopeInst_t psi;
+        fmt_metadb_propScopeInst_read(&psi, m_meta.at(md.pScopeInsts + j * ms.szScopeInst,
+                                                      FMT_METADB_SZ_PropScopeInst));
+        m_metrics.push_back({name, scopeName(psi.pScope), psi.propMetricId});
+      }
+      for(std::uint16_t j = 0; j < md.nSummaries; j++) {
+        fmt_metadb_summaryStat_t ss;
+        fmt_metadb_summaryStat_read(&ss, m_meta.at(md.pSummaries + j * ms.szSummary,
+                                                   FMT_METADB_SZ_SummaryStat));
+        m_stats.push_back({name, scopeName(ss.pScope), std::string(m_meta.string(ss.pFormula)),
+                           ss.combine, ss.statMetricId});
+      }
+    }
+  }
+
+  // Context Tree. Only the parent links and record offsets are extracted, the
+  // records themselves are decoded on demand.
+  {
+    const auto setContext = [&](std::uint32_t ctx, std::uint32_t parent, std::uint64_t rec) {
+      if(ctx == 0) throw std::runtime_error("Context with reserved ctxId 0 in meta.db");
+      if(ctx >= m_ctxParents.size()) {
+        m_ctxParents.resize(ctx + 1, noParent);
+        m_ctxRecords.resize(ctx + 1, 0);
+      }
+      m_ctxParents[ctx] = parent;
+      m_ctxRecords[ctx] = rec;
+    };
+    m_ctxParents.assign(1, noParent);
+    m_ctxRecords.assign(1, 0);
+
+    struct pending_t {
+      std::uint64_t p;
+      std::uint64_t end;
+      std::uint32_t parent;
+    };
+    std::vector<pending_t> pending;
+    fmt_metadb_contextsSHdr_t cs;
+    fmt_metadb_contextsSHdr_read(&cs, m_meta.at(fhdr.pContext, FMT_METADB_SZ_ContextsSHdr));
+    for(std::uint16_t i = 0; i < cs.nEntryPoints; i++) {
+      const std::uint64_t p = cs.pEntryPoints + i * cs.szEntryPoint;
+      fmt_metadb_entryPoint_t ep;
+      fmt_metadb_entryPoint_read(&ep, m_meta.at(p, FMT_METADB_SZ_EntryPoint));
+      setContext(ep.ctxId, 0, p | entryPointTag);
+      if(ep.szChildren > 0) pending.push_back({ep.pChildren, ep.pChildren + ep.szChildren, ep.ctxId});
+    }
+    while(!pending.empty()) {
+      auto& top = pending.back();
+      if(top.p >= top.end) {
+        pending.pop_back();
+        continue;
+      }
+      const std::uint64_t p = top.p;
+      const std::uint32_t parent = top.parent;
+      const std::uint8_t nFlexWords = m_meta.at(p, FMT_METADB_MINSZ_Context)[0x17];
+      const std::uint64_t sz = FMT_METADB_SZ_Context(nFlexWords);
+      fmt_metadb_context_t c;
+      if(!fmt_metadb_context_read(&c, m_meta.at(p, sz)))
+        throw std::runtime_error("Invalid context record in meta.db");
+      top.p += sz;
+      setContext(c.ctxId, parent, p);
+      if(c.szChildren > 0) pending.push_back({c.pChildren, c.pChildren + c.szChildren, c.ctxId});
+    }
+  }
+}
+
+Database::~Database() = default;
+
+bool Database::hasContext(std::uint32_t ctx) const noexcept {
+  return ctx == 0 || (ctx < m_ctxParents.size() && m_ctxParents[ctx] != noParent);
+}
+
+std::optional<std::uint32_t> Database::parent(std::uint32_t ctx) const {
+  if(!hasContext(ctx)) throw std::out_of_range("Invalid context identifier");
+  if(ctx == 0) return std::nullopt;
+  return m_ctxParents[ctx];
+}
+
+std::string Database::label(std::uint32_t ctx) const {
+  if(!hasContext(ctx)) throw std::out_of_range("Invalid context identifier");
+  if(ctx == 0) return "<global>";
+  const std::uint64_t rec = m_ctxRecords[ctx];
+  if(rec & entryPointTag) {
+    fmt_metadb_entryPoint_t ep;
+    fmt_metadb_entryPoint_read(&ep, m_meta.at(rec & ~entryPointTag, FMT_METADB_SZ_EntryPoint));
+    return std::string(m_meta.string(ep.pPrettyName));
+  }
+
+  const std::uint8_t nFlexWords = m_meta.at(rec, FMT_METADB_MINSZ_Context)[0x17];
+  fmt_metadb_context_t c;
+  fmt_metadb_context_read(&c, m_meta.at(rec, FMT_METADB_SZ_Context(nFlexWords)));
+
+  std::ostringstream ss;
+  const auto module = [&](std::uint64_t pModule, std::uint64_t offset) {
+    fmt_metadb_moduleSpec_t ms;
+    fmt_metadb_moduleSpec_read(&ms, m_meta.at(pModule, FMT_METADB_SZ_ModuleSpec));
+    ss << basename(m_meta.string(ms.pPath)) << "+0x" << std::hex << offset << std::dec;
+  };
+  const auto srcloc = [&](std::uint64_t pFile, std::uint32_t line) {
+    fmt_metadb_fileSpec_t fi;
+    fmt_metadb_fileSpec_read(&fi, m_meta.at(pFile, FMT_METADB_SZ_FileSpec));
+    ss << basename(m_meta.string(fi.pPath)) << ":" << line;
+  };
+
+  if(c.relation == FMT_METADB_RELATION_InlinedCall) ss << "[I] ";
+  switch(c.lexicalType) {
+  case FMT_METADB_LEXTYPE_Function:
+    if(c.pFunction != 0) {
+      fmt_metadb_functionSpec_t fn;
+      fmt_metadb_functionSpec_read(&fn, m_meta.at(c.pFunction, FMT_METADB_SZ_FunctionSpec));
+      if(fn.pName != 0) ss << m_meta.string(fn.pName);
+      else if(fn.pModule != 0) module(fn.pModule, fn.offset);
+      else ss << "<unknown function>";
+    } else ss << "<unknown function>";
+    break;
+  case FMT_METADB_LEXTYPE_Loop:
+    ss << "loop";
+    if(c.pFile != 0) {
+      ss << " at ";
+      srcloc(c.pFile, c.line);
+    }
+    break;
+  case FMT_METADB_LEXTYPE_Line:
+    if(c.pFile != 0) srcloc(c.pFile, c.line);
+    else ss << "<unknown line>";
+    break;
+  case FMT_METADB_LEXTYPE_Instruction:
+    if(c.pModule != 0) module(c.pModule, c.offset);
+    else ss << "<unknown instruction>";
+    break;
+  default:
+    ss << "<unknown lexical type " << (unsigned int)c.lexicalType << ">";
+  }
+  return ss.str();
+}
+
+Database::block_t Database::block(const MappedFile& f, std::uint64_t pTable,
+    std::uint64_t pBlk, void (*unpack)(char*, const char*, std::uint64_t),
+    std::size_t recSize) const {
+  // NOTE: {CBlk} structures are identical between profile.db and cct.db
+  fmt_profiledb_cBlk_t blk;
+  fmt_profiledb_cBlk_read(&blk, f.at(pBlk, FMT_PROFILEDB_SZ_CBlk));
+  if(blk.szRaw == 0) return std::make_shared<const std::vector<char>>();
+  const char* data = f.at(pTable + blk.pData, blk.szData);
+
+  {
+    std::unique_lock<std::mutex> l(m_blocksLock);
+    auto it = m_blocks.find(data);
+    if(it != m_blocks.end()) return it->second;
+  }
+
+  std::vector<char> raw(blk.szRaw);
+  util::lzmaDecompress(data, blk.szData, raw.data(), raw.size());
+  if(unpack != nullptr) {
+    if(raw.size() % recSize != 0)
+      throw std::runtime_error("Compressed block has an unexpected size");
+    std::vector<char> out(raw.size());
+    unpack(out.data(), raw.data(), raw.size() / recSize);
+    raw = std::move(out);
+  }
+  auto result = std::make_shared<const std::vector<char>>(std::move(raw));
+
+  std::unique_lock<std::mutex> l(m_blocksLock);
+  if(m_blocks.size() >= maxCachedBlocks) m_blocks.clear();
+  m_blocks.emplace(data, result);
+  return result;
+}
+
+void Database::loadProfileIndex() const {
+  std::call_once(m_profileOnce, [this]{
+    fmt_profiledb_fHdr_t fhdr;
+    fmt_profiledb_fHdr_read(&fhdr, checkHeader(m_profile, FMT_PROFILEDB_SZ_FHdr,
+                                               fmt_profiledb_check, "profile.db"));
+    fmt_profiledb_profInfoSHdr_t ps;
+    fmt_profiledb_profInfoSHdr_read(&ps, m_profile.at(fhdr.pProfileInfos,
+                                                      FMT_PROFILEDB_SZ_ProfInfoSHdr));
+    m_profiles.reserve(ps.nProfiles);
+    m_profInfos.reserve(ps.nProfiles);
+    for(std::uint32_t i = 0; i < ps.nProfiles; i++) {
+      const std::uint64_t p = ps.pProfiles + i * ps.szProfile;
+      fmt_profiledb_profInfo_t pi;
+      fmt_profiledb_profInfo_read(&pi, m_profile.at(p, FMT_PROFILEDB_SZ_ProfInfo));
+      m_profInfos.push_back(p);
+
+      std::ostringstream ss;
+      if(pi.pIdTuple == 0) {
+        ss << "SUMMARY";
+        if(pi.isSummary && m_summaryProf == UINT32_MAX) m_summaryProf = i;
+      } else {
+        fmt_profiledb_idTupleHdr_t th;
+        fmt_profiledb_idTupleHdr_read(&th, m_profile.at(pi.pIdTuple,
+                                                        FMT_PROFILEDB_SZ_IdTupleHdr));
+        const char* elems = m_profile.at(pi.pIdTuple, FMT_PROFILEDB_SZ_IdTuple(th.nIds))
+                            + FMT_PROFILEDB_SZ_IdTupleHdr;
+        for(std::uint16_t j = 0; j < th.nIds; j++) {
+          fmt_profiledb_idTupleElem_t e;
+          fmt_profiledb_idTupleElem_read(&e, elems + j * FMT_PROFILEDB_SZ_IdTupleElem);
+          if(j > 0) ss << ' ';
+          if(e.kind < m_kindNames.size()) ss << m_kindNames[e.kind];
+          else ss << "[" << (unsigned int)e.kind << "]";
+          ss << ' ' << (e.isPhysical ? e.physicalId : e.logicalId);
+        }
+      }
+      m_profiles.push_back({pi.isSummary, ss.str()});
+    }
+
+    if(m_trace) {
+      fmt_tracedb_fHdr_t thdr;
+      fmt_tracedb_fHdr_read(&thdr, checkHeader(*m_trace, FMT_TRACEDB_SZ_FHdr,
+                                               fmt_tracedb_check, "trace.db"));
+      fmt_tracedb_ctxTraceSHdr_t ts;
+      fmt_tracedb_ctxTraceSHdr_read(&ts, m_trace->at(thdr.pCtxTraces,
+                                                     FMT_TRACEDB_SZ_CtxTraceSHdr));
+      m_traceHdrs.assign(m_profiles.size(), 0);
+      for(std::uint32_t i = 0; i < ts.nTraces; i++) {
+        const std::uint64_t p = ts.pTraces + i * ts.szTrace;
+        fmt_tracedb_ctxTrace_t t;
+        fmt_tracedb_ctxTrace_read(&t, m_trace->at(p, FMT_TRACEDB_SZ_CtxTrace));
+        if(t.profIndex < m_traceHdrs.size()) m_traceHdrs[t.profIndex] = p;
+      }
+    }
+  });
+}
+
+const std::vector<Database::Profile>& Database::profiles() const {
+  loadProfileIndex();
+  return m_profiles;
+}
+
+std::vector<std::pair<std::uint16_t, double>>
+Database::profileValues(std::uint32_t prof, std::uint32_t ctx) const {
+  loadProfileIndex();
+  if(prof >= m_profInfos.size()) throw std::out_of_range("Invalid profile index");
+  fmt_profiledb_profInfo_t pi;
+  fmt_profiledb_profInfo_read(&pi, m_profile.at(m_profInfos[prof], FMT_PROFILEDB_SZ_ProfInfo));
+  const auto& vb = pi.valueBlock;
+  std::vector<std::pair<std::uint16_t, double>> out;
+  if(vb.nCtxs == 0) return out;
+
+  // Find the range of values for the context in the {Idx} array
+  block_t idxBlk;
+  const char* idxs;
+  if(pi.isCompressed) {
+    idxBlk = block(m_profile, vb.pCtxIndices, vb.pCtxIndices,
+                   [](char* o, const char* i, std::uint64_t n) {
+                     fmt_profiledb_cIdxs_unpack(o, i, n);
+                   }, FMT_PROFILEDB_SZ_CIdx);
+    if(idxBlk->size() != (std::size_t)vb.nCtxs * FMT_PROFILEDB_SZ_CIdx)
+      throw std::runtime_error("Compressed context indices have an unexpected size");
+    idxs = idxBlk->data();
+  } else {
+    idxs = m_profile.at(vb.pCtxIndices, (std::uint64_t)vb.nCtxs * FMT_PROFILEDB_SZ_CIdx);
+  }
+  std::uint32_t lo = 0, hi = vb.nCtxs;
+  while(lo < hi) {
+    const std::uint32_t mid = lo + (hi - lo) / 2;
+    if(fmt_u32_read(idxs + mid * FMT_PROFILEDB_SZ_CIdx) < ctx) lo = mid + 1;
+    else hi = mid;
+  }
+  if(lo == vb.nCtxs) return out;
+  fmt_profiledb_cIdx_t idx;
+  fmt_profiledb_cIdx_read(&idx, idxs + lo * FMT_PROFILEDB_SZ_CIdx);
+  if(idx.ctxId != ctx) return out;
+  const std::uint64_t first = idx.startIndex;
+  std::uint64_t last = vb.nValues;
+  if(lo + 1 < vb.nCtxs) {
+    fmt_profiledb_cIdx_read(&idx, idxs + (lo + 1) * FMT_PROFILEDB_SZ_CIdx);
+    last = idx.startIndex;
+  }
+  if(first > last || last > vb.nValues)
+    throw std::runtime_error("Invalid context index in profile.db");
+
+  // Read out the {Val} pairs, decompressing the blocks that cover them
+  out.reserve(last - first);
+  const auto emit = [&](const char* vals, std::uint64_t n) {
+    for(std::uint64_t i = 0; i < n; i++) {
+      fmt_profiledb_mVal_t v;
+      fmt_profiledb_mVal_read(&v, vals + i * FMT_PROFILEDB_SZ_MVal);
+      out.emplace_back(v.metricId, v.value);
+    }
+  };
+  if(!pi.isCompressed) {
+    emit(m_profile.at(vb.pValues + first * FMT_PROFILEDB_SZ_MVal,
+                      (last - first) * FMT_PROFILEDB_SZ_MVal), last - first);
+    return out;
+  }
+  for(std::uint64_t b = first / FMT_PROFILEDB_CBlkValues;
+      first < last && b <= (last - 1) / FMT_PROFILEDB_CBlkValues; b++) {
+    auto vals = block(m_profile, vb.pValues, vb.pValues + b * FMT_PROFILEDB_SZ_CBlk,
+                      fmt_profiledb_mVals_unpack, FMT_PROFILEDB_SZ_MVal);
+    const std::uint64_t blkFirst = b * FMT_PROFILEDB_CBlkValues;
+    const std::uint64_t blkLast = blkFirst + vals->size() / FMT_PROFILEDB_SZ_MVal;
+    const std::uint64_t a = std::max(first, blkFirst);
+    const std::uint64_t z = std::min(last, blkLast);
+    if(a >= z) throw std::runtime_error("Compressed value block is too small");
+    emit(vals->data() + (a - blkFirst) * FMT_PROFILEDB_SZ_MVal, z - a);
+  }
+  return out;
+}
+
+std::vector<std::pair<std::uint32_t, double>>
+Database::contextValues(std::uint32_t ctx, std::uint16_t metric) const {
+  fmt_cctdb_fHdr_t fhdr;
+  uint8_t minor;
+  const char* hdr = checkHeader(m_cct, FMT_CCTDB_SZ_FHdr, fmt_cctdb_check, "cct.db", &minor);
+  fmt_cctdb_fHdr_read(&fhdr, hdr, minor);
+  fmt_cctdb_ctxInfoSHdr_t cs;
+  fmt_cctdb_ctxInfoSHdr_read(&cs, m_cct.at(fhdr.pCtxInfo, FMT_CCTDB_SZ_CtxInfoSHdr));
+  std::vector<std::pair<std::uint32_t, double>> out;
+  if(ctx >= cs.nCtxs) return out;
+  fmt_cctdb_ctxInfo_t ci;
+  fmt_cctdb_ctxInfo_read(&ci, m_cct.at(cs.pCtxs + ctx * cs.szCtx, FMT_CCTDB_SZ_CtxInfo));
+  const auto& vb = ci.valueBlock;
+  if(vb.nMetrics == 0) return out;
+
+  // When compressed, the value block pointers are relative to the block data
+  block_t blk;
+  const char* mIdxs;
+  const char* pVals;
+  const std::uint64_t szMIdxs = (std::uint64_t)vb.nMetrics * FMT_CCTDB_SZ_MIdx;
+  const std::uint64_t szPVals = vb.nValues * FMT_CCTDB_SZ_PVal;
+  if(fhdr.szCtxBlocks != 0) {
+    blk = block(m_cct, fhdr.pCtxBlocks,
+                fhdr.pCtxBlocks + (ctx / FMT_CCTDB_CBlkCtxs) * FMT_CCTDB_SZ_CBlk, nullptr, 1);
+    if(vb.pMetricIndices > blk->size() || szMIdxs > blk->size() - vb.pMetricIndices
+       || vb.pValues > blk->size() || szPVals > blk->size() - vb.pValues)
+      throw std::out_of_range("Context value block extends beyond its compressed block");
+    mIdxs = blk->data() + vb.pMetricIndices;
+    pVals = blk->data() + vb.pValues;
+  } else {
+    mIdxs = m_cct.at(vb.pMetricIndices, szMIdxs);
+    pVals = m_cct.at(vb.pValues, szPVals);
+  }
+
+  std::uint16_t lo = 0, hi = vb.nMetrics;
+  while(lo < hi) {
+    const std::uint16_t mid = lo + (hi - lo) / 2;
+    if(fmt_u16_read(mIdxs + mid * FMT_CCTDB_SZ_MIdx) < metric) lo = mid + 1;
+    else hi = mid;
+  }
+  if(lo == vb.nMetrics) return out;
+  fmt_cctdb_mIdx_t idx;
+  fmt_cctdb_mIdx_read(&idx, mIdxs + lo * FMT_CCTDB_SZ_MIdx);
+  if(idx.metricId != metric) return out;
+  const std::uint64_t first = idx.startIndex;
+  std::uint64_t last = vb.nValues;
+  if(lo + 1 < vb.nMetrics) {
+    fmt_cctdb_mIdx_read(&idx, mIdxs + (lo + 1) * FMT_CCTDB_SZ_MIdx);
+    last = idx.startIndex;
+  }
+  if(first > last || last > vb.nValues)
+    throw std::runtime_error("Invalid metric index in cct.db");
+
+  out.reserve(last - first);
+  for(std::uint64_t i = first; i < last; i++) {
+    fmt_cctdb_pVal_t v;
+    fmt_cctdb_pVal_read(&v, pVals + i * FMT_CCTDB_SZ_PVal);
+    out.emplace_back(v.profIndex, v.value);
+  }
+  return out;
+}
+
+std::vector<std::pair<std::uint32_t, double>>
+Database::topContexts(std::uint16_t stat, std::size_t n) const {
+  loadProfileIndex();
+  std::vector<std::pair<std::uint32_t, double>> out;
+  if(m_summaryProf == UINT32_MAX || n == 0) return out;
+  fmt_profiledb_profInfo_t pi;
+  fmt_profiledb_profInfo_read(&pi, m_profile.at(m_profInfos[m_summaryProf],
+                                                FMT_PROFILEDB_SZ_ProfInfo));
+  const auto& vb = pi.valueBlock;
+  if(vb.nCtxs == 0) return out;
+
+  // Walk the {Idx} and {Val} arrays in step, picking out the requested metric
+  block_t idxBlk;
+  const char* idxs;
+  if(pi.isCompressed) {
+    idxBlk = block(m_profile, vb.pCtxIndices, vb.pCtxIndices,
+                   [](char* o, const char* i, std::uint64_t n) {
+                     fmt_profiledb_cIdxs_unpack(o, i, n);
+                   }, FMT_PROFILEDB_SZ_CIdx);
+    if(idxBlk->size() != (std::size_t)vb.nCtxs * FMT_PROFILEDB_SZ_CIdx)
+      throw std::runtime_error("Compressed context indices have an unexpected size");
+    idxs = idxBlk->data();
+  } else {
+    idxs = m_profile.at(vb.pCtxIndices, (std::uint64_t)vb.nCtxs * FMT_PROFILEDB_SZ_CIdx);
+  }
+
+  // Keep the best n in a min-heap, so the scan stays O(values * log n)
+  const auto cmp = [](const auto& a, const auto& b) { return a.second > b.second; };
+  std::uint32_t c = 0;
+  std::uint64_t nextStart = 0;
+  std::uint32_t ctx = 0;
+  const auto scan = [&](const char* vals, std::uint64_t base, std::uint64_t count) {
+    for(std::uint64_t i = 0; i < count; i++) {
+      const std::uint64_t idx = base + i;
+      while(c < vb.nCtxs && idx >= nextStart) {
+        fmt_profiledb_cIdx_t ci;
+        fmt_profiledb_cIdx_read(&ci, idxs + c * FMT_PROFILEDB_SZ_CIdx);
+        if(idx < ci.startIndex) break;
+        ctx = ci.ctxId;
+        c++;
+        nextStart = c < vb.nCtxs ? fmt_u64_read(idxs + c * FMT_PROFILEDB_SZ_CIdx + 4)
+                                 : vb.nValues;
+      }
+      fmt_profiledb_mVal_t v;
+      fmt_profiledb_mVal_read(&v, vals + i * FMT_PROFILEDB_SZ_MVal);
+      if(v.metricId != stat) continue;
+      if(out.size() < n) {
+        out.emplace_back(ctx, v.value);
+        std::push_heap(out.begin(), out.end(), cmp);
+      } else if(v.value > out.front().second) {
+        std::pop_heap(out.begin(), out.end(), cmp);
+        out.back() = {ctx, v.value};
+        std::push_heap(out.begin(), out.end(), cmp);
+      }
+    }
+  };
+  if(pi.isCompressed) {
+    for(std::uint64_t b = 0; b < FMT_PROFILEDB_N_CBlks(vb.nValues); b++) {
+      auto vals = block(m_profile, vb.pValues, vb.pValues + b * FMT_PROFILEDB_SZ_CBlk,
+                        fmt_profiledb_mVals_unpack, FMT_PROFILEDB_SZ_MVal);
+      scan(vals->data(), b * FMT_PROFILEDB_CBlkValues, vals->size() / FMT_PROFILEDB_SZ_MVal);
+    }
+  } else {
+    scan(m_profile.at(vb.pValues, vb.nValues * FMT_PROFILEDB_SZ_MVal), 0, vb.nValues);
+  }
+  std::sort_heap(out.begin(), out.end(), cmp);
+  return out;
+}
+
+std::pair<std::uint64_t, std::uint64_t> Database::traceRange() const {
+  if(!m_trace) throw std::runtime_error("Database does not contain traces");
+  fmt_tracedb_fHdr_t thdr;
+  fmt_tracedb_fHdr_read(&thdr, checkHeader(*m_trace, FMT_TRACEDB_SZ_FHdr,
+                                           fmt_tracedb_check, "trace.db"));
+  fmt_tracedb_ctxTraceSHdr_t ts;
+  fmt_tracedb_ctxTraceSHdr_read(&ts, m_trace->at(thdr.pCtxTraces, FMT_TRACEDB_SZ_CtxTraceSHdr));
+  return {ts.minTimestamp, ts.maxTimestamp};
+}
+
+std::vector<Database::TraceSample>
+Database::traceWindow(std::uint32_t prof, std::uint64_t start, std::uint64_t end) const {
+  if(!m_trace) throw std::runtime_error("Database does not contain traces");
+  loadProfileIndex();
+  if(prof >= m_profiles.size()) throw std::out_of_range("Invalid profile index");
+  std::vector<TraceSample> out;
+  if(m_traceHdrs[prof] == 0 || start >= end) return out;
+  fmt_tracedb_ctxTrace_t t;
+  fmt_tracedb_ctxTrace_read(&t, m_trace->at(m_traceHdrs[prof], FMT_TRACEDB_SZ_CtxTrace));
+  if(t.pEnd < t.pStart || (t.pEnd - t.pStart) % FMT_TRACEDB_SZ_CtxSample != 0)
+    throw std::runtime_error("Invalid trace header in trace.db");
+  const std::uint64_t n = (t.pEnd - t.pStart) / FMT_TRACEDB_SZ_CtxSample;
+  const char* elems = m_trace->at(t.pStart, t.pEnd - t.pStart);
+
+  // Find the first sample at or after start, then step back to the one in effect
+  std::uint64_t lo = 0, hi = n;
+  while(lo < hi) {
+    const std::uint64_t mid = lo + (hi - lo) / 2;
+    if(fmt_u64_read(elems + mid * FMT_TRACEDB_SZ_CtxSample) < start) lo = mid + 1;
+    else hi = mid;
+  }
+  if(lo > 0 && (lo == n || fmt_u64_read(elems + lo * FMT_TRACEDB_SZ_CtxSample) > start))
+    lo--;
+  for(std::uint64_t i = lo; i < n; i++) {
+    fmt_tracedb_ctxSample_t s;
+    fmt_tracedb_ctxSample_read(&s, elems + i * FMT_TRACEDB_SZ_CtxSample);
+    if(s.timestamp >= end) break;
+    out.push_back({s.timestamp, s.ctxId});
+  }
+  return out;
+}
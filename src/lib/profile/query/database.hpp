@@ -0,0 +1,230 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2023, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+#ifndef HPCTOOLKIT_PROFILE_QUERY_DATABASE_H
+#define HPCTOOLKIT_PROFILE_QUERY_DATABASE_H
+
+#include "../stdshim/filesystem.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace hpctoolkit::query {
+
+/// Read-only memory map of an entire file. All accesses are bounds-checked and
+/// throw std::out_of_range if they fall outside the file.
+class MappedFile final {
+public:
+  /// Map the given file. Throws std::runtime_error if it cannot be mapped.
+  explicit MappedFile(const stdshim::filesystem::path&);
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  std::size_t size() const noexcept { return m_size; }
+
+  /// Get a pointer to `len` bytes starting at file offset `off`.
+  const char* at(std::uint64_t off, std::uint64_t len) const;
+
+  /// Get the NUL-terminated string starting at file offset `off`.
+  std::string_view string(std::uint64_t off) const;
+
+private:
+  const char* m_data;
+  std::size_t m_size;
+};
+
+/// Random-access reader for a v4 HPCToolkit database (meta.db, profile.db,
+/// cct.db and optionally trace.db). The files are memory-mapped and only the
+/// parts needed to answer a query are touched, so queries are cheap even for
+/// databases much larger than memory. Compressed value blocks (v4.1) are
+/// decompressed on demand and a small number are kept around for reuse.
+///
+/// Errors in the database are reported by throwing std::exception subclasses.
+// MT: Internally Synchronized
+class Database final {
+public:
+  /// Open the database in the given directory. Only meta.db is indexed up
+  /// front, the other files are mapped and read lazily.
+  explicit Database(const stdshim::filesystem::path& dir);
+  ~Database();
+
+  Database(const Database&) = delete;
+  Database& operator=(const Database&) = delete;
+
+  /// Title of the database, as given to hpcprof.
+  const std::string& title() const noexcept { return m_title; }
+
+  /// A metric as it appears in the per-thread profiles, one per propagation
+  /// scope instance. `id` is the propMetricId used in the value blocks.
+  struct Metric {
+    std::string name;
+    std::string scope;
+    std::uint16_t id;
+  };
+
+  /// A summary statistic as it appears in the summary profiles. `id` is the
+  /// statMetricId used in the value blocks of summary profiles.
+  struct Statistic {
+    std::string name;
+    std::string scope;
+    std::string formula;
+    std::uint8_t combine;
+    std::uint16_t id;
+  };
+
+  const std::vector<Metric>& metrics() const noexcept { return m_metrics; }
+  const std::vector<Statistic>& statistics() const noexcept { return m_stats; }
+
+  /// Profile as listed in the profile.db. The index in profiles() is the
+  /// profIndex used throughout the cct.db and trace.db.
+  struct Profile {
+    bool isSummary;
+    /// Human-readable identifier tuple, e.g. "RANK 0 THREAD 3".
+    std::string idTuple;
+  };
+
+  /// Profiles in the profile.db. Loaded on the first call.
+  const std::vector<Profile>& profiles() const;
+
+  /// Upper bound on the context identifiers in the database. Identifier 0 is
+  /// the implicit global context.
+  std::uint32_t contextCount() const noexcept { return m_ctxParents.size(); }
+
+  /// Whether the given context is present in the meta.db context tree.
+  bool hasContext(std::uint32_t ctx) const noexcept;
+
+  /// Parent of the given context, or std::nullopt for the global context.
+  std::optional<std::uint32_t> parent(std::uint32_t ctx) const;
+
+  /// Short human-readable description of the given context.
+  std::string label(std::uint32_t ctx) const;
+
+  /// Metric values recorded for a context in a profile, as (metricId, value)
+  /// pairs in increasing metricId order. The ids are statMetricIds for summary
+  /// profiles and propMetricIds otherwise.
+  std::vector<std::pair<std::uint16_t, double>>
+  profileValues(std::uint32_t prof, std::uint32_t ctx) const;
+
+  /// Values of a single metric for a context across all profiles, as
+  /// (profIndex, value) pairs in increasing profIndex order.
+  std::vector<std::pair<std::uint32_t, double>>
+  contextValues(std::uint32_t ctx, std::uint16_t metric) const;
+
+  /// The `n` contexts with the largest value for the given statMetricId in the
+  /// canonical summary profile, as (ctxId, value) pairs in decreasing order.
+  std::vector<std::pair<std::uint32_t, double>>
+  topContexts(std::uint16_t stat, std::size_t n) const;
+
+  /// Whether the database includes a trace.db.
+  bool hasTraces() const noexcept { return (bool)m_trace; }
+
+  /// Range of timestamps (in ns) covered by the traces, inclusive.
+  std::pair<std::uint64_t, std::uint64_t> traceRange() const;
+
+  struct TraceSample {
+    std::uint64_t timestamp;
+    std::uint32_t ctx;
+  };
+
+  /// Samples from the trace for the given profile within the window
+  /// [start, end). The sample in effect at `start` (if any) is included first,
+  /// so the window is always fully described. Empty if the profile has no trace.
+  std::vector<TraceSample>
+  traceWindow(std::uint32_t prof, std::uint64_t start, std::uint64_t end) const;
+
+private:
+  using block_t = std::shared_ptr<const std::vector<char>>;
+
+  // Decompress the {CBlk} at `pBlk` of the given file, whose data is relative
+  // to `pTable`. If `unpack` is given it is used to convert the packed data.
+  block_t block(const MappedFile&, std::uint64_t pTable, std::uint64_t pBlk,
+                void (*unpack)(char*, const char*, std::uint64_t),
+                std::size_t recSize) const;
+
+  void loadProfileIndex() const;
+
+  MappedFile m_meta;
+  MappedFile m_profile;
+  MappedFile m_cct;
+  std::unique_ptr<MappedFile> m_trace;
+
+  std::string m_title;
+  std::vector<Metric> m_metrics;
+  std::vector<Statistic> m_stats;
+  std::vector<std::string> m_kindNames;
+
+  // Parent and meta.db record for every context, indexed by ctxId. Entry points
+  // have their record offset tagged with the high bit set.
+  static constexpr std::uint32_t noParent = UINT32_MAX;
+  std::vector<std::uint32_t> m_ctxParents;
+  std::vector<std::uint64_t> m_ctxRecords;
+  static constexpr std::uint64_t entryPointTag = UINT64_C(1) << 63;
+
+  // profile.db Profile Info records and the cct.db/trace.db section headers,
+  // loaded by loadProfileIndex().
+  mutable std::once_flag m_profileOnce;
+  mutable std::vector<Profile> m_profiles;
+  mutable std::vector<std::uint64_t> m_profInfos;
+  mutable std::uint32_t m_summaryProf;
+  mutable std::vector<std::uint64_t> m_traceHdrs;
+
+  // Recently decompressed blocks, keyed by their compressed data
+  mutable std::mutex m_blocksLock;
+  mutable std::unordered_map<const char*, block_t> m_blocks;
+};
+
+}  // namespace hpctoolkit::query
+
+#endif  // HPCTOOLKIT_PROFILE_QUERY_DATABASE_H
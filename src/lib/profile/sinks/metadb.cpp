@@ -57,6 +57,7 @@
 #include "lib/prof-lean/placeholders.h"
 
 #include <fstream>
+#include <mutex>
 #include <stack>
 
 using namespace hpctoolkit;
@@ -137,17 +138,13 @@ std::string MetaDB::accumulateFormulaString(const Expression& e) {
   return ss.str();
 }
 
-std::size_t MetaDB::stringsTableLookup(const std::string& s) {
-  {
-    std::shared_lock<std::shared_mutex> l(stringsLock);
-    auto it = stringsTable.find(s);
-    if(it != stringsTable.end()) return it->second;
-  }
-  std::unique_lock<std::shared_mutex> l(stringsLock);
-  auto [it, first] = stringsTable.try_emplace(s, stringsList.size());
-  if(first)
-    stringsList.push_back(it->first);
-  return it->second;
+MetaDB::str_t MetaDB::stringsTableLookup(std::string_view s) {
+  return &stringsTable.intern(s);
+}
+
+util::WorkshareResult MetaDB::help() {
+  return forFunctions.contributeWhileAble()
+         + forContexts.contributeWhileAble();
 }
 
 void MetaDB::instance(const File& f) {
@@ -171,13 +168,13 @@ void MetaDB::instance(const File& f) {
             << e.code().message() << " [" << rp.string() << "]";
         }
         if(ok) {
-          udf.pathSIdx = stringsTableLookup(relative.string());
+          udf.pathStr = stringsTableLookup(relative.string());
           udf.copied = true;
           return;
         }
       }
     }
-    udf.pathSIdx = stringsTableLookup(f.path().string());
+    udf.pathStr = stringsTableLookup(f.path().string());
     udf.copied = false;
   });
 }
@@ -185,14 +182,14 @@ void MetaDB::instance(const File& f) {
 void MetaDB::instance(const Module& m) {
   auto& udm = m.userdata[ud];
   util::call_once(udm.once, [&]{
-    udm.pathSIdx = stringsTableLookup(m.path().string());
+    udm.pathStr = stringsTableLookup(m.path().string());
   });
 }
 
 void MetaDB::instance(const Function& f) {
   auto [udf, first] = udFuncs.try_emplace(f);
   if(!first) return;
-  udf.nameSIdx = stringsTableLookup(f.name());
+  udf.nameStr = stringsTableLookup(f.name());
   instance(f.module());
   if(auto sl = f.sourceLocation()) instance(sl->first);
 }
@@ -202,7 +199,7 @@ void MetaDB::instance(Scope::placeholder_t, const Scope& s) {
   if(!first) return;
   std::string name(s.enumerated_pretty_name());
   if(name.empty()) name = s.enumerated_fallback_name();
-  udf.nameSIdx = stringsTableLookup(std::move(name));
+  udf.nameStr = stringsTableLookup(name);
 }
 
 void MetaDB::notifyContext(const Context& c) {
@@ -216,17 +213,17 @@ void MetaDB::notifyContext(const Context& c) {
     switch(sf.type()) {
     case Scope::Type::unknown:
       udc.entryPoint = FMT_METADB_ENTRYPOINT_UNKNOWN_ENTRY;
-      udc.prettyNameSIdx = stringsTableLookup("unknown entry");
+      udc.prettyNameStr = stringsTableLookup("unknown entry");
       break;
     case Scope::Type::placeholder:
       switch(sf.enumerated_data()) {
       case hpcrun_placeholder_fence_main:
         udc.entryPoint = FMT_METADB_ENTRYPOINT_MAIN_THREAD;
-        udc.prettyNameSIdx = stringsTableLookup("main thread");
+        udc.prettyNameStr = stringsTableLookup("main thread");
         break;
       case hpcrun_placeholder_fence_thread:
         udc.entryPoint = FMT_METADB_ENTRYPOINT_APPLICATION_THREAD;
-        udc.prettyNameSIdx = stringsTableLookup("application thread");
+        udc.prettyNameStr = stringsTableLookup("application thread");
         break;
       default:
         util::log::fatal{} << "Invalid top-level Scope: " << s;
@@ -277,6 +274,44 @@ void MetaDB::notifyContext(const Context& c) {
   }
 }
 
+namespace {
+// Lexical type and optional fields of the fmt_metadb_context_t composed for a
+// Context in write(). Both the layout and the composition use this, so the
+// size of a composed context is known before it is composed.
+struct ContextShape {
+  uint8_t lexicalType;
+  bool hasFunction;
+  bool hasSrcLine;
+  bool hasPoint;
+
+  std::size_t size() const noexcept {
+    return FMT_METADB_SZ_Context((hasFunction ? 1 : 0) + (hasSrcLine ? 2 : 0)
+                                 + (hasPoint ? 2 : 0));
+  }
+};
+}
+
+static ContextShape contextShape(const Context& c) {
+  switch(c.scope().flat().type()) {
+  case Scope::Type::global: std::abort();
+  case Scope::Type::unknown:
+    // We don't know the function, so there is no pFunction
+    return {FMT_METADB_LEXTYPE_Function, false, false, false};
+  case Scope::Type::function:
+  case Scope::Type::placeholder:
+    return {FMT_METADB_LEXTYPE_Function, true, false, false};
+  case Scope::Type::line:
+    return {FMT_METADB_LEXTYPE_Line, false, true, false};
+  case Scope::Type::lexical_loop:
+    return {FMT_METADB_LEXTYPE_Loop, false, true, false};
+  case Scope::Type::binary_loop:
+    return {FMT_METADB_LEXTYPE_Loop, false, true, true};
+  case Scope::Type::point:
+    return {FMT_METADB_LEXTYPE_Instruction, false, false, true};
+  }
+  std::abort();
+}
+
 void MetaDB::write() try {
   metadb->initialize();
   auto file = metadb->open(true, true);
@@ -429,7 +464,7 @@ void MetaDB::write() try {
     }
 
     // Common String Table (section)
-    formats::Written strings(l, std::move(stringsList),
+    formats::Written strings(l, stringsTable.finalize(),
         formats::DynamicArray<formats::NullTerminatedString>());
     fileHdr->pStrings = strings.ptr();
     fileHdr->szStrings = strings.bytesize();
@@ -442,10 +477,10 @@ void MetaDB::write() try {
         std::deque<fmt_metadb_moduleSpec_t> modules;
         for(const Module& m: src.modules().citerate()) {
           auto& udm = m.userdata[ud];
-          if(udm.pathSIdx == std::numeric_limits<std::size_t>::max()) continue;
+          if(udm.pathStr == nullptr) continue;
           moduleUds.emplace_back(std::ref(udm));
           modules.push_back((fmt_metadb_moduleSpec_t){
-            .pPath = strings.ptr(udm.pathSIdx),
+            .pPath = strings.ptr(udm.pathStr->index()),
           });
         }
         return modules;
@@ -466,11 +501,11 @@ void MetaDB::write() try {
         std::deque<fmt_metadb_fileSpec_t> files;
         for(const File& ff: src.files().citerate()) {
           auto& udf = ff.userdata[ud];
-          if(udf.pathSIdx == std::numeric_limits<std::size_t>::max()) continue;
+          if(udf.pathStr == nullptr) continue;
           fileUds.emplace_back(std::ref(udf));
           files.push_back((fmt_metadb_fileSpec_t){
             .copied = udf.copied,
-            .pPath = strings.ptr(udf.pathSIdx),
+            .pPath = strings.ptr(udf.pathStr->index()),
           });
         }
         return files;
@@ -486,37 +521,43 @@ void MetaDB::write() try {
     { // Functions section
       formats::SubWriteGuard<fmt_metadb_functionsSHdr_t> shdr(l, *fileHdr);
 
-      std::deque<std::reference_wrapper<udFunction>> functionUds;
-      auto functions_f = [&]() -> auto {
-        std::deque<fmt_metadb_functionSpec_t> functions;
-        for(auto& [rff, udf]: udFuncs.iterate()) {
-          const Function& ff = rff;
-          functionUds.emplace_back(std::ref(udf));
-          auto sl = ff.sourceLocation();
-          functions.push_back((fmt_metadb_functionSpec_t){
-            .pName = strings.ptr(udf.nameSIdx),
-            .pModule = ff.module().userdata[ud].ptr,
-            .offset = ff.offset().value_or(0),
-            .pFile = sl ? sl->first.userdata[ud].ptr : 0,
-            .line = sl ? static_cast<uint32_t>(sl->second) : 0,
-          });
-        }
-        for(auto& [dat, udf]: udPlaceholders.iterate()) {
-          functionUds.emplace_back(std::ref(udf));
-          functions.push_back((fmt_metadb_functionSpec_t){
-            .pName = strings.ptr(udf.nameSIdx),
+      // Gather the functions first, then compose their specs in parallel
+      std::vector<std::pair<util::optional_ref<const Function>,
+                            std::reference_wrapper<udFunction>>> functionUds;
+      for(auto& [rff, udf]: udFuncs.iterate())
+        functionUds.emplace_back(static_cast<const Function&>(rff), udf);
+      for(auto& [dat, udf]: udPlaceholders.iterate())
+        functionUds.emplace_back(std::nullopt, udf);
+
+      std::vector<fmt_metadb_functionSpec_t> functionSpecs(functionUds.size());
+      forFunctions.fill(functionUds.size(), [&](std::size_t i){
+        const auto& [ff, rudf] = functionUds[i];
+        const udFunction& udf = rudf;
+        if(!ff) {
+          functionSpecs[i] = (fmt_metadb_functionSpec_t){
+            .pName = strings.ptr(udf.nameStr->index()),
             .pModule = 0, .offset = 0,
             .pFile = 0, .line = 0,
-          });
+          };
+          return;
         }
-        return functions;
-      };
-      formats::Written functions(l, functions_f());
+        auto sl = ff->sourceLocation();
+        functionSpecs[i] = (fmt_metadb_functionSpec_t){
+          .pName = strings.ptr(udf.nameStr->index()),
+          .pModule = ff->module().userdata[ud].ptr,
+          .offset = ff->offset().value_or(0),
+          .pFile = sl ? sl->first.userdata[ud].ptr : 0,
+          .line = sl ? static_cast<uint32_t>(sl->second) : 0,
+        };
+      }, 1024);
+      forFunctions.contributeUntilComplete();
+
+      formats::Written functions(l, std::move(functionSpecs));
       shdr->pFunctions = functions.ptr();
       shdr->nFunctions = functions->size();
       std::size_t i = 0;
-      for(udFunction& ud: functionUds)
-        ud.ptr = functions.ptr(i++);
+      for(auto& [ff, udf]: functionUds)
+        udf.get().ptr = functions.ptr(i++);
     }
 
     { // Context Tree section
@@ -543,91 +584,104 @@ void MetaDB::write() try {
           break;
         }
 
-        const auto setFunction = [&](const udFunction& ud){
-          ctx.pFunction = ud.ptr;
+        const auto shape = contextShape(c);
+        ctx.lexicalType = shape.lexicalType;
+        if(shape.hasFunction) {
+          const udFunction& udf = c.scope().flat().type() == Scope::Type::placeholder
+              ? udPlaceholders.at(c.scope().flat().enumerated_data())
+              : udFuncs.at(c.scope().flat().function_data());
+          ctx.pFunction = udf.ptr;
           assert(ctx.pFunction != std::numeric_limits<uint64_t>::max());
-        };
-        const auto setSrcLine = [&]{
+        }
+        if(shape.hasSrcLine) {
           const auto [f, l] = c.scope().flat().line_data();
           ctx.pFile = f.userdata[ud].ptr;
           assert(ctx.pFile != std::numeric_limits<uint64_t>::max());
           ctx.line = l;
-        };
-        const auto setPoint = [&]{
+        }
+        if(shape.hasPoint) {
           const auto [m, o] = c.scope().flat().point_data();
           ctx.pModule = m.userdata[ud].ptr;
           assert(ctx.pModule != std::numeric_limits<uint64_t>::max());
           ctx.offset = o;
-        };
-
-        switch(c.scope().flat().type()) {
-        case Scope::Type::global: std::abort();
-        case Scope::Type::unknown:
-          ctx.lexicalType = FMT_METADB_LEXTYPE_Function;
-          // ...But we don't know the function, so pFunction = 0 still.
-          break;
-        case Scope::Type::function:
-          ctx.lexicalType = FMT_METADB_LEXTYPE_Function;
-          setFunction(udFuncs.at(c.scope().flat().function_data()));
-          break;
-        case Scope::Type::placeholder:
-          ctx.lexicalType = FMT_METADB_LEXTYPE_Function;
-          setFunction(udPlaceholders.at(c.scope().flat().enumerated_data()));
-          break;
-        case Scope::Type::line:
-          ctx.lexicalType = FMT_METADB_LEXTYPE_Line;
-          setSrcLine();
-          break;
-        case Scope::Type::lexical_loop:
-        case Scope::Type::binary_loop:
-          ctx.lexicalType = FMT_METADB_LEXTYPE_Loop;
-          setSrcLine();
-          if(c.scope().flat().type() == Scope::Type::binary_loop)
-            setPoint();
-          break;
-        case Scope::Type::point:
-          ctx.lexicalType = FMT_METADB_LEXTYPE_Instruction;
-          setPoint();
-          break;
         }
         return ctx;
       };
 
+      // Call the given function on every child of c that ends up in the output
+      const auto forChildren = [](const Context& c, const auto& f) {
+        for(const Context& cc: c.children().citerate()) {
+          if(elide(cc)) {
+            for(const Context& gcc: cc.children().citerate()) {
+              assert(!elide(gcc) && "Recursion needed for this algorithm!");
+              f(gcc);
+            }
+          } else {
+            f(cc);
+          }
+        }
+      };
+
+      // Lay out the children arrays first, in reversed DFS order. The size of
+      // each composed context only depends on its Scope, so this doesn't need
+      // the children to be composed yet.
+      std::vector<std::reference_wrapper<const Context>> parents;
+      for(const Context& top: src.contexts().children().citerate()) {
+        top.citerate(nullptr, [&](const Context& c){
+          if(c.children().empty()) return;
+          if(elide(c)) return;
+
+          auto& udc = c.userdata[ud];
+          udc.szChildren = 0;
+          forChildren(c, [&](const Context& cc){
+            udc.szChildren += contextShape(cc).size();
+          });
+          udc.pChildren = l.allocate(udc.szChildren,
+              formats::DataTraits<fmt_metadb_context_t>::alignment);
+          parents.emplace_back(c);
+        });
+      }
+
+      // Then compose and write out all the children arrays in parallel. A
+      // File::Instance is not thread-safe, so every thread taking part writes
+      // through one of its own, taken from (and returned to) a shared pool.
+      std::mutex instancesLock;
+      std::vector<util::File::Instance> instances;
+      forContexts.fill(std::move(parents), [&](const Context& c){
+        const auto& udc = c.userdata[ud];
+        std::vector<char> buf;
+        buf.reserve(udc.szChildren);
+        forChildren(c, [&](const Context& cc){
+          auto sub = formats::DataTraits<fmt_metadb_context_t>().serialize(compose(cc));
+          assert(sub.size() == contextShape(cc).size());
+          buf.insert(buf.end(), sub.begin(), sub.end());
+        });
+        assert(buf.size() == udc.szChildren);
+
+        std::optional<util::File::Instance> inst;
+        {
+          std::unique_lock<std::mutex> l(instancesLock);
+          if(!instances.empty()) {
+            inst.emplace(std::move(instances.back()));
+            instances.pop_back();
+          }
+        }
+        if(!inst) inst.emplace(metadb->open(true, true));
+        inst->writeat(udc.pChildren, buf);
+        std::unique_lock<std::mutex> l(instancesLock);
+        instances.push_back(std::move(*inst));
+      }, 64);
+      forContexts.complete();
+
       auto entryPoints_f = [&]() -> auto {
         std::deque<fmt_metadb_entryPoint_t> entryPoints;
         for(const Context& top: src.contexts().children().citerate()) {
-          // Output Contexts in reversed DFS order, since that's easier to implement
-          top.citerate(nullptr, [&](const Context& c){
-            if(c.children().empty()) return;
-            if(elide(c)) return;
-
-            auto& udc = c.userdata[ud];
-            auto children_f = [&]() -> auto {
-              std::deque<fmt_metadb_context_t> children;
-              for(const Context& cc: c.children().citerate()) {
-                if(elide(cc)) {
-                  for(const Context& gcc: cc.children().citerate()) {
-                    assert(!elide(gcc) && "Recursion needed for this algorithm!");
-                    children.push_back(compose(gcc));
-                  }
-                } else {
-                  children.push_back(compose(cc));
-                }
-              }
-              return children;
-            };
-            formats::Written children(l, children_f());
-            udc.pChildren = children.ptr();
-            udc.szChildren = children.bytesize();
-          });
-
-          // Then compose the entry point
           auto& udc = top.userdata[ud];
           entryPoints.push_back((fmt_metadb_entryPoint_t){
             .szChildren = udc.szChildren, .pChildren = udc.pChildren,
             .ctxId = top.userdata[src.identifier()],
             .entryPoint = udc.entryPoint,
-            .pPrettyName = strings.ptr(udc.prettyNameSIdx),
+            .pPrettyName = strings.ptr(udc.prettyNameStr->index()),
           });
         }
         return entryPoints;
@@ -50,6 +50,8 @@
 #include "../sink.hpp"
 
 #include "../util/file.hpp"
+#include "../util/intern_table.hpp"
+#include "../util/parallel_work.hpp"
 
 #include <mutex>
 #include "../stdshim/filesystem.hpp"
@@ -68,6 +70,8 @@ public:
 
   void write() override;
 
+  util::WorkshareResult help() override;
+
   DataClass accepts() const noexcept override {
     using namespace hpctoolkit::literals::data;
     return attributes + references + contexts + metrics;
@@ -95,15 +99,17 @@ private:
   std::optional<util::File> metadb;
   bool copySources;
 
-  std::shared_mutex stringsLock;
-  std::unordered_map<std::string, std::size_t> stringsTable;
-  std::deque<std::string_view> stringsList;
+  util::intern_table stringsTable;
+  using str_t = const util::intern_table::entry*;
+
+  str_t stringsTableLookup(std::string_view);
 
-  std::size_t stringsTableLookup(const std::string&);
+  util::ParallelFor forFunctions;
+  util::RepeatingParallelForEach<std::reference_wrapper<const Context>> forContexts;
 
   struct udFile {
     std::once_flag once;
-    std::size_t pathSIdx = std::numeric_limits<std::size_t>::max();
+    str_t pathStr = nullptr;
     bool copied : 1;
     uint64_t ptr = std::numeric_limits<uint64_t>::max();
   };
@@ -111,13 +117,13 @@ private:
 
   struct udModule {
     std::once_flag once;
-    std::size_t pathSIdx = std::numeric_limits<std::size_t>::max();
+    str_t pathStr = nullptr;
     uint64_t ptr = std::numeric_limits<uint64_t>::max();
   };
   void instance(const Module&);
 
   struct udFunction {
-    std::size_t nameSIdx = std::numeric_limits<std::size_t>::max();
+    str_t nameStr = nullptr;
     uint64_t ptr = std::numeric_limits<uint64_t>::max();
   };
   void instance(const Function&);
@@ -127,7 +133,7 @@ private:
     uint64_t szChildren = 0;
     uint64_t pChildren = 0;
     uint16_t propagation = 0;
-    std::size_t prettyNameSIdx = std::numeric_limits<std::size_t>::max();
+    str_t prettyNameStr = nullptr;
     uint16_t entryPoint = std::numeric_limits<uint16_t>::max();
   };
 
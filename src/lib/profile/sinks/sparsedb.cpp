@@ -52,6 +52,7 @@
 
 #include "../mpi/all.hpp"
 #include "../util/log.hpp"
+#include "../util/lzmastream.hpp"
 
 #include <lib/prof-lean/id-tuple.h>
 #include "lib/prof-lean/formats/profiledb.h"
@@ -62,6 +63,7 @@
 #include "../stdshim/filesystem.hpp"
 #include <cassert>
 #include <cmath>
+#include <cstring>
 #include <fstream>
 #include <omp.h>
 #include <stdexcept>
@@ -75,11 +77,70 @@ static constexpr uint64_t align(uint64_t v, uint8_t a) {
   return (v + a - 1) / a * a;
 }
 
+// LZMA preset used for compressed value blocks. Low presets are already close
+// to the best ratio for this data and are several times faster than the default.
+static constexpr uint32_t compressionPreset = 1;
+
+// Compress an array of metric/value pairs into a table of {CBlk}s, followed by
+// the compressed data for every block.
+static std::vector<char> compressMVals(const std::vector<char>& raw) {
+  const uint64_t nValues = raw.size() / FMT_PROFILEDB_SZ_MVal;
+  const uint64_t nBlks = FMT_PROFILEDB_N_CBlks(nValues);
+  std::vector<char> out(nBlks * FMT_PROFILEDB_SZ_CBlk);
+  std::vector<char> packed;
+  for(uint64_t b = 0; b < nBlks; b++) {
+    const uint64_t first = b * FMT_PROFILEDB_CBlkValues;
+    const uint64_t n = std::min<uint64_t>(FMT_PROFILEDB_CBlkValues, nValues - first);
+    packed.resize(n * FMT_PROFILEDB_SZ_MVal);
+    fmt_profiledb_mVals_pack(packed.data(), &raw[first * FMT_PROFILEDB_SZ_MVal], n);
+
+    auto data = util::lzmaCompress(packed.data(), packed.size(), compressionPreset);
+    fmt_profiledb_cBlk_t blk = {
+      .pData = out.size(),
+      .szData = data.size(),
+      .szRaw = packed.size(),
+    };
+    fmt_profiledb_cBlk_write(&out[b * FMT_PROFILEDB_SZ_CBlk], &blk);
+    out.insert(out.end(), data.begin(), data.end());
+  }
+  return out;
+}
+
+// Compress an array of ctx_id/idx pairs into a single {CBlk}, followed by the
+// compressed data.
+static std::vector<char> compressCIdxs(const std::vector<char>& raw) {
+  if(raw.empty()) return {};
+  std::vector<char> packed(raw.size());
+  fmt_profiledb_cIdxs_pack(packed.data(), raw.data(), raw.size() / FMT_PROFILEDB_SZ_CIdx);
+
+  auto data = util::lzmaCompress(packed.data(), packed.size(), compressionPreset);
+  std::vector<char> out(FMT_PROFILEDB_SZ_CBlk);
+  fmt_profiledb_cBlk_t blk = {
+    .pData = FMT_PROFILEDB_SZ_CBlk,
+    .szData = data.size(),
+    .szRaw = packed.size(),
+  };
+  fmt_profiledb_cBlk_write(out.data(), &blk);
+  out.insert(out.end(), data.begin(), data.end());
+  return out;
+}
+
+// Read and decompress the data for a single {CBlk}, from a table at `pTable`
+static std::vector<char> readCBlk(util::File::Instance& fi, uint64_t pTable,
+                                  const fmt_profiledb_cBlk_t& blk) {
+  std::vector<char> data(blk.szData);
+  fi.readat(pTable + blk.pData, data.size(), data.data());
+  std::vector<char> raw(blk.szRaw);
+  util::lzmaDecompress(data.data(), data.size(), raw.data(), raw.size());
+  return raw;
+}
+
 //
 // SparseDB common bits
 //
 
-SparseDB::SparseDB(stdshim::filesystem::path dir) {
+SparseDB::SparseDB(stdshim::filesystem::path dir, bool compress)
+  : compress(compress) {
   if(dir.empty())
     util::log::fatal{} << "SparseDB doesn't allow for dry runs!";
   else
@@ -298,8 +359,13 @@ void SparseDB::process(std::shared_ptr<const PerThreadTemporary> tt) {
   // Build prof_info
   auto& pi = t.userdata[ud].info;
   pi.isSummary = false;
+  pi.isCompressed = compress;
   pi.valueBlock.nValues = mvalsBuf.size() / FMT_PROFILEDB_SZ_MVal;
   pi.valueBlock.nCtxs = cidxsBuf.size() / FMT_PROFILEDB_SZ_CIdx;
+  if(compress) {
+    mvalsBuf = compressMVals(mvalsBuf);
+    cidxsBuf = compressCIdxs(cidxsBuf);
+  }
 
   profDataOut.write(std::move(mvalsBuf), pi.valueBlock.pValues,
                     std::move(cidxsBuf), pi.valueBlock.pCtxIndices);
@@ -386,7 +452,20 @@ static std::vector<std::pair<uint32_t, uint64_t>> readProfileCtxPairs(
   // Read the whole chunk of ctx_id/idx pairs
   auto pmfi = pmf.open(false, false);
   std::vector<char> buf(pi.valueBlock.nCtxs * FMT_PROFILEDB_SZ_CIdx);
-  pmfi.readat(pi.valueBlock.pCtxIndices, buf.size(), buf.data());
+  if(pi.isCompressed) {
+    fmt_profiledb_cBlk_t blk;
+    {
+      char blkbuf[FMT_PROFILEDB_SZ_CBlk];
+      pmfi.readat(pi.valueBlock.pCtxIndices, sizeof blkbuf, blkbuf);
+      fmt_profiledb_cBlk_read(&blk, blkbuf);
+    }
+    if(blk.szRaw != buf.size())
+      util::log::fatal{} << "Corrupted compressed context indices in profile.db!";
+    auto packed = readCBlk(pmfi, pi.valueBlock.pCtxIndices, blk);
+    fmt_profiledb_cIdxs_unpack(buf.data(), packed.data(), pi.valueBlock.nCtxs);
+  } else {
+    pmfi.readat(pi.valueBlock.pCtxIndices, buf.size(), buf.data());
+  }
 
   // Parse and save in the output
   std::vector<std::pair<uint32_t, uint64_t>> prof_ctx_pairs;
@@ -407,6 +486,8 @@ struct ProfileIndexData {
   uint64_t offset;
   // Absolute index of this profile
   uint32_t index;
+  // Whether the data block is compressed
+  bool compressed;
   // Preparsed ctx_id/idx pairs
   std::vector<std::pair<uint32_t, uint64_t>> ctxPairs;
 };
@@ -426,7 +507,7 @@ struct ProfileMetricData {
   ProfileMetricData() = default;
 
   ProfileMetricData(uint32_t firstCtx, uint32_t lastCtx, const util::File& pmf,
-      uint64_t offset, uint32_t index,
+      uint64_t offset, uint32_t index, bool compressed,
       const std::vector<std::pair<uint32_t, uint64_t>>& ctxPairs);
 };
 }
@@ -434,7 +515,7 @@ struct ProfileMetricData {
 // Load a profile's metric data from the given File and data
 ProfileMetricData::ProfileMetricData(uint32_t firstCtx, uint32_t lastCtx,
     const util::File& pmf, const uint64_t offset, const uint32_t index,
-    const std::vector<std::pair<uint32_t, uint64_t>>& ctxPairs)
+    const bool compressed, const std::vector<std::pair<uint32_t, uint64_t>>& ctxPairs)
   : first(ctxPairs.begin()), last(ctxPairs.begin()), index(index) {
   if(ctxPairs.size() <= 1 || firstCtx >= lastCtx) {
     // Empty range, we don't have any data to add.
@@ -471,15 +552,46 @@ ProfileMetricData::ProfileMetricData(uint32_t firstCtx, uint32_t lastCtx,
   assert(!mvBlob.empty());
 
   auto pmfi = pmf.open(false, false);
-  pmfi.readat(offset + first->second * FMT_PROFILEDB_SZ_MVal,
-              mvBlob.size(), mvBlob.data());
+  if(!compressed) {
+    pmfi.readat(offset + first->second * FMT_PROFILEDB_SZ_MVal,
+                mvBlob.size(), mvBlob.data());
+    return;
+  }
+
+  // Only decompress the blocks that overlap the range of values we need
+  const uint64_t firstVal = first->second;
+  const uint64_t lastVal = last->second;
+  const uint64_t firstBlk = firstVal / FMT_PROFILEDB_CBlkValues;
+  const uint64_t lastBlk = (lastVal - 1) / FMT_PROFILEDB_CBlkValues + 1;
+  std::vector<char> blks((lastBlk - firstBlk) * FMT_PROFILEDB_SZ_CBlk);
+  pmfi.readat(offset + firstBlk * FMT_PROFILEDB_SZ_CBlk, blks.size(), blks.data());
+
+  std::vector<char> vals;
+  for(uint64_t b = firstBlk; b < lastBlk; b++) {
+    fmt_profiledb_cBlk_t blk;
+    fmt_profiledb_cBlk_read(&blk, &blks[(b - firstBlk) * FMT_PROFILEDB_SZ_CBlk]);
+    auto packed = readCBlk(pmfi, offset, blk);
+    const uint64_t n = packed.size() / FMT_PROFILEDB_SZ_MVal;
+    vals.resize(packed.size());
+    fmt_profiledb_mVals_unpack(vals.data(), packed.data(), n);
+
+    // Copy out the part of this block that lands in [firstVal, lastVal)
+    const uint64_t blkFirst = b * FMT_PROFILEDB_CBlkValues;
+    const uint64_t lo = std::max(firstVal, blkFirst);
+    const uint64_t hi = std::min(lastVal, blkFirst + n);
+    if(lo >= hi)
+      util::log::fatal{} << "Corrupted compressed value block in profile.db!";
+    std::memcpy(&mvBlob[(lo - firstVal) * FMT_PROFILEDB_SZ_MVal],
+                &vals[(lo - blkFirst) * FMT_PROFILEDB_SZ_MVal],
+                (hi - lo) * FMT_PROFILEDB_SZ_MVal);
+  }
 }
 
-// Transpose and write the metric data for a range of contexts
-static void writeContexts(uint32_t firstCtx, uint32_t lastCtx,
-    const util::File& cmf,
+// Transpose the metric data for a range of contexts into `buf`. Returns the
+// first context with data, `buf` is the data to write at ctxOffsets[<return>].
+static uint32_t transposeContexts(uint32_t firstCtx, uint32_t lastCtx,
     const std::deque<ProfileMetricData>& metricData,
-    const std::vector<uint64_t>& ctxOffsets) {
+    const std::vector<uint64_t>& ctxOffsets, std::vector<char>& buf) {
   // Set up a heap with cursors into each profile's data blob
   std::vector<std::pair<
     std::vector<std::pair<uint32_t, uint64_t>>::const_iterator,  // ctx_id/idx pair in a profile
@@ -505,12 +617,11 @@ static void writeContexts(uint32_t firstCtx, uint32_t lastCtx,
   }
   heap.shrink_to_fit();
   std::make_heap(heap.begin(), heap.end(), heap_comp);
-  if(heap.empty()) return;  // No data for us!
+  if(heap.empty()) return firstCtx;  // No data for us!
 
   // Start copying data over, one context at a time. The heap efficiently sorts
   // our search so we can jump straight to the next context we want.
   const auto firstCtxId = heap.front().first->first;
-  std::vector<char> buf;
   while(!heap.empty() && heap.front().first->first < lastCtx) {
     const uint32_t ctx_id = heap.front().first->first;
     std::map<uint16_t, std::vector<char>> valuebufs;
@@ -582,12 +693,65 @@ static void writeContexts(uint32_t firstCtx, uint32_t lastCtx,
     }
   }
 
+  return firstCtxId;
+}
+
+// Transpose and write the metric data for a range of contexts
+static void writeContexts(uint32_t firstCtx, uint32_t lastCtx,
+    const util::File& cmf,
+    const std::deque<ProfileMetricData>& metricData,
+    const std::vector<uint64_t>& ctxOffsets) {
+  std::vector<char> buf;
+  const auto firstCtxId = transposeContexts(firstCtx, lastCtx, metricData,
+                                            ctxOffsets, buf);
+
   // Write out the whole blob of data where it belongs in the file
   if(buf.empty()) return;
   auto cmfi = cmf.open(true, true);
   cmfi.writeat(ctxOffsets[firstCtxId], buf.size(), buf.data());
 }
 
+// Transpose, compress and write the metric data for a range of contexts. The
+// range must cover whole {CBlk}s (except at the very end of the contexts).
+static void writeCompressedContexts(uint32_t firstCtx, uint32_t lastCtx,
+    const util::File& cmf, uint64_t pCtxBlocks,
+    const std::deque<ProfileMetricData>& metricData,
+    const std::vector<uint64_t>& ctxOffsets, mpi::SharedAccumulator& dataPos) {
+  assert(firstCtx % FMT_CCTDB_CBlkCtxs == 0 && "Context range is not block-aligned!");
+  std::vector<char> buf;
+  const auto firstCtxId = transposeContexts(firstCtx, lastCtx, metricData,
+                                            ctxOffsets, buf);
+  const uint64_t bufStart = ctxOffsets[firstCtxId];
+  const uint64_t bufEnd = bufStart + buf.size();
+
+  auto cmfi = cmf.open(true, true);
+  std::vector<char> raw;
+  for(uint32_t b = firstCtx / FMT_CCTDB_CBlkCtxs; b < FMT_CCTDB_N_CBlks(lastCtx); b++) {
+    // Decompressed blocks have the same layout as in an uncompressed cct.db
+    const uint32_t blkFirst = b * FMT_CCTDB_CBlkCtxs;
+    const uint32_t blkLast = std::min<uint32_t>(lastCtx, blkFirst + FMT_CCTDB_CBlkCtxs);
+    raw.assign(ctxOffsets[blkLast] - ctxOffsets[blkFirst], 0);
+    const uint64_t lo = std::max(bufStart, ctxOffsets[blkFirst]);
+    const uint64_t hi = std::min(bufEnd, ctxOffsets[blkLast]);
+    if(lo < hi)
+      std::memcpy(&raw[lo - ctxOffsets[blkFirst]], &buf[lo - bufStart], hi - lo);
+
+    fmt_cctdb_cBlk_t blk = {.pData = 0, .szData = 0, .szRaw = 0};
+    if(!raw.empty()) {
+      auto data = util::lzmaCompress(raw.data(), raw.size(), compressionPreset);
+      const uint64_t pos = dataPos.fetch_add(data.size());
+      cmfi.writeat(pos, data.size(), data.data());
+      blk.pData = pos - pCtxBlocks;
+      blk.szData = data.size();
+      blk.szRaw = raw.size();
+    }
+
+    char blkbuf[FMT_CCTDB_SZ_CBlk];
+    fmt_cctdb_cBlk_write(blkbuf, &blk);
+    cmfi.writeat(pCtxBlocks + b * FMT_CCTDB_SZ_CBlk, sizeof blkbuf, blkbuf);
+  }
+}
+
 void SparseDB::write() {
   auto mpiSem = src.enterOrderedWrite();
 
@@ -621,6 +785,12 @@ void SparseDB::write() {
   ci_sHdr.pCtxs = align(fHdr.pCtxInfo + FMT_CCTDB_SZ_CtxInfoSHdr, 8);
   ci_sHdr.nCtxs = mpi::bcast((contexts.back().get().userdata[src.identifier()] + 1), 0);
   fHdr.szCtxInfo = ci_sHdr.pCtxs + ci_sHdr.nCtxs * FMT_CCTDB_SZ_CtxInfo - fHdr.pCtxInfo;
+  fHdr.szCtxBlocks = 0;
+  fHdr.pCtxBlocks = 0;
+  if(compress) {
+    fHdr.pCtxBlocks = align(fHdr.pCtxInfo + fHdr.szCtxInfo, 8);
+    fHdr.szCtxBlocks = FMT_CCTDB_N_CBlks(ci_sHdr.nCtxs) * FMT_CCTDB_SZ_CBlk;
+  }
 
   // Lay out the cct.db metric data, in terms of offsets for every context
   // First figure out the byte counts for each potential context's blob
@@ -645,8 +815,10 @@ void SparseDB::write() {
   }
   // All-reduce to get the total size for every context
   ctxOffsets = mpi::allreduce(ctxOffsets, mpi::Op::sum());
-  // Exclusive-scan the sizes to get the offsets, adjusting for 4-alignment
-  const auto ctxStart = align(fHdr.pCtxInfo + fHdr.szCtxInfo, 4);
+  // Exclusive-scan the sizes to get the offsets, adjusting for 4-alignment.
+  // If compressing, these are the offsets the data would have if it weren't.
+  const auto ctxStart = compress ? align(fHdr.pCtxBlocks + fHdr.szCtxBlocks, 4)
+                                 : align(fHdr.pCtxInfo + fHdr.szCtxInfo, 4);
   stdshim::transform_exclusive_scan(ctxOffsets.begin(), ctxOffsets.end(), ctxOffsets.begin(),
     ctxStart, std::plus<>{},
     [](uint64_t sz){ return align(sz, 4); });
@@ -660,7 +832,8 @@ void SparseDB::write() {
     uint64_t cursize = 0;
     for(size_t i = 0; i < ci_sHdr.nCtxs; i++) {
       const uint64_t size = ctxOffsets[i+1] - ctxOffsets[i];
-      if(cursize + size > limit) {
+      // Compressed blocks are never split across ranges
+      if(cursize + size > limit && (!compress || i % FMT_CCTDB_CBlkCtxs == 0)) {
         ctxRanges.push_back(i);
         cursize = 0;
       }
@@ -674,6 +847,17 @@ void SparseDB::write() {
   mpi::SharedAccumulator ctxRangeCounter(mpi::Tag::SparseDB_2);
   ctxRangeCounter.initialize(mpi::World::size() - 1);
 
+  // Compressed blocks are appended to the end of the file as they are ready
+  mpi::SharedAccumulator ctxDataPos(mpi::Tag::SparseDB_3);
+  ctxDataPos.initialize(ctxStart);
+
+  // Offset of the context data as written in the Context Info section. When
+  // compressing, these are relative to the start of the decompressed block.
+  const auto ctxPos = [&](uint32_t i) -> uint64_t {
+    return compress ? ctxOffsets[i] - ctxOffsets[i - i % FMT_CCTDB_CBlkCtxs]
+                    : ctxOffsets[i];
+  };
+
   // Synchronize cct.db across the ranks
   cmf->synchronize();
 
@@ -703,6 +887,7 @@ void SparseDB::write() {
       profiles[next.fetch_add(1, std::memory_order_relaxed)] = {
         .offset = pi.valueBlock.pValues,
         .index = (uint32_t)i,
+        .compressed = pi.isCompressed,
         .ctxPairs = readProfileCtxPairs(*pmf, pi),
       };
     });
@@ -771,8 +956,13 @@ void SparseDB::write() {
       fmt_profiledb_profInfo_t summary_info;
       summary_info.isSummary = true;
       summary_info.pIdTuple = 0;
+      summary_info.isCompressed = compress;
       summary_info.valueBlock.nValues = mvalsBuf.size() / FMT_PROFILEDB_SZ_MVal;
       summary_info.valueBlock.nCtxs = cidxsBuf.size() / FMT_PROFILEDB_SZ_CIdx;
+      if(compress) {
+        mvalsBuf = compressMVals(mvalsBuf);
+        cidxsBuf = compressCIdxs(cidxsBuf);
+      }
 
       // Write the summary profile out and make sure it makes it to disk
       profDataOut.write(std::move(mvalsBuf), summary_info.valueBlock.pValues,
@@ -819,7 +1009,7 @@ void SparseDB::write() {
           fmt_cctdb_ctxInfo_t ci;
           ci.valueBlock.nMetrics = 0;
           ci.valueBlock.nValues = 0;
-          ci.valueBlock.pValues = ctxOffsets[ctxid];
+          ci.valueBlock.pValues = ctxPos(ctxid);
           ci.valueBlock.pMetricIndices = ci.valueBlock.pValues;
           fmt_cctdb_ctxInfo_write(cur, &ci);
           cur += FMT_CCTDB_SZ_CtxInfo;
@@ -830,7 +1020,7 @@ void SparseDB::write() {
         fmt_cctdb_ctxInfo_t cii;
         cii.valueBlock.nMetrics = c.userdata[ud].nMetrics;
         cii.valueBlock.nValues = (ctxOffsets[i+1] - ctxOffsets[i] - cii.valueBlock.nMetrics * FMT_CCTDB_SZ_MIdx) / FMT_CCTDB_SZ_PVal;
-        cii.valueBlock.pValues = ctxOffsets[i];
+        cii.valueBlock.pValues = ctxPos(i);
         cii.valueBlock.pMetricIndices = cii.valueBlock.pValues + cii.valueBlock.nValues * FMT_CCTDB_SZ_PVal;
         fmt_cctdb_ctxInfo_write(cur, &cii);
         cur += FMT_CCTDB_SZ_CtxInfo;
@@ -853,7 +1043,8 @@ void SparseDB::write() {
       forProfilesLoad.fill(metricData.size(),
         [this, &metricData, firstCtx, lastCtx, &profiles](size_t i){
           const auto& p = profiles[i];
-          metricData[i] = {firstCtx, lastCtx, *pmf, p.offset, p.index, p.ctxPairs};
+          metricData[i] = {firstCtx, lastCtx, *pmf, p.offset, p.index,
+                           p.compressed, p.ctxPairs};
         });
       forProfilesLoad.contributeUntilEmpty();
 
@@ -869,7 +1060,7 @@ void SparseDB::write() {
           if(ctxRanges.size() + 1 == src.teamSize()) break;
 
           cursize += ctxOffsets[id+1] - ctxOffsets[id];
-          if(cursize > target) {
+          if(cursize > target && (!compress || (id+1) % FMT_CCTDB_CBlkCtxs == 0)) {
             ctxRanges.push_back({!ctxRanges.empty() ? ctxRanges.back().second
                                                     : firstCtx, id+1});
             cursize = 0;
@@ -884,8 +1075,12 @@ void SparseDB::write() {
 
       // Handle the individual ctx copies
       forEachContextRange.fill(std::move(ctxRanges),
-        [this, &metricData, &ctxOffsets](const auto& range){
-          writeContexts(range.first, range.second, *cmf, metricData, ctxOffsets);
+        [this, &metricData, &ctxOffsets, &fHdr, &ctxDataPos](const auto& range){
+          if(compress)
+            writeCompressedContexts(range.first, range.second, *cmf,
+                fHdr.pCtxBlocks, metricData, ctxOffsets, ctxDataPos);
+          else
+            writeContexts(range.first, range.second, *cmf, metricData, ctxOffsets);
         });
       forEachContextRange.contributeUntilEmpty();
     }
@@ -902,7 +1097,9 @@ void SparseDB::write() {
   // writes have completed. If the footer isn't there, the file isn't complete.
   mpi::barrier();
   if(mpi::World::rank() + 1 == mpi::World::size()) {
-    cmf->open(true, false).writeat(ctxOffsets.back(),
+    const uint64_t footerPos = compress ? ctxDataPos.fetch_add(sizeof fmt_cctdb_footer)
+                                        : ctxOffsets.back();
+    cmf->open(true, false).writeat(footerPos,
                                    sizeof fmt_cctdb_footer, fmt_cctdb_footer);
   }
 }
@@ -62,7 +62,9 @@ namespace hpctoolkit::sinks {
 
 class SparseDB : public hpctoolkit::ProfileSink {
 public:
-  SparseDB(hpctoolkit::stdshim::filesystem::path);
+  /// If `compress` is true, the value blocks in the profile.db and cct.db are
+  /// written in the block-compressed encoding (see FORMATS.md).
+  SparseDB(hpctoolkit::stdshim::filesystem::path, bool compress = false);
   ~SparseDB() = default;
 
   void write() override;
@@ -174,6 +176,9 @@ private:
     std::array<Buffer, 2> bufs;
   } profDataOut;
 
+  // Whether to compress the value blocks in the output
+  bool compress;
+
   // Paths and Files
   std::optional<hpctoolkit::util::File> pmf;
   std::optional<hpctoolkit::util::File> cmf;
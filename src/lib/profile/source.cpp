@@ -53,16 +53,48 @@
 
 using namespace hpctoolkit;
 
-std::unique_ptr<ProfileSource> ProfileSource::create_for(const stdshim::filesystem::path& p) {
+std::unique_ptr<ProfileSource> ProfileSource::create_for(const stdshim::filesystem::path& p,
+                                                         std::size_t index) {
   // All we do is go down the list and try every file-based source.
   std::unique_ptr<ProfileSource> r;
-  r.reset(new sources::Hpcrun4(p));
-  if(r->valid()) return r;
+  if(auto segs = sources::Hpcrun4::nodeSegments(p); !segs.empty()) {
+    if(index < segs.size()) {
+      r.reset(new sources::Hpcrun4(p, segs[index].first.first, segs[index].first.second,
+                                   false, segs[index].second));
+      if(r->valid()) return r;
+    }
+    return nullptr;
+  }
+  if(auto segs = sources::Hpcrun4::segments(p); index < segs.size()) {
+    r.reset(new sources::Hpcrun4(p, segs[index].first, segs[index].second,
+                                 segs.size() > 1));
+    if(r->valid()) return r;
+  }
 
   // Unrecognized or unsupported format
   return nullptr;
 }
 
+std::vector<std::unique_ptr<ProfileSource>> ProfileSource::create_all_for(const stdshim::filesystem::path& p) {
+  std::vector<std::unique_ptr<ProfileSource>> rs;
+  if(auto nsegs = sources::Hpcrun4::nodeSegments(p); !nsegs.empty()) {
+    for(const auto& [range, trace]: nsegs) {
+      std::unique_ptr<ProfileSource> r(new sources::Hpcrun4(p, range.first, range.second,
+                                                            false, trace));
+      if(!r->valid()) return {};
+      rs.emplace_back(std::move(r));
+    }
+    return rs;
+  }
+  auto segs = sources::Hpcrun4::segments(p);
+  for(const auto& [start, end]: segs) {
+    std::unique_ptr<ProfileSource> r(new sources::Hpcrun4(p, start, end, segs.size() > 1));
+    if(!r->valid()) return {};
+    rs.emplace_back(std::move(r));
+  }
+  return rs;
+}
+
 bool ProfileSource::valid() const noexcept { return true; }
 
 void ProfileSource::bindPipeline(ProfilePipeline::Source&& se) noexcept {
@@ -65,8 +65,16 @@ public:
 
   /// Instantiates the proper Source for the given arguments. In time more
   /// overloadings may be added that will handle more interesting cases.
+  /// Files may hold more than one profile (all the threads of a process, or all
+  /// the processes of a node), `index` selects which one to read.
   // MT: Internally Synchronized
-  static std::unique_ptr<ProfileSource> create_for(const stdshim::filesystem::path&);
+  static std::unique_ptr<ProfileSource> create_for(const stdshim::filesystem::path&,
+                                                   std::size_t index = 0);
+
+  /// Instantiates Sources for every profile held in the given file, in order.
+  /// Returns an empty vector if the file is not in a recognized format.
+  // MT: Internally Synchronized
+  static std::vector<std::unique_ptr<ProfileSource>> create_all_for(const stdshim::filesystem::path&);
 
   /// Most format errors from a Source can be handled within the Source itself,
   /// but if errors happen during construction callers (create_for) will want to
@@ -47,9 +47,15 @@
 #include "hpcrun4.hpp"
 
 #include "../util/log.hpp"
+#include "lib/prof-lean/hpcnode-fmt.h"
 #include "lib/prof-lean/hpcrun-fmt.h"
 #include "lib/prof-lean/placeholders.h"
 
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
 // TODO: Remove and change this once new-cupti is finalized
 #define HPCRUN_GPU_ROOT_NODE 65533
 #define HPCRUN_GPU_RANGE_NODE 65532
@@ -79,12 +85,117 @@ scope_exit<std::decay_t<F>> make_scope_exit(F&& f) {
 }
 }
 
-Hpcrun4::Hpcrun4(const stdshim::filesystem::path& fn)
+std::vector<std::pair<std::size_t, std::size_t>>
+Hpcrun4::segments(const stdshim::filesystem::path& fn) {
+  std::vector<std::pair<std::size_t, std::size_t>> segs;
+  std::FILE* fs = std::fopen(fn.c_str(), "rb");
+  if(!fs) return segs;
+  std::fseek(fs, 0, SEEK_END);
+  long fend = std::ftell(fs);
+  // Each profile ends with a footer that locates its start, which is where
+  // the one before it ends. Walk them back from the end of the file.
+  std::size_t end = fend < 0 ? 0 : fend;
+  while(end > 0) {
+    std::size_t start;
+    if(hpcrun_sparse_segment_start(fs, end, &start) != SF_SUCCEED) break;
+    segs.emplace_back(start, end);
+    end = start;
+  }
+  std::reverse(segs.begin(), segs.end());
+
+  // A profile that failed to be appended leaves a hole that stops the walk.
+  // Scan forward for the complete profiles written before it.
+  if(end > 0) {
+    std::vector<std::pair<std::size_t, std::size_t>> before;
+    std::size_t pos = 0, skipped = 0, start, segend;
+    while(pos < end
+          && hpcrun_sparse_segment_next(fs, pos, end, &start, &segend) == SF_SUCCEED) {
+      skipped += start - pos;
+      before.emplace_back(start, segend);
+      pos = segend;
+    }
+    skipped += end - pos;
+    if(!segs.empty() || !before.empty()) {
+      util::log::warning{} << "Ignoring " << skipped << " bytes of unrecognized "
+        "data in measurement profile " << fn.string() << ", recovered "
+        << before.size() << " profiles written before them";
+    }
+    segs.insert(segs.begin(), before.begin(), before.end());
+  }
+  std::fclose(fs);
+  return segs;
+}
+
+std::vector<std::pair<std::pair<std::size_t, std::size_t>, Hpcrun4::TraceRange>>
+Hpcrun4::nodeSegments(const stdshim::filesystem::path& fn) {
+  std::vector<std::pair<std::pair<std::size_t, std::size_t>, TraceRange>> segs;
+  std::FILE* fs = std::fopen(fn.c_str(), "rb");
+  if(!fs) return segs;
+  auto fs_close = make_scope_exit([&]{ std::fclose(fs); });
+  if(!hpcnode_fmt_hdr_check(fs)) return segs;
+
+  hpcnode_fmt_index_t index;
+  auto index_free = make_scope_exit([&]{ hpcnode_fmt_index_free(&index, std::free); });
+  if(hpcnode_fmt_index_fread(&index, fs, std::malloc) != HPCFMT_OK) {
+    util::log::warning{} << "Ignoring incomplete node container " << fn.string();
+    return segs;
+  }
+
+  // Pair every profile with the trace of the same name, if there is one.
+  const std::string profileext = std::string(".") + HPCRUN_ProfileFnmSfx;
+  const std::string traceext = std::string(".") + HPCRUN_TraceFnmSfx;
+  std::unordered_map<std::string, const hpcnode_fmt_entry_t*> traces;
+  for(uint64_t i = 0; i < index.len; i++) {
+    stdshim::filesystem::path name = index.lst[i].name;
+    if(name.extension() == traceext) traces.emplace(name.stem().string(), &index.lst[i]);
+  }
+  for(uint64_t i = 0; i < index.len; i++) {
+    const auto& e = index.lst[i];
+    stdshim::filesystem::path name = e.name;
+    if(name.extension() != profileext) continue;
+    TraceRange trace;
+    if(auto it = traces.find(name.stem().string()); it != traces.end()) {
+      trace.path = fn;
+      trace.start = it->second->offset;
+      trace.end = it->second->offset + it->second->size;
+    }
+    segs.push_back({{e.offset, e.offset + e.size}, std::move(trace)});
+  }
+  return segs;
+}
+
+// hpcrun names its files <exe>-<rank>-<thread>-<host>-<pid>-<gen>.<suffix>.
+// A profile shared by the threads of a process is named for thread 0, but
+// every thread keeps its own trace.
+static stdshim::filesystem::path threadTracePath(const stdshim::filesystem::path& p,
+                                                 const std::string& tid) {
+  std::string stem = p.stem().string();
+  std::size_t end = stem.size();
+  for(int i = 0; i < 3; i++) {
+    if(end == 0) return {};
+    end = stem.rfind('-', end - 1);
+    if(end == std::string::npos) return {};
+  }
+  if(end == 0) return {};
+  std::size_t beg = stem.rfind('-', end - 1);
+  if(beg == std::string::npos) return {};
+  char thread[16];
+  std::snprintf(thread, sizeof thread, "%03d", (int)std::strtol(tid.c_str(), nullptr, 10));
+  stem.replace(beg + 1, end - beg - 1, thread);
+  return p.parent_path() / (stem + ".hpctrace");
+}
+
+Hpcrun4::Hpcrun4(const stdshim::filesystem::path& fn, std::size_t start,
+                 std::size_t end, bool shared, std::optional<TraceRange> trace)
   : ProfileSource(), fileValid(true), attrsValid(true), tattrsValid(true),
     thread(nullptr), path(fn), tracepath(fn) {
   tracepath.replace_extension(".hpctrace");
+  if(trace) {
+    trace_range = std::move(*trace);
+    tracepath = trace_range.path;
+  }
   // Try to open up the file. Errors handled inside somewhere.
-  file = hpcrun_sparse_open(path.c_str(), 0, 0);
+  file = hpcrun_sparse_open(path.c_str(), start, end);
   if(file == nullptr) {
     fileValid = false;
     return;
@@ -103,7 +214,11 @@ Hpcrun4::Hpcrun4(const stdshim::filesystem::path& fn)
     fileValid = false;
     return;
   }
-  unsigned int traceDisorder = 0;  // Assume traces are ordered.
+  // Assume traces are ordered. hpcrun records the disorder it measured while
+  // tracing, which lets the Pipeline sort the trace as it streams through a
+  // buffer of just that size, or that it was too disordered to measure.
+  unsigned int traceDisorder = 0;
+  std::string tid;
   for(uint32_t i = 0; i < hdr.nvps.len; i++) {
     const std::string k(hdr.nvps.lst[i].name);
     const auto v = hdr.nvps.lst[i].val;
@@ -115,9 +230,14 @@ Hpcrun4::Hpcrun4(const stdshim::filesystem::path& fn)
     else if(k == HPCRUN_FMT_NV_jobId)
       attrs.job(std::strtol(v, nullptr, 10));
     else if(k == HPCRUN_FMT_NV_traceDisorder) {
-      traceDisorder = std::strtoul(v, nullptr, 10);
+      if(std::strcmp(v, HPCRUN_FMT_TraceDisorderUnbounded) == 0)
+        traceDisorder = ThreadAttributes::unboundedDisorder;
+      else
+        traceDisorder = std::strtoul(v, nullptr, 10);
+    } else if(k == HPCRUN_FMT_NV_tid) {
+      tid = v;
     } else if(k != HPCRUN_FMT_NV_traceMinTime && k != HPCRUN_FMT_NV_traceMaxTime
-              && k != HPCRUN_FMT_NV_mpiRank && k != HPCRUN_FMT_NV_tid
+              && k != HPCRUN_FMT_NV_mpiRank
               && k != HPCRUN_FMT_NV_hostid && k != HPCRUN_FMT_NV_pid) {
       util::log::vwarning()
       << "Unknown file attribute in " << path.string() << ":\n"
@@ -161,7 +281,8 @@ Hpcrun4::Hpcrun4(const stdshim::filesystem::path& fn)
 
   // Also check for a corrosponding tracefile. If anything goes wrong, we'll
   // just skip it.
-  if(!setupTrace(traceDisorder)) tracepath.clear();
+  if(shared && !trace) tracepath = threadTracePath(path, tid);
+  if(tracepath.empty() || !setupTrace(traceDisorder)) tracepath.clear();
 }
 
 bool Hpcrun4::valid() const noexcept { return fileValid; }
@@ -197,6 +318,7 @@ DataClass Hpcrun4::finalizeRequest(const DataClass& d) const noexcept {
 bool Hpcrun4::setupTrace(unsigned int traceDisorder) noexcept {
   std::FILE* file = std::fopen(tracepath.c_str(), "rb");
   if(!file) return false;
+  std::fseek(file, trace_range.start, SEEK_SET);
   // Read in the file header.
   hpctrace_fmt_hdr_t thdr;
   if(hpctrace_fmt_hdr_fread(&thdr, file) != HPCFMT_OK) {
@@ -213,13 +335,17 @@ bool Hpcrun4::setupTrace(unsigned int traceDisorder) noexcept {
   trace_off = std::ftell(file);
 
   // Count the number of timepoints in the file, and save it for later.
-  std::fseek(file, 0, SEEK_END);
-  auto trace_end = std::ftell(file);
-  if((trace_end - trace_off) % (8+4) != 0) {
+  long trace_end = trace_range.end;
+  if(trace_end == 0) {
+    std::fseek(file, 0, SEEK_END);
+    trace_end = std::ftell(file);
+  }
+  if(trace_end < trace_off || (trace_end - trace_off) % (8+4) != 0) {
     std::fclose(file);
     return false;
   }
-  tattrs.ctxTimepointStats((trace_end - trace_off) / (8+4), traceDisorder);
+  trace_count = (trace_end - trace_off) / (8+4);
+  tattrs.ctxTimepointStats(trace_count, traceDisorder);
 
   std::fclose(file);
   return true;
@@ -621,7 +747,7 @@ bool Hpcrun4::realread(const DataClass& needed) try {
     std::FILE* f = std::fopen(tracepath.c_str(), "rb");
     std::fseek(f, trace_off, SEEK_SET);
     hpctrace_fmt_datum_t tpoint;
-    while(1) {
+    for(std::size_t i = 0; i < trace_count; i++) {
       int err = hpctrace_fmt_datum_fread(&tpoint, {0}, f);
       if(err == HPCFMT_EOF) break;
       else if(err != HPCFMT_OK) {
@@ -639,6 +765,7 @@ bool Hpcrun4::realread(const DataClass& needed) try {
           case ProfilePipeline::Source::TimepointStatus::rewindStart:
             // Put the cursor back at the beginning
             std::fseek(f, trace_off, SEEK_SET);
+            i = std::size_t(-1);  // Wrapped back to 0 by the loop
             break;
           }
         }
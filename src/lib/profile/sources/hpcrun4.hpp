@@ -54,6 +54,9 @@
 #include "../util/ref_wrappers.hpp"
 
 #include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
 #include "../stdshim/filesystem.hpp"
 
 // Forward declaration of a structure.
@@ -166,14 +169,39 @@ private:
   // Flag for whether we've warned about top-level context demotion
   bool warned_top_demotion = false;
 
-  // Path to the tracefile, and offset of the actual data blob.
+  // Path to the tracefile, offset of the actual data blob and number of
+  // timepoints in it.
   stdshim::filesystem::path tracepath;
   long trace_off;
+  std::size_t trace_count;
   bool trace_sort;
 
+  // Where a trace is within its file. An end of 0 is the end of the file.
+  struct TraceRange {
+    stdshim::filesystem::path path;
+    std::size_t start = 0;
+    std::size_t end = 0;
+  };
+  TraceRange trace_range;
+
+  // Find the [start, end) byte ranges of the profiles held in a file. hpcrun
+  // may append the profiles of all the threads of a process to one file.
+  static std::vector<std::pair<std::size_t, std::size_t>>
+    segments(const stdshim::filesystem::path&);
+
+  // Find the [start, end) byte ranges of the profiles held in a node
+  // container written by the hpcrun node aggregator, each with its trace
+  // (an empty path if it has none). Empty if the file is not a container.
+  static std::vector<std::pair<std::pair<std::size_t, std::size_t>, TraceRange>>
+    nodeSegments(const stdshim::filesystem::path&);
+
   // We're all friends here.
-  friend std::unique_ptr<ProfileSource> ProfileSource::create_for(const stdshim::filesystem::path&);
-  Hpcrun4(const stdshim::filesystem::path&);
+  friend std::unique_ptr<ProfileSource> ProfileSource::create_for(const stdshim::filesystem::path&,
+                                                                  std::size_t);
+  friend std::vector<std::unique_ptr<ProfileSource>>
+    ProfileSource::create_all_for(const stdshim::filesystem::path&);
+  Hpcrun4(const stdshim::filesystem::path&, std::size_t start, std::size_t end,
+          bool shared, std::optional<TraceRange> trace = std::nullopt);
 };
 
 }
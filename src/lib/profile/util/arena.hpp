@@ -0,0 +1,135 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2023, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+#ifndef HPCTOOLKIT_PROFILE_UTIL_ARENA_H
+#define HPCTOOLKIT_PROFILE_UTIL_ARENA_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <new>
+#include <utility>
+
+namespace hpctoolkit::util {
+
+/// Concurrent arena of objects of a single type.
+///
+/// Objects are allocated by bumping a single atomic counter into a series of
+/// chunks, each twice the size of the last, so neighboring allocations are
+/// usually neighbors in memory too. Objects are never freed individually, all
+/// of them are destroyed (in allocation order) when the arena is destroyed.
+///
+/// MT: Internally Synchronized
+template<class T, std::size_t FirstChunkLog = 10>
+class arena {
+public:
+  arena() {
+    for(auto& c: chunks) c.store(nullptr, std::memory_order_relaxed);
+  }
+  ~arena() {
+    const std::size_t n = count.load(std::memory_order_acquire);
+    for(std::size_t i = 0; i < n; i++) slot(i)->~T();
+    for(std::size_t k = 0; k < chunks.size(); k++) {
+      if(T* c = chunks[k].load(std::memory_order_relaxed))
+        std::allocator<T>().deallocate(c, chunkSize(k));
+    }
+  }
+
+  arena(const arena&) = delete;
+  arena(arena&&) = delete;
+  arena& operator=(const arena&) = delete;
+  arena& operator=(arena&&) = delete;
+
+  /// Construct a new object in the arena. The returned reference is stable
+  /// for the lifetime of the arena.
+  ///
+  /// Construction may not fail, since the slot cannot be given back: any
+  /// exception thrown by T's constructor terminates the program.
+  template<class... Args>
+  T& emplace(Args&&... args) noexcept {
+    T* p = slot(count.fetch_add(1, std::memory_order_relaxed));
+    return *new(p) T(std::forward<Args>(args)...);
+  }
+
+  /// Number of objects allocated in this arena.
+  // MT: Unstable
+  std::size_t size() const noexcept {
+    return count.load(std::memory_order_relaxed);
+  }
+
+private:
+  static constexpr std::size_t chunkSize(std::size_t k) noexcept {
+    return std::size_t(1) << (k + FirstChunkLog);
+  }
+
+  T* slot(std::size_t idx) {
+    // Chunk k holds the indices [2^(k+F) - 2^F, 2^(k+F+1) - 2^F)
+    const std::size_t pos = idx + chunkSize(0);
+    const std::size_t k = (std::numeric_limits<std::size_t>::digits - 1
+                           - __builtin_clzl(pos)) - FirstChunkLog;
+    T* c = chunks[k].load(std::memory_order_acquire);
+    if(c == nullptr) {
+      // Nobody has allocated this chunk yet, race to allocate it
+      T* n = std::allocator<T>().allocate(chunkSize(k));
+      if(chunks[k].compare_exchange_strong(c, n, std::memory_order_acq_rel))
+        c = n;
+      else
+        std::allocator<T>().deallocate(n, chunkSize(k));
+    }
+    return c + (pos - chunkSize(k));
+  }
+
+  std::atomic<std::size_t> count = 0;
+  std::array<std::atomic<T*>,
+             std::numeric_limits<std::size_t>::digits - FirstChunkLog> chunks;
+};
+
+}
+
+#endif  // HPCTOOLKIT_PROFILE_UTIL_ARENA_H
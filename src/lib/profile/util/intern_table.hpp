@@ -0,0 +1,326 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2023, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+#ifndef HPCTOOLKIT_PROFILE_UTIL_INTERN_TABLE_H
+#define HPCTOOLKIT_PROFILE_UTIL_INTERN_TABLE_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace hpctoolkit::util {
+
+/// Concurrent table of interned (unique) strings.
+///
+/// Lookups and insertions are lock-free. All entries live in a single linked
+/// list sorted by their bit-reversed hash (a split-ordered list), and each
+/// bucket points at a marker node in that list. Doubling the number of buckets
+/// just splits every bucket in two by adding markers, no entry is ever moved,
+/// so the table grows with the number of strings without stopping inserters.
+/// New entries are published by a single compare-and-swap onto their
+/// predecessor and are never modified or removed afterwards.
+///
+/// Each thread stages the entries it has seen recently in a small private
+/// cache, so repeated lookups of the same strings don't touch shared memory.
+///
+/// Final (dense) indices are assigned by finalize() in sorted string order,
+/// so the result does not depend on the thread interleaving.
+class intern_table {
+  /// Node in the split-ordered list, either a bucket marker or an entry.
+  /// Entries have odd keys and markers even keys.
+  struct node {
+    node(std::uint64_t k) : key(k) {};
+    const std::uint64_t key;
+    std::atomic<node*> next = nullptr;
+  };
+
+public:
+  /// Single interned string. Stable for the lifetime of the table.
+  class entry : private node {
+  public:
+    ~entry() = default;
+
+    entry(const entry&) = delete;
+    entry(entry&&) = delete;
+    entry& operator=(const entry&) = delete;
+    entry& operator=(entry&&) = delete;
+
+    /// Get the interned string.
+    // MT: Safe (const)
+    const std::string& str() const noexcept { return m_str; }
+
+    /// Get the final index of this string. Only valid after finalize().
+    // MT: Externally Synchronized (after finalize())
+    std::size_t index() const noexcept {
+      assert(m_index != std::numeric_limits<std::size_t>::max()
+             && "Attempt to get the index of a string before finalize()!");
+      return m_index;
+    }
+
+  private:
+    friend class intern_table;
+    entry(std::string_view s, std::uint64_t h)
+      : node(reverse(h) | 1), m_str(s), m_hash(h) {};
+
+    const std::string m_str;
+    const std::uint64_t m_hash;
+    std::size_t m_index = std::numeric_limits<std::size_t>::max();
+  };
+
+  /// Create a new table with (at least) the given number of initial buckets.
+  /// The table grows as strings are added, so this is only a hint.
+  explicit intern_table(std::size_t nBuckets = 1 << 10)
+    : m_id(nextId.fetch_add(1, std::memory_order_relaxed)) {
+    std::size_t n = 1;
+    while(n < nBuckets) n <<= 1;
+    firstBits = 0;
+    while((std::size_t(1) << firstBits) < n) ++firstBits;
+    size.store(n, std::memory_order_relaxed);
+    for(auto& seg: segments) seg.store(nullptr, std::memory_order_relaxed);
+    slot(0).store(&head, std::memory_order_relaxed);
+  }
+  ~intern_table() {
+    node* n = head.next.load(std::memory_order_relaxed);
+    while(n != nullptr) {
+      node* next = n->next.load(std::memory_order_relaxed);
+      if(n->key & 1) delete static_cast<entry*>(n);
+      else delete n;
+      n = next;
+    }
+    for(auto& seg: segments) delete[] seg.load(std::memory_order_relaxed);
+  }
+
+  intern_table(const intern_table&) = delete;
+  intern_table(intern_table&&) = delete;
+  intern_table& operator=(const intern_table&) = delete;
+  intern_table& operator=(intern_table&&) = delete;
+
+  /// Intern the given string, returning the unique entry for it.
+  // MT: Internally Synchronized (lock-free)
+  const entry& intern(std::string_view s) {
+    const std::uint64_t h = std::hash<std::string_view>{}(s);
+
+    auto& staged = stage();
+    const entry*& cached = staged.entries[h % staged.entries.size()];
+    if(cached != nullptr && cached->m_hash == h && cached->m_str == s)
+      return *cached;
+
+    const std::uint64_t key = reverse(h) | 1;
+    node* prev = bucket(h & (size.load(std::memory_order_acquire) - 1));
+    entry* fresh = nullptr;
+    while(true) {
+      // Skip to the entries with our key, and check whether one is for s
+      node* cur = prev->next.load(std::memory_order_acquire);
+      while(cur != nullptr && cur->key < key) {
+        prev = cur;
+        cur = cur->next.load(std::memory_order_acquire);
+      }
+      node* last = prev;
+      for(; cur != nullptr && cur->key == key;
+          last = cur, cur = cur->next.load(std::memory_order_acquire)) {
+        const entry* e = static_cast<const entry*>(cur);
+        if(e->m_str == s) {
+          delete fresh;
+          cached = e;
+          return *e;
+        }
+      }
+
+      // Not found, try to publish a new entry after the last with our key. If
+      // we lose the race, scan again from prev, which stays our predecessor.
+      if(fresh == nullptr) fresh = new entry(s, h);
+      fresh->next.store(cur, std::memory_order_relaxed);
+      if(last->next.compare_exchange_strong(cur, fresh,
+             std::memory_order_release, std::memory_order_relaxed))
+        break;
+    }
+
+    // Double the buckets once the chains get long
+    const std::size_t n = count.fetch_add(1, std::memory_order_relaxed) + 1;
+    std::size_t sz = size.load(std::memory_order_relaxed);
+    if(n > sz * maxLoad && sz < maxBuckets())
+      size.compare_exchange_strong(sz, sz * 2, std::memory_order_release,
+                                   std::memory_order_relaxed);
+
+    cached = fresh;
+    return *fresh;
+  }
+
+  /// Assign final indices to all the interned strings, and return the strings
+  /// in index order. Indices are assigned in sorted string order.
+  // MT: Externally Synchronized
+  std::vector<std::string_view> finalize() {
+    std::vector<entry*> entries;
+    entries.reserve(count.load(std::memory_order_relaxed));
+    for(node* n = head.next.load(std::memory_order_acquire); n != nullptr;
+        n = n->next.load(std::memory_order_acquire)) {
+      if(n->key & 1) entries.push_back(static_cast<entry*>(n));
+    }
+    std::sort(entries.begin(), entries.end(), [](const entry* a, const entry* b){
+      return a->m_str < b->m_str;
+    });
+
+    std::vector<std::string_view> result;
+    result.reserve(entries.size());
+    for(entry* e: entries) {
+      e->m_index = result.size();
+      result.emplace_back(e->m_str);
+    }
+    return result;
+  }
+
+  /// Get the current number of buckets. For testing purposes.
+  // MT: Internally Synchronized
+  std::size_t bucket_count() const noexcept {
+    return size.load(std::memory_order_relaxed);
+  }
+
+private:
+  /// Average entries per bucket before the buckets are doubled.
+  static constexpr std::size_t maxLoad = 2;
+  static constexpr std::size_t nSegments = 48;
+
+  /// Per-thread cache of recently interned entries, for the last table used.
+  struct staging {
+    std::uint64_t table = 0;
+    std::array<const entry*, 256> entries;
+  };
+  staging& stage() noexcept {
+    static thread_local staging staged;
+    if(staged.table != m_id) {
+      staged.table = m_id;
+      staged.entries.fill(nullptr);
+    }
+    return staged;
+  }
+
+  static std::uint64_t reverse(std::uint64_t x) noexcept {
+    x = ((x >> 1) & 0x5555555555555555ULL) | ((x & 0x5555555555555555ULL) << 1);
+    x = ((x >> 2) & 0x3333333333333333ULL) | ((x & 0x3333333333333333ULL) << 2);
+    x = ((x >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((x & 0x0F0F0F0F0F0F0F0FULL) << 4);
+    return __builtin_bswap64(x);
+  }
+
+  std::size_t maxBuckets() const noexcept {
+    return std::size_t(1) << (firstBits + nSegments - 1);
+  }
+
+  /// Get the slot for bucket b. Segment 0 holds the first 2^firstBits buckets,
+  /// each later segment as many buckets as all those before it.
+  std::atomic<node*>& slot(std::size_t b) {
+    std::size_t seg = 0, off = b;
+    if(b >> firstBits) {
+      const unsigned hb = 63 - __builtin_clzll(b);
+      seg = hb - firstBits + 1;
+      off = b - (std::size_t(1) << hb);
+    }
+    std::atomic<node*>* s = segments[seg].load(std::memory_order_acquire);
+    if(s == nullptr) {
+      const std::size_t n = seg == 0 ? std::size_t(1) << firstBits
+                                     : std::size_t(1) << (firstBits + seg - 1);
+      auto fresh = new std::atomic<node*>[n];
+      for(std::size_t i = 0; i < n; ++i)
+        fresh[i].store(nullptr, std::memory_order_relaxed);
+      if(segments[seg].compare_exchange_strong(s, fresh,
+             std::memory_order_acq_rel, std::memory_order_acquire))
+        s = fresh;
+      else
+        delete[] fresh;
+    }
+    return s[off];
+  }
+
+  /// Get the marker for bucket b, adding it (and its parents) if needed.
+  node* bucket(std::size_t b) {
+    auto& sl = slot(b);
+    if(node* m = sl.load(std::memory_order_acquire)) return m;
+
+    // The parent bucket is b without its highest bit, its marker precedes ours
+    node* prev = bucket(b & ~(std::size_t(1) << (63 - __builtin_clzll(b))));
+    const std::uint64_t key = reverse(b);
+    node* fresh = nullptr;
+    while(true) {
+      node* cur = prev->next.load(std::memory_order_acquire);
+      while(cur != nullptr && cur->key < key) {
+        prev = cur;
+        cur = cur->next.load(std::memory_order_acquire);
+      }
+      if(cur != nullptr && cur->key == key) {
+        // Someone else added the marker first
+        delete fresh;
+        fresh = cur;
+        break;
+      }
+      if(fresh == nullptr) fresh = new node(key);
+      fresh->next.store(cur, std::memory_order_relaxed);
+      if(prev->next.compare_exchange_strong(cur, fresh,
+             std::memory_order_release, std::memory_order_relaxed))
+        break;
+    }
+    sl.store(fresh, std::memory_order_release);
+    return fresh;
+  }
+
+  static inline std::atomic<std::uint64_t> nextId{1};
+  const std::uint64_t m_id;
+
+  node head{0};
+  unsigned firstBits;
+  std::atomic<std::size_t> size;
+  std::atomic<std::size_t> count = 0;
+  std::array<std::atomic<std::atomic<node*>*>, nSegments> segments;
+};
+
+}  // namespace hpctoolkit::util
+
+#endif  // HPCTOOLKIT_PROFILE_UTIL_INTERN_TABLE_H
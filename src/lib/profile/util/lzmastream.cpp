@@ -48,8 +48,10 @@
 
 #include "log.hpp"
 
+#include <algorithm>
 #include <cassert>
 #include <cstring>
+#include <stdexcept>
 
 using namespace hpctoolkit::util;
 
@@ -130,3 +132,66 @@ lzmastreambuf::int_type lzmastreambuf::underflow() {
   }
   return gptr() == egptr() ? traits_type::eof() : traits_type::not_eof(*gptr());
 }
+
+std::vector<char> hpctoolkit::util::lzmaCompress(const char* data, std::size_t size,
+                                                 uint32_t preset) {
+  std::vector<char> out(lzma_stream_buffer_bound(size));
+  std::size_t pos = 0;
+  lzma_ret ret = lzma_easy_buffer_encode(preset, LZMA_CHECK_NONE, nullptr,
+      (const uint8_t*)data, size, (uint8_t*)out.data(), &pos, out.size());
+  switch(ret) {
+  case LZMA_OK:
+    break;
+  case LZMA_MEM_ERROR:
+    throw std::runtime_error("LZMA encoder ran out of memory");
+  case LZMA_OPTIONS_ERROR:
+    throw std::runtime_error("LZMA encoder with wrong options");
+  default:
+    throw std::runtime_error("LZMA encoder failed to compress a buffer");
+  }
+  out.resize(pos);
+  return out;
+}
+
+void hpctoolkit::util::lzmaDecompress(const char* in, std::size_t inSize,
+                                      char* out, std::size_t size) {
+  uint64_t memlimit = UINT64_MAX;
+  std::size_t inPos = 0;
+  std::size_t outPos = 0;
+  maybeThrowLZMA_decoder(lzma_stream_buffer_decode(&memlimit, 0, nullptr,
+      (const uint8_t*)in, &inPos, inSize, (uint8_t*)out, &outPos, size));
+  if(outPos != size)
+    throw std::runtime_error("LZMA stream decompressed to an unexpected size");
+}
+
+std::vector<char> hpctoolkit::util::lzmaDecompress(const char* in, std::size_t inSize) {
+  lzma_stream stream = LZMA_STREAM_INIT;
+  maybeThrowLZMA_decoder(lzma_auto_decoder(&stream, UINT64_MAX, 0));
+  // Compressed text usually expands by 4-8x, start there and grow as needed
+  std::vector<char> out(std::max<std::size_t>(inSize * 4, BUFSIZE));
+  stream.next_in = (const uint8_t*)in;
+  stream.avail_in = inSize;
+  try {
+    while(true) {
+      std::size_t done = stream.total_out;
+      if(done == out.size()) out.resize(out.size() * 2);
+      stream.next_out = (uint8_t*)out.data() + done;
+      stream.avail_out = out.size() - done;
+      if(maybeThrowLZMA_decoder(lzma_code(&stream, LZMA_FINISH)) == LZMA_STREAM_END)
+        break;
+      if(stream.avail_in == 0 && stream.avail_out != 0)
+        throw std::runtime_error("attempt to decode a truncated LZMA/XZ stream");
+    }
+  } catch(...) {
+    lzma_end(&stream);
+    throw;
+  }
+  out.resize(stream.total_out);
+  lzma_end(&stream);
+  return out;
+}
+
+bool hpctoolkit::util::isXZ(const char* in, std::size_t inSize) noexcept {
+  static const char magic[6] = {'\xFD', '7', 'z', 'X', 'Z', '\0'};
+  return inSize >= sizeof magic && std::memcmp(in, magic, sizeof magic) == 0;
+}
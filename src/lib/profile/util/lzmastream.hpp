@@ -52,6 +52,7 @@
 #include <istream>
 #include <streambuf>
 #include <type_traits>
+#include <vector>
 
 namespace hpctoolkit::util {
 
@@ -88,6 +89,20 @@ public:
   ~ilzmastream() = default;
 };
 
+/// Compress a whole buffer into a single XZ stream, using the given preset.
+std::vector<char> lzmaCompress(const char* data, std::size_t size, uint32_t preset);
+
+/// Decompress a single XZ stream into a buffer of exactly the given size.
+/// Throws if the stream is corrupt or does not decompress to exactly `size` bytes.
+void lzmaDecompress(const char* in, std::size_t inSize, char* out, std::size_t size);
+
+/// Decompress a whole LZMA/XZ stream of unknown decompressed size in one go.
+/// Throws if the stream is corrupt.
+std::vector<char> lzmaDecompress(const char* in, std::size_t inSize);
+
+/// Check whether the given buffer starts with the XZ stream magic.
+bool isXZ(const char* in, std::size_t inSize) noexcept;
+
 }
 
 #endif  // HPCTOOLKIT_PROFILE_UTIL_LZMASTREAM_H
@@ -189,6 +189,21 @@ main(int argc, char **argv, char **envp)
      // if an error in init_server is reported, we report it here too.
      return sr;
     }
+    if ( strcmp (*p, "-S") == 0 ) {
+      // serve all hpcrun processes of the node  "-S <name>"
+      if ((i+1) >= argc) {
+        fprintf (stderr, "FNB2: hpcfnbounds node server invocation too few arguments\n" );
+        exit(1);
+      }
+      p++;
+      server_mode = 1;
+      if (scan_code == 1) {
+        sr = init_node_server(DiscoverFnTy_Aggressive, *p);
+      } else {
+        sr = init_node_server(DiscoverFnTy_Conservative, *p);
+      }
+      return sr;
+    }
     // any other arguments must be the name of a load objects to process
     // First, check to see if environment varirable HPCFNBOUNDS_NO_USE is set
     if (disable_init == 0 ) {
@@ -846,6 +861,8 @@ usage()
       "\t-d\tdon't perform function discovery on stripped code\n"
       "\t\t    eguivalent to -n itfa\n"
       "\t-s fdin fdout\t" "run in server mode\n"
+      "\t-S name\t" "run as the server of all hpcrun processes of the node,\n"
+      "\t\t    listening on the abstract UNIX socket <name>\n"
 #if 0
       "\t-D\tdon't attempt to process DWARF\n"
 #endif
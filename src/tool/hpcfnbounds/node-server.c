@@ -0,0 +1,741 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2023, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+
+// The node-wide mode of the fnbounds server (-S <name>).  One server
+// answers the queries of all the hpcrun processes of a user on a node
+// over a UNIX-domain socket with the abstract name <name>, so that
+// each load module is analyzed once per node instead of once per
+// process.  The first hpcrun process that finds no server launches
+// one; the server exits after IDLE_SECONDS without clients.
+//
+// Notes:
+// 1. Each client connection is served by its own thread, with the
+// same messages as over the pipe (syserv-mesg.h), except that the
+// addresses of an OK answer are not sent inline.  The OK message
+// carries a sealed memfd that holds them, which the client maps
+// shared, so all processes on the node share one copy of each table.
+//
+// 2. Answers are kept for the life of the server, keyed by the
+// identity of the file (device, inode, size and mtime), so a load
+// module reached by different paths is analyzed once.  Names that
+// cannot be stat'ed ([vdso]) are keyed by name.  Failed answers are
+// dropped once their waiting clients have been told, so a later
+// query tries again.
+//
+// 3. get_funclist() keeps its state in globals, so the analyses run
+// in up to max_workers single-threaded worker processes, each of which
+// answers one query at a time into a memfd, as it would to the pipe,
+// and passes the memfd back over its socket.  Concurrent queries for
+// the same file wait for the one analysis.  The workers are forked on
+// demand by a spawner process that is forked before the server starts
+// any thread, so no worker is the fork of a multithreaded process.  A
+// worker that crashes only fails its query and is replaced.
+//
+// 4. Only clients of the same user are served.
+//
+//***************************************************************************
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "fnbounds.h"
+#include "server.h"
+#include "syserv-mesg.h"
+
+#define IDLE_SECONDS  60
+#define MAX_WORKERS   16
+
+enum {
+  ANSWER_COMPUTING = 1,
+  ANSWER_READY
+};
+
+typedef struct answer_s {
+  struct answer_s *next;
+  char *name;
+  dev_t dev;
+  ino_t ino;
+  off_t size;
+  struct timespec mtime;
+
+  int state;
+  int refs;             // the list and the clients using the answer
+  int fd;               // sealed memfd with the addresses, or -1 on error
+  int64_t num_addrs;
+  struct syserv_fnbounds_info info;
+} answer_t;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+// broadcast when an answer is ready and when a worker becomes idle
+static pthread_cond_t answered = PTHREAD_COND_INITIALIZER;
+
+static answer_t *answers = NULL;
+
+// sockets of the idle workers, and the number of workers alive
+static int idle_workers[MAX_WORKERS];
+static int num_idle = 0;
+static int num_workers = 0;
+static int max_workers = 1;
+
+// socket to the spawner process; requests are serialized by spawn_lock
+static pthread_mutex_t spawn_lock = PTHREAD_MUTEX_INITIALIZER;
+static int spawner = -1;
+static int num_clients = 0;
+static time_t last_client;
+
+static size_t pagesize;
+
+
+//*****************************************************************
+// I/O helper functions
+//*****************************************************************
+
+static int
+send_mesg(int sock, int32_t type, int64_t len)
+{
+  struct syserv_mesg mesg;
+
+  mesg.magic = SYSERV_MAGIC;
+  mesg.type = type;
+  mesg.len = len;
+
+  return write_all(sock, &mesg, sizeof(mesg));
+}
+
+
+// Send 'len' bytes of buf in one sendmsg, with the descriptor fd
+// unless it is -1.  Returns: the number of bytes sent, or -1.
+//
+static ssize_t
+sendmsg_fd(int sock, const void *buf, size_t len, int fd)
+{
+  union {
+    struct cmsghdr hdr;
+    char buf[CMSG_SPACE(sizeof(int))];
+  } ctl;
+
+  struct iovec iov = { .iov_base = (void *) buf, .iov_len = len };
+  struct msghdr msg = { .msg_iov = &iov, .msg_iovlen = 1 };
+  if (fd >= 0) {
+    msg.msg_control = ctl.buf;
+    msg.msg_controllen = sizeof(ctl.buf);
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+  }
+
+  ssize_t ret;
+  do {
+    ret = sendmsg(sock, &msg, MSG_NOSIGNAL);
+  } while (ret < 0 && errno == EINTR);
+  return ret;
+}
+
+
+// Receive up to 'len' bytes into buf in one recvmsg, and the
+// descriptor that came with them into *fd (-1 if none).
+// Returns: the number of bytes received, 0 at end of file, or -1.
+//
+static ssize_t
+recvmsg_fd(int sock, void *buf, size_t len, int *fd)
+{
+  union {
+    struct cmsghdr hdr;
+    char buf[CMSG_SPACE(sizeof(int))];
+  } ctl;
+
+  struct iovec iov = { .iov_base = buf, .iov_len = len };
+  struct msghdr msg = {
+    .msg_iov = &iov, .msg_iovlen = 1,
+    .msg_control = ctl.buf, .msg_controllen = sizeof(ctl.buf)
+  };
+
+  ssize_t ret;
+  do {
+    ret = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+  } while (ret < 0 && errno == EINTR);
+
+  *fd = -1;
+  struct cmsghdr *cmsg = ret > 0 ? CMSG_FIRSTHDR(&msg) : NULL;
+  if (cmsg != NULL && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+    memcpy(fd, CMSG_DATA(cmsg), sizeof(int));
+  }
+  return ret;
+}
+
+
+// Send an OK message for 'len' addresses, with the memfd that holds
+// them.  Returns: 0 on success.
+//
+static int
+send_mesg_fd(int sock, int64_t len, int fd)
+{
+  struct syserv_mesg mesg;
+
+  mesg.magic = SYSERV_MAGIC;
+  mesg.type = SYSERV_OK;
+  mesg.len = len;
+
+  ssize_t ret = sendmsg_fd(sock, &mesg, sizeof(mesg), fd);
+  if (ret < 0) {
+    return -1;
+  }
+
+  // the descriptor went with the first byte, send the rest plainly
+  return write_all(sock, ((char *) &mesg) + ret, sizeof(mesg) - ret);
+}
+
+
+//*****************************************************************
+// Workers
+//*****************************************************************
+
+// Answer the queries sent over sock, one at a time, until the server
+// closes it.  Each query is a name; each answer is a status byte, 0 on
+// success, with the memfd that holds the answer.
+//
+static void
+worker_main(int sock)
+{
+  char name[PATH_MAX + 1];
+
+  signal_handler_init();
+  for (;;) {
+    ssize_t len;
+    do {
+      len = recv(sock, name, PATH_MAX, 0);
+    } while (len < 0 && errno == EINTR);
+    if (len <= 0) {
+      break;
+    }
+    name[len] = 0;
+
+    char status = 1;
+    int out = memfd_create("hpcfnbounds-answer", MFD_CLOEXEC);
+    if (out >= 0) {
+      write_answer(name, out);
+      status = 0;
+    }
+    if (sendmsg_fd(sock, &status, 1, out) != 1) {
+      break;
+    }
+    if (out >= 0) {
+      close(out);
+    }
+  }
+  _exit(0);
+}
+
+
+// Fork a worker for each request byte sent over sock, and send back a
+// status byte with the server's end of the socket to the new worker.
+// Runs in a process forked before the server started any thread.
+//
+static void
+spawner_main(int sock)
+{
+  // the workers are reaped by the kernel
+  signal(SIGCHLD, SIG_IGN);
+
+  for (;;) {
+    char req;
+    ssize_t len;
+    do {
+      len = recv(sock, &req, 1, 0);
+    } while (len < 0 && errno == EINTR);
+    if (len <= 0) {
+      break;
+    }
+
+    int sv[2];
+    pid_t pid = -1;
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) == 0) {
+      pid = fork();
+      if (pid == 0) {
+        close(sock);
+        close(sv[0]);
+        worker_main(sv[1]);
+      }
+      close(sv[1]);
+    }
+
+    char status = pid < 0;
+    int ret = sendmsg_fd(sock, &status, 1, pid < 0 ? -1 : sv[0]);
+    if (pid > 0) {
+      close(sv[0]);
+    }
+    if (ret != 1) {
+      break;
+    }
+  }
+  _exit(0);
+}
+
+
+// Returns: the socket of an idle worker, starting one if fewer than
+// max_workers are alive, or -1 if none can be started.
+//
+static int
+acquire_worker(void)
+{
+  pthread_mutex_lock(&lock);
+  while (num_idle == 0 && num_workers >= max_workers) {
+    pthread_cond_wait(&answered, &lock);
+  }
+  if (num_idle > 0) {
+    int sock = idle_workers[--num_idle];
+    pthread_mutex_unlock(&lock);
+    return sock;
+  }
+  num_workers++;
+  pthread_mutex_unlock(&lock);
+
+  char req = 0, status = 1;
+  int sock = -1;
+  pthread_mutex_lock(&spawn_lock);
+  if (sendmsg_fd(spawner, &req, 1, -1) != 1
+      || recvmsg_fd(spawner, &status, 1, &sock) != 1 || status != 0) {
+    if (sock >= 0) close(sock);
+    sock = -1;
+  }
+  pthread_mutex_unlock(&spawn_lock);
+
+  if (sock < 0) {
+    fprintf(stderr, "FNB2: unable to start a worker\n");
+    pthread_mutex_lock(&lock);
+    num_workers--;
+    pthread_cond_broadcast(&answered);
+    pthread_mutex_unlock(&lock);
+  }
+  return sock;
+}
+
+
+// Return a worker to the pool, or retire it if it failed.
+static void
+release_worker(int sock, int ok)
+{
+  pthread_mutex_lock(&lock);
+  if (ok) {
+    idle_workers[num_idle++] = sock;
+  } else {
+    close(sock);
+    num_workers--;
+  }
+  pthread_cond_broadcast(&answered);
+  pthread_mutex_unlock(&lock);
+}
+
+
+//*****************************************************************
+// Answers
+//*****************************************************************
+
+// Run the query for a->name in a worker and keep its answer.
+static void
+compute_answer(answer_t *a)
+{
+  a->fd = -1;
+
+  int worker = acquire_worker();
+  if (worker < 0) {
+    return;
+  }
+
+  char status = 1;
+  int out = -1;
+  ssize_t ret;
+  do {
+    ret = send(worker, a->name, strlen(a->name) + 1, MSG_NOSIGNAL);
+  } while (ret < 0 && errno == EINTR);
+  int ok = ret > 0 && recvmsg_fd(worker, &status, 1, &out) == 1;
+  release_worker(worker, ok);
+
+  if (!ok || status != 0 || out < 0) {
+    fprintf(stderr, "FNB2: analysis of %s failed\n", a->name);
+    if (out >= 0) close(out);
+    return;
+  }
+
+  // the answer is an OK message, the addresses and the fnbounds info
+  struct syserv_mesg mesg;
+  if (pread(out, &mesg, sizeof(mesg), 0) != sizeof(mesg)
+      || mesg.magic != SYSERV_MAGIC || mesg.type != SYSERV_OK) {
+    close(out);
+    return;
+  }
+  size_t num_bytes = mesg.len * sizeof(void *);
+  if (pread(out, &a->info, sizeof(a->info), sizeof(mesg) + num_bytes)
+      != sizeof(a->info)) {
+    close(out);
+    return;
+  }
+
+  // copy the addresses to the start of a table of their own, which the
+  // clients map at offset 0
+  int table = memfd_create("hpcfnbounds-table", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  size_t table_size = ((num_bytes + pagesize - 1) / pagesize) * pagesize;
+  void *addrs = mmap(NULL, sizeof(mesg) + num_bytes, PROT_READ, MAP_SHARED, out, 0);
+  if (table < 0 || addrs == MAP_FAILED || ftruncate(table, table_size) != 0
+      || write_all(table, (char *) addrs + sizeof(mesg), num_bytes) != 0
+      || fcntl(table, F_ADD_SEALS,
+               F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) != 0) {
+    warn("FNB2: unable to store the answer for %s", a->name);
+    if (table >= 0) close(table);
+  } else {
+    a->fd = table;
+    a->num_addrs = mesg.len;
+  }
+  if (addrs != MAP_FAILED) {
+    munmap(addrs, sizeof(mesg) + num_bytes);
+  }
+  close(out);
+}
+
+
+static int
+same_file(answer_t *a, const char *name, struct stat *st)
+{
+  if (st->st_ino == 0) {
+    return a->ino == 0 && strcmp(a->name, name) == 0;
+  }
+  return a->dev == st->st_dev && a->ino == st->st_ino && a->size == st->st_size
+    && a->mtime.tv_sec == st->st_mtim.tv_sec && a->mtime.tv_nsec == st->st_mtim.tv_nsec;
+}
+
+
+// Returns: the answer to the query for 'name', computing it first if
+// this is the first query for the file.
+static answer_t *
+get_answer(const char *name)
+{
+  struct stat st;
+  if (stat(name, &st) != 0) {
+    memset(&st, 0, sizeof(st));
+  }
+
+  pthread_mutex_lock(&lock);
+
+  answer_t *a;
+  for (a = answers; a != NULL; a = a->next) {
+    if (same_file(a, name, &st)) {
+      break;
+    }
+  }
+
+  if (a != NULL) {
+    a->refs++;
+    while (a->state != ANSWER_READY) {
+      pthread_cond_wait(&answered, &lock);
+    }
+    pthread_mutex_unlock(&lock);
+    return a;
+  }
+
+  a = calloc(1, sizeof(*a));
+  if (a == NULL || (a->name = strdup(name)) == NULL) {
+    err(1, "malloc for answer failed");
+  }
+  a->dev = st.st_dev;
+  a->ino = st.st_ino;
+  a->size = st.st_size;
+  a->mtime = st.st_mtim;
+  a->state = ANSWER_COMPUTING;
+  a->refs = 2;
+  a->next = answers;
+  answers = a;
+  pthread_mutex_unlock(&lock);
+
+  compute_answer(a);
+
+  pthread_mutex_lock(&lock);
+  a->state = ANSWER_READY;
+  if (a->fd < 0) {
+    // don't keep the failure, a later query tries again
+    for (answer_t **p = &answers; *p != NULL; p = &(*p)->next) {
+      if (*p == a) {
+        *p = a->next;
+        a->refs--;
+        break;
+      }
+    }
+  }
+  pthread_cond_broadcast(&answered);
+  pthread_mutex_unlock(&lock);
+
+  if (verbose) {
+    fprintf(stderr, "FNB2: node server answered %s: %ld addresses\n",
+            name, (long) a->num_addrs);
+  }
+  return a;
+}
+
+
+// Release the answer returned by get_answer.
+static void
+put_answer(answer_t *a)
+{
+  pthread_mutex_lock(&lock);
+  int refs = --a->refs;
+  pthread_mutex_unlock(&lock);
+
+  if (refs == 0) {
+    free(a->name);
+    free(a);
+  }
+}
+
+
+//*****************************************************************
+// Clients
+//*****************************************************************
+
+static void *
+serve_client(void *arg)
+{
+  int sock = (int) (intptr_t) arg;
+  char name[PATH_MAX + 1];
+
+  for (;;) {
+    struct syserv_mesg mesg;
+    if (read_all(sock, &mesg, sizeof(mesg)) != 0 || mesg.magic != SYSERV_MAGIC
+        || mesg.type == SYSERV_EXIT) {
+      break;
+    }
+
+    if (mesg.type == SYSERV_ACK) {
+      if (send_mesg(sock, SYSERV_ACK, 0) != 0) break;
+      continue;
+    }
+
+    if (mesg.type != SYSERV_QUERY || mesg.len < 1 || mesg.len > PATH_MAX) {
+      fprintf(stderr, "FNB2: bad message from client: type %d\n", mesg.type);
+      break;
+    }
+    if (send_mesg(sock, SYSERV_ACK, 0) != 0
+        || read_all(sock, name, mesg.len) != 0) {
+      break;
+    }
+    name[mesg.len - 1] = 0;
+
+    answer_t *a = get_answer(name);
+    int ret;
+    if (a->fd < 0) {
+      ret = send_mesg(sock, SYSERV_ERR, 0);
+    } else {
+      ret = send_mesg_fd(sock, a->num_addrs, a->fd);
+      if (ret == 0) {
+        ret = write_all(sock, &a->info, sizeof(a->info));
+      }
+    }
+    put_answer(a);
+    if (ret != 0) break;
+  }
+
+  close(sock);
+
+  pthread_mutex_lock(&lock);
+  num_clients--;
+  last_client = time(NULL);
+  pthread_mutex_unlock(&lock);
+
+  return NULL;
+}
+
+
+//*****************************************************************
+// Server
+//*****************************************************************
+
+uint64_t
+init_node_server(DiscoverFnTy fn_discovery, const char *name)
+{
+  // outlive the job step of the process that launched us, and leave
+  // the errors of writing to departed clients to the return codes
+  setsid();
+  signal(SIGPIPE, SIG_IGN);
+
+  // don't hold open the files of the process that launched us
+#ifdef SYS_close_range
+  syscall(SYS_close_range, 3, ~0U, 0);
+#endif
+
+  long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+  max_workers = ncpus / 2;
+  if (max_workers < 1) max_workers = 1;
+  if (max_workers > MAX_WORKERS) max_workers = MAX_WORKERS;
+
+  long result = sysconf(_SC_PAGESIZE);
+  pagesize = result > 0 ? result : 4096;
+
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  size_t len = strlen(name);
+  if (len + 1 > sizeof(addr.sun_path)) {
+    errx(1, "node server name too long: %s", name);
+  }
+  memcpy(addr.sun_path + 1, name, len);   // abstract namespace
+
+  int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (listener < 0) {
+    err(1, "socket failed");
+  }
+  if (bind(listener, (struct sockaddr *) &addr,
+           offsetof(struct sockaddr_un, sun_path) + 1 + len) != 0) {
+    if (errno == EADDRINUSE) {
+      // another process launched the server for this node first
+      return 0;
+    }
+    err(1, "bind to %s failed", name);
+  }
+  if (listen(listener, SOMAXCONN) != 0) {
+    err(1, "listen failed");
+  }
+
+  // fork the spawner of the workers while we are single-threaded
+  int sv[2];
+  if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) != 0) {
+    err(1, "socketpair failed");
+  }
+  pid_t pid = fork();
+  if (pid < 0) {
+    err(1, "fork failed");
+  }
+  if (pid == 0) {
+    close(listener);
+    close(sv[0]);
+    spawner_main(sv[1]);
+  }
+  close(sv[1]);
+  spawner = sv[0];
+
+  if (verbose) {
+    fprintf(stderr, "FNB2: node server %s started, %d workers\n", name, max_workers);
+  }
+
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+  last_client = time(NULL);
+  for (;;) {
+    struct pollfd pfd = { .fd = listener, .events = POLLIN };
+    int ret = poll(&pfd, 1, 1000);
+    if (ret < 0 && errno != EINTR) {
+      err(1, "poll failed");
+    }
+
+    if (ret <= 0) {
+      pthread_mutex_lock(&lock);
+      int idle = num_clients == 0 && time(NULL) - last_client >= IDLE_SECONDS;
+      pthread_mutex_unlock(&lock);
+      if (idle) break;
+      continue;
+    }
+
+    int sock = accept4(listener, NULL, NULL, SOCK_CLOEXEC);
+    if (sock < 0) {
+      continue;
+    }
+
+    struct ucred cred;
+    socklen_t cred_len = sizeof(cred);
+    if (getsockopt(sock, SOL_SOCKET, SO_PEERCRED, &cred, &cred_len) != 0
+        || cred.uid != getuid()) {
+      close(sock);
+      continue;
+    }
+
+    pthread_mutex_lock(&lock);
+    num_clients++;
+    pthread_mutex_unlock(&lock);
+
+    pthread_t thread;
+    if (pthread_create(&thread, &attr, serve_client, (void *) (intptr_t) sock) != 0) {
+      close(sock);
+      pthread_mutex_lock(&lock);
+      num_clients--;
+      pthread_mutex_unlock(&lock);
+    }
+  }
+
+  if (verbose) {
+    fprintf(stderr, "FNB2: node server %s exits after %d idle seconds\n", name, IDLE_SECONDS);
+  }
+  close(listener);
+
+  // the spawner and the idle workers exit when their sockets close
+  close(spawner);
+  pthread_mutex_lock(&lock);
+  while (num_idle > 0) {
+    close(idle_workers[--num_idle]);
+  }
+  pthread_mutex_unlock(&lock);
+  waitpid(pid, NULL, 0);
+  return 0;
+}
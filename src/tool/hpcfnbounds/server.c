@@ -216,6 +216,31 @@ do_query(DiscoverFnTy fn_discovery, struct syserv_mesg *mesg)
 }
 
 
+// Write the answer to a query for 'name' to fd, as it would be sent
+// over the pipe: either an OK message followed by the addresses and
+// the fnbounds info, or an ERR message. Used by the worker processes
+// of the node server, which answer one query after another.
+void
+write_answer(const char *name, int fd)
+{
+  fdout = fd;
+  inbuf_size = strlen(name) + 1;
+  free(inbuf);
+  inbuf = strdup(name);
+  if (inbuf == NULL) {
+    err(1, "strdup for inbuf failed");
+  }
+
+  char *ret = get_funclist(inbuf);
+  if (ret != NULL) {
+    fprintf(stderr, "\nFNB2: Server failure processing %s: %s\n", inbuf, ret );
+    if (write_mesg(SYSERV_ERR, 0) != SUCCESS) {
+      errx(1, "Server send error message failed");
+    }
+  }
+}
+
+
 
 // Send the list of functions to the client
 void
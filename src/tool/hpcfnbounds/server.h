@@ -52,7 +52,9 @@
 #include "syserv-mesg.h"
 
 uint64_t        init_server(DiscoverFnTy, int, int);
+uint64_t        init_node_server(DiscoverFnTy, const char *);
 void    do_query(DiscoverFnTy , struct syserv_mesg *);
+void    write_answer(const char *, int);
 void  send_funcs();
 
 void    signal_handler_init();
@@ -144,7 +144,8 @@ int main(int argc, char* const argv[]) {
     std::vector<std::unique_ptr<ProfileSource>> my_sources;
     #pragma omp for schedule(dynamic) nowait
     for(std::size_t i = 0; i < args.sources.size(); i++)
-      my_sources.emplace_back(ProfileSource::create_for(args.sources[i].second));
+      my_sources.emplace_back(ProfileSource::create_for(args.sources[i].second.path,
+                                                        args.sources[i].second.index));
     #pragma omp critical
     for(auto& s: my_sources) pipelineB1 << std::move(s);
     ANNOTATE_HAPPENS_BEFORE(&end_arc);
@@ -185,7 +186,8 @@ int main(int argc, char* const argv[]) {
       if(!args.foreign) {
         // Insert the proper Finalizer for drawing data directly from the Modules.
         // This is used as a fallback if the Structfiles aren't available.
-        pipelineB1 << std::make_unique<finalizers::DirectClassification>(args.dwarfMaxSize);
+        pipelineB1 << std::make_unique<finalizers::DirectClassification>(
+            args.dwarfMaxSize, args.cache, args.dwarfThreads);
       }
 
       // Ids for everything are pulled from the void. We call the shots here.
@@ -259,7 +261,8 @@ int main(int argc, char* const argv[]) {
     if(!args.foreign) {
       // Insert the proper Finalizer for drawing data directly from the Modules.
       // This is used as a fallback if the Structfiles aren't available.
-      pipelineB2 << std::make_unique<finalizers::DirectClassification>(args.dwarfMaxSize);
+      pipelineB2 << std::make_unique<finalizers::DirectClassification>(
+          args.dwarfMaxSize, args.cache, args.dwarfThreads);
     }
 
     // For unpacking metrics, we need to be able to map ids back to Contexts and
@@ -275,7 +278,7 @@ int main(int argc, char* const argv[]) {
     // Finally, we get to write stuff out
     switch(args.format) {
     case ProfArgs::Format::metadb:
-      pipelineB2 << std::make_unique<sinks::SparseDB>(args.output);
+      pipelineB2 << std::make_unique<sinks::SparseDB>(args.output, args.compress);
       if(args.include_traces)
         pipelineB2 << std::make_unique<sinks::HPCTraceDB2>(args.output);
       break;
@@ -57,9 +57,11 @@
 #include "lib/profile/mpi/all.hpp"
 
 #include "lib/prof-lean/cpuset_hwthreads.h"
+#include "lib/prof-lean/hpcnode-fmt.h"
 #include "lib/prof-lean/hpcrun-fmt.h"
 
 #include <cassert>
+#include <cstdlib>
 #include <getopt.h>
 #include <iostream>
 #include <iomanip>
@@ -127,13 +129,24 @@ Output Options:
       --no-thread-local       Disable generation of thread-local statistics.
       --no-traces             Disable generation of traces.
       --no-source             Disable embedded source output.
+      --compress              Compress the performance data in the profile.db
+                              and cct.db. Requires readers supporting v4.1.
 
 Processing options:
       --dwarf-max-size=<limit>[<unit>]
                               Specify a limit on the binary size to parse DWARF
                               data from. Units are K,M,G,T (powers of 1024)
                               If limit is "unlimited," always parses DWARF.
-                              Default limit is 100M.
+                              Default limit is 1G.
+      --dwarf-threads=N
+                              Decode the DWARF of each binary with up to N
+                              of the threads given by -j. Default is all of
+                              them; 1 decodes it serially.
+      --cache=<dir>
+                              Cache the analysis of binaries in <dir>, keyed
+                              by a hash of their contents, and reuse it in
+                              later runs. Defaults to the value of the
+                              HPCTOOLKIT_HPCPROF_CACHE environment variable.
       --foreign
                               Process the measurements as if they came from a
                               "foreign" system with a different filesystem than
@@ -164,9 +177,12 @@ const bool string_starts_with(const std::string& a, const std::string& n) {
 ProfArgs::ProfArgs(int argc, char* const argv[])
   : title(), threads(0), output(),
     include_sources(true), include_traces(true), include_thread_local(true),
-    format(Format::metadb), dwarfMaxSize(100*1024*1024), valgrindUnclean(false) {
+    compress(false), format(Format::metadb), dwarfMaxSize(1024*1024*1024),
+    dwarfThreads(0),
+    valgrindUnclean(false) {
   int arg_includeSources = include_sources;
   int arg_includeTraces = include_traces;
+  int arg_compress = compress;
   int arg_overwriteOutput = 0;
   int arg_valgrindUnclean = valgrindUnclean;
   int arg_foreign = 0;
@@ -176,6 +192,8 @@ ProfArgs::ProfArgs(int argc, char* const argv[])
     {"no-thread-local", no_argument, NULL, 0},
     {"dwarf-max-size", required_argument, NULL, 0},
     {"only-exe", required_argument, NULL, 0},
+    {"cache", required_argument, NULL, 0},
+    {"dwarf-threads", required_argument, NULL, 0},
     // The rest can be in any order
     {"version", no_argument, NULL, 'V'},
     {"help", no_argument, NULL, 'h'},
@@ -187,6 +205,7 @@ ProfArgs::ProfArgs(int argc, char* const argv[])
     {"format", required_argument, NULL, 'f'},
     {"no-traces", no_argument, &arg_includeTraces, 0},
     {"no-source", no_argument, &arg_includeSources, 0},
+    {"compress", no_argument, &arg_compress, 1},
     {"name", required_argument, NULL, 'n'},
     {"force", no_argument, &arg_overwriteOutput, 1},
     {"valgrind-unclean", no_argument, &arg_valgrindUnclean, 1},
@@ -399,6 +418,20 @@ ProfArgs::ProfArgs(int argc, char* const argv[])
       case 3:  // --only-exe
         only_exes.emplace(optarg);
         break;
+      case 4:  // --cache
+        cache = optarg;
+        break;
+      case 5: {  // --dwarf-threads
+        std::size_t pos = 0;
+        int in_threads = std::stoi(optarg, &pos, 10);
+        if(pos == 0 || optarg[pos] != '\0' || in_threads < 1) {
+          std::cerr << "Error: invalid argument for --dwarf-threads: `"
+                    << optarg << "'\n";
+          std::exit(2);
+        }
+        dwarfThreads = in_threads;
+        break;
+      }
       }
       break;
     default:
@@ -410,6 +443,11 @@ ProfArgs::ProfArgs(int argc, char* const argv[])
 
   include_sources = arg_includeSources;
   include_traces = arg_includeTraces;
+  compress = arg_compress;
+  if(cache.empty()) {
+    if(const char* env = std::getenv("HPCTOOLKIT_HPCPROF_CACHE"))
+      cache = env;
+  }
   valgrindUnclean = arg_valgrindUnclean;
   foreign = arg_foreign;
 
@@ -603,6 +641,7 @@ ProfArgs::ProfArgs(int argc, char* const argv[])
 
     std::mutex sources_lock;
     const fs::path profileext = std::string(".")+HPCRUN_ProfileFnmSfx;
+    const fs::path nodeext = std::string(".")+HPCNODE_FnmSfx;
 
     ANNOTATE_HAPPENS_BEFORE(&start_arc);
     #pragma omp parallel num_threads(threads)
@@ -612,17 +651,20 @@ ProfArgs::ProfArgs(int argc, char* const argv[])
       #pragma omp for schedule(dynamic) nowait
       for(std::size_t i = 0; i < files.size(); i++) {
         auto pg = std::move(files[i]);
-        auto s = ProfileSource::create_for(pg.first);
-        if(!only_exes.empty()) {
-          if(auto* r4 = dynamic_cast<hpctoolkit::sources::Hpcrun4*>(s.get()); r4 != nullptr) {
-            if(only_exes.count(r4->exe_basename()) == 0)
-              continue;
+        auto ss = ProfileSource::create_all_for(pg.first);
+        for(std::size_t idx = 0; idx < ss.size(); idx++) {
+          auto& s = ss[idx];
+          if(!only_exes.empty()) {
+            if(auto* r4 = dynamic_cast<hpctoolkit::sources::Hpcrun4*>(s.get()); r4 != nullptr) {
+              if(only_exes.count(r4->exe_basename()) == 0)
+                continue;
+            }
           }
-        }
-        if(s) {
-          my_sources.emplace_back(std::move(s), std::move(pg.first));
+          my_sources.emplace_back(std::move(s), Input{pg.first, idx});
           cnts_a[pg.second].fetch_add(1, std::memory_order_relaxed);
-        } else if(pg.first.extension() == profileext) {
+        }
+        if(ss.empty() && (pg.first.extension() == profileext
+                          || pg.first.extension() == nodeext)) {
           util::log::warning{} << pg.first.string() <<
             " does not contain a valid measurement profile";
         }
@@ -665,7 +707,9 @@ ProfArgs::ProfArgs(int argc, char* const argv[])
   if(sources.size() > 0) {
     for(std::size_t i = sources.size()-1; i > limit; i--) {
       assert(i == sources.size()-1);
-      extra.emplace_back(std::move(sources.back().second).string());
+      // Ship which profile in the file along with the path, as "index:path"
+      const auto& in = sources.back().second;
+      extra.emplace_back(std::to_string(in.index) + ':' + in.path.string());
       sources.pop_back();
     }
   }
@@ -707,10 +751,11 @@ ProfArgs::ProfArgs(int argc, char* const argv[])
 
   // Add the inputs newly allocated to us to our set
   for(auto& p_s: extra) {
-    stdshim::filesystem::path p = std::move(p_s);
-    auto s = ProfileSource::create_for(p);
-    if(!s) util::log::fatal{} << "Input " << p << " has changed on disk, please let it stabilize before continuing!";
-    sources.emplace_back(std::move(s), std::move(p));
+    auto colon = p_s.find(':');
+    Input in{p_s.substr(colon + 1), std::stoul(p_s.substr(0, colon))};
+    auto s = ProfileSource::create_for(in.path, in.index);
+    if(!s) util::log::fatal{} << "Input " << in.path << " has changed on disk, please let it stabilize before continuing!";
+    sources.emplace_back(std::move(s), std::move(in));
   }
 }
 
@@ -62,8 +62,15 @@ public:
   ProfArgs(int, char* const*);
   ~ProfArgs() = default;
 
-  /// Sources and corrosponding paths specified as arguments.
-  std::vector<std::pair<std::unique_ptr<ProfileSource>, stdshim::filesystem::path>> sources;
+  /// A profile specified as an argument: the file it was read from, and
+  /// which of the profiles in that file it is.
+  struct Input {
+    stdshim::filesystem::path path;
+    std::size_t index;
+  };
+
+  /// Sources and corrosponding inputs specified as arguments.
+  std::vector<std::pair<std::unique_ptr<ProfileSource>, Input>> sources;
 
   /// KernelSymbols Finalizers from properly named measurements directories
   std::vector<std::pair<std::unique_ptr<ProfileFinalizer>, stdshim::filesystem::path>> ksyms;
@@ -157,6 +164,9 @@ public:
   /// Whether to include thread-local data in the output database
   bool include_thread_local;
 
+  /// Whether to compress the performance data in the output database
+  bool compress;
+
   /// Enum for possible output formats for profile data
   enum class Format {
     /// *.db + metrics.yaml, the current database format
@@ -168,6 +178,12 @@ public:
   /// Maximum size (in bytes) to use DWARF parsing for.
   uintmax_t dwarfMaxSize;
 
+  /// Number of threads to decode the DWARF of each binary with, 0 for all.
+  unsigned int dwarfThreads;
+
+  /// Directory to cache the analysis of binaries in, empty to disable.
+  stdshim::filesystem::path cache;
+
   /// Whether to enable "Valgrind-unclean" mode, which disables some deallocations.
   bool valgrindUnclean;
 
@@ -95,13 +95,14 @@ int main(int argc, char* const argv[]) {
   if(!args.foreign) {
     // Insert the proper Finalizer for drawing data directly from the Modules.
     // This is used as a fallback if the Structfiles aren't available.
-    pipelineB << std::make_unique<finalizers::DirectClassification>(args.dwarfMaxSize);
+    pipelineB << std::make_unique<finalizers::DirectClassification>(
+        args.dwarfMaxSize, args.cache, args.dwarfThreads);
   }
 
   switch(args.format) {
   case ProfArgs::Format::metadb: {
     pipelineB << std::make_unique<sinks::MetaDB>(args.output, args.include_sources)
-              << std::make_unique<sinks::SparseDB>(args.output)
+              << std::make_unique<sinks::SparseDB>(args.output, args.compress)
               << std::make_unique<sinks::MetricsYAML>(args.output);
     if(args.include_traces)
       pipelineB << std::make_unique<sinks::HPCTraceDB2>(args.output);
@@ -62,6 +62,7 @@
 #include "Args.hpp"
 
 #include <lib/profile/stdshim/filesystem.hpp>
+#include <lib/prof-lean/hpcnode-fmt.h>
 #include <lib/prof-lean/hpcrun-fmt.h>
 #include <lib/support/diagnostics.h>
 
@@ -125,14 +126,24 @@ getLoadModuleName(loadmap_entry_t* x)
 }
 
 
+// A file may hold the profiles of all threads of a process. The last one
+// was written last, so its loadmap covers all the others.
 static bool
-readFooter(FILE* fs, hpcrun_fmt_footer_t &footer)
+readFooter(FILE* fs, size_t end_position, hpcrun_fmt_footer_t &footer)
 {
-  fseek(fs, 0, SEEK_END);
-  size_t footer_position = ftell(fs) - SF_footer_SIZE;
+  size_t start_position;
+  if (hpcrun_sparse_segment_start(fs, end_position, &start_position) != SF_SUCCEED) {
+    return false;
+  }
+
+  size_t footer_position = end_position - SF_footer_SIZE;
   fseek(fs, footer_position, SEEK_SET);
+  if (hpcrun_fmt_footer_fread(&footer, fs) != HPCFMT_OK) {
+    return false;
+  }
+  hpcrun_sparse_footer_update_w_start(&footer, start_position);
 
-  return hpcrun_fmt_footer_fread(&footer, fs) == HPCFMT_OK;
+  return true;
 }
 
 
@@ -167,9 +178,22 @@ processProfile(const std::filesystem::path &path, std::unordered_set<std::string
    FILE* fs = hpcio_fopen_r(fnm);
    if (fs) {
     hpcrun_fmt_footer_t footer;
-    bool status = readFooter(fs, footer);
+    fseek(fs, 0, SEEK_END);
+    size_t end_position = ftell(fs);
+    bool status = readFooter(fs, end_position, footer);
     if (status) {
       status = readLoadmap(fs, footer, loadModules);
+    } else {
+      // an interrupted append leaves no footer at the end of the file, so
+      // take the loadmaps of all the complete profiles before it
+      size_t pos = 0, start_position, seg_end;
+      while (hpcrun_sparse_segment_next(fs, pos, end_position,
+                                        &start_position, &seg_end) == SF_SUCCEED) {
+        status = readFooter(fs, seg_end, footer)
+          && readLoadmap(fs, footer, loadModules);
+        if (!status) break;
+        pos = seg_end;
+      }
     }
     DIAG_WMsgIf(status == false, "unable to extract loadmap from profile " << filename);
     fclose(fs);
@@ -177,6 +201,32 @@ processProfile(const std::filesystem::path &path, std::unordered_set<std::string
 }
 
 
+// A node container holds the files of all processes on one node, each
+// profile with a loadmap of its own.
+static void
+processNodeContainer(const std::filesystem::path &path, std::unordered_set<std::string> &loadModules)
+{
+  std::string filename = path;
+  const char *fnm = filename.c_str();
+
+  FILE* fs = hpcio_fopen_r(fnm);
+  if (fs) {
+    hpcnode_fmt_index_t index;
+    bool status = hpcnode_fmt_index_fread(&index, fs, malloc) == HPCFMT_OK;
+    for (uint64_t i = 0; status && i < index.len; i++) {
+      const hpcnode_fmt_entry_t &e = index.lst[i];
+      if (std::filesystem::path(e.name).extension() != ".hpcrun") continue;
+      hpcrun_fmt_footer_t footer;
+      status = readFooter(fs, e.offset + e.size, footer)
+        && readLoadmap(fs, footer, loadModules);
+    }
+    hpcnode_fmt_index_free(&index, free);
+    DIAG_WMsgIf(status == false, "unable to extract loadmaps from node container " << filename);
+    fclose(fs);
+  }
+}
+
+
 static int
 processMeasurementsDirectory(Args &args)
 {
@@ -190,7 +240,8 @@ processMeasurementsDirectory(Args &args)
   } else {
     std::vector<std::filesystem::path> hpcrunFiles;
     for (auto const& dir_entry : std::filesystem::directory_iterator(path)) {
-      if (dir_entry.path().extension() == ".hpcrun") {
+      if (dir_entry.path().extension() == ".hpcrun"
+          || dir_entry.path().extension() == ".hpcnode") {
         hpcrunFiles.push_back(dir_entry.path());
       }
     }
@@ -204,7 +255,11 @@ processMeasurementsDirectory(Args &args)
         std::unordered_set<std::string> privateLoadModules;
         #pragma omp for
         for (size_t i = 0; i < hpcrunFiles.size(); i++) {
-          processProfile(hpcrunFiles[i], privateLoadModules);
+          if (hpcrunFiles[i].extension() == ".hpcnode") {
+            processNodeContainer(hpcrunFiles[i], privateLoadModules);
+          } else {
+            processProfile(hpcrunFiles[i], privateLoadModules);
+          }
         }
         #pragma omp critical
         loadModules.merge(std::move(privateLoadModules));
@@ -0,0 +1,291 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2023, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+#include "lib/profile/query/database.hpp"
+
+#include "lib/prof-lean/formats/metadb.h"
+
+#include "include/hpctoolkit-config.h"
+#include "include/hpctoolkit-version.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <getopt.h>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace hpctoolkit;
+using query::Database;
+namespace fs = stdshim::filesystem;
+
+static const std::string summary =
+"[options]... <database> <command> [args]...";
+static const std::string header = R"EOF(
+Answer queries about a database generated by `hpcprof', without loading the
+whole database into memory. Output is tab-separated for use in scripts.
+)EOF";
+
+static const std::string commands = R"EOF(
+Commands:
+  info                        Print an overview of the database.
+  metrics                     List the metrics (propMetricIds) and summary
+                              statistics (statMetricIds) in the database.
+  profiles                    List the profiles and their identifier tuples.
+  context CTX...              Print the label and calling context of CTX.
+  values PROF CTX...          Print the metric values recorded for each CTX
+                              in profile PROF.
+  context-values CTX METRIC   Print the values of METRIC for CTX in every
+                              profile.
+  top STAT [N]                Print the N contexts (default 10) with the
+                              largest value of STAT in the summary profile.
+  trace PROF START END        Print the trace of profile PROF between the
+                              timestamps START (inclusive) and END (exclusive),
+                              in nanoseconds.
+
+METRIC may be given as a propMetricId or as NAME[:SCOPE], and STAT as a
+statMetricId or NAME[:SCOPE] to select the sum over all threads. SCOPE defaults
+to `execution', ie. inclusive metric values.
+)EOF";
+
+static const std::string options = R"EOF(
+Options:
+  -h, --help                  Display this help and exit.
+  -V, --version               Print version information and exit.
+  -p, --paths                 Print the full calling context of each context
+                              listed by `top', rather than only its label.
+)EOF";
+
+[[noreturn]] static void usage(const char* argv0, const std::string& msg) {
+  std::cerr << fs::path(argv0).filename().string() << ": " << msg << "\n"
+               "Try `" << fs::path(argv0).filename().string() << " --help' for more information.\n";
+  std::exit(2);
+}
+
+static std::uint64_t parseUInt(const char* argv0, const std::string& s, std::uint64_t max) {
+  std::size_t pos = 0;
+  unsigned long long v = 0;
+  try {
+    v = std::stoull(s, &pos, 0);
+  } catch(std::exception&) {
+    pos = 0;
+  }
+  if(pos == 0 || pos != s.size() || v > max)
+    usage(argv0, "invalid number '" + s + "'");
+  return v;
+}
+
+static bool isNumber(const std::string& s) {
+  return !s.empty() && std::all_of(s.begin(), s.end(), [](char c){ return c >= '0' && c <= '9'; });
+}
+
+static std::pair<std::string, std::string> splitScope(const std::string& s) {
+  const auto colon = s.rfind(':');
+  if(colon == std::string::npos) return {s, "execution"};
+  return {s.substr(0, colon), s.substr(colon + 1)};
+}
+
+static std::uint16_t findMetric(const char* argv0, const Database& db, const std::string& s) {
+  if(isNumber(s)) return parseUInt(argv0, s, UINT16_MAX);
+  const auto [name, scope] = splitScope(s);
+  for(const auto& m : db.metrics())
+    if(m.name == name && m.scope == scope) return m.id;
+  usage(argv0, "no metric '" + name + "' with scope '" + scope + "'");
+}
+
+static std::uint16_t findStatistic(const char* argv0, const Database& db, const std::string& s) {
+  if(isNumber(s)) return parseUInt(argv0, s, UINT16_MAX);
+  const auto [name, scope] = splitScope(s);
+  for(const auto& st : db.statistics())
+    if(st.name == name && st.scope == scope && st.combine == FMT_METADB_COMBINE_Sum
+       && st.formula == "$$")
+      return st.id;
+  usage(argv0, "no summed statistic for '" + name + "' with scope '" + scope + "'");
+}
+
+static std::string path(const Database& db, std::uint32_t ctx) {
+  std::vector<std::uint32_t> ctxs;
+  for(std::optional<std::uint32_t> c = ctx; c && *c != 0; c = db.parent(*c))
+    ctxs.push_back(*c);
+  std::string out;
+  for(auto it = ctxs.rbegin(); it != ctxs.rend(); ++it) {
+    if(!out.empty()) out += " > ";
+    out += db.label(*it);
+  }
+  return out.empty() ? db.label(ctx) : out;
+}
+
+static std::uint32_t checkContext(const char* argv0, const Database& db, const std::string& s) {
+  const std::uint32_t ctx = parseUInt(argv0, s, UINT32_MAX);
+  if(!db.hasContext(ctx)) usage(argv0, "no context with identifier " + s);
+  return ctx;
+}
+
+static std::uint32_t checkProfile(const char* argv0, const Database& db, const std::string& s) {
+  const std::uint32_t prof = parseUInt(argv0, s, UINT32_MAX);
+  if(prof >= db.profiles().size()) usage(argv0, "no profile with index " + s);
+  return prof;
+}
+
+int main(int argc, char* const argv[]) {
+  bool showPaths = false;
+  struct option longopts[] = {
+    {"help", no_argument, NULL, 'h'},
+    {"version", no_argument, NULL, 'V'},
+    {"paths", no_argument, NULL, 'p'},
+    {0, 0, 0, 0}
+  };
+  int opt;
+  // NOTE: The leading + stops at the first non-option, the command arguments
+  // are never parsed as options.
+  while((opt = getopt_long(argc, argv, "+hVp", longopts, NULL)) >= 0) {
+    switch(opt) {
+    case 'h':
+      std::cout << "Usage: " << fs::path(argv[0]).filename().string()
+                             << " " << summary  // header begins with a '\n'
+                << header << commands << options;
+      return 0;
+    case 'V': {
+      std::string prog = fs::path(argv[0]).filename().string();
+      hpctoolkit_print_version(prog.c_str());
+      return 0;
+    }
+    case 'p':
+      showPaths = true;
+      break;
+    default:
+      usage(argv[0], "invalid option");
+    }
+  }
+  if(argc - optind < 2) usage(argv[0], "expected a database and a command");
+  const fs::path dbpath = argv[optind];
+  const std::string cmd = argv[optind + 1];
+  const std::vector<std::string> args(argv + optind + 2, argv + argc);
+  const auto nargs = [&](std::size_t min, std::size_t max) {
+    if(args.size() < min || args.size() > max)
+      usage(argv[0], "wrong number of arguments for '" + cmd + "'");
+  };
+
+  std::cout << std::setprecision(std::numeric_limits<double>::max_digits10);
+  try {
+    Database db(dbpath);
+
+    if(cmd == "info") {
+      nargs(0, 0);
+      std::cout << "title\t" << db.title() << "\n"
+                   "metrics\t" << db.metrics().size() << "\n"
+                   "statistics\t" << db.statistics().size() << "\n"
+                   "profiles\t" << db.profiles().size() << "\n"
+                   "contexts\t" << db.contextCount() << "\n";
+      if(db.hasTraces()) {
+        const auto [lo, hi] = db.traceRange();
+        std::cout << "traces\t" << lo << "\t" << hi << "\n";
+      }
+    } else if(cmd == "metrics") {
+      nargs(0, 0);
+      for(const auto& m : db.metrics())
+        std::cout << "metric\t" << m.id << "\t" << m.name << "\t" << m.scope << "\n";
+      static const char* combines[] = {"sum", "min", "max"};
+      for(const auto& s : db.statistics())
+        std::cout << "stat\t" << s.id << "\t" << s.name << "\t" << s.scope << "\t"
+                  << (s.combine < 3 ? combines[s.combine] : "?") << "\t" << s.formula << "\n";
+    } else if(cmd == "profiles") {
+      nargs(0, 0);
+      const auto& profs = db.profiles();
+      for(std::size_t i = 0; i < profs.size(); i++)
+        std::cout << i << "\t" << (profs[i].isSummary ? "summary" : "thread")
+                  << "\t" << profs[i].idTuple << "\n";
+    } else if(cmd == "context") {
+      nargs(1, std::numeric_limits<std::size_t>::max());
+      for(const auto& a : args) {
+        const auto ctx = checkContext(argv[0], db, a);
+        const auto parent = db.parent(ctx);
+        std::cout << ctx << "\t" << (parent ? std::to_string(*parent) : "-") << "\t"
+                  << db.label(ctx) << "\t" << path(db, ctx) << "\n";
+      }
+    } else if(cmd == "values") {
+      nargs(2, std::numeric_limits<std::size_t>::max());
+      const auto prof = checkProfile(argv[0], db, args[0]);
+      for(std::size_t i = 1; i < args.size(); i++) {
+        const auto ctx = checkContext(argv[0], db, args[i]);
+        for(const auto& [metric, value] : db.profileValues(prof, ctx))
+          std::cout << ctx << "\t" << metric << "\t" << value << "\n";
+      }
+    } else if(cmd == "context-values") {
+      nargs(2, 2);
+      const auto ctx = checkContext(argv[0], db, args[0]);
+      const auto metric = findMetric(argv[0], db, args[1]);
+      for(const auto& [prof, value] : db.contextValues(ctx, metric))
+        std::cout << prof << "\t" << value << "\n";
+    } else if(cmd == "top") {
+      nargs(1, 2);
+      const auto stat = findStatistic(argv[0], db, args[0]);
+      const std::size_t n = args.size() > 1
+          ? parseUInt(argv[0], args[1], std::numeric_limits<std::size_t>::max()) : 10;
+      for(const auto& [ctx, value] : db.topContexts(stat, n))
+        std::cout << ctx << "\t" << value << "\t"
+                  << (showPaths ? path(db, ctx) : db.label(ctx)) << "\n";
+    } else if(cmd == "trace") {
+      nargs(3, 3);
+      const auto prof = checkProfile(argv[0], db, args[0]);
+      const auto start = parseUInt(argv[0], args[1], UINT64_MAX);
+      const auto end = parseUInt(argv[0], args[2], UINT64_MAX);
+      if(!db.hasTraces()) throw std::runtime_error("Database does not contain traces");
+      for(const auto& s : db.traceWindow(prof, start, end))
+        std::cout << s.timestamp << "\t" << s.ctx << "\n";
+    } else {
+      usage(argv[0], "unknown command '" + cmd + "'");
+    }
+  } catch(std::exception& e) {
+    std::cerr << fs::path(argv[0]).filename().string() << ": " << dbpath.string()
+              << ": " << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
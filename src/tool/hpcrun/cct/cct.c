@@ -132,6 +132,11 @@ struct cct_node_t {
   struct cct_node_t* left;
   struct cct_node_t* right;
 
+  // ---------------------------------------------------------
+  // metrics attributed to this node, allocated on first use
+  // ---------------------------------------------------------
+  metric_data_list_t* metrics;
+
 };
 
 #if 0
@@ -168,8 +173,11 @@ cct_node_create(cct_addr_t* addr, bool unwound, cct_node_t* parent)
 
   // FIXME: when multiple epochs really work, this will always be freeable.
   // WARN ME (krentel) if/when we really use freeable memory.
+  // The nodes are reclaimed with the memstore when an epoch is flushed,
+  // see hpcrun_reclaim_freeable_mem(), not returned one by one to the
+  // freeable heap, so they come from the memstore either way.
   if (ENABLED(FREEABLE)) {
-    node = hpcrun_malloc_freeable(sz);
+    node = hpcrun_malloc(sz);
   }
   else {
 //    node = hpcrun_malloc(sz);
@@ -258,7 +266,6 @@ typedef struct {
   size_t n;
 
   //YUMENG: help count number of non-zero values for each cct
-  cct2metrics_t* cct2metrics_map;
   uint64_t num_nzval;
   uint32_t num_nz_cct_nodes;
 } count_arg_t;
@@ -271,9 +278,7 @@ l_count_mark(cct_node_t* n, cct_op_arg_t arg, size_t level)
     return;
   }
 
-  metric_data_list_t *data_list =
-    hpcrun_get_metric_data_list_specific(&(count_arg->cct2metrics_map), n);
-  uint64_t num_nzval = hpcrun_metric_sparse_count(data_list);
+  uint64_t num_nzval = hpcrun_metric_sparse_count(n->metrics);
 
   // decide if we display the node in cct section of hpcrun file or not
   if(num_nzval || hpcrun_cct_retained(n)){
@@ -306,7 +311,6 @@ typedef struct {
   FILE* fs;
   epoch_flags_t flags;
   hpcrun_fmt_cct_node_t* tmp_node;
-  cct2metrics_t* cct2metrics_map;
 
   //YUMENG: get metric values while walking through cct
   hpcrun_fmt_sparse_metrics_t* sparse_metrics;
@@ -324,19 +328,15 @@ collapse_dummy_node(cct_node_t *node, cct_op_arg_t arg, size_t level)
     return;
   }
 
-  // get thread specific map
-  write_arg_t *write_arg = (write_arg_t *)arg;
-  cct2metrics_t **map = &(write_arg->cct2metrics_map);
-
   // merge dummy child metrics
   cct_node_t* parent = hpcrun_cct_parent(node);
-  metric_data_list_t *node_metrics = hpcrun_get_metric_data_list_specific(map, node);
-  if (node_metrics != NULL) {
-    metric_data_list_t *parent_metrics = hpcrun_get_metric_data_list_specific(map, parent);
+  metric_data_list_t *node_metrics = node->metrics;
+  if (node_metrics != NULL && parent != NULL) {
+    metric_data_list_t *parent_metrics = parent->metrics;
     if (parent_metrics != NULL) {
       hpcrun_merge_cct_metrics(parent_metrics, node_metrics);
     } else {
-      hpcrun_move_metric_data_list_specific(map, parent, node);
+      hpcrun_move_metric_data_list(parent, node);
     }
   }
 }
@@ -399,8 +399,7 @@ lwrite(cct_node_t* node, cct_op_arg_t arg, size_t level)
   // double casts to avoid warnings when pointer is < 64 bits
   tmp->lm_ip = (hpcfmt_vma_t) (uintptr_t) (addr->ip_norm).lm_ip;
 
-  metric_data_list_t *data_list =
-    hpcrun_get_metric_data_list_specific(&(my_arg->cct2metrics_map), node);
+  metric_data_list_t *data_list = node->metrics;
 
   //set_sparse_copy: copy the values into sparse_metrics
   uint64_t curr_cct_node_idx = sparse_metrics->cur_cct_node_idx;
@@ -756,6 +755,20 @@ hpcrun_cct_retained(cct_node_t* x)
   return (x->persistent_id & HPCRUN_FMT_RetainIdFlag);
 }
 
+
+metric_data_list_t*
+hpcrun_cct_metrics(cct_node_t* x)
+{
+  return x->metrics;
+}
+
+
+void
+hpcrun_cct_metrics_set(cct_node_t* x, metric_data_list_t* metrics)
+{
+  x->metrics = metrics;
+}
+
 //
 // Walking functions section:
 //
@@ -845,11 +858,11 @@ hpcrun_cct_insert_path(cct_node_t ** root, cct_node_t* path)
 
 #if 0
 int
-hpcrun_cct_fwrite(cct2metrics_t* cct2metrics_map, cct_node_t* cct, FILE* fs, epoch_flags_t flags)
+hpcrun_cct_fwrite(cct_node_t* cct, FILE* fs, epoch_flags_t flags)
 #else
 //YUMENG: add sparse_metrics to collect metric values
 int
-hpcrun_cct_fwrite(cct2metrics_t* cct2metrics_map, cct_node_t* cct, FILE* fs, epoch_flags_t flags, hpcrun_fmt_sparse_metrics_t* sparse_metrics)
+hpcrun_cct_fwrite(cct_node_t* cct, FILE* fs, epoch_flags_t flags, hpcrun_fmt_sparse_metrics_t* sparse_metrics)
 #endif
 {
   if (!fs) return HPCRUN_ERR;
@@ -859,9 +872,9 @@ hpcrun_cct_fwrite(cct2metrics_t* cct2metrics_map, cct_node_t* cct, FILE* fs, epo
   uint64_t num_nzval = 0;
   uint32_t num_nz_cct_nodes = 0;
   if (HPCRUN_CCT_KEEP_DUMMY) {
-    nodes = hpcrun_cct_num_nz_nodes_and_mark_display(cct, true, &cct2metrics_map, &num_nzval, &num_nz_cct_nodes);
+    nodes = hpcrun_cct_num_nz_nodes_and_mark_display(cct, true, &num_nzval, &num_nz_cct_nodes);
   } else {
-    nodes = hpcrun_cct_num_nz_nodes_and_mark_display(cct, false, &cct2metrics_map, &num_nzval, &num_nz_cct_nodes);
+    nodes = hpcrun_cct_num_nz_nodes_and_mark_display(cct, false, &num_nzval, &num_nz_cct_nodes);
   }
   sparse_metrics->num_cct_nodes = nodes;
 
@@ -889,10 +902,6 @@ hpcrun_cct_fwrite(cct2metrics_t* cct2metrics_map, cct_node_t* cct, FILE* fs, epo
     .flags       = flags,
     .tmp_node    = &tmp_node,
 
-    // multithreaded code: add personalized cct2metrics_map for multithreading programs
-    // this is to allow a thread to write the profile data of another thread.
-    .cct2metrics_map = cct2metrics_map,
-
     //YUMENG: collect metric values and info while walking through the cct
     .sparse_metrics = sparse_metrics
   };
@@ -948,17 +957,15 @@ void hpcrun_cct_fwrite_errmsg_w_fn(FILE* fs, uint32_t tid, char* msg)
 // Utilities
 //
 size_t
-hpcrun_cct_num_nz_nodes_and_mark_display(cct_node_t* cct, bool count_dummy, cct2metrics_t **cct2metrics_map,uint64_t* num_nzval, uint32_t* num_nz_cct_nodes)
+hpcrun_cct_num_nz_nodes_and_mark_display(cct_node_t* cct, bool count_dummy, uint64_t* num_nzval, uint32_t* num_nz_cct_nodes)
 {
   count_arg_t count_arg = {
     .count_dummy = count_dummy,
     .n = 0,
-    .cct2metrics_map = *cct2metrics_map,
     .num_nzval = *num_nzval,
     .num_nz_cct_nodes = *num_nz_cct_nodes
   };
   hpcrun_cct_walk_child_1st(cct, l_count_mark, &count_arg);
-  *cct2metrics_map = count_arg.cct2metrics_map;
   *num_nzval = count_arg.num_nzval;
   *num_nz_cct_nodes = count_arg.num_nz_cct_nodes;
   return count_arg.n;
@@ -1032,21 +1039,15 @@ hpcrun_cct_walkset_merge(cct_node_t* cct, cct_op_merge_t fn, cct_op_arg_t arg)
 
 
 //
-// Helpers & datatypes for cct_merge operation
+// Helpers for cct_merge operation
+//
+// Rather than splaying every node of CCT_B into the children of CCT_A, both
+// sets of siblings are flattened into sorted lists, merged like in a merge
+// sort, and the result is rebuilt as a balanced splay tree. Subtrees present
+// only in CCT_B are moved over in bulk. Merging a node with k_a and k_b
+// children is O(k_a + k_b), with no extra memory and no splay writes.
 //
-//static void merge_or_join(cct_node_t* n, cct_op_arg_t a, size_t l);
-static cct_node_t* merge_or_join(cct_node_t* n, cct_op_arg_t a, size_t l);
-
-static cct_node_t* cct_child_find_cache(cct_node_t* cct, cct_addr_t* addr);
-static void cct_disjoint_union_cached(cct_node_t* target, cct_node_t* src);
-
-typedef struct {
-  cct_node_t* targ;
-  merge_op_t fn;
-  merge_op_arg_t arg;
-} mjarg_t;
 
-// always returns NULL which indicated that node should be disconnected from old tree
 static void
 attach_to_a(cct_node_t* node, cct_op_arg_t arg, size_t l)
 {
@@ -1054,6 +1055,51 @@ attach_to_a(cct_node_t* node, cct_op_arg_t arg, size_t l)
   node->parent = targ;
 }
 
+//
+// Flatten the splay tree of siblings rooted at cct into a list sorted by
+// address, linked through the right pointers (left pointers are cleared).
+// Uses right rotations (the "tree to vine" step of Day-Stout-Warren),
+// so no stack is needed. The number of nodes is returned in *n.
+//
+static cct_node_t*
+siblings_to_list(cct_node_t* cct, size_t* n)
+{
+  cct_node_t* head = NULL;
+  cct_node_t** tail = &head;
+  *n = 0;
+  while (cct) {
+    if (cct->left) {
+      cct_node_t* l = cct->left;
+      cct->left = l->right;
+      l->right = cct;
+      cct = l;
+    }
+    else {
+      *tail = cct;
+      tail = &(cct->right);
+      cct = cct->right;
+      (*n)++;
+    }
+  }
+  return head;
+}
+
+//
+// Rebuild a balanced splay tree from the first n nodes of a sorted list
+// linked through the right pointers. *list is advanced past the used nodes.
+//
+static cct_node_t*
+list_to_siblings(cct_node_t** list, size_t n)
+{
+  if (n == 0) return NULL;
+  cct_node_t* left = list_to_siblings(list, n / 2);
+  cct_node_t* root = *list;
+  *list = root->right;
+  root->left = left;
+  root->right = list_to_siblings(list, n - n / 2 - 1);
+  return root;
+}
+
 //
 // The merging operation main code
 //
@@ -1068,6 +1114,7 @@ hpcrun_cct_merge(cct_node_t* cct_a, cct_node_t* cct_b,
     // nothing to clean, because cct_b is leaf
     merge(cct_a, cct_b, arg);
   }
+  if (! cct_b->children) return;
   if (! cct_a->children){
       // FIXME: vi3 bug because cct_b->children has the same addr as cct_a
     cct_a->children = cct_b->children;
@@ -1075,98 +1122,51 @@ hpcrun_cct_merge(cct_node_t* cct_a, cct_node_t* cct_b,
     // enough to disconnect children from cct_b (that's why hpcrun_cct_walkset is called)
     hpcrun_cct_walkset(cct_b, attach_to_a, (cct_op_arg_t) cct_a);
     cct_b->children = NULL;
-  }
-  else {
-    mjarg_t local = (mjarg_t) {.targ = cct_a, .fn = merge, .arg = arg};
-    hpcrun_cct_walkset_merge(cct_b, merge_or_join, (cct_op_arg_t) &local);
-  }
-}
-
-//
-// merge helper functions (forward declared above)
-//
-// if function cct_disjoint_union_cached is called, that means n should be removed from cct_b tree,
-// which is indicated by NULL as a return value
-// if hpcrun_cct_merge is called, that means that node n should stay in the cct_b tree
-// which is indicated by n as a return value (not NULL value)
-static cct_node_t*
-merge_or_join(cct_node_t* n, cct_op_arg_t a, size_t l)
-{
-  mjarg_t* the_arg = (mjarg_t*) a;
-  cct_node_t* targ = the_arg->targ;
-  cct_node_t* tmp = NULL;
-  if ((tmp = cct_child_find_cache(targ, hpcrun_cct_addr(n)))){
-    // when merge, n should stay in the same tree, because the whole tree is going to to freelist
-    // that is the reason why return value is not NULL
-    hpcrun_cct_merge(tmp, n, the_arg->fn, the_arg->arg);
-    return n;
-  }
-  else{
-    // disjoint has to happen, which means that node n is going to change tree
-    // if it has left and right siblings, they are going to bee added to freelist
-    // and the return value is NULL (indicates that n is goint to be disconnected from previous cct_b tree)
-
-    // add left to freelist, if needed
-    hpcrun_cct_node_free(n->left);
-    // add right to freelist, if needed
-    hpcrun_cct_node_free(n->right);
-
-    cct_disjoint_union_cached(targ, n);
-    return NULL;
-  }
-
-}
-
-//
-// Differs from the main accessor by setting the splay cache as a side
-// effect
-//
-static cct_node_t*
-cct_child_find_cache(cct_node_t* cct, cct_addr_t* addr)
-{
-  return hpcrun_cct_find_addr(cct, addr);
-}
-
-//
-// This procedure assumes that cct_child_find_cache has been
-// called, and that no other intervening splay operations have been called
-//
-static void
-cct_disjoint_union_cached(cct_node_t* target, cct_node_t* src)
-{
-
-  if ( ! target) {
-    if ( src) EMSG("WARNING: cct disjoin union called w null target!!");
     return;
   }
 
-  cct_addr_t* addr = hpcrun_cct_addr(src);
-  cct_node_t* found    = splay(target->children, addr);  // FIXME: vi3: is it possible that splay returns something which address is not equal to addre
-    //
-    // !! SPECIAL CASE for cct splay !!
-    // !! The splay tree (represented by the root) is the data structure for the set
-    // !! of children of the parent. Consequently, when the splay operation changes the root,
-    // !! the parent's children pointer must point to the NEW root node
-    // !! NOT the old (pre-splay) root node
-    //
-  if (!found) {
-    target->children = src;
-    src->parent = target;
-    return;
+  size_t n_a, n_b;
+  cct_node_t* list_a = siblings_to_list(cct_a->children, &n_a);
+  cct_node_t* list_b = siblings_to_list(cct_b->children, &n_b);
+
+  // Merge the two sorted lists. Nodes common to both are merged recursively
+  // and the node from cct_b stays behind in cct_b (as a list of children),
+  // since the whole of cct_b is going to the freelist afterwards. Nodes only
+  // in cct_b are moved to cct_a along with their entire subtree.
+  cct_node_t* merged = NULL;
+  cct_node_t** tail = &merged;
+  cct_node_t* stale = NULL;
+  cct_node_t** stale_tail = &stale;
+  size_t n = 0;
+  while (list_a || list_b) {
+    cct_node_t* next;
+    if (! list_b || (list_a && cct_addr_lt(&(list_a->addr), &(list_b->addr)))) {
+      next = list_a;
+      list_a = list_a->right;
+    }
+    else if (! list_a || cct_addr_gt(&(list_a->addr), &(list_b->addr))) {
+      next = list_b;
+      list_b = list_b->right;
+      next->parent = cct_a;
+    }
+    else {
+      cct_node_t* same = list_b;
+      list_b = list_b->right;
+      next = list_a;
+      list_a = list_a->right;
+      hpcrun_cct_merge(next, same, merge, arg);
+      *stale_tail = same;
+      stale_tail = &(same->right);
+    }
+    *tail = next;
+    tail = &(next->right);
+    n++;
   }
+  *tail = NULL;
+  *stale_tail = NULL;
 
-  if (cct_addr_lt(addr, &(found->addr))){
-    src->left = found->left;
-    src->right = found;
-    found->left = NULL;
-  }
-  else { // addr > addr of found
-    src->left = found;
-    src->right = found->right;
-    found->right = NULL;
-  }
-  target->children = src;
-  src->parent = target;
+  cct_a->children = list_to_siblings(&merged, n);
+  cct_b->children = stale;
 }
 
 
@@ -201,6 +201,12 @@ extern void hpcrun_cct_retain(cct_node_t* x);
 // call path.
 extern int hpcrun_cct_retained(cct_node_t* x);
 
+// the metrics attributed to a node, NULL if there are none yet.
+// see cct2metrics.h for the operations on them.
+extern metric_data_list_t* hpcrun_cct_metrics(cct_node_t* x);
+
+extern void hpcrun_cct_metrics_set(cct_node_t* x, metric_data_list_t* metrics);
+
 
 // Walking functions section:
 //
@@ -267,20 +273,14 @@ extern void hpcrun_cct_walkset(cct_node_t* cct, cct_op_t fn, cct_op_arg_t arg);
 //
 // Writing operation
 //
-// cct2metrics_t is defined in cct2metrics.h but we cannot include this header
-//  beceause cct2metrics.h includes this file (cct.h)
-//
-// TODO: need to declare cct2metrics_t here to avoid to cyclic inclusion
-typedef struct cct2metrics_t cct2metrics_t;
 
 
 #if 0
-int hpcrun_cct_fwrite(cct2metrics_t* cct2metrics_map,
-                      cct_node_t* cct, FILE* fs, epoch_flags_t flags);
+int hpcrun_cct_fwrite(cct_node_t* cct, FILE* fs, epoch_flags_t flags);
 #else
 //YUMENG: add sparse_metrics to collect metric values and info
-int hpcrun_cct_fwrite(cct2metrics_t* cct2metrics_map,
-                      cct_node_t* cct, FILE* fs, epoch_flags_t flags, hpcrun_fmt_sparse_metrics_t* sparse_metrics);
+int hpcrun_cct_fwrite(cct_node_t* cct, FILE* fs, epoch_flags_t flags,
+                      hpcrun_fmt_sparse_metrics_t* sparse_metrics);
 
 void hpcrun_cct_fwrite_errmsg_w_fn(FILE* fs, uint32_t tid, char* msg);
 #endif
@@ -288,7 +288,7 @@ void hpcrun_cct_fwrite_errmsg_w_fn(FILE* fs, uint32_t tid, char* msg);
 // Utilities
 //
 extern size_t hpcrun_cct_num_nz_nodes_and_mark_display(cct_node_t* cct, bool count_dummy,\
-    cct2metrics_t **cct2metrics_map,uint64_t* num_nzval, uint32_t* num_nzcct);
+    uint64_t* num_nzval, uint32_t* num_nzcct);
 
 
 //
@@ -106,13 +106,12 @@ hpcrun_cct_bundle_init(cct_bundle_t* bundle, cct_ctxt_t* ctxt)
 //
 #if 0
 int
-hpcrun_cct_bundle_fwrite(FILE* fs, epoch_flags_t flags, cct_bundle_t* bndl,
-                         cct2metrics_t* cct2metrics_map)
+hpcrun_cct_bundle_fwrite(FILE* fs, epoch_flags_t flags, cct_bundle_t* bndl)
 #else
 //YUMENG: add sparse_metrics to collect metric values and info
 int
 hpcrun_cct_bundle_fwrite(FILE* fs, epoch_flags_t flags, cct_bundle_t* bndl,
-                         cct2metrics_t* cct2metrics_map, hpcrun_fmt_sparse_metrics_t* sparse_metrics)
+                         hpcrun_fmt_sparse_metrics_t* sparse_metrics)
 #endif
 {
   if (!fs) { return HPCRUN_ERR; }
@@ -134,10 +133,10 @@ hpcrun_cct_bundle_fwrite(FILE* fs, epoch_flags_t flags, cct_bundle_t* bndl,
 
   // write out newly constructed cct
 #if 0
-  return hpcrun_cct_fwrite(cct2metrics_map, bndl->top, fs, flags);
+  return hpcrun_cct_fwrite(bndl->top, fs, flags);
 #else
 //YUMENG: add sparse_metrics to collect metric values and info
-  return hpcrun_cct_fwrite(cct2metrics_map, bndl->top, fs, flags, sparse_metrics);
+  return hpcrun_cct_fwrite(bndl->top, fs, flags, sparse_metrics);
 #endif
 }
 
@@ -65,11 +65,13 @@
 #include "frame.h"
 #include <unwind/common/backtrace_info.h>
 #include <unwind/common/fence_enum.h>
+#include <unwind/common/fast-unwind.h>
 #include <ompt/ompt-defer.h>
 #include <ompt/ompt-callstack.h>
 
 #include "cct_insert_backtrace.h"
 #include "cct_backtrace_finalize.h"
+#include "sample_phase.h"
 #include "lush/lush-backtrace.h"
 #include "unwind/common/backtrace.h"
 #include "thread_data.h"
@@ -195,18 +197,22 @@ hpcrun_cct_insert_backtrace_w_metric(cct_node_t* treenode,
                                      frame_t* path_beg, frame_t* path_end,
                                      cct_metric_data_t datum, void *data_aux)
 {
+  uint64_t phase_begin = hpcrun_sample_phase_begin();
   cct_node_t* path = hpcrun_cct_insert_backtrace(treenode, path_beg, path_end);
 
   if (hpcrun_kernel_callpath) {
     path = hpcrun_kernel_callpath(path, data_aux);
   }
+  hpcrun_sample_phase_end(SAMPLE_PHASE_CCT_INSERT, phase_begin);
 
+  phase_begin = hpcrun_sample_phase_begin();
   metric_data_list_t* mset = hpcrun_reify_metric_set(path, metric_id);
 
   metric_upd_proc_t* upd_proc = hpcrun_get_metric_proc(metric_id);
   if (upd_proc) {
     upd_proc(metric_id, mset, datum);
   }
+  hpcrun_sample_phase_end(SAMPLE_PHASE_METRIC, phase_begin);
 
   // POST-INVARIANT: metric set has been allocated for 'path'
 
@@ -393,9 +399,14 @@ help_hpcrun_backtrace2cct(cct_bundle_t* bundle, ucontext_t* context,
   // initialize bt
   memset(&bt, 0, sizeof(bt));
 
-  bool success = hpcrun_generate_backtrace(&bt, context, skipInner);
+  uint64_t unwind_begin = hpcrun_sample_phase_begin();
+  bool success = hpcrun_fast_unwind_generate_backtrace(&bt, context,
+                                                       skipInner, data)
+                 || hpcrun_generate_backtrace(&bt, context, skipInner);
 
-  assert(!success == bt.partial_unwind);
+  // the fast unwinder may report a partial unwind of a sample whose
+  // context cannot be unwound
+  assert(success || bt.partial_unwind);
 
   tramp_found = bt.has_tramp;
 
@@ -416,6 +427,7 @@ help_hpcrun_backtrace2cct(cct_bundle_t* bundle, ucontext_t* context,
   }
 
   cct_backtrace_finalize(&bt, isSync);
+  hpcrun_sample_phase_end(SAMPLE_PHASE_UNWIND, unwind_begin);
 
   if (bt.partial_unwind) {
     if (ENABLED(NO_PARTIAL_UNW)){
@@ -9,6 +9,10 @@
 #include "epoch.h"
 #include "cct2metrics.h"
 
+// Number of recent trace timestamps kept to measure how disordered a
+// trace is
+#define HPCRUN_TRACE_DISORDER_HISTORY 32
+
 enum perf_ksym_e {PERF_UNDEFINED, PERF_AVAILABLE, PERF_UNAVAILABLE} ;
 
 typedef struct core_profile_trace_data_t {
@@ -19,10 +23,6 @@ typedef struct core_profile_trace_data_t {
   // ----------------------------------------
   epoch_t* epoch;
 
-  //metrics: this is needed otherwise
-  //hpcprof does not pick them up
-  cct2metrics_t* cct2metrics_map;
-
   // for metric scale (openmp uses)
   void (*scale_fn)(void*);
   // ----------------------------------------
@@ -31,18 +31,39 @@ typedef struct core_profile_trace_data_t {
   uint64_t trace_min_time_us;
   uint64_t trace_max_time_us;
 
-  // Whether the trace is ordered, and if not how disordered we expect it to be
+  // Whether the trace is ordered
   bool trace_is_ordered;
-  unsigned int trace_expected_disorder;
   // Last timestamp in the trace, so we can tell if its ordered
   uint64_t trace_last_time;
+  // Measured disorder: the most earlier records that are later in time than
+  // any one record. Only exact while it stays below the history length.
+  unsigned int trace_disorder;
+  bool trace_disorder_overflow;
+  uint64_t trace_recent_count;
+  uint64_t trace_recent_time[HPCRUN_TRACE_DISORDER_HISTORY];
+  // When coalescing, the run of records with the same call path, metric
+  // and dLCA that the last record written started, and the number of
+  // records left out
+  uint32_t trace_run_cpid;
+  uint32_t trace_run_metric;
+  uint32_t trace_run_dlca;
+  uint64_t trace_run_time;
+  uint64_t trace_run_count;
+  uint64_t trace_coalesced;
 
   // ----------------------------------------
   // IO support
   // ----------------------------------------
   FILE* hpcrun_file;
+  // When all threads share a process profile, the profile is written to
+  // memory and appended to the shared file as a whole
+  char* hpcrun_file_buf;
+  size_t hpcrun_file_len;
   void* trace_buffer;
   hpcio_outbuf_t *trace_outbuf;
+  // When measurements are aggregated per node, the trace is written to
+  // an anonymous file and streamed to the aggregator when it is closed
+  int trace_memfd;
 
 } core_profile_trace_data_t;
 
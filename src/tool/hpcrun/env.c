@@ -52,12 +52,21 @@ const char* HPCRUN_OPT_LUSH_AGENTS = "HPCRUN_OPT_LUSH_AGENTS";
 
 const char* HPCRUN_OUT_PATH        = "HPCRUN_OUT_PATH";
 const char* HPCRUN_TRACE           = "HPCRUN_TRACE";
+const char* HPCRUN_TRACE_COALESCE  = "HPCRUN_TRACE_COALESCE";
+const char* HPCRUN_PROCESS_PROFILE = "HPCRUN_PROCESS_PROFILE";
+const char* HPCRUN_NODE_AGGREGATE  = "HPCRUN_NODE_AGGREGATE";
 
 const char* PAPI_EVENT_LIST        = "PAPI_EVENT_LIST";
 
 const char* HPCRUN_EVENT_LIST      = "HPCRUN_EVENT_LIST";
 const char* HPCRUN_MEMSIZE         = "HPCRUN_MEMSIZE";
 const char* HPCRUN_LOW_MEMSIZE     = "HPCRUN_LOW_MEMSIZE";
+const char* HPCRUN_MEMSTORE_HUGEPAGES  = "HPCRUN_MEMSTORE_HUGEPAGES";
+const char* HPCRUN_MEMSTORE_NUMA_LOCAL = "HPCRUN_MEMSTORE_NUMA_LOCAL";
+const char* HPCRUN_OVERHEAD_BUDGET     = "HPCRUN_OVERHEAD_BUDGET";
+const char* HPCRUN_SAMPLE_PHASES       = "HPCRUN_SAMPLE_PHASES";
+const char* HPCRUN_FNBOUNDS_LAZY       = "HPCRUN_FNBOUNDS_LAZY";
+const char* HPCRUN_FNBOUNDS_SHARED     = "HPCRUN_FNBOUNDS_SHARED";
 
 //
 // Returns: true if 'name' is in the environment and set to a true
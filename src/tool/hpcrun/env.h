@@ -53,12 +53,21 @@
 extern const char* HPCRUN_OPT_LUSH_AGENTS;
 
 extern const char* HPCRUN_OUT_PATH;
+extern const char* HPCRUN_PROCESS_PROFILE;
+extern const char* HPCRUN_NODE_AGGREGATE;
 
 extern const char* HPCRUN_TRACE;
+extern const char* HPCRUN_TRACE_COALESCE;
 
 extern const char* HPCRUN_EVENT_LIST;
 extern const char* HPCRUN_MEMSIZE;
 extern const char* HPCRUN_LOW_MEMSIZE;
+extern const char* HPCRUN_MEMSTORE_HUGEPAGES;
+extern const char* HPCRUN_MEMSTORE_NUMA_LOCAL;
+extern const char* HPCRUN_OVERHEAD_BUDGET;
+extern const char* HPCRUN_SAMPLE_PHASES;
+extern const char* HPCRUN_FNBOUNDS_LAZY;
+extern const char* HPCRUN_FNBOUNDS_SHARED;
 
 bool hpcrun_get_env_bool(const char *);
 
@@ -128,6 +128,7 @@
 #include "loadmap.h"
 #include "sample_prob.h"
 
+#include <lib/prof-lean/hpcnode-fmt.h>
 #include <lib/prof-lean/spinlock.h>
 #include <lib/prof-lean/vdso.h>
 #include <lib/prof-lean/crypto-hash.h> // Calculate a hash for vdso
@@ -183,6 +184,11 @@ static int log_rename_ret = 0;
 
 static int vdso_written = 0; // for coordination across fork
 
+// The profile file shared by all threads, and how much of it has been
+// handed out to them.
+static int process_profile_fd = -1;
+static size_t process_profile_len = 0;
+
 char vdso_hash_str[CRYPTO_HASH_STRING_LENGTH];
 //***************************************************************
 // private operations
@@ -206,6 +212,12 @@ hpcrun_files_init(void)
     log_done = 0;
     log_rename_done = 0;
     log_rename_ret = 0;
+    if (process_profile_fd >= 0) {
+      // the parent's file, not ours to append to
+      close(process_profile_fd);
+    }
+    process_profile_fd = -1;
+    process_profile_len = 0;
   }
 }
 
@@ -508,6 +520,92 @@ hpcrun_open_profile_file(int rank, int thread)
 }
 
 
+// Reserve len bytes at the end of the profile file that all threads of the
+// process share, opening it on first use. The file is named as the profile
+// of thread 0 would be.
+//
+// Returns: file descriptor for the shared profile (hpcrun) file, and the
+// offset of the reserved bytes in *offset.
+int
+hpcrun_open_process_profile_file(int rank, size_t len, off_t *offset)
+{
+  int ret;
+
+  spinlock_lock(&files_lock);
+  hpcrun_files_init();
+  if (process_profile_fd < 0) {
+    hpcrun_rename_log_file_early(rank);
+    process_profile_fd = hpcrun_open_file(rank, 0, HPCRUN_ProfileFnmSfx, FILES_LATE);
+  }
+  ret = process_profile_fd;
+  *offset = process_profile_len;
+  process_profile_len += len;
+  spinlock_unlock(&files_lock);
+
+  return ret;
+}
+
+
+// Format into buf the name, without the directory, of the file that rank
+// and thread would write with the given suffix, for measurement data that
+// is handed to the node aggregator instead of written to a file.
+//
+// Returns: 0 on success, else -1 if the name does not fit.
+int
+hpcrun_files_name(char *buf, size_t len, int rank, int thread, const char *suffix)
+{
+  char name[PATH_MAX + 1];
+  int ret;
+
+  spinlock_lock(&files_lock);
+  hpcrun_files_init();
+  hpcrun_rename_log_file_early(rank);
+  ret = snprintf(name, PATH_MAX, FILENAME_TEMPLATE, output_directory,
+                 executable_name, rank, thread, lateid.host, mypid, lateid.gen, suffix);
+  spinlock_unlock(&files_lock);
+
+  if (ret > PATH_MAX) {
+    return -1;
+  }
+  const char *base = name + strlen(output_directory) + 1;
+  if (strlen(base) >= len) {
+    return -1;
+  }
+  strcpy(buf, base);
+  return 0;
+}
+
+
+// Open the node container written by this process as the node
+// aggregator, named for the host and this process.
+//
+// Returns: file descriptor, else -1 on failure.
+int
+hpcrun_open_node_file(void)
+{
+  char name[PATH_MAX + 1];
+  int fd, ret;
+
+  spinlock_lock(&files_lock);
+  hpcrun_files_init();
+  ret = snprintf(name, PATH_MAX, "%s/%s-node-" HOSTID_FORMAT "-%u.%s", output_directory,
+                 executable_name, earlyid.host, mypid, HPCNODE_FnmSfx);
+  spinlock_unlock(&files_lock);
+
+  if (ret > PATH_MAX) {
+    errno = ENAMETOOLONG;
+    fd = -1;
+  } else {
+    fd = open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+  }
+  if (fd < 0) {
+    EMSG("hpctoolkit: unable to open node container file: '%s': %s", name, strerror(errno));
+  }
+
+  return fd;
+}
+
+
 // Note: we use the log file as the lock for the file names, so we
 // need to rename the log file as the first late action.  Since this
 // is out of sequence, we save the return value and return it when the
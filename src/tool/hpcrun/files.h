@@ -47,6 +47,8 @@
 #ifndef files_h
 #define files_h
 
+#include <stddef.h>
+#include <sys/types.h>
 
 //*****************************************************************************
 // forward declarations
@@ -63,6 +65,9 @@ const char *hpcrun_files_output_directory();
 int hpcrun_open_log_file(void);
 int hpcrun_open_trace_file(int thread);
 int hpcrun_open_profile_file(int rank, int thread);
+int hpcrun_open_process_profile_file(int rank, size_t len, off_t *offset);
+int hpcrun_open_node_file(void);
+int hpcrun_files_name(char *buf, size_t len, int rank, int thread, const char *suffix);
 int hpcrun_rename_log_file(int rank);
 int hpcrun_rename_trace_file(int rank, int thread);
 
@@ -75,6 +75,13 @@
 // 6. The bottom of this file has code for an interactive, stand-alone
 // client for testing hpcfnbounds in server mode.
 //
+// 7. With HPCRUN_FNBOUNDS_SHARED, connect to the node-wide server
+// (hpcfnbounds -S) over a UNIX-domain socket instead, launching it if
+// no process on the node has yet.  The messages are the same, except
+// that an OK answer carries a memfd with the addresses, which we map
+// shared instead of reading the addresses.  If the node server can't
+// be reached, fall back to a private server for the rest of the run.
+//
 // Todo:
 //
 
@@ -119,8 +126,10 @@ char    *outfile;
 
 #include <sys/types.h>
 #include <sys/mman.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/time.h>
+#include <sys/un.h>
 #include <sys/wait.h>
 #include <err.h>
 #include <errno.h>
@@ -128,16 +137,19 @@ char    *outfile;
 #include <sched.h>
 #include <signal.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #if !defined(STAND_ALONE_CLIENT)
 #include <hpcfnbounds/syserv-mesg.h>
 #include "client.h"
 #include "disabled.h"
+#include "env.h"
 #include "fnbounds_file_header.h"
 #include "main.h"
 #include "messages.h"
@@ -152,6 +164,11 @@ char    *outfile;
 // Size to allocate for the stack of the server setup function, in KiB.
 #define SERVER_STACK_SIZE 1024
 
+// How long to wait for a newly launched node server to listen, in
+// tries of CONNECT_WAIT_MS each.
+#define CONNECT_TRIES    40
+#define CONNECT_WAIT_MS  50
+
 #define SUCCESS   0
 #define FAILURE  -1
 #define END_OF_FILE  -2
@@ -168,6 +185,20 @@ static char *server_stack;
 static int fdout = -1;
 static int fdin = -1;
 
+// use the node server, and whether we are connected to it
+static bool shared_wanted = false;
+static bool shared_failed = false;
+static bool shared_active = false;
+static struct sockaddr_un shared_addr;
+static socklen_t shared_addr_len;
+
+// arguments to the clone shims: the pipes to a private server, or the
+// name of the node server to launch
+typedef struct {
+  int sendfd[2], recvfd[2];
+  const char *node_name;
+} server_args_t;
+
 static pid_t my_pid;
 
 #if 0
@@ -284,6 +315,55 @@ read_mesg(struct syserv_mesg *mesg)
 }
 
 
+// Read a single syserv mesg from the node server socket, along with
+// the file descriptor that comes with it, if any (else -1).
+// Returns: SUCCESS, FAILURE or END_OF_FILE.
+//
+static int
+read_mesg_fd(struct syserv_mesg *mesg, int *fd)
+{
+  union {
+    struct cmsghdr hdr;
+    char buf[CMSG_SPACE(sizeof(int))];
+  } ctl;
+  struct iovec iov = { .iov_base = mesg, .iov_len = sizeof(*mesg) };
+  struct msghdr msg = {
+    .msg_iov = &iov, .msg_iovlen = 1,
+    .msg_control = ctl.buf, .msg_controllen = sizeof(ctl.buf)
+  };
+  ssize_t ret;
+
+  *fd = -1;
+  memset(mesg, 0, sizeof(*mesg));
+  do {
+    ret = recvmsg(fdin, &msg, MSG_CMSG_CLOEXEC);
+  } while (ret < 0 && errno == EINTR);
+  if (ret < 0) {
+    return FAILURE;
+  }
+  if (ret == 0) {
+    return END_OF_FILE;
+  }
+
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  if (cmsg != NULL && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+    memcpy(fd, CMSG_DATA(cmsg), sizeof(int));
+  }
+
+  // the descriptor comes with the first byte, the rest may be short
+  int ans = read_all(fdin, ((char *) mesg) + ret, sizeof(*mesg) - ret);
+  if (ans == SUCCESS && mesg->magic != SYSERV_MAGIC) {
+    ans = FAILURE;
+  }
+  if (ans != SUCCESS && *fd >= 0) {
+    auditor_exports->close(*fd);
+    *fd = -1;
+  }
+
+  return ans;
+}
+
+
 // Write a single syserv mesg to outgoing pipe.
 // Returns: SUCCESS or FAILURE.
 //
@@ -377,10 +457,14 @@ hpcrun_sigpipe_handler(int sig, siginfo_t *info, void *context)
 static void
 shutdown_server(void)
 {
-  auditor_exports->close(fdout);
+  // the socket to the node server is both fdin and fdout
+  if (fdout != fdin) {
+    auditor_exports->close(fdout);
+  }
   auditor_exports->close(fdin);
   fdout = -1;
   fdin = -1;
+  shared_active = false;
   client_status = SYSERV_INACTIVE;
 
   TMSG(FNBOUNDS_CLIENT, "syserv shutdown");
@@ -389,12 +473,12 @@ shutdown_server(void)
 static int
 hpcfnbounds_grandchild(void* fds_vp)
 {
-  struct {
-    int sendfd[2], recvfd[2];
-  }* fds = fds_vp;
+  server_args_t* fds = fds_vp;
 
-  auditor_exports->close(fds->sendfd[1]);
-  auditor_exports->close(fds->recvfd[0]);
+  if (fds->node_name == NULL) {
+    auditor_exports->close(fds->sendfd[1]);
+    auditor_exports->close(fds->recvfd[0]);
+  }
 
   // dup the hpcrun log file fd onto stdout and stderr.
   if (dup2(messages_logfile_fd(), 1) < 0) {
@@ -428,9 +512,14 @@ hpcfnbounds_grandchild(void* fds_vp)
     arglist[j++] = "-v2";
   }
 #endif
-  arglist[j++] = "-s";
-  arglist[j++] = fdin_str;
-  arglist[j++] = fdout_str;
+  if (fds->node_name != NULL) {
+    arglist[j++] = "-S";
+    arglist[j++] = (char *) fds->node_name;
+  } else {
+    arglist[j++] = "-s";
+    arglist[j++] = fdin_str;
+    arglist[j++] = fdout_str;
+  }
   arglist[j++] = NULL;
 
   // Exec with the purified environment, so we don't have recursion.
@@ -448,40 +537,13 @@ hpcfnbounds_child(void* fds_vp) {
   return grandchild_pid < 0 ? errno != 0 ? errno : -1 : 0;
 }
 
+// Clone the child shim, which clones the server, and wait for it.
 // Returns: 0 on success, else -1 on failure.
 static int
-launch_server(void)
+clone_server(server_args_t *args)
 {
-  struct {
-    int sendfd[2], recvfd[2];
-  } fds;
-  bool sampling_is_running = false;
   pid_t child_pid;
 
-  // already running
-  if (client_status == SYSERV_ACTIVE && my_pid == getpid()) {
-    return 0;
-  }
-
-  // new process after fork
-  if (client_status == SYSERV_ACTIVE) {
-    shutdown_server();
-  }
-
-  if (auditor_exports->pipe(fds.sendfd) != 0 || auditor_exports->pipe(fds.recvfd) != 0) {
-    EMSG("FNBOUNDS_CLIENT ERROR: syserv launch failed: pipe failed");
-    return -1;
-  }
-
-  if (hpcrun_is_initialized()){
-    // some sample sources need to be stopped in the parent, or else
-    // they cause problems in the child.
-    sampling_is_running = SAMPLE_SOURCES(started);
-    if (sampling_is_running) {
-      SAMPLE_SOURCES(stop);
-    }
-  }
-
   // Give up a bit of our stack for the child shim. It doesn't need much.
   // Make sure the stack is aligned, in case the architecture cares (e.g. ARM).
   char child_stack[4 * 1024 * 2] __attribute__((aligned));
@@ -490,7 +552,7 @@ launch_server(void)
   // where this will reset the pthreads state in the parent if CLONE_VM is used.
   // Clone the memory space to avoid feedback effects.
   child_pid = auditor_exports->clone(hpcfnbounds_child,
-    &child_stack[4 * 1024], CLONE_UNTRACED, &fds);
+    &child_stack[4 * 1024], CLONE_UNTRACED, args);
 
   if (child_pid < 0) {
     //
@@ -527,6 +589,113 @@ launch_server(void)
     return -1;
   }
 
+  TMSG(FNBOUNDS_CLIENT, "syserv launch: success, child shim: %d, server: ???", (int) child_pid);
+
+  return 0;
+}
+
+
+// Connect to the node server, launching it if no process has yet.
+// If several processes launch it at once, all but one exit at bind()
+// and everyone connects to the survivor.
+// Returns: 0 on success, else -1 on failure.
+static int
+connect_shared_server(void)
+{
+  server_args_t args = { .node_name = shared_addr.sun_path + 1 };
+  bool launched = false;
+
+  for (int i = 0; i < CONNECT_TRIES; i++) {
+    int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (sock < 0) {
+      return -1;
+    }
+    if (connect(sock, (struct sockaddr *) &shared_addr, shared_addr_len) == 0) {
+      fdout = fdin = sock;
+      my_pid = getpid();
+      shared_active = true;
+      client_status = SYSERV_ACTIVE;
+      TMSG(FNBOUNDS_CLIENT, "connected to node server %s", args.node_name);
+      return 0;
+    }
+    int connect_errno = errno;
+    auditor_exports->close(sock);
+    if (connect_errno != ECONNREFUSED && connect_errno != EAGAIN) {
+      TMSG(FNBOUNDS_CLIENT, "connect to node server failed: %d", connect_errno);
+      return -1;
+    }
+
+    if (!launched) {
+      bool sampling_is_running = false;
+      if (hpcrun_is_initialized()) {
+        sampling_is_running = SAMPLE_SOURCES(started);
+        if (sampling_is_running) {
+          SAMPLE_SOURCES(stop);
+        }
+      }
+      int ret = clone_server(&args);
+      if (sampling_is_running) {
+        SAMPLE_SOURCES(start);
+      }
+      if (ret != 0) {
+        return -1;
+      }
+      launched = true;
+    }
+
+    struct timespec wait = { .tv_sec = 0, .tv_nsec = CONNECT_WAIT_MS * 1000000L };
+    while (nanosleep(&wait, &wait) != 0 && errno == EINTR) {
+    }
+  }
+
+  return -1;
+}
+
+
+// Returns: 0 on success, else -1 on failure.
+static int
+launch_server(void)
+{
+  server_args_t fds = { .node_name = NULL };
+  bool sampling_is_running = false;
+
+  // already running
+  if (client_status == SYSERV_ACTIVE && my_pid == getpid()) {
+    return 0;
+  }
+
+  // new process after fork
+  if (client_status == SYSERV_ACTIVE) {
+    shutdown_server();
+  }
+
+  if (shared_wanted && !shared_failed) {
+    if (connect_shared_server() == 0) {
+      return 0;
+    }
+    EMSG("FNBOUNDS_CLIENT: unable to reach the node fnbounds server, "
+         "using a private server instead");
+    shared_failed = true;
+  }
+
+  if (auditor_exports->pipe(fds.sendfd) != 0 || auditor_exports->pipe(fds.recvfd) != 0) {
+    EMSG("FNBOUNDS_CLIENT ERROR: syserv launch failed: pipe failed");
+    return -1;
+  }
+
+  if (hpcrun_is_initialized()){
+    // some sample sources need to be stopped in the parent, or else
+    // they cause problems in the child.
+    sampling_is_running = SAMPLE_SOURCES(started);
+    if (sampling_is_running) {
+      SAMPLE_SOURCES(stop);
+    }
+  }
+
+  if (clone_server(&fds) != 0) {
+    return -1;
+  }
+
   //
   // parent process: return and wait for queries.
   //
@@ -537,8 +706,6 @@ launch_server(void)
   my_pid = getpid();
   client_status = SYSERV_ACTIVE;
 
-  TMSG(FNBOUNDS_CLIENT, "syserv launch: success, child shim: %d, server: ???", (int) child_pid);
-
   // Fnbounds talks first with a READY message
   struct syserv_mesg mesg;
   if (read_mesg(&mesg) != SUCCESS) {
@@ -559,6 +726,24 @@ launch_server(void)
 }
 
 
+// The node server listens on an abstract socket named for the user
+// and the server binary, so different installs don't share a server.
+static void
+shared_name_init(void)
+{
+  uint64_t hash = 14695981039346656037UL;  // FNV-1a
+  for (const char *p = server; *p != 0; p++) {
+    hash = (hash ^ (unsigned char) *p) * 1099511628211UL;
+  }
+
+  memset(&shared_addr, 0, sizeof(shared_addr));
+  shared_addr.sun_family = AF_UNIX;
+  int len = snprintf(shared_addr.sun_path + 1, sizeof(shared_addr.sun_path) - 1,
+                     "hpcfnbounds-%d-%016lx", (int) getuid(), (unsigned long) hash);
+  shared_addr_len = offsetof(struct sockaddr_un, sun_path) + 1 + len;
+}
+
+
 // Returns: 0 on success, else -1 on failure.
 int
 hpcrun_syserv_init(void)
@@ -581,6 +766,13 @@ hpcrun_syserv_init(void)
   mem_limit = size * 1024;
 #endif
 
+#if !defined(STAND_ALONE_CLIENT)
+  if (hpcrun_get_env_bool(HPCRUN_FNBOUNDS_SHARED)) {
+    shared_wanted = true;
+    shared_name_init();
+  }
+#endif
+
   // Allocate enough space for fnbounds summoning.
   // Twice as much to allow for growth in either direction.
   server_stack = mmap_anon(SERVER_STACK_SIZE * 1024 * 2);
@@ -685,22 +877,35 @@ hpcrun_syserv_query(const char *fname, struct fnbounds_file_header *fh)
     shutdown_server();
     return NULL;
   }
-  if (read_mesg(&mesg) != SUCCESS) {
+  int table_fd = -1;
+  int ret = shared_active ? read_mesg_fd(&mesg, &table_fd) : read_mesg(&mesg);
+  if (ret != SUCCESS) {
     EMSG("FNBOUNDS_CLIENT ERROR: lost contact with server");
     shutdown_server();
     return NULL;
   }
   if (mesg.type != SYSERV_OK) {
     EMSG("FNBOUNDS_CLIENT ERROR: query failed: %s", fname);
+    if (table_fd >= 0) {
+      auditor_exports->close(table_fd);
+    }
     return NULL;
   }
 
   // Mmap a region for the answer and read the array of addresses.
   // Note: mesg.len is the number of addrs, not bytes.
   //
+  // The node server sends the addresses as a memfd instead, which
+  // other processes on the node map too.
+  //
   size_t num_bytes = mesg.len * sizeof(void *);
   size_t mmap_size = page_align(num_bytes);
-  addr = mmap_anon(mmap_size);
+  if (table_fd >= 0) {
+    addr = mmap(NULL, mmap_size, PROT_READ, MAP_SHARED, table_fd, 0);
+    auditor_exports->close(table_fd);
+  } else {
+    addr = mmap_anon(mmap_size);
+  }
   if (addr == MAP_FAILED) {
     // Technically, we could keep the server alive in this case.
     // But we would have to read all the data to stay in sync with
@@ -709,7 +914,7 @@ hpcrun_syserv_query(const char *fname, struct fnbounds_file_header *fh)
     shutdown_server();
     return NULL;
   }
-  if (read_all(fdin, addr, num_bytes) != SUCCESS) {
+  if (table_fd < 0 && read_all(fdin, addr, num_bytes) != SUCCESS) {
     EMSG("FNBOUNDS_CLIENT ERROR: lost contact with server");
     shutdown_server();
     return NULL;
@@ -717,7 +922,7 @@ hpcrun_syserv_query(const char *fname, struct fnbounds_file_header *fh)
 
   // Read the trailing fnbounds file header.
   struct syserv_fnbounds_info fnb_info;
-  int ret = read_all(fdin, &fnb_info, sizeof(fnb_info));
+  ret = read_all(fdin, &fnb_info, sizeof(fnb_info));
   if (ret != SUCCESS || fnb_info.magic != FNBOUNDS_MAGIC) {
     EMSG("FNBOUNDS_CLIENT ERROR: lost contact with server");
     shutdown_server();
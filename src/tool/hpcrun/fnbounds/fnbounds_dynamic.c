@@ -56,6 +56,13 @@
 //     with system when there might be multiple threads active with
 //     sampling enabled.
 //
+//     with HPCRUN_FNBOUNDS_LAZY, the bounds of a load module other than
+//     the executable are not computed when it is mapped, but when a
+//     sample or unwind first needs them. the request is made from the
+//     signal handler, which only marks the module and wakes a helper
+//     thread that queries the server. until the table arrives, lookups
+//     in the module fail and the unwinder falls back on frame pointers.
+//
 //  Modification history:
 //     2008 April 28 - created John Mellor-Crummey
 //
@@ -73,7 +80,14 @@
 #include <errno.h>     // for errno
 #include <stdint.h>
 #include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
+#include <signal.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
 #include <sys/param.h> // for PATH_MAX
+#include <sys/resource.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
 #include <unistd.h>    // getpid
 
@@ -97,6 +111,7 @@
 #include <hpcrun/main.h>
 #include <hpcrun_stats.h>
 #include <disabled.h>
+#include <env.h>
 #include <files.h>
 #include <loadmap.h>
 #include <epoch.h>
@@ -107,6 +122,7 @@
 #include <messages/messages.h>
 
 #include <lib/prof-lean/spinlock.h>
+#include <lib/prof-lean/stdatomic.h>
 #include <lib/prof-lean/vdso.h>
 
 #include <include/hpctoolkit-config.h>
@@ -143,6 +159,34 @@ static spinlock_t fnbounds_lock = SPINLOCK_UNLOCKED;
         TD_GET(fnbounds_lock) = 0;              \
 } while (0)
 
+// lazy computation of function bounds
+
+static bool fnbounds_lazy = false;
+
+// serializes queries to the server between the helper thread and
+// threads that map load modules
+static spinlock_t query_lock = SPINLOCK_UNLOCKED;
+
+// protects the fnbounds state of dsos against concurrent unmapping
+static spinlock_t lazy_lock = SPINLOCK_UNLOCKED;
+
+static char fnbounds_exe_name[PATH_MAX + 1];
+
+static pid_t fnbounds_helper_pid = 0;
+
+// bumped (and used as a futex) to wake the helper thread
+static atomic_uint fnbounds_requests = ATOMIC_VAR_INIT(0);
+
+// statistics
+
+static atomic_long num_modules = ATOMIC_VAR_INIT(0);
+static atomic_long num_deferred = ATOMIC_VAR_INIT(0);
+static atomic_long num_computed = ATOMIC_VAR_INIT(0);
+static atomic_long num_lazy_computed = ATOMIC_VAR_INIT(0);
+static atomic_long table_bytes = ATOMIC_VAR_INIT(0);
+static atomic_long query_ns = ATOMIC_VAR_INIT(0);
+static atomic_long lazy_query_ns = ATOMIC_VAR_INIT(0);
+
 
 //*********************************************************************
 // forward declarations
@@ -151,6 +195,16 @@ static spinlock_t fnbounds_lock = SPINLOCK_UNLOCKED;
 static dso_info_t *
 fnbounds_compute(const char *filename, void *start, void *end);
 
+static dso_info_t *
+fnbounds_defer(const char *filename, void *start, void *end,
+               struct dl_phdr_info* info);
+
+static void
+fnbounds_lazy_init(const char *executable_name);
+
+static bool
+fnbounds_table_ready(dso_info_t *dso);
+
 
 //*********************************************************************
 // interface operations
@@ -176,6 +230,8 @@ fnbounds_init(const char *executable_name)
 
   hpcrun_syserv_init();
 
+  fnbounds_lazy_init(executable_name);
+
   return 0;
 }
 
@@ -187,7 +243,7 @@ fnbounds_enclosing_addr(void* ip, void** start, void** end, load_module_t** lm)
   load_module_t* lm_ = hpcrun_loadmap_findByAddr(ip, ip);
   dso_info_t* dso = (lm_) ? lm_->dso_info : NULL;
 
-  if (dso && dso->nsymbols > 0) {
+  if (dso && fnbounds_table_ready(dso) && dso->nsymbols > 0) {
     void* ip_norm = ip;
     if (dso->is_relocatable) {
       ip_norm = (void*) (((unsigned long) ip_norm) - dso->start_to_ref_dist);
@@ -217,10 +273,35 @@ fnbounds_enclosing_addr(void* ip, void** start, void** end, load_module_t** lm)
   return ret;
 }
 
+bool
+fnbounds_pending_addr(void* ip, load_module_t** lm)
+{
+  if (!fnbounds_lazy) return false;
+
+  load_module_t* lm_ = hpcrun_loadmap_findByAddr(ip, ip);
+  dso_info_t* dso = (lm_) ? lm_->dso_info : NULL;
+
+  if (dso == NULL ||
+      atomic_load_explicit(&dso->fnbounds_state, memory_order_acquire)
+      == DSO_FNBOUNDS_READY) {
+    return false;
+  }
+
+  if (lm) {
+    *lm = lm_;
+  }
+  return true;
+}
+
 load_module_t*
 fnbounds_map_dso(const char *module_name, void *start, void *end, struct dl_phdr_info* info)
 {
-  dso_info_t *dso = fnbounds_compute(module_name, start, end);
+  dso_info_t *dso;
+  if (fnbounds_lazy && info != NULL) {
+    dso = fnbounds_defer(module_name, start, end, info);
+  } else {
+    dso = fnbounds_compute(module_name, start, end);
+  }
   if (dso) {
     load_module_t* lm = hpcrun_loadmap_map(dso);
     lm->phdr_info = *info;
@@ -248,6 +329,26 @@ fnbounds_fini()
 }
 
 
+void
+fnbounds_summary(void)
+{
+  if (atomic_load(&num_modules) == 0) return;
+
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+
+  AMSG("FNBOUNDS: lazy: %s, modules: %ld (deferred: %ld), computed: %ld "
+       "(lazily: %ld), table KB: %ld, query ms: %.1f (lazily: %.1f), "
+       "max RSS KB: %ld",
+       fnbounds_lazy ? "yes" : "no",
+       atomic_load(&num_modules), atomic_load(&num_deferred),
+       atomic_load(&num_computed), atomic_load(&num_lazy_computed),
+       atomic_load(&table_bytes) / 1024,
+       atomic_load(&query_ns) / 1e6, atomic_load(&lazy_query_ns) / 1e6,
+       usage.ru_maxrss);
+}
+
+
 void
 fnbounds_release_lock(void)
 {
@@ -278,14 +379,20 @@ fnbounds_fetch_executable_table(void)
 // is already locked (mostly).
 //*********************************************************************
 
-static dso_info_t*
-fnbounds_compute(const char* incoming_filename, void* start, void* end)
+static long
+fnbounds_time_ns(void)
 {
-  struct fnbounds_file_header fh;
-  char filename[PATH_MAX + 1];
-  void** nm_table;
-  long map_size;
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
 
+
+// returns the name under which the bounds of a load module are computed
+// and recorded, in filename (of size PATH_MAX + 1)
+static const char*
+fnbounds_resolve_name(const char* incoming_filename, char* filename)
+{
   // typically, we use the filename for the query to the system server. however,
   // for [vdso], the filename will be the name of a file in the measurements
   // directory where a copy of the [vdso] segment will be saved. for parallel programs,
@@ -297,42 +404,293 @@ fnbounds_compute(const char* incoming_filename, void* start, void* end)
   // name of the file that contains a copy. given [vdso], the system server will
   // compute the bounds using its own memory-mapped copy of [vdso] rather than
   // waiting for the file to be written -- johnmc 7/2017
-  const char *pathname_for_query;
-  if (incoming_filename == NULL) {
-    return (NULL);
-  }
 
   // [vdso] and linux-gate.so are virtual files and don't exist
   // in the file system.
   if (strncmp(incoming_filename, "linux-gate.so", 13) == 0) {
-    filename[sizeof(filename) - 1] = 0;
+    filename[PATH_MAX] = 0;
     strncpy(filename, incoming_filename, PATH_MAX);
-    pathname_for_query = filename;
   } else {
     realpath(incoming_filename, filename);
-    pathname_for_query = filename;
   }
+  return filename;
+}
+
+
+// query the server for the function bounds of a load module mapped at
+// [start, end). returns the table, or NULL if the server has none.
+static void**
+fnbounds_query(const char* filename, void* start, void* end,
+               struct fnbounds_file_header* fh, bool lazily)
+{
+  long t0 = fnbounds_time_ns();
+
+  if (fnbounds_lazy) spinlock_lock(&query_lock);
+  void** nm_table = (void**) hpcrun_syserv_query(filename, fh);
+  if (fnbounds_lazy) spinlock_unlock(&query_lock);
+
+  atomic_long* ns = lazily ? &lazy_query_ns : &query_ns;
+  atomic_fetch_add(ns, fnbounds_time_ns() - t0);
+  atomic_fetch_add(&num_computed, 1);
+  if (lazily) atomic_fetch_add(&num_lazy_computed, 1);
 
-  nm_table = (void**) hpcrun_syserv_query(pathname_for_query, &fh);
   if (nm_table == NULL) {
-    return hpcrun_dso_make(filename, NULL, NULL, start, end, 0);
+    return NULL;
   }
-  map_size = fh.mmap_size;
+  atomic_fetch_add(&table_bytes, fh->mmap_size);
 
-  if (fh.num_entries < 1) {
+  if (fh->num_entries < 1) {
     EMSG("fnbounds returns no symbols for file %s, (all intervals poisoned)", filename);
-    return hpcrun_dso_make(filename, NULL, NULL, start, end, 0);
+    return NULL;
   }
 
   //
   // Note: we no longer care if binary is stripped.
   //
-  if (fh.is_relocatable) {
+  if (fh->is_relocatable) {
     if (nm_table[0] >= start && nm_table[0] <= end) {
       // segment loaded at its preferred address
-      fh.is_relocatable = 0;
+      fh->is_relocatable = 0;
     }
   }
 
-  return hpcrun_dso_make(filename, nm_table, &fh, start, end, map_size);
+  return nm_table;
+}
+
+
+static dso_info_t*
+fnbounds_compute(const char* incoming_filename, void* start, void* end)
+{
+  struct fnbounds_file_header fh;
+  char filename[PATH_MAX + 1];
+
+  if (incoming_filename == NULL) {
+    return (NULL);
+  }
+  atomic_fetch_add(&num_modules, 1);
+
+  const char *pathname_for_query = fnbounds_resolve_name(incoming_filename, filename);
+
+  void** nm_table = fnbounds_query(pathname_for_query, start, end, &fh, false);
+  if (nm_table == NULL) {
+    return hpcrun_dso_make(filename, NULL, NULL, start, end, 0);
+  }
+
+  return hpcrun_dso_make(filename, nm_table, &fh, start, end, fh.mmap_size);
+}
+
+
+//*********************************************************************
+// lazy function bounds
+//*********************************************************************
+
+static void
+fnbounds_futex_wait(atomic_uint* addr, unsigned int val)
+{
+  syscall(SYS_futex, (void*) addr, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+}
+
+
+static void
+fnbounds_futex_wake(atomic_uint* addr)
+{
+  syscall(SYS_futex, (void*) addr, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+
+//
+// Map a load module without computing its function bounds. The
+// normalization of IPs in the module must not change once its table
+// arrives: the server reports the address of the first executable
+// segment as the reference offset, and the auditor reports where that
+// segment was mapped as 'start', so their distance is the load bias.
+//
+static dso_info_t*
+fnbounds_defer(const char* incoming_filename, void* start, void* end,
+               struct dl_phdr_info* info)
+{
+  char filename[PATH_MAX + 1];
+
+  if (incoming_filename == NULL) {
+    return (NULL);
+  }
+
+  fnbounds_resolve_name(incoming_filename, filename);
+  if (strcmp(filename, fnbounds_exe_name) == 0) {
+    // the bounds of the executable are needed at startup anyway
+    return fnbounds_compute(incoming_filename, start, end);
+  }
+  atomic_fetch_add(&num_modules, 1);
+  atomic_fetch_add(&num_deferred, 1);
+
+  dso_info_t* dso = hpcrun_dso_make(filename, NULL, NULL, start, end, 0);
+  dso->start_to_ref_dist = info->dlpi_addr;
+  dso->is_relocatable = (info->dlpi_addr != 0);
+  atomic_store_explicit(&dso->fnbounds_state, DSO_FNBOUNDS_PENDING,
+                        memory_order_release);
+
+  TMSG(FNBOUNDS_LAZY, "defer %s [%p, %p)", filename, start, end);
+  return dso;
+}
+
+
+//
+// Returns true if the table of dso may be used. Called from signal
+// handlers: the first call for a module whose table has not been
+// computed only queues it for the helper thread.
+//
+static bool
+fnbounds_table_ready(dso_info_t* dso)
+{
+  int state = atomic_load_explicit(&dso->fnbounds_state, memory_order_acquire);
+  if (state == DSO_FNBOUNDS_READY) {
+    return true;
+  }
+
+  if (state == DSO_FNBOUNDS_PENDING &&
+      atomic_compare_exchange_strong(&dso->fnbounds_state, &state,
+                                     DSO_FNBOUNDS_QUEUED)) {
+    atomic_fetch_add(&fnbounds_requests, 1);
+    fnbounds_futex_wake(&fnbounds_requests);
+  }
+  return false;
+}
+
+
+static void
+fnbounds_lazy_compute(dso_info_t* dso)
+{
+  char filename[PATH_MAX + 1];
+  void *start = NULL, *end = NULL;
+  unsigned int gen = 0;
+
+  // the dso may be unmapped (and its record reused) at any time by the
+  // thread that runs dlclose: take a consistent copy of what we need
+  spinlock_lock(&lazy_lock);
+  bool queued = atomic_load(&dso->fnbounds_state) == DSO_FNBOUNDS_QUEUED;
+  if (queued) {
+    filename[PATH_MAX] = 0;
+    strncpy(filename, dso->name, PATH_MAX);
+    start = dso->start_addr;
+    end = dso->end_addr;
+    gen = dso->fnbounds_gen;
+  }
+  spinlock_unlock(&lazy_lock);
+  if (!queued) return;
+
+  struct fnbounds_file_header fh;
+  void** nm_table = fnbounds_query(filename, start, end, &fh, true);
+
+  spinlock_lock(&lazy_lock);
+  if (dso->fnbounds_gen == gen &&
+      atomic_load(&dso->fnbounds_state) == DSO_FNBOUNDS_QUEUED) {
+    uintptr_t dist = (nm_table != NULL && fh.is_relocatable) ?
+      (uintptr_t) start - fh.reference_offset : 0;
+    if (nm_table != NULL && dist != dso->start_to_ref_dist) {
+      // IPs in the module have already been normalized with the
+      // provisional bias, which other threads may be reading, so it is
+      // kept and the table, which does not match it, is dropped.
+      EMSG("%s: load bias %lx differs from the server's %lx,"
+           " no function bounds for it", filename,
+           (long) dso->start_to_ref_dist, (long) dist);
+    } else if (nm_table != NULL) {
+      dso->table = nm_table;
+      dso->map_size = fh.mmap_size;
+      dso->nsymbols = fh.num_entries;
+      dso->is_relocatable = fh.is_relocatable;
+      nm_table = NULL;
+    }
+    atomic_store_explicit(&dso->fnbounds_state, DSO_FNBOUNDS_READY,
+                          memory_order_release);
+  }
+  spinlock_unlock(&lazy_lock);
+
+  if (nm_table != NULL) {
+    // unmapped in the meantime, or the bias did not match
+    munmap(nm_table, fh.mmap_size);
+  }
+  TMSG(FNBOUNDS_LAZY, "computed %s", filename);
+}
+
+
+//
+// The helper thread. Requests are not passed to it explicitly: the
+// loadmap is scanned for queued modules whenever the request count
+// changes. Load modules are never freed, so the scan is safe while
+// other threads map new ones.
+//
+static void*
+fnbounds_helper(void* arg)
+{
+  sigset_t mask;
+  sigfillset(&mask);
+  pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+  hpcrun_thread_init_mem_pool_once(TOOL_THREAD_ID, NULL, HPCRUN_NO_TRACE, true);
+
+  for (;;) {
+    unsigned int requests = atomic_load(&fnbounds_requests);
+    for (load_module_t* lm = hpcrun_getLoadmap()->lm_head; lm; lm = lm->next) {
+      dso_info_t* dso = lm->dso_info;
+      if (dso && atomic_load(&dso->fnbounds_state) == DSO_FNBOUNDS_QUEUED) {
+        fnbounds_lazy_compute(dso);
+      }
+    }
+    fnbounds_futex_wait(&fnbounds_requests, requests);
+  }
+  return NULL;
+}
+
+
+static void
+fnbounds_lazy_unmap(load_module_t* lm)
+{
+  dso_info_t* dso = lm->dso_info;
+
+  spinlock_lock(&lazy_lock);
+  dso->fnbounds_gen++;
+  if (atomic_load(&dso->fnbounds_state) != DSO_FNBOUNDS_READY) {
+    atomic_store(&dso->fnbounds_state, DSO_FNBOUNDS_UNMAPPED);
+  }
+  spinlock_unlock(&lazy_lock);
+}
+
+
+static void
+fnbounds_lazy_init(const char* executable_name)
+{
+  static loadmap_notify_t lazy_notify = {
+    .map = NULL, .unmap = fnbounds_lazy_unmap, .next = NULL
+  };
+
+  if (!hpcrun_get_env_bool(HPCRUN_FNBOUNDS_LAZY)) return;
+
+  // after a fork, the helper thread is gone (and may have held the lock)
+  if (fnbounds_helper_pid == getpid()) return;
+
+  if (!fnbounds_lazy) {
+    fnbounds_exe_name[0] = 0;
+    if (executable_name != NULL) {
+      fnbounds_resolve_name(executable_name, fnbounds_exe_name);
+    }
+    hpcrun_loadmap_notify_register(&lazy_notify);
+  }
+  spinlock_init(&query_lock);
+  spinlock_init(&lazy_lock);
+
+  pthread_t thread;
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  monitor_disable_new_threads();
+  int rc = pthread_create(&thread, &attr, fnbounds_helper, NULL);
+  monitor_enable_new_threads();
+  pthread_attr_destroy(&attr);
+
+  if (rc != 0) {
+    EMSG("unable to start the fnbounds helper thread, computing all function bounds eagerly");
+    return;
+  }
+  fnbounds_helper_pid = getpid();
+  fnbounds_lazy = true;
 }
@@ -63,6 +63,12 @@ fnbounds_init(const char *executable_name);
 bool
 fnbounds_enclosing_addr(void *ip, void **start, void **end, load_module_t **lm);
 
+// fnbounds_pending_addr(): Return true if 'ip' lies in a load module
+// whose function bounds have not been computed yet, because they are
+// computed lazily (HPCRUN_FNBOUNDS_LAZY). Also return the load module.
+bool
+fnbounds_pending_addr(void *ip, load_module_t **lm);
+
 load_module_t*
 fnbounds_map_dso(const char *module_name, void *start, void *end, struct dl_phdr_info*);
 
@@ -72,6 +78,10 @@ fnbounds_fini();
 void
 fnbounds_release_lock(void);
 
+// write the fnbounds statistics to the log
+void
+fnbounds_summary(void);
+
 
 // fnbounds_table_lookup(): Given an instruction pointer (IP) 'ip',
 // return the bounds [start, end) of the function that contains 'ip'.
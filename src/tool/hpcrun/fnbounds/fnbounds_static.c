@@ -145,12 +145,25 @@ fnbounds_enclosing_addr(void *ip, void **start, void **end, load_module_t **lm)
 }
 
 
+bool
+fnbounds_pending_addr(void *ip, load_module_t **lm)
+{
+  return false;
+}
+
+
 void
 fnbounds_fini()
 {
 }
 
 
+void
+fnbounds_summary(void)
+{
+}
+
+
 void
 fnbounds_release_lock(void)
 {
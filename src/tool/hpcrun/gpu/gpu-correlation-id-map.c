@@ -85,11 +85,11 @@
 #define st_count                                \
   typed_splay_count(correlation_id)
 
-#define st_alloc(free_list)                     \
-  typed_splay_alloc(free_list, gpu_correlation_id_map_entry_t)
+#define st_alloc()                              \
+  typed_splay_alloc_freeable(gpu_correlation_id_map_entry_t)
 
-#define st_free(free_list, node)                \
-  typed_splay_free(free_list, node)
+#define st_free(node)                           \
+  typed_splay_free_freeable(node)
 
 
 
@@ -121,8 +121,6 @@ typedef struct typed_splay_node(correlation_id) {
 
 static __thread gpu_correlation_id_map_entry_t *map_root = NULL;
 
-static __thread gpu_correlation_id_map_entry_t *free_list = NULL;
-
 
 
 //*****************************************************************************
@@ -135,7 +133,7 @@ typed_splay_impl(correlation_id)
 static gpu_correlation_id_map_entry_t *
 gpu_correlation_id_map_entry_alloc()
 {
-  return st_alloc(&free_list);
+  return st_alloc();
 }
 
 
@@ -146,9 +144,11 @@ gpu_correlation_id_map_entry_new
  uint64_t host_correlation_id
 )
 {
+  // zero filled, or NULL when the freeable heap is exhausted
   gpu_correlation_id_map_entry_t *e = gpu_correlation_id_map_entry_alloc();
-
-  memset(e, 0, sizeof(gpu_correlation_id_map_entry_t));
+  if (e == NULL) {
+    return NULL;
+  }
 
   e->gpu_correlation_id = gpu_correlation_id;
   e->host_correlation_id = host_correlation_id;
@@ -192,6 +192,13 @@ gpu_correlation_id_map_insert
   } else {
     gpu_correlation_id_map_entry_t *entry =
       gpu_correlation_id_map_entry_new(gpu_correlation_id, host_correlation_id);
+    if (entry == NULL) {
+      // out of memory: drop the correlation, as if it had never been
+      // made, rather than disable sampling
+      PRINT("correlation_id_map insert: correlation_id=0x%lx dropped\n",
+            gpu_correlation_id);
+      return;
+    }
 
     st_insert(&map_root, entry);
 
@@ -225,7 +232,7 @@ gpu_correlation_id_map_delete
 )
 {
   gpu_correlation_id_map_entry_t *node = st_delete(&map_root, gpu_correlation_id);
-  st_free(&free_list, node);
+  st_free(node);
 }
 
 
@@ -88,11 +88,11 @@
 #define st_count                                \
   typed_splay_count(host_correlation)
 
-#define st_alloc(free_list)                     \
-  typed_splay_alloc(free_list, gpu_host_correlation_map_entry_t)
+#define st_alloc()                              \
+  typed_splay_alloc_freeable(gpu_host_correlation_map_entry_t)
 
-#define st_free(free_list, node)                \
-  typed_splay_free(free_list, node)
+#define st_free(node)                           \
+  typed_splay_free_freeable(node)
 
 
 
@@ -127,8 +127,6 @@ typedef struct typed_splay_node(host_correlation) {
 
 static __thread gpu_host_correlation_map_entry_t *map_root = NULL;
 
-static __thread gpu_host_correlation_map_entry_t *free_list = NULL;
-
 static __thread bool allow_replace = false;
 
 //******************************************************************************
@@ -144,7 +142,7 @@ gpu_host_correlation_map_entry_alloc
  void
 )
 {
-  return st_alloc(&free_list);
+  return st_alloc();
 }
 
 
@@ -157,9 +155,11 @@ gpu_host_correlation_map_entry_new
  gpu_activity_channel_t *activity_channel
 )
 {
+  // zero filled, or NULL when the freeable heap is exhausted
   gpu_host_correlation_map_entry_t *e = gpu_host_correlation_map_entry_alloc();
-
-  memset(e, 0, sizeof(gpu_host_correlation_map_entry_t));
+  if (e == NULL) {
+    return NULL;
+  }
 
   e->host_correlation_id = host_correlation_id;
   e->gpu_op_ccts = *gpu_op_ccts;
@@ -231,6 +231,13 @@ gpu_host_correlation_map_insert
     gpu_host_correlation_map_entry_t *entry =
       gpu_host_correlation_map_entry_new(host_correlation_id, gpu_op_ccts,
                                          cpu_submit_time, activity_channel);
+    if (entry == NULL) {
+      // out of memory: drop the correlation, as if it had never been
+      // made, rather than disable sampling
+      PRINT("host_correlation_map insert: correlation_id=0x%lx dropped\n",
+            host_correlation_id);
+      return;
+    }
 
     st_insert(&map_root, entry);
 
@@ -296,7 +303,7 @@ gpu_host_correlation_map_delete
 {
   PRINT("host_correlation_map delete: correlation_id=0x%lx\n", host_correlation_id);
   gpu_host_correlation_map_entry_t *node = st_delete(&map_root, host_correlation_id);
-  st_free(&free_list, node);
+  st_free(node);
 }
 
 
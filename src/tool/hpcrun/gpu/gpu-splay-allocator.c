@@ -102,3 +102,24 @@ splay_uint64_free_helper
   NEXT(node) = *free_list;
   *free_list = node;
 }
+
+
+splay_uint64_node_t *
+splay_uint64_alloc_freeable
+(
+ size_t size
+)
+{
+  // zero filled
+  return (splay_uint64_node_t *) hpcrun_malloc_freeable(size);
+}
+
+
+void
+splay_uint64_free_freeable
+(
+ splay_uint64_node_t *node
+)
+{
+  hpcrun_free(node);
+}
@@ -75,6 +75,15 @@
   ((splay_uint64_node_t **) free_list,                          \
    (splay_uint64_node_t *) node)
 
+// nodes from the calling thread's freeable heap, rather than a free
+// list, for maps whose nodes are short lived
+#define typed_splay_alloc_freeable(splay_node_type)             \
+  (splay_node_type *) splay_uint64_alloc_freeable               \
+  (sizeof(splay_node_type))
+
+#define typed_splay_free_freeable(node)                         \
+  splay_uint64_free_freeable((splay_uint64_node_t *) node)
+
 
 
 //******************************************************************************
@@ -97,5 +106,19 @@ splay_uint64_free_helper
 );
 
 
+splay_uint64_node_t *
+splay_uint64_alloc_freeable
+(
+ size_t size
+);
+
+
+void
+splay_uint64_free_freeable
+(
+ splay_uint64_node_t *e
+);
+
+
 
 #endif
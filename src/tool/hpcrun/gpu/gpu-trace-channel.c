@@ -47,6 +47,8 @@
 
 #include <string.h>
 #include <pthread.h>
+#include <stdint.h>
+#include <time.h>
 
 
 //******************************************************************************
@@ -61,9 +63,13 @@
 // local includes
 //******************************************************************************
 
-#include <lib/prof-lean/bichannel.h>
+#include <lib/prof-lean/ringchannel.h>
+#include <lib/prof-lean/stdatomic.h>
 
+#include <hpcrun/control-knob.h>
+#include <hpcrun/hpcrun_stats.h>
 #include <hpcrun/memory/hpcrun-malloc.h>
+#include <hpcrun/messages/messages.h>
 
 #include "gpu-trace.h"
 #include "gpu-trace-channel.h"
@@ -77,28 +83,17 @@
 
 #define CHANNEL_FILL_COUNT 100
 
+// trace items the consumer processes in place at a time
+#define CHANNEL_CONSUME_BATCH 64
 
-#undef typed_bichannel
-#undef typed_stack_elem
+// a producer facing a full channel backs off for this long between
+// attempts, and reports every CHANNEL_FULL_REPORT_NS that it is still
+// waiting.
+#define CHANNEL_FULL_BACKOFF_NS 100000
+#define CHANNEL_FULL_REPORT_NS ((2 * SECONDS_UNTIL_WAKEUP + 1) * 1000000000ull)
 
-#define typed_bichannel(x) gpu_trace_channel_t
-#define typed_stack_elem(x) gpu_trace_item_t
-
-// define macros that simplify use of trace channel API
-#define channel_init  \
-  typed_bichannel_init(gpu_trace_item_t)
-
-#define channel_pop   \
-  typed_bichannel_pop(gpu_trace_item_t)
-
-#define channel_push  \
-  typed_bichannel_push(gpu_trace_item_t)
-
-#define channel_reverse \
-  typed_bichannel_reverse(gpu_trace_item_t)
-
-#define channel_steal \
-  typed_bichannel_steal(gpu_trace_item_t)
+#define HEAP_PARENT(i) (((i) - 1) / 2)
+#define HEAP_LEFT(i) (2 * (i) + 1)
 
 
 
@@ -109,12 +104,26 @@
 typedef struct thread_data_t thread_data_t;
 
 
+// activities of a stream can complete, and so arrive, out of order. the
+// consumer holds up to window_size of them in a min-heap keyed by start
+// time and emits the earliest only when another arrives at a full window,
+// so the trace line is written in order unless an activity arrives more
+// than window_size places late.
+typedef struct gpu_trace_reorder_window_t {
+  gpu_trace_item_t *heap;
+  size_t size;
+  size_t count;
+} gpu_trace_reorder_window_t;
+
+
 typedef struct gpu_trace_channel_t {
-  bistack_t bistacks[2];
+  ringchannel_t ring;
   pthread_mutex_t mutex;
   pthread_cond_t cond;
   uint64_t count;
   thread_data_t *td;
+  gpu_trace_reorder_window_t window;
+  _Atomic(bool) released;   // the consumer has flushed the channel for good
 } gpu_trace_channel_t;
 
 
@@ -123,9 +132,6 @@ typedef struct gpu_trace_channel_t {
 // private functions
 //******************************************************************************
 
-// implement bidirectional channels for traces
-typed_bichannel_impl(gpu_trace_item_t)
-
 static void
 gpu_trace_channel_signal_consumer_when_full
 (
@@ -139,6 +145,106 @@ gpu_trace_channel_signal_consumer_when_full
 }
 
 
+static size_t
+gpu_trace_channel_capacity
+(
+ void
+)
+{
+  int knob = 0;
+  control_knob_value_get_int("TRACE_CHANNEL_CAPACITY", &knob);
+
+  // the ring needs a power of two
+  size_t capacity = 2;
+  while (capacity < (size_t) knob) capacity <<= 1;
+  return capacity;
+}
+
+
+static void
+gpu_trace_reorder_window_init
+(
+ gpu_trace_reorder_window_t *window
+)
+{
+  int knob = 0;
+  control_knob_value_get_int("TRACE_REORDER_WINDOW", &knob);
+
+  window->size = knob > 0 ? (size_t) knob : 0;
+  window->count = 0;
+  // with room for the arrival that makes the window overflow
+  window->heap = window->size > 0 ?
+    hpcrun_malloc_safe((window->size + 1) * sizeof(gpu_trace_item_t)) : NULL;
+}
+
+
+static void
+gpu_trace_reorder_window_push
+(
+ gpu_trace_reorder_window_t *window,
+ gpu_trace_item_t *ti
+)
+{
+  gpu_trace_item_t *heap = window->heap;
+  size_t i = window->count++;
+  while (i > 0 && heap[HEAP_PARENT(i)].start > ti->start) {
+    heap[i] = heap[HEAP_PARENT(i)];
+    i = HEAP_PARENT(i);
+  }
+  heap[i] = *ti;
+}
+
+
+static void
+gpu_trace_reorder_window_pop
+(
+ gpu_trace_reorder_window_t *window,
+ gpu_trace_item_t *ti
+)
+{
+  gpu_trace_item_t *heap = window->heap;
+  *ti = heap[0];
+
+  gpu_trace_item_t last = heap[--window->count];
+  size_t i = 0;
+  for (size_t child = HEAP_LEFT(i); child < window->count; child = HEAP_LEFT(i)) {
+    if (child + 1 < window->count && heap[child + 1].start < heap[child].start) {
+      child++;
+    }
+    if (last.start <= heap[child].start) break;
+    heap[i] = heap[child];
+    i = child;
+  }
+  heap[i] = last;
+}
+
+
+static void
+gpu_trace_channel_emit
+(
+ gpu_trace_channel_t *channel,
+ gpu_trace_item_t *ti,
+ cct_node_t *no_activity
+)
+{
+  gpu_trace_reorder_window_t *window = &channel->window;
+
+  if (window->size == 0) {
+    gpu_trace_item_consume(consume_one_trace_item, channel->td, ti, no_activity);
+    return;
+  }
+
+  // the arrival takes part, so an activity window_size places late is
+  // still emitted before the activities that overtook it
+  gpu_trace_reorder_window_push(window, ti);
+  if (window->count > window->size) {
+    gpu_trace_item_t earliest;
+    gpu_trace_reorder_window_pop(window, &earliest);
+    gpu_trace_item_consume(consume_one_trace_item, channel->td, &earliest, no_activity);
+  }
+}
+
+
 
 //******************************************************************************
 // interface functions
@@ -170,12 +276,22 @@ gpu_trace_channel_alloc
  gpu_tag_t tag
 )
 {
-  gpu_trace_channel_t *channel =
-    hpcrun_malloc_safe(sizeof(gpu_trace_channel_t));
+  // the producer and consumer indices of the ring sit on separate cache
+  // lines only if the channel itself is aligned to one
+  uintptr_t mem = (uintptr_t)
+    hpcrun_malloc_safe(sizeof(gpu_trace_channel_t) + RINGCHANNEL_CACHE_LINE);
+  gpu_trace_channel_t *channel = (gpu_trace_channel_t *)
+    ((mem + RINGCHANNEL_CACHE_LINE - 1) & ~(uintptr_t) (RINGCHANNEL_CACHE_LINE - 1));
 
   memset(channel, 0, sizeof(gpu_trace_channel_t));
+  atomic_init(&channel->released, false);
 
-  channel_init(channel);
+  size_t capacity = gpu_trace_channel_capacity();
+  ringchannel_init(&channel->ring,
+                   hpcrun_malloc_safe(capacity * sizeof(gpu_trace_item_t)),
+                   capacity, sizeof(gpu_trace_item_t));
+
+  gpu_trace_reorder_window_init(&channel->window);
 
   channel->td = gpu_trace_stream_acquire(tag);
 
@@ -193,10 +309,6 @@ gpu_trace_channel_produce
  gpu_trace_item_t *ti
 )
 {
-  gpu_trace_item_t *cti = gpu_trace_item_alloc(channel);
-
-  *cti = *ti;
-
   PRINT("\n===========TRACE_PRODUCE: ti = %p || submit = %lu, start = %lu, end = %lu, cct_node = %p\n\n",
          ti,
          ti->cpu_submit_time,
@@ -204,7 +316,24 @@ gpu_trace_channel_produce
          ti->end,
          ti->call_path_leaf);
 
-  channel_push(channel, bichannel_direction_forward, cti);
+  // the channel is bounded. when it is full, wake the consumer and back
+  // off until it has made room. items are only dropped, and counted in
+  // the accelerator trace records dropped, once the consumer is gone.
+  uint64_t waited_ns = 0;
+  while (ringchannel_produce(&channel->ring, ti, 1) == 0) {
+    if (atomic_load_explicit(&channel->released, memory_order_acquire)) {
+      hpcrun_stats_acc_trace_records_dropped_add(1);
+      return;
+    }
+    gpu_trace_channel_signal_consumer(channel);
+    struct timespec backoff = { 0, CHANNEL_FULL_BACKOFF_NS };
+    nanosleep(&backoff, NULL);
+    waited_ns += CHANNEL_FULL_BACKOFF_NS;
+    if (waited_ns % CHANNEL_FULL_REPORT_NS == 0) {
+      EMSG("gpu trace channel %p full for %lu s; waiting for its consumer",
+           channel, (unsigned long) (waited_ns / 1000000000ull));
+    }
+  }
 
   gpu_trace_channel_signal_consumer_when_full(channel);
 }
@@ -219,26 +348,52 @@ gpu_trace_channel_consume
 
   hpcrun_set_thread_data(channel->td);
 
-  // steal elements previously pushed by the producer
-  channel_steal(channel, bichannel_direction_forward);
+  cct_node_t *no_activity = gpu_trace_cct_no_activity(channel->td);
 
-  // reverse them so that they are in FIFO order
-  channel_reverse(channel, bichannel_direction_forward);
+  // consume elements in place, a batch at a time. stop after one
+  // channel's worth so that a busy producer cannot starve the other
+  // channels served by this thread.
+  size_t budget = ringchannel_capacity(&channel->ring);
+  while (budget > 0) {
+    gpu_trace_item_t *items;
+    size_t n = ringchannel_peek(&channel->ring, (void **) &items,
+                                budget < CHANNEL_CONSUME_BATCH ? budget : CHANNEL_CONSUME_BATCH);
+    if (n == 0) break;
+
+    for (size_t i = 0; i < n; i++) {
+      gpu_trace_item_t *ti = &items[i];
+      PRINT("\n===========TRACE_CONSUME: ti = %p || submit = %lu, start = %lu, end = %lu, cct_node = %p\n\n",
+             ti,
+             ti->cpu_submit_time,
+             ti->start,
+             ti->end,
+             ti->call_path_leaf);
+      gpu_trace_channel_emit(channel, ti, no_activity);
+    }
+
+    ringchannel_consume(&channel->ring, n);
+    budget -= n;
+  }
+}
+
+
+void
+gpu_trace_channel_flush
+(
+ gpu_trace_channel_t *channel
+)
+{
+  // producers that find the channel full from now on drop their items
+  atomic_store_explicit(&channel->released, true, memory_order_release);
+
+  gpu_trace_channel_consume(channel);
 
   cct_node_t *no_activity = gpu_trace_cct_no_activity(channel->td);
-  // consume all elements enqueued before this function was called
-  for (;;) {
-    gpu_trace_item_t *ti = channel_pop(channel, bichannel_direction_forward);
-    if (!ti) break;
-
-    PRINT("\n===========TRACE_CONSUME: ti = %p || submit = %lu, start = %lu, end = %lu, cct_node = %p\n\n",
-           ti,
-           ti->cpu_submit_time,
-           ti->start,
-           ti->end,
-           ti->call_path_leaf);
-    gpu_trace_item_consume(consume_one_trace_item, channel->td, ti, no_activity);
-    gpu_trace_item_free(channel, ti);
+
+  while (channel->window.count > 0) {
+    gpu_trace_item_t ti;
+    gpu_trace_reorder_window_pop(&channel->window, &ti);
+    gpu_trace_item_consume(consume_one_trace_item, channel->td, &ti, no_activity);
   }
 }
 
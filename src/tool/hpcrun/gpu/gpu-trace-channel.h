@@ -101,6 +101,15 @@ gpu_trace_channel_consume
 );
 
 
+// consume everything in the channel, including the activities still
+// held back for reordering. called when the stream is released.
+void
+gpu_trace_channel_flush
+(
+ gpu_trace_channel_t *channel
+);
+
+
 void
 gpu_trace_channel_await
 (
@@ -62,7 +62,6 @@
 // local includes
 //******************************************************************************
 
-#include "gpu-channel-item-allocator.h"
 #include "gpu-trace-item.h"
 #include "gpu-print.h"
 
@@ -102,24 +101,3 @@ gpu_trace_item_consume
 {
   trace_item_consume(td, ti->call_path_leaf, ti->start, ti->end, no_activity);
 }
-
-
-gpu_trace_item_t *
-gpu_trace_item_alloc
-(
- gpu_trace_channel_t *channel
-)
-{
-  return channel_item_alloc(channel, gpu_trace_item_t);
-}
-
-
-void
-gpu_trace_item_free
-(
- gpu_trace_channel_t *channel,
- gpu_trace_item_t *ti
-)
-{
-  channel_item_free(channel, ti);
-}
@@ -121,20 +121,5 @@ gpu_trace_item_consume
 );
 
 
-gpu_trace_item_t *
-gpu_trace_item_alloc
-(
- gpu_trace_channel_t *channel
-);
-
-
-void
-gpu_trace_item_free
-(
- gpu_trace_channel_t *channel,
- gpu_trace_item_t *ti
-);
-
-
 
 #endif
@@ -222,7 +222,7 @@ gpu_trace_start_adjust
     start = last_end + 1;
   }
 
-  td->gpu_trace_prev_time = end;
+  td->gpu_trace_prev_time = end > start ? end : start;
 
   return start;
 }
@@ -302,8 +302,6 @@ gpu_trace_stream_acquire
 
   gpu_compute_profile_name(tag, &td->core_profile_trace_data);
 
-  td->core_profile_trace_data.trace_expected_disorder = 30;
-
   return td;
 }
 
@@ -316,6 +314,10 @@ gpu_trace_stream_release
 {
   thread_data_t *td = gpu_trace_channel_get_td(channel);
 
+  // emit the activities still held in the reorder window before the
+  // profile, which records how ordered the trace turned out to be
+  gpu_trace_channel_flush(channel);
+
   hpcrun_write_profile_data(&td->core_profile_trace_data);
   hpcrun_trace_close(&td->core_profile_trace_data);
   atomic_fetch_add(&active_streams_counter, -1);
@@ -445,6 +447,10 @@ consume_one_trace_item
 
   start = gpu_trace_start_adjust(td, start, end);
 
+  // an activity that was moved later to follow its predecessor must not
+  // end before it starts, or the trace line would go backwards
+  if (end < start) end = start;
+
   int frequency = gpu_monitoring_trace_sample_frequency_get();
 
   bool append = false;
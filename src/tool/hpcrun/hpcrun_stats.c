@@ -50,6 +50,9 @@
 //***************************************************************************
 #include "sample_event.h"
 #include "disabled.h"
+#include "sample_budget.h"
+#include "sample_phase.h"
+#include <fnbounds/fnbounds_interface.h>
 
 #include <memory/hpcrun-malloc.h>
 #include <messages/messages.h>
@@ -80,6 +83,9 @@ static atomic_long frames_total = ATOMIC_VAR_INIT(0);
 static atomic_long trolled_frames = ATOMIC_VAR_INIT(0);
 static atomic_long frames_libfail_total = ATOMIC_VAR_INIT(0);
 
+static atomic_long num_fast_unwind = ATOMIC_VAR_INIT(0);
+static atomic_long num_fast_unwind_fallback = ATOMIC_VAR_INIT(0);
+
 static atomic_long acc_trace_records = ATOMIC_VAR_INIT(0);
 static atomic_long acc_trace_records_dropped = ATOMIC_VAR_INIT(0);
 static atomic_long acc_samples = ATOMIC_VAR_INIT(0);
@@ -106,6 +112,9 @@ hpcrun_stats_reinit(void)
   atomic_store_explicit(&trolled_frames, 0, memory_order_relaxed);
   atomic_store_explicit(&frames_libfail_total, 0, memory_order_relaxed);
 
+  atomic_store_explicit(&num_fast_unwind, 0, memory_order_relaxed);
+  atomic_store_explicit(&num_fast_unwind_fallback, 0, memory_order_relaxed);
+
   atomic_store_explicit(&acc_trace_records, 0, memory_order_relaxed);
   atomic_store_explicit(&acc_trace_records_dropped, 0, memory_order_relaxed);
 
@@ -434,6 +443,38 @@ hpcrun_stats_num_samples_yielded(void)
   return atomic_load_explicit(&num_samples_yielded, memory_order_relaxed);
 }
 
+//------------------------------------------------------
+// samples unwound by the fast (frame pointer) unwinder
+//------------------------------------------------------
+
+void
+hpcrun_stats_num_fast_unwind_inc(void)
+{
+  atomic_fetch_add_explicit(&num_fast_unwind, 1L, memory_order_relaxed);
+}
+
+long
+hpcrun_stats_num_fast_unwind(void)
+{
+  return atomic_load_explicit(&num_fast_unwind, memory_order_relaxed);
+}
+
+//------------------------------------------------------
+// samples where the fast unwinder fell back on recipes
+//------------------------------------------------------
+
+void
+hpcrun_stats_num_fast_unwind_fallback_inc(void)
+{
+  atomic_fetch_add_explicit(&num_fast_unwind_fallback, 1L, memory_order_relaxed);
+}
+
+long
+hpcrun_stats_num_fast_unwind_fallback(void)
+{
+  return atomic_load_explicit(&num_fast_unwind_fallback, memory_order_relaxed);
+}
+
 //-----------------------------
 // print summary
 //-----------------------------
@@ -460,6 +501,9 @@ hpcrun_stats_print_summary(void)
   long cpu_intervals_total = atomic_load_explicit(&num_unwind_intervals_total, memory_order_relaxed);
   long cpu_intervals_susp = atomic_load_explicit(&num_unwind_intervals_suspicious, memory_order_relaxed);
 
+  long cpu_fast_unwind = atomic_load_explicit(&num_fast_unwind, memory_order_relaxed);
+  long cpu_fast_unwind_fallback = atomic_load_explicit(&num_fast_unwind_fallback, memory_order_relaxed);
+
   long acc_samp = atomic_load_explicit(&acc_samples, memory_order_relaxed);
   long acc_samp_dropped = atomic_load_explicit(&acc_samples_dropped, memory_order_relaxed);
 
@@ -491,6 +535,16 @@ hpcrun_stats_print_summary(void)
        cpu_intervals_total, cpu_intervals_susp
        );
 
+  if (cpu_fast_unwind + cpu_fast_unwind_fallback > 0) {
+    AMSG("FAST UNWIND: samples: %ld (fast: %ld, fallback: %ld)",
+         cpu_fast_unwind + cpu_fast_unwind_fallback,
+         cpu_fast_unwind, cpu_fast_unwind_fallback);
+  }
+
+  hpcrun_sample_budget_summary();
+  hpcrun_sample_phase_summary();
+  fnbounds_summary();
+
   if (hpcrun_get_disabled()) {
     AMSG("SAMPLING HAS BEEN DISABLED");
   }
@@ -195,6 +195,20 @@ long hpcrun_stats_frames_libfail_total(void);
 void hpcrun_stats_trolled_frames_inc(long amt);
 long hpcrun_stats_trolled_frames(void);
 
+//------------------------------------------------------
+// samples unwound by the fast (frame pointer) unwinder
+//------------------------------------------------------
+
+void hpcrun_stats_num_fast_unwind_inc(void);
+long hpcrun_stats_num_fast_unwind(void);
+
+//------------------------------------------------------
+// samples where the fast unwinder fell back on recipes
+//------------------------------------------------------
+
+void hpcrun_stats_num_fast_unwind_fallback_inc(void);
+long hpcrun_stats_num_fast_unwind_fallback(void);
+
 //-----------------------------
 // print summary
 //-----------------------------
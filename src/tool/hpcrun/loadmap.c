@@ -131,6 +131,7 @@ hpcrun_dso_new()
   else {
     TMSG(DSO, " hpcrun_dso_new");
     x = (dso_info_t*) hpcrun_malloc(sizeof(dso_info_t));
+    x->fnbounds_gen = 0;
   }
 
   return x;
@@ -156,6 +157,8 @@ hpcrun_dso_make(const char* name, void** table,
   x->start_to_ref_dist = 0;
   x->start_addr = startaddr;
   x->end_addr = endaddr;
+  atomic_store_explicit(&x->fnbounds_state, DSO_FNBOUNDS_READY,
+                        memory_order_relaxed);
 
   if (fh) {
     x->nsymbols = (unsigned long)fh->num_entries;
@@ -78,6 +78,16 @@
 // types
 //***************************************************************************
 
+// state of the function bounds table of a dso. tables are only ever
+// computed later than the mapping of their dso when function bounds
+// are computed lazily (see fnbounds_dynamic.c).
+enum {
+  DSO_FNBOUNDS_READY = 0, // table (possibly empty) is available
+  DSO_FNBOUNDS_PENDING,   // not computed, not yet needed
+  DSO_FNBOUNDS_QUEUED,    // requested from the fnbounds helper thread
+  DSO_FNBOUNDS_UNMAPPED,  // unmapped before its table was computed
+};
+
 typedef struct dso_info_t {
   char* name;
   void* start_addr;
@@ -88,6 +98,9 @@ typedef struct dso_info_t {
   unsigned long nsymbols;
   int  is_relocatable;
 
+  _Atomic(int) fnbounds_state;
+  unsigned int fnbounds_gen; // bumped each time the dso is unmapped
+
   struct dso_info_t* next; //to only be used with dso_free_list
   struct dso_info_t* prev;
 
@@ -112,6 +112,9 @@
 #include "sample_sources_all.h"
 #include "segv_handler.h"
 #include "sample_prob.h"
+#include "sample_budget.h"
+#include "sample_phase.h"
+#include "node-aggregate.h"
 #include "term_handler.h"
 
 #include "device-initializers.h"
@@ -825,6 +828,7 @@ hpcrun_fini_internal()
 
     // write all threads' profile data and close trace file
     hpcrun_threadMgr_data_fini(td);
+    hpcrun_node_aggregate_fini();
 
 #ifndef HPCRUN_STATIC_LINK
     auditor_exports->mainlib_disconnect();
@@ -922,6 +926,7 @@ hpcrun_thread_fini(epoch_t *epoch)
     lushPthr_thread_fini(&TD_GET(pthr_metrics));
 
     if (hpcrun_get_disabled()) {
+      hpcrun_memory_thread_fini();
       return;
     }
 
@@ -944,6 +949,8 @@ hpcrun_thread_fini(epoch_t *epoch)
 
     TMSG(PROCESS, "End of thread");
   }
+
+  hpcrun_memory_thread_fini();
 }
 
 //***************************************************************************
@@ -1017,6 +1024,8 @@ monitor_init_process(int *argc, char **argv, void* data)
 #endif // defined(HOST_SYSTEM_IBM_BLUEGENE)
 
   hpcrun_sample_prob_init();
+  hpcrun_sample_budget_init();
+  hpcrun_sample_phase_init();
 
   process_name = get_process_name();
 
@@ -1075,6 +1084,9 @@ monitor_init_process(int *argc, char **argv, void* data)
     }
 #endif
 
+    // before any thread opens its trace file
+    hpcrun_node_aggregate_init();
+
     TMSG(PROCESS, "init process: pid: %d  parent: %d  fork-child: %d",
          (int) getpid(), (int) getppid(), (int) is_child);
     TMSG(PROCESS, "name: %s", process_name);
@@ -88,7 +88,11 @@ void* hpcrun_malloc(size_t size);
 void* hpcrun_malloc_freeable(size_t size);
 void* hpcrun_malloc_safe(size_t size);
 
+// Return a block from hpcrun_malloc_freeable(), from any thread.
+void hpcrun_free(void* ptr);
+
 void hpcrun_memory_reinit(void);
+void hpcrun_memory_thread_fini(void);
 void hpcrun_reclaim_freeable_mem(void);
 void hpcrun_memory_summary(void);
 
@@ -51,9 +51,19 @@
 // When memory gets low, we write out an epoch and reclaim the CCT
 // nodes.
 //
+// Freeable memory comes from a size-class heap per thread (see
+// lib/prof-lean/sizeclass.h), whose blocks are returned with
+// hpcrun_free() from any thread.  When a thread exits, its heap is
+// abandoned, along with any blocks still in use, and adopted by the
+// next thread that needs one.  Only short-lived blocks come from it so
+// far, the entries of the GPU correlation maps.  CCT nodes stay in the
+// memstore, where an epoch flush reclaims them, and running out of
+// memstore still shuts down sampling.
+//
 
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
 
 #include <errno.h>
@@ -75,15 +85,22 @@
 #include "safe-sampling.h"
 
 #include <messages/messages.h>
+#include <lib/prof-lean/sizeclass.h>
 
 #define DEFAULT_MEMSIZE   (4 * 1024 * 1024)
 #define MIN_LOW_MEMSIZE  (80 * 1024)
 #define DEFAULT_PAGESIZE  4096
 
+// from <numaif.h>, which is not always installed
+#define MEM_MPOL_PREFERRED  1
+#define MEM_MAX_NUMA_NODES  1024
+
 static size_t memsize = DEFAULT_MEMSIZE;
 static size_t low_memsize = MIN_LOW_MEMSIZE;
 static size_t pagesize = DEFAULT_PAGESIZE;
 static int allow_extra_mmap = 1;
+static int use_hugepages = 0;
+static int use_numa_local = 0;
 
 static long num_segments = 0;
 static long total_allocation = 0;
@@ -102,6 +119,25 @@ __thread hpcrun_meminfo_t memstore;
 __thread int              mem_low;
 
 
+// ---------------------------------------------------
+// hpcrun_malloc_freeable() size-class heaps
+// ---------------------------------------------------
+typedef struct mem_heap_t {
+  sizeclass_heap_t heap;
+  struct mem_heap_t *next;            // all heaps, for the summary
+  struct mem_heap_t *next_abandoned;
+} mem_heap_t;
+
+static _Atomic(mem_heap_t *) all_heaps = ATOMIC_VAR_INIT(NULL);
+static atomic_long num_heaps = ATOMIC_VAR_INIT(0);
+
+// lock-free, like all_heaps, since a signal handler may need a heap
+// while its thread is abandoning one
+static _Atomic(mem_heap_t *) abandoned_heaps = ATOMIC_VAR_INIT(NULL);
+
+static __thread mem_heap_t *my_heap = NULL;
+
+
 
 //------------------------------------------------------------------
 // Internal functions
@@ -141,6 +177,9 @@ hpcrun_mem_init(void)
     memsize = hpcrun_align_pagesize(result);
   }
 
+  use_hugepages = hpcrun_get_env_bool(HPCRUN_MEMSTORE_HUGEPAGES);
+  use_numa_local = hpcrun_get_env_bool(HPCRUN_MEMSTORE_NUMA_LOCAL);
+
   str = getenv(HPCRUN_LOW_MEMSIZE);
   if (str != NULL && sscanf(str, "%ld", &result) == 1) {
     low_memsize = result;
@@ -151,11 +190,43 @@ hpcrun_mem_init(void)
   }
 
   TMSG(MALLOC, "%s: pagesize = %ld, memsize = %ld, "
-       "low memsize = %ld, extra mmap = %d",
-       __func__, pagesize, memsize, low_memsize, allow_extra_mmap);
+       "low memsize = %ld, extra mmap = %d, hugepages = %d, numa local = %d",
+       __func__, pagesize, memsize, low_memsize, allow_extra_mmap,
+       use_hugepages, use_numa_local);
   init_done = 1;
 }
 
+//
+// Ask for a new region to be backed by transparent huge pages, and/or
+// placed on the NUMA node of the CPU the calling thread is running on,
+// which is normally the node where the thread will touch it.  Both are
+// only advice: failure leaves the region usable with default policy.
+//
+static void
+hpcrun_mem_advise(void *addr, size_t size)
+{
+#ifdef MADV_HUGEPAGE
+  if (use_hugepages && madvise(addr, size, MADV_HUGEPAGE) != 0) {
+    TMSG(MALLOC, "%s: madvise huge pages failed: %s",
+         __func__, strerror(errno));
+  }
+#endif
+
+#if defined(SYS_mbind) && defined(SYS_getcpu)
+  unsigned int cpu, node;
+  if (use_numa_local && syscall(SYS_getcpu, &cpu, &node, NULL) == 0
+      && node < MEM_MAX_NUMA_NODES) {
+    unsigned long mask[MEM_MAX_NUMA_NODES / (8 * sizeof(unsigned long))] = { 0 };
+    mask[node / (8 * sizeof(unsigned long))] = 1UL << (node % (8 * sizeof(unsigned long)));
+    if (syscall(SYS_mbind, addr, size, MEM_MPOL_PREFERRED, mask,
+                MEM_MAX_NUMA_NODES + 1, 0) != 0) {
+      TMSG(MALLOC, "%s: mbind to node %u failed: %s",
+           __func__, node, strerror(errno));
+    }
+  }
+#endif
+}
+
 //
 // Returns: address of mmap-ed region, else NULL on failure.
 //
@@ -195,6 +266,7 @@ hpcrun_mmap_anon(size_t size)
   } else {
     num_segments++;
     total_allocation += size;
+    hpcrun_mem_advise(addr, size);
   }
 
   TMSG(MALLOC, "%s: size = %ld, fd = %d, addr = %p",
@@ -202,6 +274,85 @@ hpcrun_mmap_anon(size_t size)
   return addr;
 }
 
+static void *
+hpcrun_heap_map(size_t size)
+{
+  return hpcrun_mmap_anon(size);
+}
+
+static void
+hpcrun_heap_unmap(void *addr, size_t size)
+{
+  munmap(addr, hpcrun_align_pagesize(size));
+}
+
+//
+// Push the chain of abandoned heaps from first to last.
+//
+static void
+hpcrun_abandon_heaps(mem_heap_t *first, mem_heap_t *last)
+{
+  last->next_abandoned =
+    atomic_load_explicit(&abandoned_heaps, memory_order_relaxed);
+  while (!atomic_compare_exchange_weak_explicit(&abandoned_heaps,
+                                                &last->next_abandoned, first,
+                                                memory_order_release,
+                                                memory_order_relaxed));
+}
+
+//
+// Returns: a heap abandoned by an exited thread, else NULL.  The whole
+// list is taken in one exchange and the rest pushed back, since popping
+// a single heap with a compare-and-swap could be fooled by the same heap
+// being adopted and abandoned again in between.
+//
+static mem_heap_t *
+hpcrun_adopt_heap(void)
+{
+  mem_heap_t *h = atomic_exchange_explicit(&abandoned_heaps, NULL,
+                                           memory_order_acquire);
+  if (h != NULL && h->next_abandoned != NULL) {
+    mem_heap_t *last = h->next_abandoned;
+    while (last->next_abandoned != NULL) {
+      last = last->next_abandoned;
+    }
+    hpcrun_abandon_heaps(h->next_abandoned, last);
+  }
+  return h;
+}
+
+//
+// Returns: this thread's size-class heap, adopting one abandoned by
+// an exited thread if there is one, else NULL on failure.
+//
+static sizeclass_heap_t *
+hpcrun_get_heap(void)
+{
+  if (my_heap != NULL) {
+    return &my_heap->heap;
+  }
+
+  mem_heap_t *h = hpcrun_adopt_heap();
+
+  if (h == NULL) {
+    h = hpcrun_malloc(sizeof(mem_heap_t));
+    if (h == NULL) {
+      return NULL;
+    }
+    hpcrun_mem_init();
+    sizeclass_heap_init(&h->heap, hpcrun_heap_map, hpcrun_heap_unmap);
+    h->next = atomic_load_explicit(&all_heaps, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(&all_heaps, &h->next, h,
+                                                  memory_order_release,
+                                                  memory_order_relaxed));
+    atomic_fetch_add_explicit(&num_heaps, 1, memory_order_relaxed);
+  }
+
+  TMSG(MALLOC, "%s: heap = %p", __func__, h);
+  my_heap = h;
+  return &h->heap;
+}
+
 //------------------------------------------------------------------
 // External functions
 //------------------------------------------------------------------
@@ -359,43 +510,71 @@ hpcrun_malloc_safe(size_t size)
 }
 
 //
-// Returns: address of freeable region at the high end,
-// else NULL on failure.
+// Returns: address of a zero-filled block from this thread's size-class
+// heap, else NULL on failure.  Unlike hpcrun_malloc(), running out of
+// freeable memory does not shut down sampling.
 //
 void *
 hpcrun_malloc_freeable(size_t size)
 {
-  return hpcrun_malloc(size);
-
-  // For now, don't bother with freeable memory.
-#if 0
-  hpcrun_meminfo_t *mi = &TD_GET(memstore);
-  void *addr, *result;
-
-  size = round_up(size);
-  addr = mi->mi_low + size;
+  sizeclass_heap_t *heap;
+  void *addr;
 
-  // Recoverable out of memory.
-  if (addr >= mi->mi_high) {
-    TD_GET(mem_low) = 1;
-    TMSG(MALLOC, "%s: size = %ld, failure: temporary out of memory",
-         __func__, size);
-    num_failures++;
+  if (size == 0) {
     return NULL;
   }
 
-  // Low on memory.
-  if (addr + low_memsize > mi->mi_high) {
-    TD_GET(mem_low) = 1;
-    TMSG(MALLOC, "%s: low on memory, setting epoch flush flag", __func__);
+  heap = hpcrun_get_heap();
+  addr = (heap != NULL) ? sizeclass_alloc(heap, size) : NULL;
+  if (addr == NULL) {
+    TMSG(MALLOC, "%s: size = %ld, failure: out of memory", __func__, size);
+    num_failures++;
+    return NULL;
   }
 
-  result = mi->mi_low;
-  mi->mi_low = addr;
+  memset(addr, 0, size);
   total_freeable += size;
   TMSG(MALLOC, "%s: size = %ld, addr = %p", __func__, size, addr);
-  return result;
-#endif
+  return addr;
+}
+
+//
+// Return a block from hpcrun_malloc_freeable() to the heap it came
+// from.  May be called from any thread, including one that never
+// allocated freeable memory, and from a signal handler.
+//
+void
+hpcrun_free(void *ptr)
+{
+  sizeclass_free(my_heap != NULL ? &my_heap->heap : NULL, ptr);
+}
+
+//
+// Abandon this thread's size-class heap at thread exit.  Blocks freed
+// later by other threads are collected by the next owner.  Samples are
+// dropped meanwhile, so that a handler does not adopt another heap for
+// this thread after it has given up its own.
+//
+void
+hpcrun_memory_thread_fini(void)
+{
+  mem_heap_t *h = my_heap;
+
+  if (h == NULL) {
+    return;
+  }
+
+  int unsafe = hpcrun_safe_enter();
+
+  my_heap = NULL;
+  sizeclass_heap_collect(&h->heap);
+  hpcrun_abandon_heaps(h, h);
+
+  if (unsafe) {
+    hpcrun_safe_exit();
+  }
+
+  TMSG(MALLOC, "%s: heap = %p", __func__, h);
 }
 
 void
@@ -410,6 +589,18 @@ hpcrun_memory_summary(void)
   AMSG("MEMORY: total freeable: %.1f meg, total non-freeable: %.1f meg, "
        "malloc failures: %ld",
        total_freeable/meg, total_non_freeable/meg, num_failures);
+
+  sizeclass_stats_t stats = { 0 };
+  mem_heap_t *h = atomic_load_explicit(&all_heaps, memory_order_acquire);
+  for (; h != NULL; h = h->next) {
+    sizeclass_heap_stats(&h->heap, &stats);
+  }
+
+  AMSG("MEMORY: freeable heaps: %ld, allocs: %zu, frees: %zu "
+       "(remote: %zu), mapped: %.1f meg, in use: %.1f meg",
+       atomic_load_explicit(&num_heaps, memory_order_relaxed),
+       stats.allocs, stats.frees, stats.remote_frees,
+       stats.bytes_mapped/meg, stats.bytes_in_use/meg);
 }
 
 int
@@ -518,17 +518,8 @@ void hpcrun_metric_std_inc(int metric_id, metric_data_list_t *set,
 metric_data_list_t *
 hpcrun_new_metric_data_list(int metric_id)
 {
-  metric_data_list_t *curr = hpcrun_malloc(sizeof(metric_data_list_t));
   hpcrun_get_num_kind_metrics();
-  curr->kind = metric_data[metric_id].kind;
-  int n_metrics = hpcrun_get_num_metrics(curr->kind);
-  curr->metrics = hpcrun_malloc(n_metrics * sizeof(hpcrun_metricVal_t));
-  // FIXME(Keren): duplicate?
-  for (int i = 0; i < n_metrics; i++)
-    curr->metrics[i].v1 = curr->kind->null_metrics[i];
-  memset(curr->metrics, 0, n_metrics * sizeof(hpcrun_metricVal_t));
-  curr->next = NULL;
-  return curr;
+  return hpcrun_new_metric_data_list_kind(metric_data[metric_id].kind);
 }
 
 metric_data_list_t *
@@ -552,17 +543,20 @@ hpcrun_reify_metric_data_list_kind(metric_data_list_t *rv, int metric_id)
   return curr;
 }
 
+//
+// the list entry and the dense values of its kind come from one
+// allocation out of the thread's memstore, so the values attributed to
+// a cct node sit right behind the entry the node points to.
+//
 metric_data_list_t *
 hpcrun_new_metric_data_list_kind(kind_info_t *kind)
 {
-  metric_data_list_t *curr = hpcrun_malloc(sizeof(metric_data_list_t));
   hpcrun_get_num_kind_metrics();
+  int n_metrics = hpcrun_get_num_metrics(kind);
+  metric_data_list_t *curr =
+    hpcrun_malloc(sizeof(metric_data_list_t) + n_metrics * sizeof(hpcrun_metricVal_t));
   curr->kind = kind;
-  int n_metrics = hpcrun_get_num_metrics(curr->kind);
-  curr->metrics = hpcrun_malloc(n_metrics * sizeof(hpcrun_metricVal_t));
-  // FIXME(Keren): duplicate?
-  for (int i = 0; i < n_metrics; i++)
-    curr->metrics[i].v1 = curr->kind->null_metrics[i];
+  curr->metrics = (metric_set_t *) (curr + 1);
   memset(curr->metrics, 0, n_metrics * sizeof(hpcrun_metricVal_t));
   curr->next = NULL;
   return curr;
@@ -0,0 +1,726 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2023, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <include/hpctoolkit-config.h>
+#include <lib/prof-lean/hpcnode-fmt.h>
+#include <lib/prof-lean/shmchannel.h>
+#include <lib/prof-lean/stdatomic.h>
+#include <messages/messages.h>
+
+#ifndef HPCRUN_STATIC_LINK
+#include "audit/audit-api.h"
+#endif
+#include "env.h"
+#include "files.h"
+#include "node-aggregate.h"
+
+#define CHANNEL_CAPACITY  512
+#define MESSAGE_SIZE      (64 * 1024)
+#define MAX_CLIENTS       4096
+#define MAX_STREAMS       (64 * 1024)
+
+#define NS_PER_MS  (1000 * 1000)
+#define NS_PER_SEC (1000 * NS_PER_MS)
+
+// The aggregator stays up this long after its last client leaves, so
+// processes launched a little later on the same node still find it.
+#define GRACE_NS           (2 * (uint64_t) NS_PER_SEC)
+#define IDLE_SLEEP_NS      (100 * 1000)
+#define ATTACH_TIMEOUT_NS  (5 * (uint64_t) NS_PER_SEC)
+#define FINISH_TIMEOUT_NS  (60 * (uint64_t) NS_PER_SEC)
+#define CLAIM_TIMEOUT_NS   (30 * (uint64_t) NS_PER_SEC)
+// A slot claimed by a producer that has not yet recorded its pid is
+// discarded after this long.  A slot whose producer is known is kept
+// until that process exits.
+#define STALL_TIMEOUT_NS   (1 * (uint64_t) NS_PER_SEC)
+#define ATTACH_ATTEMPTS    4
+
+#define AGGREGATOR_STACK_SIZE  (256 * 1024)
+
+enum {
+  STATE_STARTING = 0,   // segment created, aggregator not yet running
+  STATE_OPEN,           // accepting new clients
+  STATE_CLOSED,         // draining the clients it already has
+  STATE_DONE,           // container complete
+  STATE_FAILED
+};
+
+enum {
+  MSG_OPEN = 1,         // start a stream: payload is its name
+  MSG_DATA              // payload is bytes of the stream at offset
+};
+
+typedef struct segment_t {
+  atomic_int state;
+  atomic_int aggregator;
+  atomic_uint_least64_t next_stream;
+  atomic_int clients[MAX_CLIENTS];
+  // the channel follows at CHANNEL_OFFSET
+} segment_t;
+
+typedef struct message_t {
+  uint32_t type;
+  uint32_t len;         // bytes of payload
+  uint64_t stream;
+  uint64_t offset;      // MSG_DATA: offset of the payload in the stream
+  uint64_t size;        // MSG_OPEN: total size of the stream
+  char payload[];
+} message_t;
+
+#define CHANNEL_OFFSET \
+  ((sizeof(segment_t) + SHMCHANNEL_CACHE_LINE - 1) & ~(size_t) (SHMCHANNEL_CACHE_LINE - 1))
+#define PAYLOAD_SIZE  (MESSAGE_SIZE - sizeof(message_t))
+
+// The aggregator's record of one stream, kept in private memory.
+typedef struct stream_t {
+  uint64_t offset;      // in the container, 0 if not yet opened
+  uint64_t size;
+  uint64_t received;
+  char name[NAME_MAX + 1];
+} stream_t;
+
+static bool aggregate_active = false;
+static pid_t my_pid = 0;
+static bool is_creator = false;
+static int client_slot = -1;
+
+static char segment_name[NAME_MAX + 1];
+static size_t segment_size = 0;
+static segment_t *segment = NULL;
+static shmchannel_t *channel = NULL;
+
+static int container_fd = -1;
+static char *aggregator_stack = NULL;
+
+
+// -------------------------------------------------------------------
+// This file implements node-local aggregation of measurement files.
+// If HPCRUN_NODE_AGGREGATE is set, then the processes measured on one
+// node, into one output directory, stream their profiles and traces
+// to a single aggregator instead of each creating files of their own.
+// The aggregator writes them all into one .hpcnode container (see
+// hpcnode-fmt.h), so a run creates one file per node rather than one
+// or two per thread.
+//
+// The processes find each other through a POSIX shared memory segment
+// named for the user and the output directory.  The first process to
+// create the segment launches the aggregator, a detached clone of
+// itself that only makes system calls, and writes the container.
+// Every process registers its pid in the segment and then sends its
+// files through a bounded channel of fixed-size messages.  The
+// aggregator reserves a contiguous region of the container for each
+// file when it is opened, so messages of different files may be
+// interleaved freely.
+//
+// The aggregator stops accepting clients once none of its clients is
+// alive and none has arrived for GRACE_NS, then writes the index and
+// exits.  A process that cannot attach, or whose aggregator dies,
+// falls back to writing its files itself.
+// -------------------------------------------------------------------
+
+
+static inline uint64_t
+now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * NS_PER_SEC + ts.tv_nsec;
+}
+
+
+static void
+sleep_ns(uint64_t ns)
+{
+  struct timespec ts = { .tv_sec = ns / NS_PER_SEC, .tv_nsec = ns % NS_PER_SEC };
+  nanosleep(&ts, NULL);
+}
+
+
+static bool
+pid_alive(pid_t pid)
+{
+  return pid > 0 && (kill(pid, 0) == 0 || errno == EPERM);
+}
+
+
+static int
+write_all(int fd, const void *buf, size_t len, uint64_t offset)
+{
+  for (size_t done = 0; done < len; ) {
+    ssize_t n = pwrite(fd, (const char *) buf + done, len - done, offset + done);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+    done += n;
+  }
+  return 0;
+}
+
+
+//*****************************************************************************
+// aggregator
+//*****************************************************************************
+
+// Whether any registered client is alive.  Clients that died without
+// leaving are removed.
+static bool
+any_live_client(void)
+{
+  bool live = false;
+  for (int i = 0; i < MAX_CLIENTS; i++) {
+    int pid = atomic_load(&segment->clients[i]);
+    if (pid == 0)
+      continue;
+    if (pid_alive(pid)) {
+      live = true;
+    } else {
+      atomic_compare_exchange_strong(&segment->clients[i], &pid, 0);
+    }
+  }
+  return live;
+}
+
+
+static void
+aggregator_receive(stream_t *streams, uint64_t *end, message_t *msg)
+{
+  if (msg->stream >= MAX_STREAMS)
+    return;
+  stream_t *s = &streams[msg->stream];
+
+  if (msg->type == MSG_OPEN) {
+    size_t len = msg->len < NAME_MAX ? msg->len : NAME_MAX;
+    memcpy(s->name, msg->payload, len);
+    s->name[len] = '\0';
+    s->offset = *end;
+    s->size = msg->size;
+    *end += msg->size;
+  } else if (msg->type == MSG_DATA && s->offset != 0
+             && msg->offset + msg->len <= s->size) {
+    if (write_all(container_fd, msg->payload, msg->len, s->offset + msg->offset) == 0)
+      s->received += msg->len;
+  }
+}
+
+
+static void
+aggregator_finish(stream_t *streams, uint64_t end)
+{
+  char buf[NAME_MAX + 64];
+  uint64_t index_offset = end;
+  uint64_t count = 0;
+
+  // A file is listed only once all of it has arrived.
+  for (uint64_t i = 0; i < MAX_STREAMS; i++) {
+    stream_t *s = &streams[i];
+    if (s->offset == 0 || s->received != s->size)
+      continue;
+    size_t n = hpcnode_fmt_entry_swrite(s->name, s->offset, s->size, buf);
+    if (write_all(container_fd, buf, n, end) != 0)
+      return;
+    end += n;
+    count++;
+  }
+
+  size_t n = hpcnode_fmt_trailer_swrite(index_offset, count, buf);
+  write_all(container_fd, buf, n, end);
+}
+
+
+static int
+aggregator_main(void *arg)
+{
+  // The aggregator outlives the process that launched it and must not
+  // take part in its signal handling or job control.
+  sigset_t all;
+  sigfillset(&all);
+  syscall(SYS_rt_sigprocmask, SIG_SETMASK, &all, NULL, _NSIG / 8);
+  setsid();
+
+  size_t table_size = MAX_STREAMS * sizeof(stream_t);
+  stream_t *streams = mmap(NULL, table_size, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (streams == MAP_FAILED) {
+    atomic_store(&segment->state, STATE_FAILED);
+    syscall(SYS_exit_group, 1);
+  }
+
+  char hdr[HPCNODE_FMT_MagicLen];
+  uint64_t end = hpcnode_fmt_hdr_swrite(hdr);
+  write_all(container_fd, hdr, end, 0);
+
+  atomic_store(&segment->aggregator, (int) syscall(SYS_getpid));
+  atomic_store(&segment->state, STATE_OPEN);
+
+  uint64_t last_seen = now_ns();
+  uint64_t stall_ticket = UINT64_MAX;
+  uint64_t stall_start = 0;
+  int state = STATE_OPEN;
+  for (;;) {
+    message_t *msg = shmchannel_peek(channel);
+    if (msg != NULL) {
+      aggregator_receive(streams, &end, msg);
+      shmchannel_release(channel);
+      continue;
+    }
+
+    // A producer that died between claiming a slot and publishing it
+    // would hold up every message behind it.  Its stream is left
+    // incomplete and so is not listed in the index.
+    uint64_t ticket;
+    int32_t owner;
+    if (shmchannel_stalled(channel, &ticket, &owner)) {
+      if (ticket != stall_ticket) {
+        stall_ticket = ticket;
+        stall_start = now_ns();
+      } else if (owner != 0 ? !pid_alive(owner)
+                 : now_ns() - stall_start >= STALL_TIMEOUT_NS) {
+        shmchannel_discard(channel);
+        continue;
+      }
+    }
+
+    if (any_live_client()) {
+      last_seen = now_ns();
+    } else if (shmchannel_empty(channel)) {
+      if (state == STATE_CLOSED)
+        break;
+      if (now_ns() - last_seen >= GRACE_NS) {
+        // Stop taking new clients.  A client registers before it checks
+        // the state, so any client that saw the segment open is seen by
+        // the next pass over the clients.
+        atomic_store(&segment->state, STATE_CLOSED);
+        shm_unlink(segment_name);
+        state = STATE_CLOSED;
+        continue;
+      }
+    }
+    sleep_ns(IDLE_SLEEP_NS);
+  }
+
+  aggregator_finish(streams, end);
+  fsync(container_fd);
+  close(container_fd);
+  atomic_store(&segment->state, STATE_DONE);
+  syscall(SYS_exit_group, 0);
+  return 0;
+}
+
+
+#ifndef HPCRUN_STATIC_LINK
+// Close every file descriptor inherited from the measured process but
+// the container, and point the standard streams at /dev/null, so the
+// aggregator holds no pipes or sockets open after the process exits.
+static void
+aggregator_close_fds(void)
+{
+  if (container_fd < 3) {
+    int fd = fcntl(container_fd, F_DUPFD, 3);
+    if (fd >= 0)
+      container_fd = fd;
+  }
+
+  int null_fd = open("/dev/null", O_RDWR);
+  for (int fd = 0; fd < 3; fd++) {
+    if (null_fd >= 0 && null_fd != fd)
+      dup2(null_fd, fd);
+  }
+  if (null_fd > 2 && null_fd != container_fd)
+    close(null_fd);
+
+#ifdef SYS_close_range
+  if ((container_fd == 3 || syscall(SYS_close_range, 3, container_fd - 1, 0) == 0)
+      && syscall(SYS_close_range, container_fd + 1, ~0U, 0) == 0)
+    return;
+#endif
+  struct rlimit rl;
+  int max_fd = getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur != RLIM_INFINITY
+    && rl.rlim_cur < INT_MAX ? (int) rl.rlim_cur : 64 * 1024;
+  for (int fd = 3; fd < max_fd; fd++) {
+    if (fd != container_fd)
+      close(fd);
+  }
+}
+
+
+static int
+aggregator_child(void *arg)
+{
+  aggregator_close_fds();
+
+  // Clone the aggregator as a grandchild, so it is not a child of the
+  // measured process.  It shares this copy of the address space, which
+  // is no longer used once we return.
+  errno = 0;
+  pid_t pid = auditor_exports->clone(aggregator_main,
+    &aggregator_stack[AGGREGATOR_STACK_SIZE], CLONE_UNTRACED | CLONE_VM, arg);
+  return pid < 0 ? errno != 0 ? errno : -1 : 0;
+}
+#endif
+
+
+static int
+launch_aggregator(void)
+{
+#ifdef HPCRUN_STATIC_LINK
+  EMSG("node aggregation is not supported with static linking");
+  return -1;
+#else
+  container_fd = hpcrun_open_node_file();
+  if (container_fd < 0)
+    return -1;
+
+  aggregator_stack = mmap(NULL, AGGREGATOR_STACK_SIZE, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (aggregator_stack == MAP_FAILED) {
+    aggregator_stack = NULL;
+    close(container_fd);
+    return -1;
+  }
+
+  char child_stack[4 * 1024 * 2] __attribute__((aligned));
+  pid_t child = auditor_exports->clone(aggregator_child, &child_stack[4 * 1024],
+                                       CLONE_UNTRACED, NULL);
+  int status = 0;
+  int ret = 0;
+  if (child < 0
+      || auditor_exports->waitpid(child, &status, __WCLONE) < 0
+      || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    EMSG("unable to launch the node aggregator");
+    ret = -1;
+  }
+
+  // The aggregator has its own copies of these.
+  close(container_fd);
+  container_fd = -1;
+  munmap(aggregator_stack, AGGREGATOR_STACK_SIZE);
+  aggregator_stack = NULL;
+  return ret;
+#endif
+}
+
+
+//*****************************************************************************
+// clients
+//*****************************************************************************
+
+static void
+unmap_segment(void)
+{
+  if (segment != NULL)
+    munmap(segment, segment_size);
+  segment = NULL;
+  channel = NULL;
+}
+
+
+// Create or open the segment and register with its aggregator.
+// Returns 0 if attached, 1 to try again, else -1.
+static int
+attach(void)
+{
+  int fd = shm_open(segment_name, O_RDWR | O_CREAT | O_EXCL, 0600);
+  is_creator = (fd >= 0);
+  if (fd < 0 && errno == EEXIST)
+    fd = shm_open(segment_name, O_RDWR, 0600);
+  if (fd < 0) {
+    if (errno == ENOENT)
+      return 1;
+    EMSG("unable to open node aggregation segment %s: %s", segment_name, strerror(errno));
+    return -1;
+  }
+
+  if (is_creator && ftruncate(fd, segment_size) != 0) {
+    EMSG("unable to size node aggregation segment: %s", strerror(errno));
+    close(fd);
+    shm_unlink(segment_name);
+    return -1;
+  }
+
+  // Wait for the creator to size the segment.
+  struct stat st;
+  uint64_t start = now_ns();
+  while (fstat(fd, &st) == 0 && (size_t) st.st_size < segment_size) {
+    if (now_ns() - start > ATTACH_TIMEOUT_NS) {
+      close(fd);
+      return -1;
+    }
+    sleep_ns(NS_PER_MS);
+  }
+
+  segment = mmap(NULL, segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (segment == MAP_FAILED) {
+    segment = NULL;
+    return -1;
+  }
+  channel = (shmchannel_t *) ((char *) segment + CHANNEL_OFFSET);
+
+  if (is_creator) {
+    shmchannel_init(channel, CHANNEL_CAPACITY, MESSAGE_SIZE);
+    if (launch_aggregator() != 0) {
+      atomic_store(&segment->state, STATE_FAILED);
+      shm_unlink(segment_name);
+      unmap_segment();
+      return -1;
+    }
+  }
+
+  // Wait for the aggregator to start.
+  start = now_ns();
+  int state;
+  while ((state = atomic_load(&segment->state)) == STATE_STARTING) {
+    if (now_ns() - start > ATTACH_TIMEOUT_NS) {
+      unmap_segment();
+      return -1;
+    }
+    sleep_ns(NS_PER_MS);
+  }
+
+  // Register, then check that the aggregator still takes clients.
+  if (state == STATE_OPEN) {
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+      int empty = 0;
+      if (atomic_compare_exchange_strong(&segment->clients[i], &empty, my_pid)) {
+        client_slot = i;
+        break;
+      }
+    }
+    if (client_slot < 0) {
+      unmap_segment();
+      return -1;
+    }
+    state = atomic_load(&segment->state);
+    if (state == STATE_OPEN && pid_alive(atomic_load(&segment->aggregator)))
+      return 0;
+    atomic_store(&segment->clients[client_slot], 0);
+    client_slot = -1;
+  }
+
+  // The segment is left from an aggregator that finished or died.
+  if (state == STATE_OPEN && !pid_alive(atomic_load(&segment->aggregator)))
+    shm_unlink(segment_name);
+  unmap_segment();
+  return state == STATE_FAILED ? -1 : 1;
+}
+
+
+void
+hpcrun_node_aggregate_init(void)
+{
+  if (segment != NULL) {
+    if (my_pid == getpid())
+      return;
+    // new process after fork: the segment is still mapped, but this
+    // process must register on its own and did not launch anything.
+    unmap_segment();
+    client_slot = -1;
+  }
+
+  aggregate_active = false;
+  if (!hpcrun_get_env_bool(HPCRUN_NODE_AGGREGATE))
+    return;
+
+  // FNV-1a hash of the output directory, so runs into different
+  // directories use different aggregators.
+  const char *dir = hpcrun_files_output_directory();
+  uint64_t hash = 0xcbf29ce484222325;
+  for (const char *p = dir; p != NULL && *p != '\0'; p++)
+    hash = (hash ^ (unsigned char) *p) * 0x100000001b3;
+  snprintf(segment_name, sizeof segment_name, "/hpcrun-node-%u-%016llx",
+           (unsigned) getuid(), (unsigned long long) hash);
+
+  segment_size = CHANNEL_OFFSET + shmchannel_size(CHANNEL_CAPACITY, MESSAGE_SIZE);
+  my_pid = getpid();
+
+  for (int i = 0; i < ATTACH_ATTEMPTS; i++) {
+    int ret = attach();
+    if (ret == 0) {
+      aggregate_active = true;
+      TMSG(NODE_AGGREGATE, "attached to node aggregator %d via %s%s",
+           atomic_load(&segment->aggregator), segment_name,
+           is_creator ? " (launched)" : "");
+      return;
+    }
+    if (ret < 0)
+      break;
+    sleep_ns(10 * NS_PER_MS);
+  }
+  EMSG("node aggregation unavailable, writing measurement files directly");
+}
+
+
+bool
+hpcrun_node_aggregate_active(void)
+{
+  return aggregate_active && my_pid == getpid();
+}
+
+
+// Claim a message slot, waiting while the channel is full, but not
+// longer than CLAIM_TIMEOUT_NS in all.
+static message_t *
+claim(uint64_t *ticket)
+{
+  uint64_t start = now_ns();
+  for (int spins = 0; ; spins++) {
+    message_t *msg = shmchannel_claim(channel, ticket, my_pid);
+    if (msg != NULL)
+      return msg;
+    if (spins % 1000 == 999
+        && (!pid_alive(atomic_load(&segment->aggregator))
+            || now_ns() - start > CLAIM_TIMEOUT_NS))
+      return NULL;
+    sleep_ns(IDLE_SLEEP_NS);
+  }
+}
+
+
+int
+hpcrun_node_aggregate_write(const char *name, const void *data, size_t len)
+{
+  if (!hpcrun_node_aggregate_active())
+    return -1;
+
+  uint64_t stream = atomic_fetch_add(&segment->next_stream, 1);
+  if (stream >= MAX_STREAMS)
+    return -1;
+
+  uint64_t ticket;
+  message_t *msg = claim(&ticket);
+  if (msg == NULL)
+    goto dead;
+  size_t name_len = strlen(name);
+  msg->type = MSG_OPEN;
+  msg->len = name_len < PAYLOAD_SIZE ? name_len : PAYLOAD_SIZE;
+  msg->stream = stream;
+  msg->offset = 0;
+  msg->size = len;
+  memcpy(msg->payload, name, msg->len);
+  if (shmchannel_publish(channel, ticket) != 0)
+    goto dead;
+
+  for (size_t done = 0; done < len; ) {
+    size_t n = len - done < PAYLOAD_SIZE ? len - done : PAYLOAD_SIZE;
+    msg = claim(&ticket);
+    if (msg == NULL)
+      goto dead;
+    msg->type = MSG_DATA;
+    msg->len = n;
+    msg->stream = stream;
+    msg->offset = done;
+    msg->size = 0;
+    memcpy(msg->payload, (const char *) data + done, n);
+    if (shmchannel_publish(channel, ticket) != 0)
+      goto dead;
+    done += n;
+  }
+
+  TMSG(NODE_AGGREGATE, "sent %s: %zu bytes as stream %llu", name, len,
+       (unsigned long long) stream);
+  return 0;
+
+dead:
+  EMSG("node aggregator %d is gone or not keeping up, writing %s directly",
+       atomic_load(&segment->aggregator), name);
+  aggregate_active = false;
+  return -1;
+}
+
+
+void
+hpcrun_node_aggregate_fini(void)
+{
+  if (segment == NULL || my_pid != getpid())
+    return;
+
+  if (client_slot >= 0) {
+    atomic_store(&segment->clients[client_slot], 0);
+    client_slot = -1;
+  }
+
+  // The process that launched the aggregator waits for the container to
+  // be complete, so a launcher that cleans up after the last process of
+  // a job does not kill the aggregator first.
+  if (is_creator) {
+    uint64_t start = now_ns();
+    int state;
+    while ((state = atomic_load(&segment->state)) != STATE_DONE
+           && pid_alive(atomic_load(&segment->aggregator))) {
+      if (now_ns() - start > FINISH_TIMEOUT_NS) {
+        EMSG("timed out waiting for the node aggregator to finish");
+        break;
+      }
+      sleep_ns(NS_PER_MS);
+    }
+    TMSG(NODE_AGGREGATE, "node aggregator finished: %s",
+         state == STATE_DONE ? "yes" : "no");
+  }
+
+  aggregate_active = false;
+  unmap_segment();
+}
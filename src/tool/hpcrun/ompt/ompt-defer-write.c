@@ -151,9 +151,6 @@ write_other_td
       continue;
     }
     entry->flag = true;
-    thread_data_t *td = hpcrun_get_thread_data();
-    cct2metrics_t* store_cct2metrics_map = td->core_profile_trace_data.cct2metrics_map;
-    td->core_profile_trace_data.cct2metrics_map = entry->td->core_profile_trace_data.cct2metrics_map;
     if(entry->td->defer_flag) {
       TMSG(DEFER_CTXT, "write another td with id %d", entry->td->core_profile_trace_data.id);
       resolve_cntxt_fini(entry->td);
@@ -162,7 +159,6 @@ write_other_td
     // write out a given td
     hpcrun_write_profile_data(&(entry->td->core_profile_trace_data));
     hpcrun_trace_close(&(entry->td->core_profile_trace_data));
-    td->core_profile_trace_data.cct2metrics_map = store_cct2metrics_map;
 
     entry = entry->next;
   }
@@ -89,6 +89,21 @@
 
 #define DEFER_DEBUGGING 0
 
+// implicit tasks a thread completes between attempts to resolve its
+// pending region contexts
+#define OMPT_RESOLVE_EPOCH_DEFAULT 16
+
+
+
+//*****************************************************************************
+// private variables
+//*****************************************************************************
+
+static int ompt_resolve_epoch = OMPT_RESOLVE_EPOCH_DEFAULT;
+
+// implicit tasks completed by this thread in the current epoch
+static __thread int ompt_resolve_epoch_ticks = 0;
+
 
 
 //*****************************************************************************
@@ -561,7 +576,9 @@ add_pseudo_cct
 }
 
 
-void
+// return false if the region has already ended, so that the
+// notification will never come back to be resolved
+bool
 register_to_region
 (
  ompt_notification_t* notification
@@ -569,16 +586,19 @@ register_to_region
 {
   ompt_region_data_t* region_data = notification->region_data;
 
-  ompt_region_debug_notify_needed(notification);
-
   // create notification and enqueu to region's queue
   OMPT_BASE_T_GET_NEXT(notification) = NULL;
 
   // register thread to region's wait free queue
-  wfq_enqueue(OMPT_BASE_T_STAR(notification), &region_data->queue);
+  if (!ompt_region_register(region_data, notification)) {
+    return false;
+  }
+
+  ompt_region_debug_notify_needed(notification);
 
   // increment the number of unresolved regions
   unresolved_cnt++;
+  return true;
 }
 
 ompt_notification_t*
@@ -647,8 +667,13 @@ register_to_all_regions
     // mark that we took sample
     current_el->took_sample = true;
     if (!current_el->team_master) {
-      // register for region's call path if not the master
-      register_to_region(current_el->notification);
+      // register for region's call path if not the master. if the region
+      // has already ended, its call path never comes: keep the notification
+      // as a master does, so that swap_and_free frees it, and leave the
+      // samples under the unresolved node.
+      if (!register_to_region(current_el->notification)) {
+        current_el->team_master = true;
+      }
       // add unresolved cct at some place underneath thread root
       // find parent of new_cct
       parent_cct = (i == 0) ? hpcrun_get_thread_epoch()->csdata.thread_root
@@ -698,8 +723,14 @@ try_resolve_one_region_context
 {
   ompt_notification_t *old_head = NULL;
 
+  // take every pending notification at once, in the order in which they
+  // arrived, so inner regions are resolved before the regions around them
+  if (!private_threads_queue) {
+    private_threads_queue = (ompt_data_t*) wfq_dequeue_all(&threads_queue);
+  }
+
   old_head = (ompt_notification_t*)
-    wfq_dequeue_private(&threads_queue, OMPT_BASE_T_STAR_STAR(private_threads_queue));
+    freelist_remove_first(OMPT_BASE_T_STAR_STAR(private_threads_queue));
 
   if (!old_head) return 0;
 
@@ -747,12 +778,8 @@ try_resolve_one_region_context
   // free notification
   hpcrun_ompt_notification_free(old_head);
 
-  // check if the notification needs to be forwarded
-  ompt_notification_t* next = (ompt_notification_t*) wfq_dequeue_public(&region_data->queue);
-  if (next) {
-    wfq_enqueue(OMPT_BASE_T_STAR(next), next->threads_queue);
-  } else {
-    // notify creator of region that region_data can be put in region's freelist
+  // the last thread to resolve the region returns it to its creator
+  if (atomic_fetch_sub(&region_data->pending, 1) == 1) {
     hpcrun_ompt_region_free(region_data);
   }
 
@@ -862,12 +889,22 @@ ompt_resolve_region_contexts_poll
  void
 )
 {
-  // if there are any unresolved contexts
-  if (unresolved_cnt) {
-    // attempt to resolve contexts by consuming any notifications that
-    // are currently pending.
+  // if there are any unresolved contexts, attempt to resolve them once
+  // per epoch by consuming all notifications that are currently pending.
+  if (unresolved_cnt && ++ompt_resolve_epoch_ticks >= ompt_resolve_epoch) {
+    ompt_resolve_epoch_ticks = 0;
     while (try_resolve_one_region_context());
-  };
+  }
+}
+
+
+void
+ompt_resolve_epoch_set
+(
+ int implicit_tasks
+)
+{
+  ompt_resolve_epoch = implicit_tasks > 0 ? implicit_tasks : 1;
 }
 
 
@@ -175,6 +175,15 @@ resolve_one_region_context
 );
 
 
+// number of implicit tasks a thread completes between attempts to
+// resolve its pending region contexts
+void
+ompt_resolve_epoch_set
+(
+ int implicit_tasks
+);
+
+
 void
 ompt_resolve_region_contexts_poll
 (
@@ -48,6 +48,9 @@
  * global include files
  *****************************************************************************/
 
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <sys/param.h>
 
 
@@ -60,6 +63,7 @@
 #include <hpcrun/cct/cct-node-vector.h>
 #include <hpcrun/cct2metrics.h>
 #include <hpcrun/device-finalizers.h>
+#include <hpcrun/env.h>
 #include <hpcrun/hpcrun-initializers.h>
 #include <hpcrun/main.h>
 #include <hpcrun/memory/hpcrun-malloc.h>
@@ -69,6 +73,7 @@
 #include <hpcrun/sample-sources/blame-shift/undirected.h>
 #include <hpcrun/sample-sources/sample-filters.h>
 #include <hpcrun/thread_data.h>
+#include <hpcrun/unwind/common/fast-unwind.h>
 
 #include <monitor.h>
 
@@ -93,6 +98,11 @@
 #define OMPT_DEBUG_STARTUP 0
 #define OMPT_DEBUG_TASK 0
 
+// records carved from a fresh arena chunk
+#define OMPT_ARENA_CHUNK_RECORDS 64
+
+#define OMPT_CACHE_LINE 64
+
 
 
 //*****************************************************************************
@@ -119,6 +129,9 @@ static bs_fn_entry_t mutex_bs_entry;
 static bs_fn_entry_t idle_bs_entry;
 static sf_fn_entry_t serial_only_sf_entry;
 
+// arena backing this thread's notifications
+static __thread ompt_arena_t notification_arena;
+
 // state for directed blame shifting away from spinning on a mutex
 static directed_blame_info_t omp_mutex_blame_info;
 
@@ -602,6 +615,9 @@ ompt_initialize
 
   ompt_initialized = 1;
 
+  // call stack trimming compares frame addresses against stack pointers
+  hpcrun_fast_unwind_require_sp();
+
   ompt_init_inquiry_fn_ptrs(lookup);
 
   init_threads();
@@ -633,6 +649,11 @@ ompt_initialize
     ompt_elide = 1;
     ompt_callstack_init();
   }
+  int resolve_epoch;
+  if (hpcrun_get_env_int("HPCRUN_OMPT_RESOLVE_EPOCH", &resolve_epoch)) {
+    ompt_resolve_epoch_set(resolve_epoch);
+  }
+
   if (getenv("HPCRUN_OMP_SERIAL_ONLY")) {
     serial_only_sf_entry.fn = ompt_serial_only;
     serial_only_sf_entry.arg = 0;
@@ -940,6 +961,32 @@ freelist_add_first
   OMPT_BASE_T_GET_NEXT(new) = *head;
   *head = new;
 }
+void *
+hpcrun_ompt_arena_alloc
+(
+ ompt_arena_t *arena,
+ size_t size
+)
+{
+  // records are padded to whole cache lines. a record is enqueued by
+  // other threads, so neighbors must not share a line with it.
+  size = (size + OMPT_CACHE_LINE - 1) & ~((size_t) OMPT_CACHE_LINE - 1);
+
+  if (arena->end - arena->next < (ptrdiff_t) size) {
+    size_t chunk = size * OMPT_ARENA_CHUNK_RECORDS;
+    char *base = (char *) hpcrun_malloc(chunk + OMPT_CACHE_LINE);
+    if (!base) return NULL;
+    arena->next = (char *) (((uintptr_t) base + OMPT_CACHE_LINE - 1)
+                            & ~((uintptr_t) OMPT_CACHE_LINE - 1));
+    arena->end = arena->next + chunk;
+  }
+
+  void *record = arena->next;
+  arena->next += size;
+  return record;
+}
+
+
 // allocating and free notifications
 ompt_notification_t*
 hpcrun_ompt_notification_alloc
@@ -950,7 +997,8 @@ hpcrun_ompt_notification_alloc
   // only the current thread uses notification_freelist_head
   ompt_notification_t* first = (ompt_notification_t*) freelist_remove_first(
           OMPT_BASE_T_STAR_STAR(notification_freelist_head));
-  return first ? first : (ompt_notification_t*)hpcrun_malloc(sizeof(ompt_notification_t));
+  return first ? first : (ompt_notification_t*)
+    hpcrun_ompt_arena_alloc(&notification_arena, sizeof(ompt_notification_t));
 }
 
 
@@ -199,6 +199,18 @@ ompt_task_full_context_p
  void
 );
 
+//-----------------------------------------------------------------------------
+// carve a cache-line aligned record out of a per-thread arena
+//-----------------------------------------------------------------------------
+
+void *
+hpcrun_ompt_arena_alloc
+(
+ ompt_arena_t *arena,
+ size_t size
+);
+
+
 //-----------------------------------------------------------------------------
 // allocate and free notifications
 //-----------------------------------------------------------------------------
@@ -151,6 +151,26 @@ wfq_dequeue_public
   return first;
 }
 
+// detach all elements of the queue with a single exchange and return
+// them as a nil-terminated list in the order in which they were enqueued.
+// the caller owns the returned list exclusively.
+ompt_base_t*
+wfq_dequeue_all
+(
+ ompt_wfq_t *queue
+)
+{
+  ompt_base_t* lifo = atomic_exchange(&queue->head, ompt_base_nil);
+  ompt_base_t* fifo = ompt_base_nil;
+  while (lifo) {
+    ompt_base_t* next = wfq_get_next(lifo);
+    atomic_store(&lifo->next.anext, fifo);
+    fifo = lifo;
+    lifo = next;
+  }
+  return fifo;
+}
+
 // returns first element from private list
 // if it is empty, takes all element from public queue
 // and store them to private list
@@ -114,6 +114,13 @@ wfq_dequeue_public
 );
 
 
+ompt_base_t *
+wfq_dequeue_all
+(
+ ompt_wfq_t *queue
+);
+
+
 ompt_base_t *
 wfq_dequeue_private
 (
@@ -86,6 +86,9 @@
 // private freelist from which only thread owner can reused regions
 static __thread ompt_data_t* private_region_freelist_head = NULL;
 
+// arena backing the regions created by this thread
+static __thread ompt_arena_t region_arena;
+
 
 //*****************************************************************************
 // forward declarations
@@ -121,6 +124,12 @@ ompt_region_data_new
   e->call_path = call_path;
 
   wfq_init(&e->queue);
+  atomic_init(&e->pending, 0);
+
+  // reopen the region only once its id is set, so that a registration
+  // late for the region this one was recycled from is refused. any such
+  // registration still in flight keeps its count.
+  atomic_fetch_and(&e->registering, ~OMPT_REGION_CLOSED);
 
   // parts for freelist
   OMPT_BASE_T_GET_NEXT(e) = NULL;
@@ -186,8 +195,16 @@ ompt_parallel_end_internal
   ompt_region_data_t* region_data = (ompt_region_data_t*)parallel_data->ptr;
 
   if (!ompt_eager_context_p()){
-    // check if there is any thread registered that should be notified that region call path is available
-    ompt_notification_t* to_notify = (ompt_notification_t*) wfq_dequeue_public(&region_data->queue);
+    // take all threads registered to be notified that the region call path
+    // is available. a worker may still register after its implicit task
+    // passed the closing barrier, so close the region first and wait for
+    // registrations in flight, so that none is left behind in the queue.
+    unsigned int registering =
+      atomic_fetch_or(&region_data->registering, OMPT_REGION_CLOSED);
+    while (registering != OMPT_REGION_CLOSED) {
+      registering = atomic_load(&region_data->registering);
+    }
+    ompt_notification_t* to_notify = (ompt_notification_t*) wfq_dequeue_all(&region_data->queue);
 
     region_stack_el_t *stack_el = &region_stack[top_index + 1];
     ompt_notification_t *notification = stack_el->notification;
@@ -218,8 +235,22 @@ ompt_parallel_end_internal
         ending_region = NULL;
       }
 
-      // notify next thread
-      wfq_enqueue(OMPT_BASE_T_STAR(to_notify), to_notify->threads_queue);
+      // the region is released by whichever thread resolves it last,
+      // so count the notifications before handing out any of them
+      int pending = 0;
+      for (ompt_notification_t* n = to_notify; n;
+           n = (ompt_notification_t*) OMPT_BASE_T_GET_NEXT(n)) {
+        pending++;
+      }
+      atomic_store(&region_data->pending, pending);
+
+      // notify all registered threads at once
+      while (to_notify) {
+        ompt_notification_t* next =
+          (ompt_notification_t*) OMPT_BASE_T_GET_NEXT(to_notify);
+        wfq_enqueue(OMPT_BASE_T_STAR(to_notify), to_notify->threads_queue);
+        to_notify = next;
+      }
     } else {
       // if none, you can reuse region
       // this thread is region creator, so it could add to private region's list
@@ -388,7 +419,9 @@ ompt_region_alloc
  void
 )
 {
-  ompt_region_data_t* r = (ompt_region_data_t*) hpcrun_malloc(sizeof(ompt_region_data_t));
+  ompt_region_data_t* r = (ompt_region_data_t*)
+    hpcrun_ompt_arena_alloc(&region_arena, sizeof(ompt_region_data_t));
+  atomic_init(&r->registering, OMPT_REGION_CLOSED);
   return r;
 }
 
@@ -455,6 +488,31 @@ hpcrun_ompt_region_free
 }
 
 
+bool
+ompt_region_register
+(
+ ompt_region_data_t *region_data,
+ ompt_notification_t *notification
+)
+{
+  unsigned int registering = atomic_load(&region_data->registering);
+  do {
+    if (registering & OMPT_REGION_CLOSED) return false;
+  } while (!atomic_compare_exchange_weak(&region_data->registering, &registering,
+                                         registering + OMPT_REGION_REGISTERING));
+
+  // region records are never unmapped, only recycled. if this one was
+  // recycled after the notification was made, it is for another region.
+  bool registered = region_data->region_id == notification->region_id;
+  if (registered) {
+    wfq_enqueue(OMPT_BASE_T_STAR(notification), &region_data->queue);
+  }
+
+  atomic_fetch_sub(&region_data->registering, OMPT_REGION_REGISTERING);
+  return registered;
+}
+
+
 
 //*****************************************************************************
 // interface operations
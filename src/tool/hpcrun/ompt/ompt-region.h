@@ -83,5 +83,16 @@ hpcrun_ompt_region_free
 );
 
 
+// enqueue notification to be resolved when its region ends. returns
+// false if the region has already ended, or been recycled for another
+// region, and the notification will never be resolved.
+bool
+ompt_region_register
+(
+ ompt_region_data_t *region_data,
+ ompt_notification_t *notification
+);
+
+
 
 #endif
@@ -129,8 +129,21 @@ typedef struct ompt_region_data_s {
   int depth;
 
   struct ompt_region_data_s *next_region;
+
+  // number of notifications handed out at the end of the region
+  // that have not been resolved yet. the last thread to resolve
+  // its notification returns the region to its creator.
+  _Atomic(int) pending;
+
+  // OMPT_REGION_CLOSED once the region has ended and its queue has been
+  // drained, plus OMPT_REGION_REGISTERING for every registration that is
+  // enqueueing its notification. kept when the region is recycled.
+  _Atomic(unsigned int) registering;
 } ompt_region_data_t;
 
+#define OMPT_REGION_CLOSED       1u
+#define OMPT_REGION_REGISTERING  2u
+
 
 typedef struct ompt_notification_s{
   // it can also cover freelist to, we do not need another next_freelist
@@ -163,6 +176,15 @@ typedef struct ompt_trl_el_s {
 } ompt_trl_el_t;
 
 
+// per-thread arena from which notifications and regions are carved
+// a chunk at a time. records are recycled through the freelists and
+// never returned to the arena.
+typedef struct ompt_arena_s {
+  char *next;
+  char *end;
+} ompt_arena_t;
+
+
 // region stack element which points to the corresponding
 // notification, and says if thread took sample and if the
 // thread is the master in team
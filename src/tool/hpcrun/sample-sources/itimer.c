@@ -96,6 +96,7 @@
 #include <hpcrun/main.h>
 #include <hpcrun/metrics.h>
 #include <hpcrun/safe-sampling.h>
+#include <hpcrun/sample_budget.h>
 #include <hpcrun/sample_event.h>
 #include <hpcrun/sample_sources_registered.h>
 #include <hpcrun/thread_data.h>
@@ -273,6 +274,14 @@ hpcrun_start_timer(thread_data_t *td)
 {
 #ifdef ENABLE_CLOCK_REALTIME
   if (use_realtime || use_cputime) {
+    if (hpcrun_sample_budget_active()) {
+      // rearm with this thread's share of the overhead budget
+      struct itimerspec spec = itspec_start;
+      long ns = (long) (period * 1000 * hpcrun_sample_budget_scale());
+      spec.it_value.tv_sec = ns / 1000000000;
+      spec.it_value.tv_nsec = ns % 1000000000;
+      return hpcrun_settime(td, &spec);
+    }
     return hpcrun_settime(td, &itspec_start);
   }
 #else
@@ -705,7 +714,7 @@ itimer_signal_handler(int sig, siginfo_t* siginfo, void* context)
   sampling_info_t info = {
     .sample_clock = 0,
     .sample_data = NULL,
-    .sampling_period = period * 1000,
+    .sampling_period = (uint64_t) (period * 1000 * hpcrun_sample_budget_scale()),
     .is_time_based_metric = 1
   };
 
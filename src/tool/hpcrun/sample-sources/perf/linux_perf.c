@@ -55,6 +55,7 @@
 #include <fcntl.h>
 #include <signal.h>
 #include <stdio.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
@@ -98,12 +99,14 @@
 #include <hpcrun/messages/messages.h>
 #include <hpcrun/metrics.h>
 #include <hpcrun/safe-sampling.h>
+#include <hpcrun/sample_budget.h>
 #include <hpcrun/sample_event.h>
 #include <hpcrun/sample_sources_registered.h>
 #include <hpcrun/sample-sources/blame-shift/blame-shift.h>
 #include <hpcrun/utilities/tokenize.h>
 #include <hpcrun/utilities/arch/context-pc.h>
 #include <hpcrun/trace.h>
+#include <unwind/common/fast-unwind.h>
 
 #include <evlist.h>
 #include <limits.h>   // PATH_MAX
@@ -258,6 +261,35 @@ perf_start_all(int nevents, event_thread_t *event_thread)
   }
 }
 
+/*
+ * Move the period of each counter sampling with a fixed period to this
+ * thread's share of the overhead budget. Counters must be disabled.
+ */
+static void
+perf_budget_adjust(int nevents, event_thread_t *event_thread)
+{
+  if (!hpcrun_sample_budget_active())
+    return;
+
+  double scale = hpcrun_sample_budget_scale();
+
+  for(int i=0; i<nevents; i++) {
+    event_thread_t *et = &event_thread[i];
+    if (et->fd<0 || et->event->attr.freq)
+      continue;
+
+    u64 period = (u64) (et->event->attr.sample_period * scale);
+    if (period < 1)
+      period = 1;
+    if (period == et->period)
+      continue;
+
+    if (ioctl(et->fd, PERF_EVENT_IOC_PERIOD, &period) == 0) {
+      et->period = period;
+    }
+  }
+}
+
 /*
  * Disable all the counters
  */
@@ -388,6 +420,7 @@ static bool
 perf_thread_init(event_info_t *event, event_thread_t *et)
 {
   et->event = event;
+  et->period = event->attr.sample_period;
   // ask sys to "create" the event
   // it returns -1 if it fails.
   et->fd = perf_event_open(&event->attr,
@@ -502,21 +535,57 @@ get_fd_index(int nevents, int fd, event_thread_t *event_thread)
 }
 
 
+// Convert the CLOCK_MONOTONIC time of a perf sample (see
+// perf_util_attr_init) to the clock of the traces, in nanoseconds since
+// the epoch.
+static uint64_t
+perf_sample_clock(u64 time)
+{
+  struct timespec mono, real;
+  clock_gettime(CLOCK_MONOTONIC, &mono);
+  clock_gettime(CLOCK_REALTIME, &real);
+  uint64_t now_mono = (uint64_t) mono.tv_sec * 1000000000 + mono.tv_nsec;
+  uint64_t now_real = (uint64_t) real.tv_sec * 1000000000 + real.tv_nsec;
+  if (time == 0 || time > now_mono || now_mono - time > now_real) {
+    return 0;
+  }
+  return now_real - (now_mono - time);
+}
+
+
 static sample_val_t*
 record_sample(event_thread_t *current, perf_mmap_data_t *mmap_data,
-    void* context, sample_val_t* sv)
+    void* context, sample_val_t* sv, bool stale)
 {
   if (current == NULL || current->event == NULL || current->event->perf_metric_id < 0)
     return NULL;
 
+  // ----------------------------------------------------------------------------
+  // a sample older than the newest one in a batch was not taken at the
+  // interrupted context: it can only be attributed by its kernel callchain
+  // ----------------------------------------------------------------------------
+  if (stale && !hpcrun_fast_unwind_context_free(mmap_data)) {
+    hpcrun_stats_num_samples_dropped_inc();
+    return NULL;
+  }
+
   // ----------------------------------------------------------------------------
   // for event with frequency, we need to increase the counter by its period
   // sampling taken by perf event kernel
   // ----------------------------------------------------------------------------
-  uint64_t metric_inc = 1;
+  double metric_inc = 1;
   if (current->event->attr.freq==1 && mmap_data->period > 0)
     metric_inc = mmap_data->period;
 
+  // ----------------------------------------------------------------------------
+  // if the overhead budget has moved the period away from the metric's period,
+  // weight the sample by the period it actually covers. without the budget the
+  // period is never reprogrammed, and the weight must stay 1: the metric's
+  // period already scales every sample of a fixed-period event.
+  // ----------------------------------------------------------------------------
+  else if (hpcrun_sample_budget_active() && mmap_data->period > 0)
+    metric_inc = (double) mmap_data->period / current->event->attr.sample_period;
+
   // ----------------------------------------------------------------------------
   // record time enabled and time running
   // if the time enabled is not the same as running time, then it's multiplexed
@@ -562,14 +631,16 @@ record_sample(event_thread_t *current, perf_mmap_data_t *mmap_data,
   // ----------------------------------------------------------------------------
   int time_based_metric = (hpcrun_cycles_metric_id == current->event->hpcrun_metric_id) ? 1 : 0;
   sampling_info_t info = {
-    .sample_clock = 0,
+    .sample_clock = stale ? perf_sample_clock(mmap_data->time) : 0,
     .sample_data = mmap_data,
     .sampling_period = hpcrun_cycles_cmd_period,
     .is_time_based_metric = time_based_metric
   };
+  hpcrun_fast_unwind_set_context_stale(stale);
   *sv = hpcrun_sample_callpath(context, current->event->hpcrun_metric_id,
         (hpcrun_metricVal_t) {.r=counter},
         0/*skipInner*/, 0/*isSync*/, &info);
+  hpcrun_fast_unwind_set_context_stale(false);
 
   blame_shift_apply(current->event->hpcrun_metric_id, sv->sample_node,
                     counter /*metricIncr*/);
@@ -1178,10 +1249,15 @@ perf_event_handler(
   event_info_t *event_info     = (event_info_t *) current->event;
   struct perf_event_attr *attr = &event_info->attr;
 
+  // ----------------------------------------------------------------------------
+  // with wakeup_events > 1 the kernel signals once per batch: drain it all
+  // ----------------------------------------------------------------------------
+  bool batched = perf_util_get_wakeup_events() > 1;
+
   int more_data = 0;
   do {
     perf_mmap_data_t mmap_data;
-    memset(&mmap_data, 0, sizeof(perf_mmap_data_t));
+    memset(&mmap_data, 0, offsetof(perf_mmap_data_t, ips));
 
     // reading info from mmapped buffer
     more_data = read_perf_buffer(current->mmap, attr, &mmap_data);
@@ -1189,13 +1265,17 @@ perf_event_handler(
     sample_val_t sv;
     memset(&sv, 0, sizeof(sample_val_t));
 
+    // only the newest sample was taken at the interrupted context; records
+    // of other kinds may still follow it
     if (mmap_data.header_type == PERF_RECORD_SAMPLE)
-      record_sample(current, &mmap_data, context, &sv);
+      record_sample(current, &mmap_data, context, &sv,
+                    batched && more_data && perf_sample_pending(current->mmap));
 
     kernel_block_handler(current, sv, &mmap_data);
 
-  } while (more_data);
+  } while (batched && more_data);
 
+  perf_budget_adjust(nevents, event_thread);
   perf_start_all(nevents, event_thread);
 
   hpcrun_safe_exit();
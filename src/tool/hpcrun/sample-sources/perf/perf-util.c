@@ -48,6 +48,7 @@
 
 #include <linux/version.h>
 #include <ctype.h>
+#include <time.h>
 
 
 /******************************************************************************
@@ -55,6 +56,7 @@
  *****************************************************************************/
 
 #include <hpcrun/cct_insert_backtrace.h>
+#include <unwind/common/fast-unwind.h>
 #include <lib/prof-lean/spinlock.h>     // hostid
 #include <lib/support-lean/OSUtil.h>     // hostid
 
@@ -65,6 +67,9 @@
 
 #define MAX_BUFFER_LINUX_KERNEL 128
 
+#define HPCRUN_PERF_WAKEUP_EVENTS "HPCRUN_PERF_WAKEUP_EVENTS"
+#define MAX_WAKEUP_EVENTS 256
+
 
 //******************************************************************************
 // constants
@@ -208,6 +213,45 @@ perf_get_kernel_lm_id()
 
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(3,7,0)
 
+//----------------------------------------------------------
+// a callchain lists kernel frames (if any) before user frames.
+// return the index of the marker that starts the user frames,
+// or the length of the callchain if there are none.
+//----------------------------------------------------------
+static int
+perf_callchain_user_index(
+  perf_mmap_data_t *data
+)
+{
+  int nr = (int) data->nr;   // at most MAX_CALLCHAIN_FRAMES
+  for (int i = 0; i < nr; i++) {
+    if (data->ips[i] == PERF_CONTEXT_USER) return i;
+  }
+  return nr;
+}
+
+
+//----------------------------------------------------------
+// return the user-mode frames of a callchain for the fast
+// unwinder
+//----------------------------------------------------------
+static int
+perf_user_callchain(
+  void *data_aux,
+  const uint64_t **ips
+)
+{
+  perf_mmap_data_t *data = (perf_mmap_data_t*) data_aux;
+
+  int nr = (int) data->nr;
+  int user_index = perf_callchain_user_index(data);
+  if (user_index >= nr) return 0;
+
+  *ips = (const uint64_t *) &data->ips[user_index + 1];
+  return nr - user_index - 1;
+}
+
+
 //----------------------------------------------------------
 // extend a user-mode callchain with kernel frames (if any)
 //----------------------------------------------------------
@@ -224,7 +268,8 @@ perf_add_kernel_callchain(
   }
 
   perf_mmap_data_t *data = (perf_mmap_data_t*) data_aux;
-  if (data->nr > 0) {
+  int nr_kernel = perf_callchain_user_index(data);
+  if (nr_kernel > 0) {
     uint16_t kernel_lm_id = perf_get_kernel_lm_id();
 
     // bug #44 https://github.com/HPCToolkit/hpctoolkit/issues/44
@@ -236,7 +281,7 @@ perf_add_kernel_callchain(
 
     // add kernel IPs to the call chain top down, which is the
     // reverse of the order in which they appear in ips[]
-    for (int i = data->nr - 1; i > 0; i--) {
+    for (int i = nr_kernel - 1; i > 0; i--) {
       parent = perf_insert_cct(kernel_lm_id, parent, data->ips[i]);
     }
 
@@ -293,6 +338,64 @@ perf_util_get_max_sample_rate()
 }
 
 
+//----------------------------------------------------------
+// returns the maximum number of frames the kernel records in
+// a callchain, from LINUX_PERF_EVENTS_MAX_STACK. asking for
+// more than that fails perf_event_open.
+//----------------------------------------------------------
+int
+perf_util_get_max_stack()
+{
+  static int initialized = 0;
+  static int max_stack = 127; // the kernel's default
+  if (!initialized) {
+    FILE *perf_stack_file = fopen(LINUX_PERF_EVENTS_MAX_STACK, "r");
+
+    if (perf_stack_file != NULL) {
+      fscanf(perf_stack_file, "%d", &max_stack);
+      fclose(perf_stack_file);
+    }
+    initialized = 1;
+  }
+  return max_stack;
+}
+
+
+//----------------------------------------------------------
+// returns the number of samples the kernel takes before it
+// signals us, from HPCRUN_PERF_WAKEUP_EVENTS (default 1).
+// only the newest sample in a batch is taken at the context
+// the signal interrupts, so the older ones must be unwound
+// from the callchains the kernel records: batches are only
+// allowed in the callchain fast-unwind mode.
+//----------------------------------------------------------
+int
+perf_util_get_wakeup_events()
+{
+  static int initialized = 0;
+  static int wakeup_events = 1;
+  if (!initialized) {
+    const char *str = getenv(HPCRUN_PERF_WAKEUP_EVENTS);
+    int val = (str != NULL) ? atoi(str) : 1;
+
+    if (val > MAX_WAKEUP_EVENTS) {
+      val = MAX_WAKEUP_EVENTS;
+    }
+    if (val > 1 && hpcrun_fast_unwind_mode() != HPCRUN_FAST_UNWIND_CALLCHAIN) {
+      EMSG("WARNING: %s requires --fast-unwind callchain, ignored",
+           HPCRUN_PERF_WAKEUP_EVENTS);
+      val = 1;
+    }
+    if (val > 1) {
+      wakeup_events = val;
+    }
+    TMSG(LINUX_PERF, "wakeup events: %d", wakeup_events);
+    initialized = 1;
+  }
+  return wakeup_events;
+}
+
+
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(3,7,0)
 //----------------------------------------------------------
 // testing perf availability
@@ -350,6 +453,10 @@ perf_util_init()
     hpcrun_kernel_callpath_register(perf_add_kernel_callchain);
     ksym_status = PERF_AVAILABLE;
   }
+
+  if (hpcrun_fast_unwind_mode() == HPCRUN_FAST_UNWIND_CALLCHAIN) {
+    hpcrun_user_callchain_register(perf_user_callchain);
+  }
 #endif
 }
 
@@ -400,8 +507,16 @@ perf_util_attr_init(
   }
 
   attr->disabled       = 1;                 /* the counter will be enabled later  */
-  attr->wakeup_events  = 1;                 /* wake up every samples */
+  attr->wakeup_events  = perf_util_get_wakeup_events(); /* wake up every N samples */
   attr->sample_type    = sample_type;
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,1,0)
+  if (attr->wakeup_events > 1) {
+    /* samples delivered in a batch are traced at the time they were taken */
+    attr->use_clockid = 1;
+    attr->clockid     = CLOCK_MONOTONIC;
+  }
+#endif
   attr->exclude_kernel = EXCLUDE;
   attr->exclude_hv     = EXCLUDE;
 
@@ -419,6 +534,20 @@ perf_util_attr_init(
     attr->exclude_kernel           = INCLUDE;
   }
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3,7,0)
+  if (hpcrun_fast_unwind_mode() == HPCRUN_FAST_UNWIND_CALLCHAIN) {
+    /* let the kernel walk the user stack so we don't have to */
+    attr->sample_type             |= PERF_SAMPLE_CALLCHAIN;
+    attr->exclude_callchain_user   = INCLUDE_CALLCHAIN;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,8,0)
+    /* no more frames than perf_mmap_data_t holds with the context markers */
+    int max_stack = MAX_CALLCHAIN_FRAMES - PERF_MAX_CONTEXTS_PER_STACK;
+    int kernel_max_stack = perf_util_get_max_stack();
+    attr->sample_max_stack = (max_stack < kernel_max_stack ? max_stack : kernel_max_stack);
+#endif
+  }
+#endif
+
   char *name;
   int precise_ip_type = perf_skid_parse_event(event_name, &name);
   free(name);
@@ -58,8 +58,21 @@
 
 // the number of maximum frames (call chains)
 // For kernel only call chain, I think 32 is a good number.
-// If we include user call chains, it should be bigger than that.
-#define MAX_CALLCHAIN_FRAMES 32
+// If we include user call chains (HPCRUN_FAST_UNWIND=callchain), it
+// should be bigger than that: 127 is the kernel's default for
+// /proc/sys/kernel/perf_event_max_stack, plus the context markers.
+// Only one perf_mmap_data_t is live at a time, on the stack of the
+// signal handler, and ips is not cleared for each sample, so the
+// larger array costs about 1 KiB of that stack and no time.
+// Build with -DMAX_CALLCHAIN_FRAMES=n to change it; the kernel is
+// never asked for more frames than fit.
+#ifndef MAX_CALLCHAIN_FRAMES
+#define MAX_CALLCHAIN_FRAMES 136
+#endif
+
+#ifndef PERF_MAX_CONTEXTS_PER_STACK
+#define PERF_MAX_CONTEXTS_PER_STACK 8
+#endif
 
 
 /******************************************************************************
@@ -80,7 +93,7 @@ typedef struct perf_mmap_data_s {
   u64    period;     /* if PERF_SAMPLE_PERIOD */
                      /* if PERF_SAMPLE_READ */
   u64    nr;         /* if PERF_SAMPLE_CALLCHAIN */
-  u64    ips[MAX_CALLCHAIN_FRAMES];       /* if PERF_SAMPLE_CALLCHAIN */
+                     /* ips: if PERF_SAMPLE_CALLCHAIN, see below */
   u32    size;       /* if PERF_SAMPLE_RAW */
   char   *data;      /* if PERF_SAMPLE_RAW */
   /* if PERF_SAMPLE_BRANCH_STACK */
@@ -104,6 +117,10 @@ typedef struct perf_mmap_data_s {
   u32   header_misc; /* information about the sample */
   u32   header_type; /* either sample record or other */
 
+  // last, so clearing the fields before it leaves the frames alone:
+  // only the first nr of them are valid
+  u64    ips[MAX_CALLCHAIN_FRAMES];       /* if PERF_SAMPLE_CALLCHAIN */
+
 } perf_mmap_data_t;
 
 
@@ -137,6 +154,7 @@ typedef struct event_thread_s {
   pe_mmap_t    *mmap;  // mmap buffer
   int          fd;     // file descriptor of the event
   event_info_t *event; // pointer to main event description
+  u64          period; // sampling period currently set in the kernel
 
 } event_thread_t;
 
@@ -166,6 +184,12 @@ perf_util_get_paranoid_level();
 int
 perf_util_get_max_sample_rate();
 
+int
+perf_util_get_max_stack();
+
+int
+perf_util_get_wakeup_events();
+
 int
 perf_util_check_precise_ip_suffix(char *event);
 
@@ -83,11 +83,16 @@
 
 #define MMAP_OFFSET_0            0
 
-#define PERF_DATA_PAGE_EXP        1      // use 2^PERF_DATA_PAGE_EXP pages
+#define PERF_DATA_PAGE_EXP        1      // use at least 2^PERF_DATA_PAGE_EXP pages
 #define PERF_DATA_PAGES           (1 << PERF_DATA_PAGE_EXP)
+#define PERF_MAX_DATA_PAGES       64
 
-#define PERF_MMAP_SIZE(pagesz)    ((pagesz) * (PERF_DATA_PAGES + 1))
-#define PERF_TAIL_MASK(pagesz)    (((pagesz) * PERF_DATA_PAGES) - 1)
+// room to budget for each sample in a batch, enough for a sample with
+// a long callchain
+#define PERF_BATCH_RECORD_SIZE    1024
+
+#define PERF_MMAP_SIZE(pagesz)    ((pagesz) * (data_pages + 1))
+#define PERF_TAIL_MASK(pagesz)    (((pagesz) * data_pages) - 1)
 
 #define BUFFER_FRONT(current_perf_mmap)              ((char *) current_perf_mmap + pagesize)
 #define BUFFER_SIZE               (tail_mask + 1)
@@ -107,6 +112,7 @@
 
 static int pagesize      = 0;
 static size_t tail_mask  = 0;
+static int data_pages    = PERF_DATA_PAGES;
 
 
 /******************************************************************************
@@ -165,6 +171,20 @@ perf_read(u64 data_head, u64 *data_tail,
 }
 
 
+//----------------------------------------------------------
+// advance the tail past bytes we have no room to store
+//----------------------------------------------------------
+static int
+perf_skip(u64 data_head, u64 *data_tail, size_t bytes_skipped)
+{
+  if (bytes_skipped > data_head - *data_tail) return -1;
+
+  *data_tail += bytes_skipped;
+
+  return 0;
+}
+
+
 static inline int
 perf_read_header(u64 data_head, u64 *data_tail,
   pe_mmap_t *current_perf_mmap,
@@ -257,7 +277,9 @@ perf_sample_callchain(u64 data_head, u64 *data_tail,
 
       // read the IPs for the frames
       if (perf_read(data_head, data_tail,
-                    current_perf_mmap, mmap_data->ips, num_records * sizeof(u64)) != 0) {
+                    current_perf_mmap, mmap_data->ips, mmap_data->nr * sizeof(u64)) != 0
+          || perf_skip(data_head, data_tail,
+                       (num_records - mmap_data->nr) * sizeof(u64)) != 0) {
         // the data seems invalid
         mmap_data->nr = 0;
         TMSG(LINUX_PERF, "unable to read all %d frames", num_records);
@@ -488,7 +510,36 @@ read_perf_buffer(pe_mmap_t *current_perf_mmap,
   rmb();  // memory fence before writing data_tail
   current_perf_mmap->data_tail += hdr.size;
 
-  return (data_tail-current_perf_mmap->data_tail);
+  // nonzero if more records were already in the buffer
+  return (data_head != current_perf_mmap->data_tail);
+}
+
+
+//----------------------------------------------------------
+// look through the records left in the buffer, without
+// consuming them.
+// return true if a sample record is among them,
+//        false otherwise
+//----------------------------------------------------------
+bool
+perf_sample_pending(pe_mmap_t *current_perf_mmap)
+{
+  pe_header_t hdr;
+  u64 data_tail = current_perf_mmap->data_tail;
+  u64 data_head = current_perf_mmap->data_head;
+
+  rmb();  // memory fence after reading the data head
+
+  while (perf_read_header(data_head, &data_tail, current_perf_mmap, &hdr) == 0
+         && hdr.size >= sizeof(pe_header_t)) {
+    if (hdr.type == PERF_RECORD_SAMPLE) {
+      return true;
+    }
+    if (perf_skip(data_head, &data_tail, hdr.size - sizeof(pe_header_t)) != 0) {
+      break;
+    }
+  }
+  return false;
 }
 
 //----------------------------------------------------------
@@ -537,5 +588,14 @@ void
 perf_mmap_init()
 {
   pagesize = sysconf(_SC_PAGESIZE);
+
+  // when the kernel signals only every few samples, the buffer must hold
+  // a whole batch, twice over so a batch can land while one is drained
+  size_t batch_bytes = 2 * (size_t) perf_util_get_wakeup_events() * PERF_BATCH_RECORD_SIZE;
+  data_pages = PERF_DATA_PAGES;
+  while (data_pages * (size_t) pagesize < batch_bytes && data_pages < PERF_MAX_DATA_PAGES) {
+    data_pages *= 2;
+  }
+
   tail_mask = PERF_TAIL_MASK(pagesize);
 }
@@ -53,6 +53,8 @@
 /******************************************************************************
  *  headers
  *****************************************************************************/
+#include <stdbool.h>
+
 #include <linux/perf_event.h>
 
 #include "perf-util.h"
@@ -78,5 +80,8 @@ int
 read_perf_buffer(pe_mmap_t *current_perf_mmap,
     struct perf_event_attr *attr, perf_mmap_data_t *mmap_info);
 
+bool
+perf_sample_pending(pe_mmap_t *current_perf_mmap);
+
 
 #endif
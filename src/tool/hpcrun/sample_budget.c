@@ -0,0 +1,216 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2023, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <messages/messages.h>
+#include "env.h"
+#include "sample_budget.h"
+
+#define MIN_BUDGET  0.01
+#define MAX_BUDGET  50.0
+
+// Bounds on the period scale, relative to the period requested for
+// each event.  The budget only caps the overhead: it never samples
+// faster than requested.
+#define MIN_SCALE  1.0
+#define MAX_SCALE  64.0
+
+// Bounds on the change of scale at the end of one window.
+#define MIN_STEP  0.5
+#define MAX_STEP  2.0
+
+#define WINDOW_SAMPLES  32
+#define WINDOW_NS       (100 * 1000 * 1000)
+
+static bool budget_active = false;
+static double budget = 0.0;   // target fraction of time in the handler
+
+static atomic_uint_fast64_t total_busy_ns = ATOMIC_VAR_INIT(0);
+static atomic_uint_fast64_t total_elapsed_ns = ATOMIC_VAR_INIT(0);
+static atomic_long num_adjustments = ATOMIC_VAR_INIT(0);
+
+static __thread double   scale = 1.0;
+static __thread uint64_t window_start = 0;
+static __thread uint64_t window_busy = 0;
+static __thread int      window_samples = 0;
+
+
+// -------------------------------------------------------------------
+// This file implements overhead-budgeted sampling.  If
+// HPCRUN_OVERHEAD_BUDGET is set in the environment to a percentage,
+// then each thread measures the time it spends handling samples and,
+// every WINDOW_SAMPLES samples or WINDOW_NS nanoseconds, whichever
+// comes later, scales its sampling periods to bring that time back
+// toward the budget.
+//
+// The scale is applied by the sample sources when they rearm a
+// thread's timer or counter.  A sample source whose metric values do
+// not already measure the elapsed interval (e.g. perf events with a
+// fixed period) weights each sample by its actual period over the
+// requested one, so the metric totals stay unbiased.
+// -------------------------------------------------------------------
+
+
+static inline uint64_t
+now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+void
+hpcrun_sample_budget_init(void)
+{
+  char *str = getenv(HPCRUN_OVERHEAD_BUDGET);
+  double val;
+
+  budget_active = false;
+  if (str == NULL) {
+    return;
+  }
+
+  if (sscanf(str, "%lf", &val) < 1 || val < MIN_BUDGET || val > MAX_BUDGET) {
+    EMSG("%s = '%s' is not a percentage between %g and %g, ignored",
+         HPCRUN_OVERHEAD_BUDGET, str, MIN_BUDGET, MAX_BUDGET);
+    return;
+  }
+
+  budget = val / 100.0;
+  budget_active = true;
+  TMSG(SAMPLE_BUDGET, "overhead budget: %g%%, scale in [%g, %g]",
+       val, MIN_SCALE, MAX_SCALE);
+}
+
+
+bool
+hpcrun_sample_budget_active(void)
+{
+  return budget_active;
+}
+
+
+uint64_t
+hpcrun_sample_budget_begin(void)
+{
+  return budget_active ? now_ns() : 0;
+}
+
+
+// Async-signal safe: called at the end of every sample.
+void
+hpcrun_sample_budget_end(uint64_t begin)
+{
+  if (!budget_active) {
+    return;
+  }
+
+  uint64_t end = now_ns();
+
+  // the first sample on a thread only starts its first window
+  if (window_start == 0) {
+    window_start = end;
+    return;
+  }
+
+  window_busy += end - begin;
+  window_samples++;
+
+  uint64_t elapsed = end - window_start;
+  if (window_samples < WINDOW_SAMPLES || elapsed < WINDOW_NS) {
+    return;
+  }
+
+  double step = ((double) window_busy / elapsed) / budget;
+  if (step < MIN_STEP) step = MIN_STEP;
+  if (step > MAX_STEP) step = MAX_STEP;
+
+  double next = scale * step;
+  if (next < MIN_SCALE) next = MIN_SCALE;
+  if (next > MAX_SCALE) next = MAX_SCALE;
+  if (next != scale) {
+    atomic_fetch_add_explicit(&num_adjustments, 1, memory_order_relaxed);
+  }
+  scale = next;
+
+  atomic_fetch_add_explicit(&total_busy_ns, window_busy, memory_order_relaxed);
+  atomic_fetch_add_explicit(&total_elapsed_ns, elapsed, memory_order_relaxed);
+
+  window_start = end;
+  window_busy = 0;
+  window_samples = 0;
+}
+
+
+double
+hpcrun_sample_budget_scale(void)
+{
+  return scale;
+}
+
+
+void
+hpcrun_sample_budget_summary(void)
+{
+  if (!budget_active) {
+    return;
+  }
+
+  uint64_t busy = atomic_load_explicit(&total_busy_ns, memory_order_relaxed);
+  uint64_t elapsed = atomic_load_explicit(&total_elapsed_ns, memory_order_relaxed);
+
+  AMSG("OVERHEAD BUDGET: target: %.2f%%, measured: %.2f%%, "
+       "period adjustments: %ld",
+       budget * 100.0, elapsed > 0 ? 100.0 * busy / elapsed : 0.0,
+       atomic_load_explicit(&num_adjustments, memory_order_relaxed));
+}
@@ -69,6 +69,8 @@
 #include <utilities/arch/context-pc.h>
 #include "hpcrun-malloc.h"
 #include "sample_event.h"
+#include "sample_budget.h"
+#include "sample_phase.h"
 #include "sample_sources_all.h"
 #include "start-stop.h"
 #include "uw_recipe_map.h"
@@ -168,7 +170,8 @@ hpcrun_drop_sample(void)
 }
 
 static cct_node_t *
-hpcrun_trace_ip(ip_normalized_t leaf_ip, cct_node_t *parent, int metricId, uint64_t sampling_period)
+hpcrun_trace_ip(ip_normalized_t leaf_ip, cct_node_t *parent, int metricId, uint64_t sampling_period,
+                uint64_t sample_clock)
 {
   cct_node_t *trace_node = NULL;
 
@@ -191,7 +194,12 @@ hpcrun_trace_ip(ip_normalized_t leaf_ip, cct_node_t *parent, int metricId, uint6
     trace_node = func_proxy;
 
     TMSG(TRACE, "Changed persistent id to indicate mutation of func_proxy node");
-    hpcrun_trace_append(&td->core_profile_trace_data, func_proxy, metricId, td->prev_dLCA, sampling_period);
+    if (sample_clock != 0) {
+      hpcrun_trace_append_at(&td->core_profile_trace_data, func_proxy, metricId, td->prev_dLCA,
+                             sampling_period, sample_clock);
+    } else {
+      hpcrun_trace_append(&td->core_profile_trace_data, func_proxy, metricId, td->prev_dLCA, sampling_period);
+    }
     TMSG(TRACE, "Appended func_proxy node to trace");
   }
 
@@ -209,7 +217,7 @@ hpcrun_trace_node(cct_node_t *node)
     // needs a proper metric for a data-centric trace
     int metricId = 0;
     uint64_t sampling_period = UINT64_MAX;
-    hpcrun_trace_ip(addr->ip_norm, parent, metricId, sampling_period);
+    hpcrun_trace_ip(addr->ip_norm, parent, metricId, sampling_period, 0);
 #endif
   }
 }
@@ -255,6 +263,9 @@ hpcrun_sample_callpath(void* context, int metricId,
   TMSG(SAMPLE_CALLPATH, "attempting sample");
   hpcrun_stats_num_samples_attempted_inc();
 
+  uint64_t budget_begin = hpcrun_sample_budget_begin();
+  uint64_t phase_begin = hpcrun_sample_phase_begin();
+
   thread_data_t* td   = hpcrun_get_thread_data();
   sigjmp_buf_t* it    = &(td->bad_unwind);
   sigjmp_buf_t* old   = td->current_jmp_buf;
@@ -363,7 +374,10 @@ hpcrun_sample_callpath(void* context, int metricId,
     uint64_t sampling_period = data->sampling_period;;
     int is_time_based_metric = data->is_time_based_metric;
     if (is_time_based_metric > 0) {
-      ret.trace_node = hpcrun_trace_ip(leaf_ip, hpcrun_cct_parent(node), metricId, sampling_period);
+      uint64_t trace_begin = hpcrun_sample_phase_begin();
+      ret.trace_node = hpcrun_trace_ip(leaf_ip, hpcrun_cct_parent(node), metricId, sampling_period,
+                                       data->sample_clock);
+      hpcrun_sample_phase_end(SAMPLE_PHASE_TRACE, trace_begin);
     }
   }
 
@@ -373,6 +387,9 @@ hpcrun_sample_callpath(void* context, int metricId,
     hpcrun_reclaim_freeable_mem();
   }
 
+  hpcrun_sample_phase_end(SAMPLE_PHASE_TOTAL, phase_begin);
+  hpcrun_sample_budget_end(budget_begin);
+
   TMSG(SAMPLE_CALLPATH,"done w sample, return %p", ret.sample_node);
   monitor_unblock_shootdown();
 
@@ -0,0 +1,196 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2023, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <include/hpctoolkit-config.h>
+#if defined(HOST_CPU_x86_64)
+#include <x86intrin.h>
+#endif
+
+#include <messages/messages.h>
+#include "env.h"
+#include "sample_phase.h"
+#include "thread_finalize.h"
+
+#if defined(HOST_CPU_x86_64)
+#define TICK_UNIT  "ticks"
+#else
+#define TICK_UNIT  "ns"
+#endif
+
+#define FLUSH_SAMPLES  256
+
+static bool phase_active = false;
+
+static atomic_uint_fast64_t total_ticks[SAMPLE_PHASE_COUNT];
+static atomic_uint_fast64_t total_samples = ATOMIC_VAR_INIT(0);
+
+static __thread uint64_t ticks[SAMPLE_PHASE_COUNT];
+static __thread uint64_t samples = 0;
+
+static thread_finalize_entry_t phase_finalizer;
+static bool finalizer_registered = false;
+
+
+// -------------------------------------------------------------------
+// This file implements lightweight timers for the phases of handling a
+// sample.  If HPCRUN_SAMPLE_PHASES is set in the environment, then the
+// time each thread spends unwinding, inserting the call path into its
+// CCT, updating the metrics of the leaf and appending to its trace is
+// accumulated per thread and summed over all threads every
+// FLUSH_SAMPLES samples and when the thread exits.
+//
+// The totals are written to the log file with the other summary
+// statistics, in time stamp counter ticks where there is one and in
+// nanoseconds otherwise.  This is meant for benchmarking hpcrun itself
+// (see tests2/hpcrun/cpu/bench-sample-phases), not for users.
+// -------------------------------------------------------------------
+
+
+static inline uint64_t
+now_ticks(void)
+{
+#if defined(HOST_CPU_x86_64)
+  return __rdtsc();
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+
+static void
+flush_thread(void)
+{
+  for (int i = 0; i < SAMPLE_PHASE_COUNT; i++) {
+    atomic_fetch_add_explicit(&total_ticks[i], ticks[i], memory_order_relaxed);
+    ticks[i] = 0;
+  }
+  atomic_fetch_add_explicit(&total_samples, samples, memory_order_relaxed);
+  samples = 0;
+}
+
+
+static void
+phase_thread_finalize(int is_process)
+{
+  flush_thread();
+}
+
+
+void
+hpcrun_sample_phase_init(void)
+{
+  phase_active = hpcrun_get_env_bool(HPCRUN_SAMPLE_PHASES);
+  if (!phase_active) {
+    return;
+  }
+
+  // init runs again in the child after fork, which keeps the list
+  if (!finalizer_registered) {
+    phase_finalizer.next = NULL;
+    phase_finalizer.fn = phase_thread_finalize;
+    thread_finalize_register(&phase_finalizer);
+    finalizer_registered = true;
+  }
+  TMSG(SAMPLE_PHASE, "sample phase timers enabled, in %s", TICK_UNIT);
+}
+
+
+bool
+hpcrun_sample_phase_active(void)
+{
+  return phase_active;
+}
+
+
+uint64_t
+hpcrun_sample_phase_begin(void)
+{
+  return phase_active ? now_ticks() : 0;
+}
+
+
+// Async-signal safe: called in the sample handler.
+void
+hpcrun_sample_phase_end(sample_phase_t phase, uint64_t begin)
+{
+  if (!phase_active) {
+    return;
+  }
+
+  ticks[phase] += now_ticks() - begin;
+  if (phase == SAMPLE_PHASE_TOTAL && ++samples >= FLUSH_SAMPLES) {
+    flush_thread();
+  }
+}
+
+
+void
+hpcrun_sample_phase_summary(void)
+{
+  if (!phase_active) {
+    return;
+  }
+
+  uint64_t n = atomic_load_explicit(&total_samples, memory_order_relaxed);
+  double per[SAMPLE_PHASE_COUNT];
+  for (int i = 0; i < SAMPLE_PHASE_COUNT; i++) {
+    uint64_t t = atomic_load_explicit(&total_ticks[i], memory_order_relaxed);
+    per[i] = n > 0 ? (double) t / n : 0.0;
+  }
+
+  AMSG("SAMPLE PHASES: samples: %ld, %s per sample: unwind: %.0f, "
+       "cct insert: %.0f, metric: %.0f, trace: %.0f, total: %.0f",
+       (long) n, TICK_UNIT, per[SAMPLE_PHASE_UNWIND], per[SAMPLE_PHASE_CCT_INSERT],
+       per[SAMPLE_PHASE_METRIC], per[SAMPLE_PHASE_TRACE], per[SAMPLE_PHASE_TOTAL]);
+}
@@ -333,26 +333,28 @@ core_profile_trace_data_init
   cptd->epoch = hpcrun_malloc(sizeof(epoch_t));
   cptd->epoch->csdata_ctxt = copy_thr_ctxt(thr_ctxt);
 
-  // ----------------------------------------
-  // cct2metrics map: associate a metric_set with
-  //                  a cct node
-  hpcrun_cct2metrics_init(&(cptd->cct2metrics_map));
-
   // ----------------------------------------
   // tracing
   // ----------------------------------------
   cptd->trace_min_time_us = 0;
   cptd->trace_max_time_us = 0;
   cptd->trace_is_ordered = true;
-  cptd->trace_expected_disorder = 5;
   cptd->trace_last_time = 0;
+  cptd->trace_disorder = 0;
+  cptd->trace_disorder_overflow = false;
+  cptd->trace_recent_count = 0;
+  cptd->trace_run_count = 0;
+  cptd->trace_coalesced = 0;
 
   // ----------------------------------------
   // IO support
   // ----------------------------------------
   cptd->hpcrun_file  = NULL;
+  cptd->hpcrun_file_buf = NULL;
+  cptd->hpcrun_file_len = 0;
   cptd->trace_buffer = NULL;
   cptd->trace_outbuf = NULL;
+  cptd->trace_memfd = -1;
 
   // ----------------------------------------
   // ???
@@ -48,10 +48,14 @@
 // global includes
 //*********************************************************************
 
+#include <errno.h>
+#include <inttypes.h>
 #include <stdio.h>
+#include <sys/mman.h>
 #include <sys/time.h>
 #include <assert.h>
 #include <limits.h>
+#include <unistd.h>
 
 
 //*********************************************************************
@@ -64,6 +68,7 @@
 #include "env.h"
 #include "files.h"
 #include "monitor.h"
+#include "node-aggregate.h"
 #include "rank.h"
 #include "string.h"
 #include "trace.h"
@@ -99,7 +104,10 @@
 //*********************************************************************
 
 static void hpcrun_trace_file_validate(int valid, char *op);
+static void hpcrun_trace_send(core_profile_trace_data_t *cptd);
+static void hpcrun_trace_disorder_update(core_profile_trace_data_t *cptd, uint64_t nanotime);
 static inline void hpcrun_trace_append_with_time_real(core_profile_trace_data_t *cptd, unsigned int call_path_id, unsigned int metric_id, uint32_t dLCA, uint64_t nanotime);
+static void hpcrun_trace_write_datum(core_profile_trace_data_t *cptd, unsigned int call_path_id, unsigned int metric_id, uint32_t dLCA, uint64_t nanotime);
 
 
 //*********************************************************************
@@ -108,6 +116,7 @@ static inline void hpcrun_trace_append_with_time_real(core_profile_trace_data_t
 
 static int tracing = 0;
 static int trace_flags = 0;
+static bool coalesce = false;
 
 //*********************************************************************
 // interface operations
@@ -127,7 +136,9 @@ hpcrun_trace_init()
   if (tracing > 1) {
       hpcrun_set_trace_metric(HPCRUN_CPU_KERNEL_LAUNCH_TRACE_FLAG);
   }
-  TMSG(TRACE, "Tracing is %s (%d)", (tracing ? "ON" : "OFF"), tracing);
+  coalesce = hpcrun_get_env_bool(HPCRUN_TRACE_COALESCE);
+  TMSG(TRACE, "Tracing is %s (%d), coalescing %s", (tracing ? "ON" : "OFF"), tracing,
+       (coalesce ? "ON" : "OFF"));
 }
 
 void
@@ -149,7 +160,17 @@ hpcrun_trace_open(core_profile_trace_data_t * cptd, hpcrun_trace_type_t type)
     // I think unlocked is ok here (we don't overlap any system
     // locks).  At any rate, locks only protect against threads, they
     // don't help with signal handlers (that's much harder).
-    fd = hpcrun_open_trace_file(cptd->id);
+    fd = -1;
+    if (hpcrun_node_aggregate_active()) {
+      // keep a descriptor to read the trace back when it is closed
+      fd = memfd_create("hpctrace", MFD_CLOEXEC);
+      if (fd >= 0) {
+        cptd->trace_memfd = dup(fd);
+      }
+    }
+    if (fd < 0) {
+      fd = hpcrun_open_trace_file(cptd->id);
+    }
     hpcrun_trace_file_validate(fd >= 0, "open");
     cptd->trace_buffer = hpcrun_malloc(HPCRUN_TraceBufferSz);
 
@@ -184,6 +205,8 @@ hpcrun_trace_open(core_profile_trace_data_t * cptd, hpcrun_trace_type_t type)
       // TODO: hpcrun_terminate()
     }
 
+    HPCTRACE_HDR_FLAGS_SET_BIT(flags, HPCTRACE_HDR_FLAGS_COALESCED_BIT_POS, coalesce);
+
     ret = hpctrace_fmt_hdr_outbuf(flags, cptd->trace_outbuf);
     hpcrun_trace_file_validate(ret == HPCFMT_OK, "write header to");
   }
@@ -210,14 +233,28 @@ hpcrun_trace_append(core_profile_trace_data_t *cptd, cct_node_t* node, unsigned
     assert(ret == 0 && "in trace_append: gettimeofday failed!");
     uint64_t nanotime = ((uint64_t)tv.tv_usec
                          + (((uint64_t)tv.tv_sec) * 1000000)) * 1000;
-    if (sampling_period > 0 && prev_nanotime != 0 && nanotime - prev_nanotime > TRACE_GAP_FACTOR * sampling_period) {
+    hpcrun_trace_append_at(cptd, node, metric_id, dLCA, sampling_period, nanotime);
+  }
+}
+
+
+// As hpcrun_trace_append, for a sample taken at nanotime rather than now,
+// e.g. one of a batch of perf samples delivered together.
+void
+hpcrun_trace_append_at(core_profile_trace_data_t *cptd, cct_node_t* node, unsigned int metric_id, uint32_t dLCA, uint64_t sampling_period, uint64_t nanotime)
+{
+  if (tracing && hpcrun_sample_prob_active()) {
+    if (sampling_period > 0 && prev_nanotime != 0 && nanotime > prev_nanotime
+        && nanotime - prev_nanotime > TRACE_GAP_FACTOR * sampling_period) {
       cct_bundle_t* cct_bundle = &(cptd->epoch->csdata);
       cct_node_t* idle_node = hpcrun_cct_bundle_get_no_activity_node(cct_bundle);
       hpcrun_cct_retain(idle_node);
       int32_t no_activity_call_path_id = hpcrun_cct_persistent_id(idle_node);
       hpcrun_trace_append_with_time_real(cptd, no_activity_call_path_id, metric_id, dLCA, prev_nanotime + sampling_period);
     }
-    prev_nanotime = nanotime;
+    if (nanotime > prev_nanotime) {
+      prev_nanotime = nanotime;
+    }
 
     // mark the leaf of a call path recorded in a trace record for retention
     // so that the call path associated with the trace record can be recovered.
@@ -254,14 +291,27 @@ hpcrun_trace_close(core_profile_trace_data_t * cptd)
   if (tracing && hpcrun_sample_prob_active()) {
 
     TMSG(TRACE, "Trace active close code");
+
+    // keep the end of the last run
+    if (coalesce && cptd->trace_run_count > 1) {
+      hpcrun_trace_write_datum(cptd, cptd->trace_run_cpid, cptd->trace_run_metric,
+                               cptd->trace_run_dlca, cptd->trace_run_time);
+      cptd->trace_coalesced--;
+    }
+    TMSG(TRACE, "Trace records coalesced: %"PRIu64, cptd->trace_coalesced);
+
     int ret = hpcio_outbuf_close(&cptd->trace_outbuf);
     if (ret != HPCFMT_OK) {
       EMSG("unable to flush and close trace file");
     }
 
-    int rank = hpcrun_get_rank();
-    if (rank >= 0) {
-      hpcrun_rename_trace_file(rank, cptd->id);
+    if (cptd->trace_memfd >= 0) {
+      hpcrun_trace_send(cptd);
+    } else {
+      int rank = hpcrun_get_rank();
+      if (rank >= 0) {
+        hpcrun_rename_trace_file(rank, cptd->id);
+      }
     }
   }
   TMSG(TRACE, "trace close done");
@@ -283,11 +333,39 @@ hpcrun_trace_append_with_time_real(core_profile_trace_data_t *cptd, unsigned int
         cptd->trace_max_time_us = nanotime;
     }
 
+    // a record that would be written the same as the one before it, save
+    // for its time, only extends the run the earlier record started
+    if (coalesce && cptd->trace_run_count > 0 && call_path_id == cptd->trace_run_cpid
+        && metric_id == cptd->trace_run_metric
+#if defined(LCA_TRACE)
+        && dLCA == cptd->trace_run_dlca
+#endif
+        && nanotime >= cptd->trace_run_time) {
+      cptd->trace_run_time = nanotime;
+      cptd->trace_run_count++;
+      cptd->trace_coalesced++;
+      return;
+    }
+    cptd->trace_run_cpid = call_path_id;
+    cptd->trace_run_metric = metric_id;
+    cptd->trace_run_dlca = dLCA;
+    cptd->trace_run_time = nanotime;
+    cptd->trace_run_count = 1;
+
     if(cptd->trace_last_time > nanotime) {
       cptd->trace_is_ordered = false;
+      hpcrun_trace_disorder_update(cptd, nanotime);
     }
     cptd->trace_last_time = nanotime;
+    cptd->trace_recent_time[cptd->trace_recent_count++ % HPCRUN_TRACE_DISORDER_HISTORY] = nanotime;
+
+    hpcrun_trace_write_datum(cptd, call_path_id, metric_id, dLCA, nanotime);
+}
 
+
+static void
+hpcrun_trace_write_datum(core_profile_trace_data_t *cptd, unsigned int call_path_id, unsigned int metric_id, uint32_t dLCA, uint64_t nanotime)
+{
     hpctrace_fmt_datum_t trace_datum;
     trace_datum.cpId = (uint32_t)call_path_id;
     //TODO: was not in GPU version
@@ -320,6 +398,28 @@ hpcrun_trace_append_with_time_real(core_profile_trace_data_t *cptd, unsigned int
 }
 
 
+// A record that goes back in time has to be moved past every earlier
+// record later than it. The most records any one has to move past is the
+// bound a reader needs to sort the trace while streaming it.
+static void
+hpcrun_trace_disorder_update(core_profile_trace_data_t *cptd, uint64_t nanotime)
+{
+  uint64_t recent = cptd->trace_recent_count;
+  if (recent > HPCRUN_TRACE_DISORDER_HISTORY) recent = HPCRUN_TRACE_DISORDER_HISTORY;
+
+  unsigned int later = 0;
+  for (uint64_t i = 0; i < recent; i++) {
+    if (cptd->trace_recent_time[i] > nanotime) later++;
+  }
+
+  if (later == HPCRUN_TRACE_DISORDER_HISTORY) {
+    // records older than the history may be later still
+    cptd->trace_disorder_overflow = true;
+  }
+  if (later > cptd->trace_disorder) cptd->trace_disorder = later;
+}
+
+
 static void
 hpcrun_trace_file_validate(int valid, char *op)
 {
@@ -329,6 +429,50 @@ hpcrun_trace_file_validate(int valid, char *op)
   }
 }
 
+
+// Stream a trace written to memory to the node aggregator, or if that
+// fails, write it to the trace file it would have had otherwise.
+static void
+hpcrun_trace_send(core_profile_trace_data_t *cptd)
+{
+  int memfd = cptd->trace_memfd;
+  cptd->trace_memfd = -1;
+
+  int rank = hpcrun_get_rank();
+  off_t len = lseek(memfd, 0, SEEK_END);
+  char *data = MAP_FAILED;
+  if (len > 0) {
+    data = mmap(NULL, len, PROT_READ, MAP_SHARED, memfd, 0);
+  }
+  if (data == MAP_FAILED) {
+    EMSG("unable to read back trace data: %s", strerror(errno));
+    close(memfd);
+    return;
+  }
+
+  char name[PATH_MAX];
+  if (hpcrun_files_name(name, sizeof name, rank >= 0 ? rank : 0, cptd->id,
+                        HPCRUN_TraceFnmSfx) != 0
+      || hpcrun_node_aggregate_write(name, data, len) != 0) {
+    int fd = hpcrun_open_trace_file(cptd->id);
+    hpcrun_trace_file_validate(fd >= 0, "open");
+    for (off_t done = 0; done < len; ) {
+      ssize_t n = write(fd, data + done, len - done);
+      if (n < 0 && errno == EINTR)
+        continue;
+      hpcrun_trace_file_validate(n > 0, "write");
+      done += n;
+    }
+    close(fd);
+    if (rank >= 0) {
+      hpcrun_rename_trace_file(rank, cptd->id);
+    }
+  }
+
+  munmap(data, len);
+  close(memfd);
+}
+
 void
 hpcrun_set_trace_metric
 (
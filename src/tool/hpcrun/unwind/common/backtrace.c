@@ -72,6 +72,7 @@
 #include <trampoline/common/trampoline.h>
 #include <dbg_backtrace.h>
 #include "backtrace_info.h"
+#include "fast-unwind.h"
 #include "../../thread_data.h"
 
 extern bool hpcrun_get_retain_recursion_mode();
@@ -171,6 +172,27 @@ hpcrun_skip_chords(frame_t* bt_outer, frame_t* bt_inner,
   return &bt_inner[skip];
 }
 
+//
+// Replace the outermost frame of a backtrace with the placeholder for the
+// fence (if any) that stopped the unwind.
+//
+void
+hpcrun_bt_mark_fence(fence_enum_t fence, frame_t* bt_last)
+{
+  switch(fence) {
+  case FENCE_NONE:
+  case FENCE_BAD:
+  case FENCE_TRAMP:
+    break;
+  case FENCE_MAIN:
+    bt_last->ip_norm = get_placeholder_norm(hpcrun_placeholder_fence_main);
+    break;
+  case FENCE_THREAD:
+    bt_last->ip_norm = get_placeholder_norm(hpcrun_placeholder_fence_thread);
+    break;
+  }
+}
+
 static int max_unwind_attempts = 0;
 
 void
@@ -179,6 +201,14 @@ hpcrun_backtrace_setup()
   control_knob_value_get_int("MAX_UNWIND_DEPTH", &max_unwind_attempts);
   if(max_unwind_attempts <= 0)
     max_unwind_attempts = 1000;
+
+  hpcrun_fast_unwind_init();
+}
+
+int
+hpcrun_backtrace_max_depth()
+{
+  return max_unwind_attempts == 0 ? 1000 : max_unwind_attempts;
 }
 
 //
@@ -307,18 +337,7 @@ hpcrun_generate_backtrace_no_trampoline(backtrace_info_t* bt,
   frame_t* bt_beg  = td->btbuf_beg;      // innermost, inclusive
   frame_t* bt_last = td->btbuf_cur - 1; // outermost, inclusive
 
-  switch(bt->fence) {
-  case FENCE_NONE:
-  case FENCE_BAD:
-  case FENCE_TRAMP:
-    break;
-  case FENCE_MAIN:
-    bt_last->ip_norm = get_placeholder_norm(hpcrun_placeholder_fence_main);
-    break;
-  case FENCE_THREAD:
-    bt_last->ip_norm = get_placeholder_norm(hpcrun_placeholder_fence_thread);
-    break;
-  }
+  hpcrun_bt_mark_fence(bt->fence, bt_last);
 
   if (skipInner) {
     if (ENABLED(USE_TRAMP)){
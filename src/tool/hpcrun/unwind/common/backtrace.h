@@ -111,6 +111,10 @@ void     hpcrun_bt_init(backtrace_t* bt, size_t size);
 
 void hpcrun_backtrace_setup();
 
+int hpcrun_backtrace_max_depth();
+
+void hpcrun_bt_mark_fence(fence_enum_t fence, frame_t* bt_last);
+
 bool     hpcrun_backtrace_std(backtrace_t* bt, ucontext_t* context);
 
 bool hpcrun_generate_backtrace(backtrace_info_t* bt,
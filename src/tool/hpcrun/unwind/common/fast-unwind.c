@@ -0,0 +1,494 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2023, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+// file: fast-unwind.c
+//
+// purpose:
+//     collect call paths without binary analysis for code compiled with
+//     frame pointers. two sources of frames are supported:
+//
+//       callchain: the user-mode callchain the kernel records with a
+//                  perf sample (PERF_SAMPLE_CALLCHAIN). no memory of the
+//                  application is read during the sample.
+//
+//       fp:        walk the chain of saved frame pointers starting from
+//                  the signal context.
+//
+//     every recovered return address must map to a known function and
+//     every step must move up the stack. if any check fails, the sample
+//     is unwound again using the standard recipe-based unwinder.
+//***************************************************************************
+
+//***************************************************************************
+// system include files
+//***************************************************************************
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ucontext.h>
+
+//***************************************************************************
+// external include files
+//***************************************************************************
+
+#include <monitor.h>
+
+//***************************************************************************
+// local include files
+//***************************************************************************
+
+#include <hpcrun/hpcrun_stats.h>
+#include <hpcrun/sample_event.h>
+#include <hpcrun/thread_data.h>
+#include <fnbounds/fnbounds_interface.h>
+#include <messages/messages.h>
+#include <utilities/ip-normalized.h>
+
+#include "backtrace.h"
+#include "fast-unwind.h"
+
+//***************************************************************************
+// local constants & macros
+//***************************************************************************
+
+// The frame record pushed by a standard prologue is laid out identically
+// on x86_64 ([bp] = caller's bp, [bp+8] = return address) and on aarch64
+// ([fp] = caller's fp, [fp+8] = lr).
+#if defined(__x86_64__)
+#define FAST_UNW_SUPPORTED 1
+#define CONTEXT_PC(uc) ((void*) (uc)->uc_mcontext.gregs[REG_RIP])
+#define CONTEXT_FP(uc) ((void**) (uc)->uc_mcontext.gregs[REG_RBP])
+#define CONTEXT_SP(uc) ((void**) (uc)->uc_mcontext.gregs[REG_RSP])
+#elif defined(__aarch64__)
+#define FAST_UNW_SUPPORTED 1
+#define CONTEXT_PC(uc) ((void*) (uc)->uc_mcontext.pc)
+#define CONTEXT_FP(uc) ((void**) (uc)->uc_mcontext.regs[29])
+#define CONTEXT_SP(uc) ((void**) (uc)->uc_mcontext.sp)
+#define CONTEXT_LR(uc) ((void*) (uc)->uc_mcontext.regs[30])
+#else
+#define FAST_UNW_SUPPORTED 0
+#endif
+
+#define FP_ALIGNED(fp) ((((uintptr_t) (fp)) & (sizeof(void*) - 1)) == 0)
+
+// kernel callchains interleave context markers (PERF_CONTEXT_*) with the
+// ips; all of them lie in the last page of the address space.
+#define CALLCHAIN_IS_MARKER(ip) ((ip) >= (uint64_t) -4095)
+
+//***************************************************************************
+// local variables
+//***************************************************************************
+
+static hpcrun_fast_unwind_mode_t fast_unwind_mode = HPCRUN_FAST_UNWIND_NONE;
+static bool fast_unwind_initialized = false;
+static bool fast_unwind_need_sp = false;
+
+static hpcrun_user_callchain_t user_callchain = NULL;
+
+static __thread bool context_stale = false;
+
+//***************************************************************************
+// private operations
+//***************************************************************************
+
+//
+// Append a frame for unnormalized 'pc' to the thread's backtrace buffer.
+// 'fn_ip' is an address within the function containing pc: pc itself for
+// the interrupted frame, pc - 1 for return addresses (the call may be the
+// last instruction of its function).
+//
+// Returns false if pc does not lie in a function known to fnbounds.
+//
+static bool
+fast_unwind_push(thread_data_t* td, void* pc, void* fn_ip,
+                 void** bp, void** sp, void* ra_loc)
+{
+  void *start, *end;
+  load_module_t* lm = NULL;
+  if (!fnbounds_enclosing_addr(fn_ip, &start, &end, &lm) || lm == NULL) {
+    TMSG(FAST_UNW, "no enclosing function for pc = %p", pc);
+    return false;
+  }
+
+  hpcrun_ensure_btbuf_avail();
+
+  frame_t* f = td->btbuf_cur++;
+  memset(&f->cursor, 0, sizeof(f->cursor));
+  f->cursor.pc_unnorm = pc;
+  f->cursor.bp = bp;
+  f->cursor.sp = sp;
+  f->cursor.ra_loc = ra_loc;
+  f->cursor.pc_norm = hpcrun_normalize_ip(pc, lm);
+  f->cursor.the_function = hpcrun_normalize_ip(start, lm);
+  f->ip_norm = f->cursor.pc_norm;
+  f->the_function = f->cursor.the_function;
+  f->ra_loc = NULL;
+  return true;
+}
+
+
+// returns the fence (if any) that ends an unwind at pc
+static fence_enum_t
+fast_unwind_fence(void* pc)
+{
+  return monitor_unwind_process_bottom_frame(pc) ? FENCE_MAIN :
+         monitor_unwind_thread_bottom_frame(pc) ? FENCE_THREAD : FENCE_NONE;
+}
+
+
+//
+// Recover the frames of a sample from the user callchain recorded by
+// the kernel. The kernel itself walked frame pointers to produce it, so
+// this saves us from touching application memory at all.
+//
+static bool
+fast_unwind_callchain(backtrace_info_t* bt, void* data_aux)
+{
+  if (user_callchain == NULL || data_aux == NULL || fast_unwind_need_sp) {
+    return false;
+  }
+
+  const uint64_t* ips = NULL;
+  int nips = user_callchain(data_aux, &ips);
+  if (nips <= 0) {
+    return false;
+  }
+
+  thread_data_t* td = hpcrun_get_thread_data();
+  int max_depth = hpcrun_backtrace_max_depth();
+
+  for (int i = 0; i < nips && i < max_depth; i++) {
+    if (CALLCHAIN_IS_MARKER(ips[i])) {
+      break;
+    }
+    void* pc = (void*) ips[i];
+    void* fn_ip = (i == 0) ? pc : (void*) (ips[i] - 1);
+    if (!fast_unwind_push(td, pc, fn_ip, NULL, NULL, NULL)) {
+      return false;
+    }
+    fence_enum_t fence = fast_unwind_fence(pc);
+    if (fence != FENCE_NONE) {
+      bt->fence = fence;
+      return true;
+    }
+  }
+
+  // the callchain was truncated (or the kernel's walk went astray) before
+  // reaching the bottom of the stack: we cannot trust it.
+  TMSG(FAST_UNW, "callchain of %d frames did not reach a fence", nips);
+  return false;
+}
+
+
+#if FAST_UNW_SUPPORTED
+
+//
+// In the first instructions of a function, the new frame record is not
+// set up yet and the frame pointer still belongs to the caller. Detect the
+// common prologue and epilogue positions so the caller is not skipped.
+// Returns the location of the return address, or NULL if pc is in the body
+// of the function.
+//
+static void**
+fast_unwind_leaf_ra_loc(void* pc, void** sp)
+{
+  void *start, *end;
+  if (!fnbounds_enclosing_addr(pc, &start, &end, NULL)) {
+    return NULL;
+  }
+#if defined(__x86_64__)
+  static const unsigned char endbr64[] = { 0xf3, 0x0f, 0x1e, 0xfa };
+  unsigned char* fn = (unsigned char*) start;
+  if ((size_t) ((char*) end - (char*) start) > sizeof(endbr64)
+      && memcmp(fn, endbr64, sizeof(endbr64)) == 0) {
+    fn += sizeof(endbr64);
+  }
+  if ((unsigned char*) pc <= fn) {
+    return sp;                      // before push %rbp
+  }
+  if ((unsigned char*) pc == fn + 1 && fn[0] == 0x55) {
+    return sp + 1;                  // after push %rbp, before mov %rsp,%rbp
+  }
+  if (*(unsigned char*) pc == 0xc3) {
+    return sp;                      // at ret, after pop %rbp
+  }
+#endif
+  return NULL;
+}
+
+
+//
+// Walk the chain of frame records from the signal context.
+//
+static bool
+fast_unwind_fp(backtrace_info_t* bt, ucontext_t* context)
+{
+  thread_data_t* td = hpcrun_get_thread_data();
+  void** stack_bottom = (void**) monitor_stack_bottom();
+  int max_depth = hpcrun_backtrace_max_depth();
+
+  void*  pc = CONTEXT_PC(context);
+  void** fp = CONTEXT_FP(context);
+  void** sp = CONTEXT_SP(context);
+
+  if (!fast_unwind_push(td, pc, pc, fp, sp, NULL)) {
+    return false;
+  }
+
+  // handle a leaf that has not (or no longer) set up its frame record
+  void* next_pc = NULL;
+  void** ra_loc = NULL;
+#if defined(__aarch64__)
+  void *start, *end;
+  if (fnbounds_enclosing_addr(pc, &start, &end, NULL) && pc == start) {
+    next_pc = CONTEXT_LR(context);
+  }
+#else
+  ra_loc = fast_unwind_leaf_ra_loc(pc, sp);
+  if (ra_loc != NULL) {
+    if (ra_loc < sp || ra_loc >= stack_bottom) {
+      return false;
+    }
+    next_pc = *ra_loc;
+    sp = ra_loc + 1;
+  }
+#endif
+
+  for (int depth = 1; depth < max_depth; depth++) {
+    fence_enum_t fence = fast_unwind_fence(pc);
+    if (fence != FENCE_NONE) {
+      bt->fence = fence;
+      return true;
+    }
+
+    if (next_pc == NULL) {
+      // a frame record must lie within this thread's stack, above the
+      // current stack pointer.
+      if (!FP_ALIGNED(fp) || fp < sp || fp + 1 >= stack_bottom) {
+        TMSG(FAST_UNW, "invalid frame pointer %p (sp = %p) at pc = %p", fp, sp, pc);
+        return false;
+      }
+      ra_loc = fp + 1;
+      next_pc = *ra_loc;
+      sp = fp + 2;
+      void** next_fp = (void**) *fp;
+
+      // the chain must move up the stack (or end)
+      if (next_fp != NULL && next_fp <= fp) {
+        TMSG(FAST_UNW, "frame pointer chain does not advance: %p -> %p", fp, next_fp);
+        return false;
+      }
+      fp = next_fp;
+    }
+
+    if (!fast_unwind_push(td, next_pc, ((char*) next_pc) - 1, fp, sp, NULL)) {
+      return false;
+    }
+    (td->btbuf_cur - 2)->ra_loc = ra_loc;
+
+    pc = next_pc;
+    next_pc = NULL;
+  }
+
+  TMSG(FAST_UNW, "unwind exceeded %d frames", max_depth);
+  return false;
+}
+
+#else
+
+static bool
+fast_unwind_fp(backtrace_info_t* bt, ucontext_t* context)
+{
+  return false;
+}
+
+#endif
+
+
+//***************************************************************************
+// interface operations
+//***************************************************************************
+
+void
+hpcrun_fast_unwind_init(void)
+{
+  if (fast_unwind_initialized) return;
+  fast_unwind_initialized = true;
+
+  const char* mode = getenv("HPCRUN_FAST_UNWIND");
+  if (mode == NULL || *mode == '\0') {
+    fast_unwind_mode = HPCRUN_FAST_UNWIND_NONE;
+  } else if (strcasecmp(mode, "fp") == 0) {
+    fast_unwind_mode = HPCRUN_FAST_UNWIND_FP;
+  } else if (strcasecmp(mode, "callchain") == 0) {
+    fast_unwind_mode = HPCRUN_FAST_UNWIND_CALLCHAIN;
+  } else {
+    EMSG("WARNING: ignoring unknown HPCRUN_FAST_UNWIND mode '%s'", mode);
+    fast_unwind_mode = HPCRUN_FAST_UNWIND_NONE;
+  }
+
+  if (fast_unwind_mode != HPCRUN_FAST_UNWIND_NONE && !FAST_UNW_SUPPORTED) {
+    EMSG("WARNING: fast unwinding is not supported on this platform");
+    fast_unwind_mode = HPCRUN_FAST_UNWIND_NONE;
+  }
+
+  TMSG(FAST_UNW, "fast unwind mode = %d", fast_unwind_mode);
+}
+
+
+hpcrun_fast_unwind_mode_t
+hpcrun_fast_unwind_mode(void)
+{
+  // sample sources may ask before the unwinder is set up
+  hpcrun_fast_unwind_init();
+  return fast_unwind_mode;
+}
+
+
+void
+hpcrun_user_callchain_register(hpcrun_user_callchain_t ucc)
+{
+  user_callchain = ucc;
+}
+
+
+void
+hpcrun_fast_unwind_require_sp(void)
+{
+  fast_unwind_need_sp = true;
+}
+
+
+bool
+hpcrun_fast_unwind_context_free(void *data_aux)
+{
+  const uint64_t* ips = NULL;
+  return hpcrun_fast_unwind_mode() == HPCRUN_FAST_UNWIND_CALLCHAIN
+    && user_callchain != NULL && !fast_unwind_need_sp
+    && data_aux != NULL && user_callchain(data_aux, &ips) > 0;
+}
+
+
+void
+hpcrun_fast_unwind_set_context_stale(bool stale)
+{
+  context_stale = stale;
+}
+
+
+bool
+hpcrun_fast_unwind_generate_backtrace(backtrace_info_t* bt,
+                                      ucontext_t* context,
+                                      int skipInner, void* data_aux)
+{
+  if (context_stale && (fast_unwind_mode != HPCRUN_FAST_UNWIND_CALLCHAIN
+                        || hpcrun_no_unwind || ENABLED(USE_TRAMP))) {
+    // only the kernel's callchain can attribute a sample whose context
+    // is not the one it was taken in
+    hpcrun_drop_sample();
+  }
+  if (fast_unwind_mode == HPCRUN_FAST_UNWIND_NONE
+      || hpcrun_no_unwind || ENABLED(USE_TRAMP)) {
+    return false;
+  }
+
+  bt->has_tramp = false;
+  bt->n_trolls = 0;
+  bt->fence = FENCE_BAD;
+  bt->bottom_frame_elided = false;
+  bt->partial_unwind = true;
+
+  thread_data_t* td = hpcrun_get_thread_data();
+  td->btbuf_cur = td->btbuf_beg;
+  td->btbuf_sav = td->btbuf_end;
+
+  bool ok = false;
+  if (fast_unwind_mode == HPCRUN_FAST_UNWIND_CALLCHAIN) {
+    ok = fast_unwind_callchain(bt, data_aux);
+    if (!ok && context_stale) {
+      // the context does not belong to this sample and must not be
+      // unwound: the frames the kernel recorded are all there is, as a
+      // partial unwind, and without any the sample is dropped
+      hpcrun_stats_num_fast_unwind_fallback_inc();
+      if (td->btbuf_cur == td->btbuf_beg) {
+        hpcrun_drop_sample();
+      }
+      bt->begin = td->btbuf_beg;
+      bt->last  = td->btbuf_cur - 1;
+      return true;
+    }
+    if (!ok) td->btbuf_cur = td->btbuf_beg;
+  }
+  if (!ok) {
+    ok = fast_unwind_fp(bt, context);
+  }
+
+  if (!ok) {
+    td->btbuf_cur = td->btbuf_beg;
+    hpcrun_stats_num_fast_unwind_fallback_inc();
+    return false;
+  }
+
+  frame_t* bt_beg  = td->btbuf_beg;     // innermost, inclusive
+  frame_t* bt_last = td->btbuf_cur - 1; // outermost, inclusive
+
+  hpcrun_bt_mark_fence(bt->fence, bt_last);
+
+  if (skipInner) {
+    bt_beg = hpcrun_skip_chords(bt_last, bt_beg, skipInner);
+  }
+
+  bt->begin = bt_beg;
+  bt->last  = bt_last;
+  bt->partial_unwind = false;
+
+  hpcrun_stats_num_fast_unwind_inc();
+  return true;
+}
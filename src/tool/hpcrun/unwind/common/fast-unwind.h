@@ -0,0 +1,133 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2023, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+// file: fast-unwind.h
+//
+// purpose:
+//     an optional fast path for call path collection that avoids binary
+//     analysis of the application. frames are recovered either from the
+//     user-mode callchain supplied by the kernel with a perf sample, or by
+//     walking the frame-pointer chain directly. when the frames recovered
+//     this way fail validation, callers fall back on the standard
+//     recipe-based unwinder.
+//
+//     this mode is only profitable (and only correct) for code compiled
+//     with -fno-omit-frame-pointer.
+//***************************************************************************
+
+#ifndef hpcrun_fast_unwind_h
+#define hpcrun_fast_unwind_h
+
+//***************************************************************************
+// system include files
+//***************************************************************************
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <ucontext.h>
+
+//***************************************************************************
+// local include files
+//***************************************************************************
+
+#include <unwind/common/backtrace_info.h>
+
+//***************************************************************************
+// type declarations
+//***************************************************************************
+
+typedef enum {
+  HPCRUN_FAST_UNWIND_NONE = 0,  // always use the recipe-based unwinder
+  HPCRUN_FAST_UNWIND_FP,        // walk the frame-pointer chain
+  HPCRUN_FAST_UNWIND_CALLCHAIN, // use the kernel's user callchain, else walk
+} hpcrun_fast_unwind_mode_t;
+
+// Extract the user-mode portion of a kernel-supplied callchain from the
+// auxiliary sample data of a sample source. On success, returns the number
+// of frames (innermost first) and sets *ips to point at them. Returns 0 if
+// no usable user callchain is present.
+typedef int (*hpcrun_user_callchain_t)(void *data_aux, const uint64_t **ips);
+
+//***************************************************************************
+// interface functions
+//***************************************************************************
+
+// read the selected mode from the environment (HPCRUN_FAST_UNWIND)
+void hpcrun_fast_unwind_init(void);
+
+hpcrun_fast_unwind_mode_t hpcrun_fast_unwind_mode(void);
+
+// register the sample source that knows how to decode user callchains
+void hpcrun_user_callchain_register(hpcrun_user_callchain_t ucc);
+
+// kernel callchains carry no stack pointers. if some client requires
+// stack pointers in each frame (e.g. OMPT call stack trimming), the
+// callchain mode degrades to walking frame pointers.
+void hpcrun_fast_unwind_require_sp(void);
+
+// true if a sample can be unwound from its kernel callchain alone,
+// without the context it was taken in
+bool hpcrun_fast_unwind_context_free(void *data_aux);
+
+// mark the samples that follow on this thread as taken at some context
+// other than the one passed with them (e.g. older samples in a batch of
+// perf records). if the kernel callchain of such a sample is truncated,
+// its frames are recorded as a partial unwind instead of falling back on
+// an unwinder that would walk the wrong context.
+void hpcrun_fast_unwind_set_context_stale(bool stale);
+
+// Attempt to generate a backtrace into the thread's backtrace buffer
+// without binary analysis. Returns true and fills in 'bt' on success.
+// Returns false if the fast path is disabled or the frames it recovered
+// could not be validated; the caller should then fall back on
+// hpcrun_generate_backtrace(). For a sample with a stale context, returns
+// true with bt->partial_unwind set if the callchain was truncated.
+bool hpcrun_fast_unwind_generate_backtrace(backtrace_info_t *bt,
+                                           ucontext_t *context,
+                                           int skipInner, void *data_aux);
+
+#endif // hpcrun_fast_unwind_h
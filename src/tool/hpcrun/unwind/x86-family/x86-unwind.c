@@ -55,6 +55,7 @@
 //***************************************************************************
 
 #include <stdio.h>
+#include <string.h>
 #include <setjmp.h>
 #include <stdbool.h>
 #include <assert.h>
@@ -176,6 +177,27 @@ compute_normalized_ips(hpcrun_unw_cursor_t* cursor)
   cursor->the_function = hpcrun_normalize_ip(func_start_pc, lm);
 }
 
+//
+// No recipe can be built for pc while the function bounds of its load
+// module are being computed (HPCRUN_FNBOUNDS_LAZY). Describe a frame at
+// pc without an interval, so it is still recorded.  As for any frame
+// without an interval, unwinding continues from it by trolling: the
+// module may not keep frame pointers, so bp cannot be trusted.
+//
+static bool
+unw_pending_frame(unwindr_info_t* unwr_info, void* pc)
+{
+  load_module_t* lm = NULL;
+  if (!fnbounds_pending_addr(pc, &lm)) {
+    return false;
+  }
+  memset(unwr_info, 0, sizeof(*unwr_info));
+  unwr_info->lm = lm;
+  unwr_info->interval.start = (uintptr_t) pc;
+  unwr_info->interval.end = (uintptr_t) pc + 1;
+  return true;
+}
+
 
 
 //************************************************
@@ -260,7 +282,7 @@ hpcrun_unw_init_cursor(hpcrun_unw_cursor_t* cursor, void* context)
 
   bool found = uw_recipe_map_lookup(pc, NATIVE_UNWINDER, &cursor->unwr_info);
 
-  if (!found) {
+  if (!found && !unw_pending_frame(&cursor->unwr_info, pc)) {
     EMSG("unw_init: cursor could NOT build an interval for initial pc = %p",
          cursor->pc_unnorm);
   }
@@ -587,7 +609,7 @@ unw_step_sp(hpcrun_unw_cursor_t* cursor)
 
   unwindr_info_t unwr_info;
   bool found = uw_recipe_map_lookup(((char *)next_pc) - 1, NATIVE_UNWINDER, &unwr_info);
-  if (!found){
+  if (!found && !unw_pending_frame(&unwr_info, ((char *)next_pc) - 1)){
     if (((void *)next_sp) >= monitor_stack_bottom()){
       TMSG(UNW,"  step_sp: STEP_STOP_WEAK, no next interval and next_sp >= stack bottom,"
            " so stop unwind ...");
@@ -650,7 +672,7 @@ unw_step_bp(hpcrun_unw_cursor_t* cursor)
 
   unwindr_info_t unwr_info;
   bool found = uw_recipe_map_lookup(((char *)next_pc) - 1, NATIVE_UNWINDER, &unwr_info);
-  if (!found){
+  if (!found && !unw_pending_frame(&unwr_info, ((char *)next_pc) - 1)){
     if (((void *)next_sp) >= monitor_stack_bottom()) {
       TMSG(UNW,"  step_bp: STEP_STOP_WEAK, next_sp >= monitor_stack_bottom,"
            " next_sp = %p", next_sp);
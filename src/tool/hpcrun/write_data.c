@@ -48,9 +48,12 @@
 // system includes
 //*****************************************************************************
 
+#include <errno.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <setjmp.h>
+#include <string.h>
 #include <unistd.h>
 
 //*****************************************************************************
@@ -59,6 +62,7 @@
 
 #include "fname_max.h"
 #include "backtrace.h"
+#include "env.h"
 #include "files.h"
 #include "epoch.h"
 #include "rank.h"
@@ -67,6 +71,7 @@
 #include "hpcrun_return_codes.h"
 #include "write_data.h"
 #include "loadmap.h"
+#include "node-aggregate.h"
 #include "sample_prob.h"
 #include "cct/cct_bundle.h"
 
@@ -142,6 +147,95 @@ static const uint64_t default_measurement_granularity = 1;
 //
 //***************************************************************************
 
+// With HPCRUN_PROCESS_PROFILE set, each thread writes its profile to
+// memory and appends it to a single profile file for the whole process.
+// Each profile keeps the layout of a standalone file, with its offsets
+// relative to its own start, so readers find them by following the footers
+// back from the end of the file. A reserved range that is never written
+// leaves a hole, past which readers scan forward for the earlier profiles.
+static bool
+process_profile_enabled(void)
+{
+  static int enabled = -1;
+
+  if (enabled < 0) {
+    enabled = hpcrun_get_env_bool(HPCRUN_PROCESS_PROFILE);
+  }
+  return enabled;
+}
+
+static int
+write_profile_buffer(core_profile_trace_data_t *cptd, int fd, off_t offset)
+{
+  char *buf = cptd->hpcrun_file_buf;
+  size_t len = cptd->hpcrun_file_len;
+  int ret = HPCRUN_OK;
+
+  TMSG(DATA_WRITE, "writing %zu bytes of profile data at offset %ld",
+       len, (long) offset);
+  for (size_t done = 0; done < len; ) {
+    ssize_t n = pwrite(fd, buf + done, len - done, offset + done);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      EMSG("could not write profile data: %s", strerror(errno));
+      ret = HPCRUN_ERR;
+      break;
+    }
+    done += n;
+  }
+
+  free(buf);
+  cptd->hpcrun_file_buf = NULL;
+  cptd->hpcrun_file_len = 0;
+  return ret;
+}
+
+static int
+append_process_profile(core_profile_trace_data_t *cptd, int rank)
+{
+  off_t offset;
+  int fd = hpcrun_open_process_profile_file(rank, cptd->hpcrun_file_len, &offset);
+  if (fd < 0)
+    return HPCRUN_ERR;
+  return write_profile_buffer(cptd, fd, offset);
+}
+
+// With HPCRUN_NODE_AGGREGATE set, the profile is written to memory in
+// the same way and streamed to the node aggregator.  If that fails, it
+// is written as it would have been without aggregation.
+static int
+flush_profile_buffer(core_profile_trace_data_t *cptd)
+{
+  int rank = hpcrun_get_rank();
+  if (rank < 0)
+  {
+    rank = 0;
+  }
+
+  if (hpcrun_node_aggregate_active()) {
+    char name[PATH_MAX];
+    if (hpcrun_files_name(name, sizeof name, rank, cptd->id, HPCRUN_ProfileFnmSfx) == 0
+        && hpcrun_node_aggregate_write(name, cptd->hpcrun_file_buf,
+                                       cptd->hpcrun_file_len) == 0) {
+      free(cptd->hpcrun_file_buf);
+      cptd->hpcrun_file_buf = NULL;
+      cptd->hpcrun_file_len = 0;
+      return HPCRUN_OK;
+    }
+  }
+
+  if (process_profile_enabled())
+    return append_process_profile(cptd, rank);
+
+  int fd = hpcrun_open_profile_file(rank, cptd->id);
+  if (fd < 0)
+    return HPCRUN_ERR;
+  int ret = write_profile_buffer(cptd, fd, 0);
+  close(fd);
+  return ret;
+}
+
 static FILE *
 lazy_open_data_file(core_profile_trace_data_t *cptd)
 {
@@ -157,8 +251,12 @@ lazy_open_data_file(core_profile_trace_data_t *cptd)
     rank = 0;
   }
 
-  int fd = hpcrun_open_profile_file(rank, cptd->id);
-  fs = fdopen(fd, "w");
+  if (process_profile_enabled() || hpcrun_node_aggregate_active()) {
+    fs = open_memstream(&cptd->hpcrun_file_buf, &cptd->hpcrun_file_len);
+  } else {
+    int fd = hpcrun_open_profile_file(rank, cptd->id);
+    fs = fdopen(fd, "w");
+  }
   if (fs == NULL)
   {
     EEMSG("HPCToolkit: %s: unable to open profile file", __func__);
@@ -196,8 +294,15 @@ lazy_open_data_file(core_profile_trace_data_t *cptd)
   char traceMaxTimeStr[bufSZ];
   snprintf(traceMaxTimeStr, bufSZ, "%" PRIu64, cptd->trace_max_time_us);
 
+  // record the disorder measured while tracing, so that readers can sort
+  // the trace while streaming it without ever overflowing the bound. when
+  // it was more than the history could measure, say so rather than guess.
   char traceDisorderStr[bufSZ];
-  snprintf(traceDisorderStr, bufSZ, "%u", cptd->trace_expected_disorder);
+  if (cptd->trace_disorder_overflow) {
+    snprintf(traceDisorderStr, bufSZ, "%s", HPCRUN_FMT_TraceDisorderUnbounded);
+  } else {
+    snprintf(traceDisorderStr, bufSZ, "%u", cptd->trace_disorder);
+  }
 
   //
   // ==== file hdr =====
@@ -329,7 +434,7 @@ write_epochs(FILE *fs, core_profile_trace_data_t *cptd, epoch_t *epoch, hpcrun_f
 
     cct_bundle_t *cct = &(s->csdata);
 #if 0
-    int ret = hpcrun_cct_bundle_fwrite(fs, epoch_flags, cct, cptd->cct2metrics_map);
+    int ret = hpcrun_cct_bundle_fwrite(fs, epoch_flags, cct);
 #else
     // YUMENG: set up sparse_metrics and walk through cct
     // footer
@@ -341,7 +446,7 @@ write_epochs(FILE *fs, core_profile_trace_data_t *cptd, epoch_t *epoch, hpcrun_f
     sparse_metrics.id_tuple = cptd->id_tuple;
 
     // assign value to sparse metrics while writing cct info
-    ret = hpcrun_cct_bundle_fwrite(fs, epoch_flags, cct, cptd->cct2metrics_map, &sparse_metrics);
+    ret = hpcrun_cct_bundle_fwrite(fs, epoch_flags, cct, &sparse_metrics);
 
     // footer
     if (footer)
@@ -507,6 +612,10 @@ int hpcrun_write_profile_data(core_profile_trace_data_t *cptd)
 
   TMSG(DATA_WRITE, "closing file");
   hpcio_fclose(fs);
+  if (cptd->hpcrun_file_buf) {
+    if (flush_profile_buffer(cptd) != HPCRUN_OK)
+      return HPCRUN_ERR;
+  }
   TMSG(DATA_WRITE, "Done!");
 
   return HPCRUN_OK;
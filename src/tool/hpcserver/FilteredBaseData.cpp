@@ -65,6 +65,7 @@
 #include <iostream>
 
 
+#include "Constants.hpp"
 #include "DebugUtils.hpp"
 #include "FilteredBaseData.hpp"
 
@@ -120,6 +121,41 @@ int FilteredBaseData::getInt(FileOffset position)
 {
         return baseDataFile->getMasterBuffer()->getInt(position);
 }
+/**
+ * Reads count consecutive trace records starting at position into times and,
+ * if it is not NULL, cpids, converted to host byte order. The records are
+ * read a page-sized span at a time rather than one lookup per field.
+ */
+void FilteredBaseData::getRecords(FileOffset position, int64_t count, uint64_t* times, int* cpids)
+{
+        LargeByteBuffer* buffer = baseDataFile->getMasterBuffer();
+        int64_t i = 0;
+        while (i < count)
+        {
+                FileOffset len = (count - i) * SIZE_OF_TRACE_RECORD;
+                char* span = buffer->getSpan(position, &len);
+                int64_t inSpan = len / SIZE_OF_TRACE_RECORD;
+                if (inSpan == 0)
+                {
+                        //This record straddles two pages
+                        times[i] = buffer->getLong(position);
+                        if (cpids)
+                                cpids[i] = buffer->getInt(position + SIZEOF_LONG);
+                        i++;
+                        position += SIZE_OF_TRACE_RECORD;
+                        continue;
+                }
+                for (int64_t j = 0; j < inSpan; j++)
+                {
+                        char* record = span + j * SIZE_OF_TRACE_RECORD;
+                        times[i + j] = ByteUtilities::readLong(record);
+                        if (cpids)
+                                cpids[i + j] = ByteUtilities::readInt(record + SIZEOF_LONG);
+                }
+                i += inSpan;
+                position += inSpan * SIZE_OF_TRACE_RECORD;
+        }
+}
 
 int FilteredBaseData::getNumberOfRanks()
 {
@@ -82,6 +82,7 @@ namespace TraceviewerServer
                 FileOffset getMaxLoc(int pseudoRank);
                 int64_t getLong(FileOffset position);
                 int getInt(FileOffset position);
+                void getRecords(FileOffset position, int64_t count, uint64_t* times, int* cpids);
                 int getNumberOfRanks();
                 int* getProcessIDs();
                 short* getThreadIDs();
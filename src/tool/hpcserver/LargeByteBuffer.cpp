@@ -146,6 +146,20 @@ namespace TraceviewerServer
                 return val;
 
         }
+        /**
+         * Returns the bytes at pos so a run of records can be read without
+         * going through the page lookup for each one. On entry len is the
+         * number of bytes wanted; on return it is how many of them are
+         * contiguous from pos, which stops at the end of a page.
+         */
+        char* LargeByteBuffer::getSpan(FileOffset pos, FileOffset* len)
+        {
+                int Page = pos / mmPageSize;
+                FileOffset loc = pos % mmPageSize;
+                FileOffset pageEnd = min(mmPageSize*(Page+1), fileSize);
+                *len = min(*len, pageEnd - pos);
+                return masterBuffer[Page].get() + loc;
+        }
         //Could very well be a template, but we only use it for uint64_t
         uint64_t LargeByteBuffer::lcm(uint64_t _a, uint64_t _b)
         {
@@ -80,6 +80,7 @@ namespace TraceviewerServer
                 FileOffset size();
                 Long getLong(FileOffset);
                 int getInt(FileOffset);
+                char* getSpan(FileOffset, FileOffset*);
         private:
                 static uint64_t lcm(uint64_t, uint64_t);
                 static uint64_t getRamSize();
@@ -0,0 +1,115 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2023, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   Picks the trace records to show for each pixel of a timeline.
+//
+// Description:
+//   Branchless search over a contiguous block of timestamps.
+//
+//***************************************************************************
+
+#include "TimelineSampler.hpp"
+
+namespace TraceviewerServer
+{
+        //Below this many candidates a linear count is faster than halving again,
+        //and the count has no data-dependent branches so it vectorizes
+        static const Long LINEAR_SEARCH_LENGTH = 32;
+
+        /**
+         * Returns the index of the first timestamp in times[first, n) that is
+         * after time, or n if there is none.
+         */
+        Long TimelineSampler::upperBound(const Time* times, Long first, Long n, Time time)
+        {
+                const Time* base = times + first;
+                Long len = n - first;
+
+                //The answer always lies in [lo, lo + len]. Each step halves len
+                //with a conditional move rather than a branch.
+                Long lo = 0;
+                while (len > LINEAR_SEARCH_LENGTH)
+                {
+                        Long half = len / 2;
+                        lo += (base[lo + half - 1] <= time) ? half : 0;
+                        len -= half;
+                }
+
+                Long count = 0;
+                for (Long i = 0; i < len; i++)
+                        count += (base[lo + i] <= time);
+
+                return first + lo + count;
+        }
+
+        void TimelineSampler::sample(const Time* times, Long n, const Time* targets, int count,
+                        Long* indices)
+        {
+                //The targets are sorted, so each search starts where the previous ended
+                Long first = 0;
+                for (int p = 0; p < count; p++)
+                {
+                        Time time = targets[p];
+                        Long upper = upperBound(times, first, n, time);
+
+                        Long l = upper > 0 ? upper - 1 : 0;
+                        Long r = upper < n ? upper : n - 1;
+
+                        Time leftDiff = time > times[l] ? time - times[l] : times[l] - time;
+                        Time rightDiff = times[r] > time ? times[r] - time : time - times[r];
+                        indices[p] = leftDiff < rightDiff ? l : r;
+
+                        first = l;
+                }
+        }
+
+} /* namespace TraceviewerServer */
@@ -0,0 +1,86 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2023, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   Picks the trace records to show for each pixel of a timeline.
+//
+// Description:
+//   Branchless search over a contiguous block of timestamps.
+//
+//***************************************************************************
+
+#ifndef TIMELINESAMPLER_H_
+#define TIMELINESAMPLER_H_
+
+#include "TimeCPID.hpp"
+#include "ByteUtilities.hpp" //Long
+
+namespace TraceviewerServer
+{
+
+        class TimelineSampler
+        {
+        public:
+                /**
+                 * For each of the count target times, which must be in
+                 * increasing order, finds the index of the closest of the n
+                 * sorted timestamps in times, the same record
+                 * TraceDataByRank::findTimeInInterval picks. All the targets
+                 * are resolved in a single pass over the block.
+                 */
+                static void sample(const Time* times, Long n, const Time* targets, int count,
+                                Long* indices);
+        private:
+                static Long upperBound(const Time* times, Long first, Long n, Time time);
+        };
+
+} /* namespace TraceviewerServer */
+#endif /* TIMELINESAMPLER_H_ */
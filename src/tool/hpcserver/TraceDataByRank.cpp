@@ -61,10 +61,15 @@
 #include <algorithm>
 #include <cstdlib> // previously: cmath but it causes ambiguity in abs function for gcc 4.4.6
 #include "Constants.hpp"
+#include "TimelineSampler.hpp"
 #include <iostream>
 
 namespace TraceviewerServer
 {
+        //Up to this many records per pixel, reading the whole range as one
+        //block and sampling it in a single pass beats searching the file
+        //separately for every pixel
+        static const Long BLOCK_SAMPLING_RECORDS_PER_PIXEL = 64;
 
         TraceDataByRank::TraceDataByRank(FilteredBaseData* _data, int _rank,
                         int _numPixelH, int _headerSize)
@@ -101,12 +106,16 @@ namespace TraceviewerServer
                 if (numRec <= numPixelsH)
                 {
                         // display all the records
-                        for (FileOffset i = startLoc; i <= endLoc;)
-                        {
-                                listCPID->push_back(getData(i));
-                                // one record of data contains of an integer (cpid) and a long (time)
-                                i = i + SIZE_OF_TRACE_RECORD;
-                        }
+                        vector<Time> times(numRec);
+                        vector<int> cpids(numRec);
+                        data->getRecords(startLoc, numRec, times.data(), cpids.data());
+                        listCPID->reserve(numRec);
+                        for (Long i = 0; i < numRec; i++)
+                                listCPID->push_back(TimeCPID(times[i], cpids[i]));
+                }
+                else if (numRec <= numPixelsH * BLOCK_SAMPLING_RECORDS_PER_PIXEL)
+                {
+                        sampleBlock(startLoc, numRec, pixelLength, timeStart);
                 }
                 else
                 {
@@ -171,6 +180,39 @@ namespace TraceviewerServer
                 return (addedLeft + addedRight + 1);
         }
 
+        /*******************************************************************************************
+         * Fills in the same samples as sampleTimeLine over numRec records starting at minLoc,
+         * but reads the timestamps once as a contiguous block and resolves every pixel in a
+         * single pass over it instead of searching the file for each pixel.
+         * @param minLoc The location in the file of the first record.
+         * @param numRec The number of records in the range.
+         ******************************************************************************************/
+        void TraceDataByRank::sampleBlock(FileOffset minLoc, Long numRec, double pixelLength,
+                        Time startingTime)
+        {
+                vector<Time> times(numRec);
+                data->getRecords(minLoc, numRec, times.data(), NULL);
+
+                // sampleTimeLine visits every pixel but the first
+                int count = numPixelsH - 1;
+                if (count <= 0)
+                        return;
+                vector<Time> targets(count);
+                for (int p = 0; p < count; p++)
+                        targets[p] = (long)((p + 1) * pixelLength + startingTime);
+
+                vector<Long> indices(count);
+                TimelineSampler::sample(times.data(), numRec, targets.data(), count, indices.data());
+
+                listCPID->reserve(listCPID->size() + count);
+                for (int p = 0; p < count; p++)
+                {
+                        FileOffset loc = minLoc + indices[p] * SIZE_OF_TRACE_RECORD;
+                        listCPID->push_back(TimeCPID(times[indices[p]],
+                                        data->getInt(loc + SIZEOF_LONG)));
+                }
+        }
+
 
         /*********************************************************************************
          *      Returns the location in the traceFile of the trace data (time stamp and cpid)
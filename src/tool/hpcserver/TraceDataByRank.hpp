@@ -95,6 +95,7 @@ namespace TraceviewerServer
 
                 FileOffset getRelativeLocation(FileOffset);
                 void addSample(unsigned int, TimeCPID);
+                void sampleBlock(FileOffset minLoc, Long numRec, double pixelLength, Time startingTime);
                 TimeCPID getData(FileOffset);
                 Long getNumberOfRecords(FileOffset, FileOffset);
                 void postProcess();
@@ -61,6 +61,7 @@ extern void filterTest();
 extern void progBarTest();
 extern void compressionTest();
 extern void lruTest();
+extern void timelineSamplerTest();
 
 int main(int argc, char** argv)
 {
@@ -68,4 +69,5 @@ int main(int argc, char** argv)
         compressionTest();
         progBarTest();
         filterTest();
+        timelineSamplerTest();
 }
@@ -0,0 +1,59 @@
+/*
+ * TimelineSampler_test.cpp
+ *
+ * Checks the single-pass sampler against a plain search for the closest
+ * timestamp to each pixel.
+ */
+
+#undef NDEBUG
+
+#include "../TimelineSampler.hpp"
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+using namespace std;
+using namespace TraceviewerServer;
+
+static Long closest(const vector<Time>& times, Time time)
+{
+        Long best = 0;
+        for (Long i = 1; i < (Long)times.size(); i++)
+        {
+                Time bestDiff = time > times[best] ? time - times[best] : times[best] - time;
+                Time diff = time > times[i] ? time - times[i] : times[i] - time;
+                //Ties go to the later record, as in findTimeInInterval
+                if (diff <= bestDiff)
+                        best = i;
+        }
+        return best;
+}
+
+void timelineSamplerTest()
+{
+        srand(7);
+        for (int round = 0; round < 50; round++)
+        {
+                Long n = 1 + rand() % 5000;
+                vector<Time> times(n);
+                Time t = 1000;
+                for (Long i = 0; i < n; i++)
+                {
+                        //Repeated timestamps happen when records are coalesced
+                        t += rand() % 4 == 0 ? 0 : rand() % 100;
+                        times[i] = t;
+                }
+
+                int count = 1 + rand() % 300;
+                double pixelLength = (double)(t + 200 - 900) / count;
+                vector<Time> targets(count);
+                for (int p = 0; p < count; p++)
+                        targets[p] = (Time)(p * pixelLength + 900);
+
+                vector<Long> indices(count);
+                TimelineSampler::sample(times.data(), n, targets.data(), count, indices.data());
+                for (int p = 0; p < count; p++)
+                        assert(times[indices[p]] == times[closest(times, targets[p])]);
+        }
+        cout << "Timeline sampler test passed" << endl;
+}
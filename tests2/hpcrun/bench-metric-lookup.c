@@ -0,0 +1,185 @@
+// Benchmark of the per-sample lookup of a cct node's metric data list, the
+// lookup hpcrun_reify_metric_set does for every sample:
+//
+//   - "splay map" splays a per-thread tree keyed by the node's address, as
+//     the cct2metrics map in tool/hpcrun/cct2metrics.c used to, built from
+//     the same REGULAR_SPLAY_TREE in lib/prof-lean/splay-macros.h;
+//   - "node field" reads the pointer the node now holds itself.
+//
+// Each lookup is of a node drawn in advance, 80% of them from a hot 5% of
+// the nodes, the rest from all of them. The cost per lookup is reported in
+// time stamp counter ticks where there is one and in nanoseconds otherwise,
+// like the sample phase timers of tool/hpcrun/sample_phase.c.
+//
+// Usage: benchunit-metric-lookup [LOOKUPS [NODES...]]
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#define TICK_UNIT "ticks"
+#else
+#define TICK_UNIT "ns"
+#endif
+
+#include <lib/prof-lean/splay-macros.h>
+
+#define CHECK(cond)                                                  \
+  do {                                                               \
+    if (!(cond)) {                                                   \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__,         \
+              __LINE__, #cond);                                      \
+      exit(1);                                                       \
+    }                                                                \
+  } while (0)
+
+#define DEFAULT_LOOKUPS 2000000
+
+// a stand-in for a cct node: the fields before the metrics pointer pad it
+// out to the size of a real one, so that nodes spread over as many cache
+// lines as they do in hpcrun
+typedef struct node_t {
+  void* padding[12];
+  void* metrics;
+} node_t;
+
+typedef struct cct2metrics_t {
+  node_t* node;
+  void* kind_metrics;
+  struct cct2metrics_t* left;
+  struct cct2metrics_t* right;
+} cct2metrics_t;
+
+
+static inline uint64_t
+now_ticks(void)
+{
+#if defined(__x86_64__)
+  return __rdtsc();
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+
+static uint64_t
+next_random(uint64_t* state)
+{
+  *state = *state * 6364136223846793005ULL + 1442695040888963407ULL;
+  return *state >> 33;
+}
+
+
+static cct2metrics_t*
+splay(cct2metrics_t* map, node_t* node)
+{
+  REGULAR_SPLAY_TREE(cct2metrics_t, map, node, node, left, right);
+  return map;
+}
+
+
+static cct2metrics_t*
+map_insert(cct2metrics_t* map, node_t* node, void* kind_metrics)
+{
+  cct2metrics_t* entry = calloc(1, sizeof(cct2metrics_t));
+  CHECK(entry != NULL);
+  entry->node = node;
+  entry->kind_metrics = kind_metrics;
+
+  map = splay(map, node);
+  if (map != NULL) {
+    CHECK(map->node != node);
+    if (node < map->node) {
+      entry->left = map->left;
+      entry->right = map;
+      map->left = NULL;
+    } else {
+      entry->right = map->right;
+      entry->left = map;
+      map->right = NULL;
+    }
+  }
+  return entry;
+}
+
+
+static void
+map_free(cct2metrics_t* map)
+{
+  if (map == NULL) return;
+  map_free(map->left);
+  map_free(map->right);
+  free(map);
+}
+
+
+static void
+bench(size_t n_nodes, size_t n_lookups)
+{
+  // allocate nodes one by one, as hpcrun does, and give each a metric list
+  node_t** nodes = malloc(n_nodes * sizeof(node_t*));
+  CHECK(nodes != NULL);
+  cct2metrics_t* map = NULL;
+  for (size_t i = 0; i < n_nodes; i++) {
+    nodes[i] = calloc(1, sizeof(node_t));
+    CHECK(nodes[i] != NULL);
+    nodes[i]->metrics = nodes[i]->padding;
+    map = map_insert(map, nodes[i], nodes[i]->metrics);
+  }
+
+  size_t n_hot = n_nodes / 20 > 0 ? n_nodes / 20 : 1;
+  uint64_t state = n_nodes;
+  node_t** lookups = malloc(n_lookups * sizeof(node_t*));
+  CHECK(lookups != NULL);
+  for (size_t i = 0; i < n_lookups; i++) {
+    bool hot = next_random(&state) % 10 < 8;
+    lookups[i] = nodes[next_random(&state) % (hot ? n_hot : n_nodes)];
+  }
+
+  // splay map, each lookup checked so that none can be optimized away
+  uint64_t begin = now_ticks();
+  for (size_t i = 0; i < n_lookups; i++) {
+    map = splay(map, lookups[i]);
+    if (map->node != lookups[i] || map->kind_metrics == NULL) abort();
+  }
+  uint64_t splay_ticks = now_ticks() - begin;
+
+  // node field
+  begin = now_ticks();
+  for (size_t i = 0; i < n_lookups; i++) {
+    if (*(void* volatile*) &lookups[i]->metrics == NULL) abort();
+  }
+  uint64_t field_ticks = now_ticks() - begin;
+
+  printf("%10zu %14.1f %14.1f\n", n_nodes, (double) splay_ticks / n_lookups,
+         (double) field_ticks / n_lookups);
+
+  map_free(map);
+  for (size_t i = 0; i < n_nodes; i++) free(nodes[i]);
+  free(nodes);
+  free(lookups);
+}
+
+
+int
+main(int argc, char* argv[])
+{
+  size_t n_lookups = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_LOOKUPS;
+  CHECK(n_lookups > 0);
+
+  printf("%s per metric lookup, %zu lookups, 80%% of them on 5%% of the nodes\n",
+         TICK_UNIT, n_lookups);
+  printf("%10s %14s %14s\n", "nodes", "splay map", "node field");
+  if (argc > 2) {
+    for (int i = 2; i < argc; i++) bench(strtoul(argv[i], NULL, 10), n_lookups);
+  } else {
+    for (size_t n = 1000; n <= 100000; n *= 10) bench(n, n_lookups);
+  }
+  return 0;
+}
@@ -0,0 +1,56 @@
+// Synthetic workload with a wide and deep calling context tree, for
+// benchmarking how hpcrun merges the CCTs of OpenMP worker threads.
+//
+// Every level of the recursion calls one of 16 distinct functions, 5 levels
+// deep, for up to 16^5 (~1M) distinct calling contexts. Many short parallel
+// regions are used so that the contexts of each region are merged often.
+
+#include <cmath>
+#include <cstdlib>
+#include <utility>
+#include <omp.h>
+
+constexpr unsigned width = 16;
+constexpr int depth = 5;
+
+template <int D>
+double level(unsigned path);
+
+template <>
+double level<0>(unsigned path) {
+  double v = path;
+  for (int i = 0; i < 64; i++)
+    v = std::sqrt(v + i);
+  return v;
+}
+
+template <unsigned K, int D>
+[[gnu::noinline]] double step(unsigned path) {
+  return level<D - 1>(path / width) + K;
+}
+
+template <int D, unsigned... Ks>
+double dispatch(unsigned path, std::integer_sequence<unsigned, Ks...>) {
+  static constexpr double (*steps[])(unsigned) = {step<Ks, D>...};
+  return steps[path % width](path);
+}
+
+template <int D>
+double level(unsigned path) {
+  return dispatch<D>(path, std::make_integer_sequence<unsigned, width>());
+}
+
+int main(int argc, char** argv) {
+  const int regions = argc > 1 ? std::atoi(argv[1]) : 200;
+  unsigned paths = 1;
+  for (int i = 0; i < depth; i++)
+    paths *= width;
+
+  double sum = 0;
+  for (int r = 0; r < regions; r++) {
+#pragma omp parallel for reduction(+ : sum) schedule(static)
+    for (unsigned p = r; p < paths; p += regions)
+      sum += level<depth>(p);
+  }
+  return sum > 0 ? 0 : 1;
+}
@@ -0,0 +1,69 @@
+// Loads many shared libraries and barely runs them, as a Python interpreter
+// does with its extension modules, for measuring what computing function
+// bounds for every load module costs hpcrun at startup.
+//
+// Every library named on the command line is dlopen'ed. Those that are links
+// of the chain in sample-cost-dso.c are called now and then while the program
+// spins in its own code for the given time, so a few samples land in them.
+//
+// Usage: tstexe-dlopen-many <seconds> <library>...
+
+#include <dlfcn.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "sample-cost.h"
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+__attribute__((noinline)) static uint64_t compute(uint64_t v, int n) {
+  for (int i = 0; i < n; i++) {
+    v ^= v << 13;
+    v ^= v >> 7;
+    v ^= v << 17;
+  }
+  return v;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2)
+    return 2;
+  double seconds = atof(argv[1]);
+
+  // Each link is called on its own, as the last of a chain of one
+  struct dso_chain chains[SAMPLE_COST_DSOS];
+  int nchains = 0;
+  for (int i = 2; i < argc; i++) {
+    void* h = dlopen(argv[i], RTLD_NOW | RTLD_LOCAL);
+    if (!h) {
+      fprintf(stderr, "%s\n", dlerror());
+      return 1;
+    }
+    for (int k = 0; k < SAMPLE_COST_DSOS && nchains < SAMPLE_COST_DSOS; k++) {
+      char name[32];
+      snprintf(name, sizeof name, "sample_cost_dso_%d", k);
+      if (dlsym(h, name)) {
+        chains[nchains].len = 1;
+        chains[nchains].work[0] = (dso_work_t)dlsym(h, name);
+        nchains++;
+      }
+    }
+  }
+
+  uint64_t v = 1;
+  double end = now() + seconds;
+  for (int r = 0; now() < end; r++) {
+    v = compute(v, 100000);
+    if (nchains > 0 && r % 16 == 0) {
+      const struct dso_chain* c = &chains[(r / 16) % nchains];
+      v = c->work[0](v, 0, c);
+    }
+  }
+  return v == 0 ? 1 : 0;
+}
@@ -0,0 +1,260 @@
+// Synthetic OpenMP runtime that drives a tool through the OMPT interface,
+// for benchmarking how hpcrun resolves the calling contexts of parallel
+// regions without depending on a real OpenMP runtime.
+//
+// A team of threads runs many short parallel regions and dispatches the
+// events a runtime would at the same points: parallel-begin and -end on the
+// master, implicit-task-begin and -end on every member of the team. When no
+// tool is present in the process (i.e. not run under hpcrun) the same work
+// is done without any callbacks, as a baseline.
+//
+// Optionally every member of the team then runs nested parallel regions
+// inside its implicit task, each serialized to a team of one, to the given
+// depth. Each thread is then the master of its inner regions while being a
+// worker of the enclosing one.
+//
+// Optionally the workers of the outermost team also keep working after
+// the join barrier, and end their implicit tasks only after the master has
+// dispatched parallel-end. A tool then sees them take samples in a region
+// that has already ended.
+//
+// Task frames are not reported, so a tool cannot trim runtime frames.
+//
+// Usage: tstexe-ompt-driver [threads] [regions] [work per region] [nesting]
+//                           [work after the join]
+
+#include <dlfcn.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "omp-tools.h"
+
+typedef ompt_start_tool_result_t* (*start_tool_t)(unsigned int, const char*);
+
+#define MAX_CALLBACK 64
+#define MAX_NESTING 8
+
+static ompt_callback_t callbacks[MAX_CALLBACK];
+static atomic_uint_fast64_t next_unique_id = 1;
+
+static int team_size;
+static int regions;
+static int work;
+static int nesting;
+static int late;
+
+static pthread_barrier_t fork_barrier;
+static pthread_barrier_t join_barrier;
+static pthread_barrier_t late_barrier;
+static ompt_data_t parallel_data;
+
+// the parallel regions a thread is in, outermost first, and the implicit
+// task it runs in each of them
+typedef struct {
+  ompt_data_t* parallel;
+  ompt_data_t parallel_storage;
+  ompt_data_t task;
+  int team_size;
+  int thread_num;
+} level_t;
+
+static __thread int thread_num;
+static __thread level_t levels[MAX_NESTING + 1];
+static __thread int depth;
+static __thread ompt_data_t initial_task;
+static __thread ompt_frame_t task_frame;
+
+static atomic_uint_fast64_t sink;
+
+#define dispatch(event, ...)                                                 \
+  do {                                                                       \
+    if (callbacks[ompt_callback_##event])                                    \
+      ((ompt_callback_##event##_t)callbacks[ompt_callback_##event])(__VA_ARGS__); \
+  } while (0)
+
+static ompt_set_result_t set_callback(ompt_callbacks_t event, ompt_callback_t callback) {
+  if (event <= 0 || event >= MAX_CALLBACK)
+    return ompt_set_never;
+  callbacks[event] = callback;
+  return ompt_set_always;
+}
+
+static ompt_data_t* current_task(void) {
+  return depth > 0 ? &levels[depth - 1].task : &initial_task;
+}
+
+static int get_state(ompt_wait_id_t* wait_id) {
+  if (wait_id)
+    *wait_id = 0;
+  return depth > 0 ? ompt_state_work_parallel : ompt_state_work_serial;
+}
+
+static int get_parallel_info(int level, ompt_data_t** parallel, int* size) {
+  if (level < 0 || level >= depth)
+    return 0;
+  level_t* l = &levels[depth - 1 - level];
+  if (parallel)
+    *parallel = l->parallel;
+  if (size)
+    *size = l->team_size;
+  return 2;
+}
+
+static int get_task_info(int level, int* flags, ompt_data_t** task, ompt_frame_t** frame,
+                         ompt_data_t** parallel, int* num) {
+  // the implicit tasks of the enclosing regions, then the initial task
+  if (level < 0 || level > depth)
+    return 0;
+  level_t* l = level < depth ? &levels[depth - 1 - level] : NULL;
+  if (flags)
+    *flags = l ? ompt_task_implicit : ompt_task_initial;
+  if (task)
+    *task = l ? &l->task : &initial_task;
+  if (frame)
+    *frame = &task_frame;
+  if (parallel)
+    *parallel = l ? l->parallel : NULL;
+  if (num)
+    *num = l ? l->thread_num : 0;
+  return 2;
+}
+
+static uint64_t get_unique_id(void) { return atomic_fetch_add(&next_unique_id, 1); }
+
+static ompt_interface_fn_t lookup(const char* name) {
+  static const struct {
+    const char* name;
+    ompt_interface_fn_t fn;
+  } entries[] = {
+      {"ompt_set_callback", (ompt_interface_fn_t)set_callback},
+      {"ompt_get_state", (ompt_interface_fn_t)get_state},
+      {"ompt_get_parallel_info", (ompt_interface_fn_t)get_parallel_info},
+      {"ompt_get_task_info", (ompt_interface_fn_t)get_task_info},
+      {"ompt_get_unique_id", (ompt_interface_fn_t)get_unique_id},
+  };
+  for (size_t i = 0; i < sizeof entries / sizeof entries[0]; i++) {
+    if (strcmp(name, entries[i].name) == 0)
+      return entries[i].fn;
+  }
+  return NULL;
+}
+
+__attribute__((noinline)) static uint64_t compute(int n) {
+  uint64_t v = thread_num + 1;
+  for (int i = 0; i < n; i++) {
+    v ^= v << 13;
+    v ^= v >> 7;
+    v ^= v << 17;
+  }
+  return v;
+}
+
+static void implicit_task_begin(ompt_data_t* parallel, int size, int num) {
+  level_t* l = &levels[depth++];
+  l->parallel = parallel;
+  l->task.value = 0;
+  l->team_size = size;
+  l->thread_num = num;
+  dispatch(implicit_task, ompt_scope_begin, parallel, &l->task, size, num,
+           ompt_task_implicit);
+}
+
+static void implicit_task_end(void) {
+  level_t* l = &levels[depth - 1];
+  dispatch(implicit_task, ompt_scope_end, l->parallel, &l->task, l->team_size, l->thread_num,
+           ompt_task_implicit);
+  depth--;
+}
+
+// run a region serialized to a team of one inside the current implicit task
+__attribute__((noinline)) static void nested_region(int level) {
+  const int flags = ompt_parallel_invoker_runtime | ompt_parallel_team;
+  ompt_data_t* parallel = &levels[depth].parallel_storage;
+  parallel->value = 0;
+  dispatch(parallel_begin, current_task(), &task_frame, parallel, 1, flags, NULL);
+  implicit_task_begin(parallel, 1, 0);
+  atomic_fetch_xor(&sink, compute(work));
+  if (level < nesting)
+    nested_region(level + 1);
+  implicit_task_end();
+  dispatch(parallel_end, parallel, current_task(), flags, NULL);
+}
+
+static void* team_member(void* arg) {
+  thread_num = (int)(intptr_t)arg;
+
+  ompt_data_t thread_data = ompt_data_none;
+  dispatch(thread_begin, thread_num == 0 ? ompt_thread_initial : ompt_thread_worker,
+           &thread_data);
+
+  const int flags = ompt_parallel_invoker_runtime | ompt_parallel_team;
+  for (int r = 0; r < regions; r++) {
+    if (thread_num == 0) {
+      parallel_data.value = 0;
+      dispatch(parallel_begin, current_task(), &task_frame, &parallel_data, team_size, flags,
+               NULL);
+    }
+    pthread_barrier_wait(&fork_barrier);
+
+    implicit_task_begin(&parallel_data, team_size, thread_num);
+    atomic_fetch_xor(&sink, compute(work));
+    if (nesting > 0)
+      nested_region(1);
+    if (late == 0 || thread_num == 0)
+      implicit_task_end();
+
+    pthread_barrier_wait(&join_barrier);
+    if (thread_num == 0)
+      dispatch(parallel_end, &parallel_data, current_task(), flags, NULL);
+
+    // the workers are still in the region the master has just ended. the
+    // master waits for them before it reuses parallel_data for the next.
+    if (late > 0) {
+      if (thread_num != 0) {
+        atomic_fetch_xor(&sink, compute(late));
+        implicit_task_end();
+      }
+      pthread_barrier_wait(&late_barrier);
+    }
+  }
+
+  dispatch(thread_end, &thread_data);
+  return NULL;
+}
+
+int main(int argc, char** argv) {
+  team_size = argc > 1 ? atoi(argv[1]) : 4;
+  regions = argc > 2 ? atoi(argv[2]) : 20000;
+  work = argc > 3 ? atoi(argv[3]) : 20000;
+  nesting = argc > 4 ? atoi(argv[4]) : 0;
+  late = argc > 5 ? atoi(argv[5]) : 0;
+  if (team_size < 1 || regions < 0 || work < 0 || nesting < 0 || nesting > MAX_NESTING
+      || late < 0)
+    return 2;
+
+  // A tool already loaded into the process is found the same way a real
+  // OpenMP runtime would find it
+  start_tool_t start_tool = (start_tool_t)dlsym(RTLD_DEFAULT, "ompt_start_tool");
+  ompt_start_tool_result_t* tool = start_tool ? start_tool(201811, "ompt-driver") : NULL;
+  if (tool && !tool->initialize(lookup, 0, &tool->tool_data))
+    tool = NULL;
+
+  pthread_barrier_init(&fork_barrier, NULL, team_size);
+  pthread_barrier_init(&join_barrier, NULL, team_size);
+  pthread_barrier_init(&late_barrier, NULL, team_size);
+
+  pthread_t* workers = calloc(team_size, sizeof *workers);
+  for (int i = 1; i < team_size; i++)
+    pthread_create(&workers[i], NULL, team_member, (void*)(intptr_t)i);
+  team_member((void*)(intptr_t)0);
+  for (int i = 1; i < team_size; i++)
+    pthread_join(workers[i], NULL);
+  free(workers);
+
+  if (tool)
+    tool->finalize(&tool->tool_data);
+  return atomic_load(&sink) == 1 ? 1 : 0;
+}
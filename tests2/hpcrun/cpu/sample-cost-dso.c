@@ -0,0 +1,22 @@
+// One link in a chain of shared libraries for sample-cost.c. Built many
+// times with a different DSO_INDEX, so a call path through the chain
+// crosses as many load modules as there are copies.
+
+#include <stdint.h>
+
+#include "sample-cost.h"
+
+#define CAT(a, b) a##b
+#define DSO_WORK(i) CAT(sample_cost_dso_, i)
+
+__attribute__((noinline)) uint64_t DSO_WORK(DSO_INDEX)(uint64_t v, int i,
+                                                      const struct dso_chain* chain) {
+  if (i + 1 < chain->len)
+    return chain->work[i + 1](v + DSO_INDEX, i + 1, chain) + 1;
+  for (int k = 0; k < 1000; k++) {
+    v ^= v << 13;
+    v ^= v >> 7;
+    v ^= v << 17;
+  }
+  return v;
+}
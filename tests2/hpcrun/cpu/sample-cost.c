@@ -0,0 +1,169 @@
+// Synthetic workloads for benchmarking what hpcrun spends on each sample,
+// each stressing a different part of handling a sample:
+//
+//   recursion [depth]   samples deep in a recursive call chain (long unwinds)
+//   wide [width]        samples spread over width^2 distinct call paths
+//                       (many CCT insertions that create new nodes)
+//   dsos                call paths that cross SAMPLE_COST_DSOS shared
+//                       libraries (unwinding across load modules)
+//   threads [threads]   many threads sampled at once
+//   alloc [size]        a malloc/free loop, for the MEMLEAK sample source
+//
+// Each workload runs for the given number of seconds, so the number of
+// samples taken does not depend on the measurement overhead.
+//
+// Usage: tstexe-sample-cost <workload> [seconds] [parameter]
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "sample-cost.h"
+
+static double seconds;
+static long param;
+static volatile uint64_t sink;
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+__attribute__((noinline)) static uint64_t spin(uint64_t v, int n) {
+  for (int i = 0; i < n; i++) {
+    v ^= v << 13;
+    v ^= v >> 7;
+    v ^= v << 17;
+  }
+  return v;
+}
+
+// --- recursion
+
+__attribute__((noinline)) static uint64_t recurse(uint64_t v, long depth) {
+  if (depth == 0)
+    return spin(v, 100000);
+  // Not a tail call, so every level keeps its frame
+  return recurse(v + 1, depth - 1) ^ depth;
+}
+
+static void run_recursion(double end) {
+  long depth = param > 0 ? param : 500;
+  while (now() < end)
+    sink ^= recurse(sink, depth);
+}
+
+// --- wide
+
+// 16 distinct functions, each of which calls one of 16 distinct leaves
+#define SIXTEEN(X)                                                                                 \
+  X(0) X(1) X(2) X(3) X(4) X(5) X(6) X(7) X(8) X(9) X(10) X(11) X(12) X(13) X(14) X(15)
+
+static long width;
+
+#define LEAF(i)                                                                                    \
+  __attribute__((noinline)) static uint64_t leaf##i(uint64_t v) { return spin(v + i, 2000); }
+SIXTEEN(LEAF)
+
+#define LEAF_PTR(i) leaf##i,
+static uint64_t (*const leaves[])(uint64_t) = {SIXTEEN(LEAF_PTR)};
+
+#define MID(i)                                                                                     \
+  __attribute__((noinline)) static uint64_t mid##i(uint64_t v, long k) {                           \
+    return leaves[k % width](v + i);                                                               \
+  }
+SIXTEEN(MID)
+
+#define MID_PTR(i) mid##i,
+static uint64_t (*const mids[])(uint64_t, long) = {SIXTEEN(MID_PTR)};
+
+static void run_wide(double end) {
+  width = param > 0 && param <= 16 ? param : 16;
+  for (long k = 0; now() < end; k++)
+    sink ^= mids[k % width](sink, k / width);
+}
+
+// --- dsos
+
+static const struct dso_chain chain = {
+    SAMPLE_COST_DSOS,
+    {
+        sample_cost_dso_0,  sample_cost_dso_1,  sample_cost_dso_2,  sample_cost_dso_3,
+        sample_cost_dso_4,  sample_cost_dso_5,  sample_cost_dso_6,  sample_cost_dso_7,
+        sample_cost_dso_8,  sample_cost_dso_9,  sample_cost_dso_10, sample_cost_dso_11,
+        sample_cost_dso_12, sample_cost_dso_13, sample_cost_dso_14, sample_cost_dso_15,
+    },
+};
+
+static void run_dsos(double end) {
+  while (now() < end)
+    sink ^= chain.work[0](sink, 0, &chain);
+}
+
+// --- threads
+
+static void* thread_body(void* arg) {
+  double end = *(double*)arg;
+  uint64_t v = (uintptr_t)&arg;
+  while (now() < end)
+    v ^= recurse(v, 20);
+  sink ^= v;
+  return NULL;
+}
+
+static void run_threads(double end) {
+  long n = param > 0 ? param : 32;
+  pthread_t* threads = calloc(n, sizeof *threads);
+  for (long i = 1; i < n; i++)
+    pthread_create(&threads[i], NULL, thread_body, &end);
+  thread_body(&end);
+  for (long i = 1; i < n; i++)
+    pthread_join(threads[i], NULL);
+  free(threads);
+}
+
+// --- alloc
+
+static void run_alloc(double end) {
+  size_t size = param > 0 ? param : 64;
+  enum { live = 1024 };
+  static void* slots[live];
+  for (unsigned long k = 0; now() < end; k++) {
+    unsigned i = k % live;
+    free(slots[i]);
+    slots[i] = malloc(size + k % 256);
+    memset(slots[i], (int)k, size);
+  }
+  for (unsigned i = 0; i < live; i++)
+    free(slots[i]);
+}
+
+int main(int argc, char** argv) {
+  static const struct {
+    const char* name;
+    void (*run)(double);
+  } workloads[] = {
+      {"recursion", run_recursion}, {"wide", run_wide},   {"dsos", run_dsos},
+      {"threads", run_threads},     {"alloc", run_alloc},
+  };
+
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s <workload> [seconds] [parameter]\n", argv[0]);
+    return 2;
+  }
+  seconds = argc > 2 ? atof(argv[2]) : 2.0;
+  param = argc > 3 ? atol(argv[3]) : 0;
+
+  for (size_t i = 0; i < sizeof workloads / sizeof workloads[0]; i++) {
+    if (strcmp(argv[1], workloads[i].name) == 0) {
+      workloads[i].run(now() + seconds);
+      return sink == 1 ? 1 : 0;
+    }
+  }
+  fprintf(stderr, "unknown workload: %s\n", argv[1]);
+  return 2;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+
+#define SAMPLE_COST_DSOS 16
+
+// The functions in the chain of shared libraries, see sample-cost-dso.c.
+// The i-th calls the next in the chain, the last does the work.
+struct dso_chain;
+typedef uint64_t (*dso_work_t)(uint64_t v, int i, const struct dso_chain* chain);
+struct dso_chain {
+  int len;
+  dso_work_t work[SAMPLE_COST_DSOS];
+};
+
+#define SAMPLE_COST_DSO_DECL(i)                                                                    \
+  uint64_t sample_cost_dso_##i(uint64_t, int, const struct dso_chain*);
+SAMPLE_COST_DSO_DECL(0)
+SAMPLE_COST_DSO_DECL(1)
+SAMPLE_COST_DSO_DECL(2)
+SAMPLE_COST_DSO_DECL(3)
+SAMPLE_COST_DSO_DECL(4)
+SAMPLE_COST_DSO_DECL(5)
+SAMPLE_COST_DSO_DECL(6)
+SAMPLE_COST_DSO_DECL(7)
+SAMPLE_COST_DSO_DECL(8)
+SAMPLE_COST_DSO_DECL(9)
+SAMPLE_COST_DSO_DECL(10)
+SAMPLE_COST_DSO_DECL(11)
+SAMPLE_COST_DSO_DECL(12)
+SAMPLE_COST_DSO_DECL(13)
+SAMPLE_COST_DSO_DECL(14)
+SAMPLE_COST_DSO_DECL(15)
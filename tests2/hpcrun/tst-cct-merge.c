@@ -0,0 +1,258 @@
+// Checks of hpcrun_cct_merge in tool/hpcrun/cct/cct.c, built directly from
+// its source with the rest of hpcrun stubbed out:
+//
+//   - two synthetic CCTs whose siblings partly overlap (children present
+//     in both trees) and partly do not (children present in only one)
+//     merge into exactly the union of their paths, with every merged child
+//     still reachable through the sibling splay trees and pointing back to
+//     its new parent;
+//   - the merge operation is called exactly once per leaf common to both;
+//   - the same is checked at scale, with about a million nodes in the
+//     first tree, and the time taken by the merge is reported.
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <cct/cct.h>
+#include <memory/hpcrun-malloc.h>
+#include <messages/messages.h>
+
+#define CHECK(cond)                                                  \
+  do {                                                               \
+    if (!(cond)) {                                                   \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__,         \
+              __LINE__, #cond);                                      \
+      exit(1);                                                       \
+    }                                                                \
+  } while (0)
+
+// a child with address ip exists under a node of tree A when ip is even,
+// and under a node of tree B when ip is a multiple of 3. the masks below
+// record which of the trees a node belongs to.
+#define IN_A 1
+#define IN_B 2
+
+#define MAX_FANOUT 64
+
+
+//*****************************************************************************
+// stubs for the parts of hpcrun that cct.c links against
+//*****************************************************************************
+
+lush_lip_t lush_lip_NULL;
+
+void* hpcrun_malloc(size_t size) { return calloc(1, size); }
+int debug_flag_get(dbg_category flag) { return 0; }
+void hpcrun_pmsg(const char* tag, const char *fmt, ...) { }
+
+void
+hpcrun_stderr_log_msg(bool copy_to_log, const char *fmt, ...)
+{
+  va_list ap;
+  va_start(ap, fmt);
+  vfprintf(stderr, fmt, ap);
+  va_end(ap);
+}
+
+int hpcrun_get_num_kind_metrics(void) { return 0; }
+uint64_t hpcrun_metric_sparse_count(metric_data_list_t* list) { return 0; }
+
+uint64_t
+hpcrun_metric_set_sparse_copy(cct_metric_data_t* val, uint16_t* metric_ids,
+                              metric_data_list_t* list, int initializing_offset)
+{
+  return 0;
+}
+
+ip_normalized_t
+hpcrun_normalize_ip(void* unnormalized_ip, load_module_t* lm)
+{
+  abort();
+}
+
+size_t hpcio_be8_fwrite(uint64_t* val, FILE* fs) { abort(); }
+
+int
+hpcrun_fmt_cct_node_fwrite(hpcrun_fmt_cct_node_t* x, epoch_flags_t flags, FILE* fs)
+{
+  abort();
+}
+
+
+//*****************************************************************************
+// synthetic trees
+//*****************************************************************************
+
+static unsigned fanout;
+static unsigned depth;
+static uint64_t seed = 88172645463325252ull;
+
+static uint64_t
+rnd(void)
+{
+  seed ^= seed << 13;
+  seed ^= seed >> 7;
+  seed ^= seed << 17;
+  return seed;
+}
+
+
+static int
+child_mask(int mask, unsigned ip)
+{
+  return ((mask & IN_A) && ip % 2 == 0 ? IN_A : 0)
+       | ((mask & IN_B) && ip % 3 == 0 ? IN_B : 0);
+}
+
+
+// insert the children of node in a random order, so that the sibling
+// splay trees come in many shapes
+static void
+build(cct_node_t* node, int mask, unsigned level)
+{
+  if (level == depth) return;
+  unsigned order[MAX_FANOUT];
+  for (unsigned i = 0; i < fanout; i++) order[i] = i;
+  for (unsigned i = fanout - 1; i > 0; i--) {
+    unsigned j = rnd() % (i + 1);
+    unsigned t = order[i]; order[i] = order[j]; order[j] = t;
+  }
+  for (unsigned i = 0; i < fanout; i++) {
+    unsigned ip = order[i];
+    if (! child_mask(mask, ip)) continue;
+    cct_addr_t addr = ADDR2(1, ip);
+    cct_node_t* child = hpcrun_cct_insert_addr(node, &addr, true);
+    build(child, mask, level + 1);
+  }
+}
+
+
+static cct_node_t*
+make_tree(int mask)
+{
+  cct_node_t* root = hpcrun_cct_new();
+  build(root, mask, 0);
+  return root;
+}
+
+
+//*****************************************************************************
+// checks of the merged tree
+//*****************************************************************************
+
+static size_t merges;
+
+static void
+count_merge(cct_node_t* a, cct_node_t* b, merge_op_arg_t arg)
+{
+  CHECK(cct_addr_eq(hpcrun_cct_addr(a), hpcrun_cct_addr(b)));
+  CHECK(hpcrun_cct_is_leaf(a) && hpcrun_cct_is_leaf(b));
+  merges++;
+}
+
+
+typedef struct {
+  cct_node_t* parent;
+  unsigned seen[MAX_FANOUT];
+  size_t n;
+} siblings_t;
+
+static void
+collect_sibling(cct_node_t* node, cct_op_arg_t arg, size_t level)
+{
+  siblings_t* s = (siblings_t*) arg;
+  cct_addr_t* addr = hpcrun_cct_addr(node);
+  CHECK(hpcrun_cct_parent(node) == s->parent);
+  CHECK(addr->ip_norm.lm_id == 1 && addr->ip_norm.lm_ip < fanout);
+  s->seen[addr->ip_norm.lm_ip]++;
+  s->n++;
+}
+
+
+// check that the subtree under node holds exactly the paths of the union,
+// and return the number of nodes below node. *common counts the leaves
+// present in both trees.
+static size_t
+check_union(cct_node_t* node, int mask, unsigned level, size_t* common)
+{
+  if (level == depth) {
+    CHECK(hpcrun_cct_is_leaf(node));
+    if (mask == (IN_A | IN_B)) (*common)++;
+    return 0;
+  }
+
+  siblings_t s = { .parent = node };
+  hpcrun_cct_walkset(node, collect_sibling, &s);
+
+  size_t n = 0;
+  for (unsigned ip = 0; ip < fanout; ip++) {
+    int m = child_mask(mask, ip);
+    cct_addr_t addr = ADDR2(1, ip);
+    cct_node_t* child = hpcrun_cct_find_addr(node, &addr);
+    CHECK(s.seen[ip] == (m ? 1 : 0));
+    CHECK((child != NULL) == (m != 0));
+    if (child) n += 1 + check_union(child, m, level + 1, common);
+  }
+  CHECK(n >= s.n);
+  return n;
+}
+
+
+static size_t
+count_nodes(int mask, unsigned level)
+{
+  if (level == depth) return 0;
+  size_t n = 0;
+  for (unsigned ip = 0; ip < fanout; ip++) {
+    int m = child_mask(mask, ip);
+    if (m) n += 1 + count_nodes(m, level + 1);
+  }
+  return n;
+}
+
+
+static void
+check_merge(unsigned f, unsigned d, bool report)
+{
+  fanout = f;
+  depth = d;
+
+  cct_node_t* a = make_tree(IN_A);
+  cct_node_t* b = make_tree(IN_B);
+
+  struct timespec start, end;
+  merges = 0;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  hpcrun_cct_merge(a, b, count_merge, NULL);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  size_t common = 0;
+  size_t n = check_union(a, IN_A | IN_B, 0, &common);
+  CHECK(n == count_nodes(IN_A | IN_B, 0));
+  CHECK(merges == common);
+
+  if (report) {
+    double secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+    printf("merged %zu + %zu nodes into %zu in %.3f s\n",
+           count_nodes(IN_A, 0), count_nodes(IN_B, 0), n, secs);
+  }
+}
+
+
+int
+main(void)
+{
+  // trees too small for the sibling sets to be balanced, then a range of
+  // shapes, then about a million nodes in the first tree
+  check_merge(1, 1, false);
+  check_merge(2, 3, false);
+  for (unsigned f = 3; f <= 24; f += 7) {
+    for (unsigned d = 1; d <= 4; d++) check_merge(f, d, false);
+  }
+  check_merge(64, 4, true);
+  return 0;
+}
@@ -0,0 +1,214 @@
+// Checks of the reorder window of tool/hpcrun/gpu/gpu-trace-channel.c,
+// built directly from its source with the rest of hpcrun stubbed out:
+//
+//   - activities that arrive at most window_size places late are emitted
+//     in order of their start time;
+//   - activities that arrive later than that, and arbitrary orders, are
+//     emitted exactly as a window holding the last window_size activities
+//     and always emitting the earliest of them would emit them, so every
+//     activity is emitted once and the min-heap keeps its order;
+//   - a window of 0 emits activities in the order they arrive;
+//   - flushing the channel emits the activities still held in the window.
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <gpu/gpu-trace-channel.h>
+#include <gpu/gpu-trace-item.h>
+#include <hpcrun/control-knob.h>
+#include <hpcrun/hpcrun_stats.h>
+#include <memory/hpcrun-malloc.h>
+#include <messages/messages.h>
+
+#define CHECK(cond)                                                  \
+  do {                                                               \
+    if (!(cond)) {                                                   \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__,         \
+              __LINE__, #cond);                                      \
+      exit(1);                                                       \
+    }                                                                \
+  } while (0)
+
+#define CHANNEL_CAPACITY 256
+#define MAX_ITEMS 100000
+
+
+//*****************************************************************************
+// stubs for the parts of hpcrun that gpu-trace-channel.c links against
+//*****************************************************************************
+
+static int window_knob;
+
+// the start times of the activities in the order they were emitted
+static uint64_t emitted[MAX_ITEMS];
+static size_t n_emitted;
+
+int
+control_knob_value_get_int(char *in, int *value)
+{
+  if (strcmp(in, "TRACE_REORDER_WINDOW") == 0) *value = window_knob;
+  else if (strcmp(in, "TRACE_CHANNEL_CAPACITY") == 0) *value = CHANNEL_CAPACITY;
+  else abort();
+  return 0;
+}
+
+void* hpcrun_malloc_safe(size_t size) { return calloc(1, size); }
+void hpcrun_stats_acc_trace_records_dropped_add(long value) { abort(); }
+void hpcrun_set_thread_data(thread_data_t *td) { }
+
+void
+hpcrun_emsg(const char *fmt, ...)
+{
+  va_list ap;
+  va_start(ap, fmt);
+  vfprintf(stderr, fmt, ap);
+  va_end(ap);
+}
+
+thread_data_t* gpu_trace_stream_acquire(gpu_tag_t tag) { return NULL; }
+cct_node_t* gpu_trace_cct_no_activity(thread_data_t* td) { return NULL; }
+
+void
+consume_one_trace_item(thread_data_t* td, cct_node_t *call_path, uint64_t start_time,
+                       uint64_t end_time, cct_node_t *no_activity)
+{
+  abort();
+}
+
+void
+gpu_trace_item_consume(gpu_trace_item_consume_fn_t trace_item_consume, thread_data_t *td,
+                       gpu_trace_item_t *ti, cct_node_t *no_activity)
+{
+  CHECK(trace_item_consume == consume_one_trace_item);
+  CHECK(n_emitted < MAX_ITEMS);
+  emitted[n_emitted++] = ti->start;
+}
+
+
+//*****************************************************************************
+// checks
+//*****************************************************************************
+
+// pass the start times through a channel with the given window, consuming
+// whenever the ring is half full and flushing at the end
+static void
+run_channel(int window, const uint64_t *starts, size_t n)
+{
+  window_knob = window;
+  n_emitted = 0;
+
+  gpu_trace_channel_t *channel = gpu_trace_channel_alloc((gpu_tag_t) {0});
+  for (size_t i = 0; i < n; i++) {
+    gpu_trace_item_t ti = { .start = starts[i], .end = starts[i] + 1 };
+    gpu_trace_channel_produce(channel, &ti);
+    if ((i + 1) % (CHANNEL_CAPACITY / 2) == 0) gpu_trace_channel_consume(channel);
+  }
+  gpu_trace_channel_flush(channel);
+  CHECK(n_emitted == n);
+}
+
+
+// what a window holding the last size activities would emit, found by a
+// linear search for the earliest instead of a heap
+static void
+reference_order(size_t size, const uint64_t *starts, size_t n, uint64_t *out)
+{
+  uint64_t *held = malloc((size + 1) * sizeof *held);
+  size_t count = 0, emit = 0;
+  for (size_t i = 0; i < n || count > 0; i++) {
+    if (i < n) held[count++] = starts[i];
+    if (count > size || i >= n) {
+      size_t min = 0;
+      for (size_t j = 1; j < count; j++) {
+        if (held[j] < held[min]) min = j;
+      }
+      out[emit++] = held[min];
+      held[min] = held[--count];
+    }
+  }
+  CHECK(emit == n);
+  free(held);
+}
+
+
+// start times 0..n-1, each shuffled within its block of late + 1, so no
+// activity arrives after more than late activities that start after it
+static void
+late_starts(uint64_t *starts, size_t n, size_t late)
+{
+  for (size_t i = 0; i < n; i++) starts[i] = i;
+  for (size_t b = 0; b < n; b += late + 1) {
+    size_t len = b + late + 1 <= n ? late + 1 : n - b;
+    for (size_t i = len; i > 1; i--) {
+      size_t j = rand() % i;
+      uint64_t t = starts[b + i - 1];
+      starts[b + i - 1] = starts[b + j];
+      starts[b + j] = t;
+    }
+  }
+}
+
+
+static void
+check_in_order(void)
+{
+  static uint64_t starts[MAX_ITEMS];
+  const int windows[] = { 1, 2, 7, 32, 1000 };
+  for (size_t w = 0; w < sizeof windows / sizeof windows[0]; w++) {
+    for (size_t late = 0; late <= (size_t) windows[w]; late += 1 + late / 2) {
+      size_t n = 20000 + rand() % 100;
+      late_starts(starts, n, late);
+      run_channel(windows[w], starts, n);
+      for (size_t i = 0; i < n; i++) CHECK(emitted[i] == i);
+    }
+  }
+}
+
+
+static void
+check_like_reference(void)
+{
+  static uint64_t starts[MAX_ITEMS];
+  static uint64_t expected[MAX_ITEMS];
+  const int windows[] = { 1, 3, 32, 333 };
+  for (size_t w = 0; w < sizeof windows / sizeof windows[0]; w++) {
+    // too late for the window, arbitrary with many ties, and fewer
+    // activities than the window holds
+    size_t ns[] = { 20000, 20000, (size_t) windows[w] / 2 + 1 };
+    for (int c = 0; c < 3; c++) {
+      size_t n = ns[c];
+      if (c == 0) late_starts(starts, n, 4 * windows[w]);
+      else for (size_t i = 0; i < n; i++) starts[i] = rand() % (c == 1 ? 50 : 1000000);
+
+      run_channel(windows[w], starts, n);
+      reference_order(windows[w], starts, n, expected);
+      CHECK(memcmp(emitted, expected, n * sizeof *expected) == 0);
+    }
+  }
+}
+
+
+static void
+check_no_window(void)
+{
+  static uint64_t starts[MAX_ITEMS];
+  size_t n = 10000;
+  for (size_t i = 0; i < n; i++) starts[i] = rand();
+  run_channel(0, starts, n);
+  CHECK(memcmp(emitted, starts, n * sizeof *starts) == 0);
+}
+
+
+int
+main(void)
+{
+  srand(1);
+  check_in_order();
+  check_like_reference();
+  check_no_window();
+  printf("ok\n");
+  return 0;
+}
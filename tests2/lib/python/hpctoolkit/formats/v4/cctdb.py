@@ -1,7 +1,9 @@
 import dataclasses
+import io
+import lzma
 import typing
 
-from .._util import VersionedStructure
+from .._util import VersionedStructure, read_nbytes
 from ..base import DatabaseFile, StructureBase, _CommentedMap, yaml_object
 
 if typing.TYPE_CHECKING:
@@ -27,7 +29,7 @@ class ContextDB(DatabaseFile):
     """The cct.db file format."""
 
     major_version = 4
-    max_minor_version = 0
+    max_minor_version = 1
     format_code = b"ctxt"
     footer_code = b"__ctx.db"
     yaml_tag: typing.ClassVar[str] = "!cct.db/v4"
@@ -37,6 +39,8 @@ class ContextDB(DatabaseFile):
     __struct = DatabaseFile._header_struct(
         # Added in v4.0
         CtxInfos=(0,),
+        # Added in v4.1
+        CtxBlocks=(1,),
     )
 
     def _with(self, meta: "MetaDB", profile: "ProfileDB"):
@@ -46,11 +50,49 @@ class ContextDB(DatabaseFile):
     def from_file(cls, file):
         minor = cls._parse_header(file)
         sections = cls.__struct.unpack_file(minor, file, 0)
+        blocks = None
+        if sections.get("szCtxBlocks", 0) > 0:
+            blocks = CompressedBlocks(file, sections["pCtxBlocks"])
         return cls(
-            ctx_infos=ContextInfos.from_file(minor, file, sections["pCtxInfos"]),
+            ctx_infos=ContextInfos.from_file(minor, file, sections["pCtxInfos"], blocks),
         )
 
 
+class CompressedBlocks:
+    """Lazily decompressed blocks of context data, for compressed cct.db files (v4.1)."""
+
+    ctxs_per_block = 0x400
+
+    __cblk = VersionedStructure(
+        "<",
+        # Fixed structure
+        pData=(-1, 0x00, "Q"),
+        szData=(-1, 0x08, "Q"),
+        szRaw=(-1, 0x10, "Q"),
+    )
+    assert __cblk.size(0) == 0x18
+
+    def __init__(self, file, offset: int):
+        self._file = file
+        self._offset = offset
+        self._cache: dict[int, io.BytesIO] = {}
+
+    def for_context(self, ctx_id: int) -> io.BytesIO:
+        """Return a file-like object for the decompressed block containing the given context."""
+        b = ctx_id // self.ctxs_per_block
+        if b not in self._cache:
+            blk = self.__cblk.unpack_file(0, self._file, self._offset + b * self.__cblk.size(0))
+            raw = b""
+            if blk["szRaw"] > 0:
+                raw = lzma.decompress(
+                    read_nbytes(self._file, blk["szData"], self._offset + blk["pData"])
+                )
+            if len(raw) != blk["szRaw"]:
+                raise ValueError("Compressed block decompressed to an unexpected size")
+            self._cache = {b: io.BytesIO(raw)}
+        return self._cache[b]
+
+
 @yaml_object
 @dataclasses.dataclass(eq=False, kw_only=True)
 class ContextInfos(StructureBase):
@@ -82,12 +124,14 @@ class ContextInfos(StructureBase):
             c._with(meta, profile, ctx_id)
 
     @classmethod
-    def from_file(cls, version: int, file, offset: int):
+    def from_file(cls, version: int, file, offset: int, blocks: CompressedBlocks | None = None):
         data = cls.__struct.unpack_file(version, file, offset)
         return cls(
             contexts=[
-                PerContext.from_file(version, file, o)
-                for o in scaled_range(data["pCtxs"], data["nCtxs"], data["szCtx"])
+                PerContext.from_file(
+                    version, file, o, blocks.for_context(i) if blocks is not None else None
+                )
+                for i, o in enumerate(scaled_range(data["pCtxs"], data["nCtxs"], data["szCtx"]))
             ],
         )
 
@@ -144,16 +188,19 @@ class PerContext(StructureBase):
         return None
 
     @classmethod
-    def from_file(cls, version: int, file, offset: int):
+    def from_file(cls, version: int, file, offset: int, datafile=None):
+        """Read a context from the file. If given, values are read from `datafile` instead."""
         data = cls.__struct.unpack_file(version, file, offset)
+        if datafile is None:
+            datafile = file
         values = [
-            cls.__value.unpack_file(0, file, o)
+            cls.__value.unpack_file(0, datafile, o)
             for o in scaled_range(
                 data["valueBlock_pValues"], data["valueBlock_nValues"], cls.__value.size(0)
             )
         ]
         met_indices = [
-            cls.__met_idx.unpack_file(0, file, o)
+            cls.__met_idx.unpack_file(0, datafile, o)
             for o in scaled_range(
                 data["valueBlock_pMetricIndices"],
                 data["valueBlock_nMetrics"],
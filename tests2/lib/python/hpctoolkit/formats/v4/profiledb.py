@@ -1,8 +1,11 @@
 import dataclasses
 import functools
+import itertools
+import lzma
+import struct
 import typing
 
-from .._util import VersionedStructure
+from .._util import VersionedStructure, read_nbytes
 from ..base import BitFlags, DatabaseFile, EnumEntry, StructureBase, _CommentedMap, yaml_object
 
 if typing.TYPE_CHECKING:
@@ -29,7 +32,7 @@ class ProfileDB(DatabaseFile):
     """The profile.db file format."""
 
     major_version = 4
-    max_minor_version = 0
+    max_minor_version = 1
     format_code = b"prof"
     footer_code = b"_prof.db"
     yaml_tag: typing.ClassVar[str] = "!profile.db/v4"
@@ -102,6 +105,8 @@ class Profile(StructureBase):
     class Flags(BitFlags, yaml_tag="!profile.db/v4/Profile.Flags"):
         # Added in v4.0
         is_summary = EnumEntry(0, min_version=0)
+        # Added in v4.1
+        is_compressed = EnumEntry(1, min_version=1)
 
     id_tuple: typing.Optional["IdentifierTuple"]
     flags: Flags
@@ -132,6 +137,48 @@ class Profile(StructureBase):
         startIndex=(-1, 0x04, "Q"),
     )
     assert __ctx_idx.size(0) == 0x0C
+    __cblk = VersionedStructure(
+        "<",
+        # Fixed structure
+        pData=(-1, 0x00, "Q"),
+        szData=(-1, 0x08, "Q"),
+        szRaw=(-1, 0x10, "Q"),
+    )
+    assert __cblk.size(0) == 0x18
+
+    @classmethod
+    def _read_cblk(cls, file, table: int, index: int) -> bytes:
+        blk = cls.__cblk.unpack_file(0, file, table + index * cls.__cblk.size(0))
+        raw = lzma.decompress(read_nbytes(file, blk["szData"], table + blk["pData"]))
+        if len(raw) != blk["szRaw"]:
+            raise ValueError("Compressed block decompressed to an unexpected size")
+        return raw
+
+    @classmethod
+    def _read_compressed(cls, file, data) -> tuple[list[dict], list[dict]]:
+        n_values, n_ctxs = data["valueBlock_nValues"], data["valueBlock_nCtxs"]
+        values: list[dict] = []
+        for b in range(-(-n_values // 0x4000)):
+            raw = cls._read_cblk(file, data["valueBlock_pValues"], b)
+            n = len(raw) // cls.__value.size(0)
+            values.extend(
+                {"metricId": m, "value": v}
+                for m, v in zip(
+                    struct.unpack_from(f"<{n:d}H", raw, 0),
+                    struct.unpack_from(f"<{n:d}d", raw, 2 * n),
+                )
+            )
+
+        ctx_indices: list[dict] = []
+        if n_ctxs > 0:
+            raw = cls._read_cblk(file, data["valueBlock_pCtxIndices"], 0)
+            ids = itertools.accumulate(struct.unpack_from(f"<{n_ctxs:d}L", raw, 0))
+            starts = itertools.accumulate(struct.unpack_from(f"<{n_ctxs:d}Q", raw, 4 * n_ctxs))
+            ctx_indices = [
+                {"ctxId": c & 0xFFFFFFFF, "startIndex": s & 0xFFFFFFFFFFFFFFFF}
+                for c, s in zip(ids, starts)
+            ]
+        return values, ctx_indices
 
     @property
     def shorthand(self) -> str:
@@ -148,23 +195,27 @@ class Profile(StructureBase):
     @classmethod
     def from_file(cls, version: int, file, offset: int):
         data = cls.__struct.unpack_file(version, file, offset)
-        values = [
-            cls.__value.unpack_file(0, file, o)
-            for o in scaled_range(
-                data["valueBlock_pValues"], data["valueBlock_nValues"], cls.__value.size(0)
-            )
-        ]
-        ctx_indices = [
-            cls.__ctx_idx.unpack_file(0, file, o)
-            for o in scaled_range(
-                data["valueBlock_pCtxIndices"], data["valueBlock_nCtxs"], cls.__ctx_idx.size(0)
-            )
-        ]
+        flags = cls.Flags.versioned_decode(version, data["flags"])
+        if cls.Flags.is_compressed in flags:
+            values, ctx_indices = cls._read_compressed(file, data)
+        else:
+            values = [
+                cls.__value.unpack_file(0, file, o)
+                for o in scaled_range(
+                    data["valueBlock_pValues"], data["valueBlock_nValues"], cls.__value.size(0)
+                )
+            ]
+            ctx_indices = [
+                cls.__ctx_idx.unpack_file(0, file, o)
+                for o in scaled_range(
+                    data["valueBlock_pCtxIndices"], data["valueBlock_nCtxs"], cls.__ctx_idx.size(0)
+                )
+            ]
         return cls(
             id_tuple=IdentifierTuple.from_file(version, file, data["pIdTuple"])
             if data["pIdTuple"] != 0
             else None,
-            flags=cls.Flags.versioned_decode(version, data["flags"]),
+            flags=flags,
             values={
                 idx["ctxId"]: {
                     val["metricId"]: val["value"]
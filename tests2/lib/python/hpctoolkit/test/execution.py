@@ -3,7 +3,9 @@ import collections.abc
 import contextlib
 import functools
 import os
+import re
 import shlex
+import struct
 import subprocess
 import sys
 import tempfile
@@ -78,6 +80,66 @@ class Measurements:
     profile = functools.partialmethod(_get_file_path, "_profile_suffix")
     tracefile = functools.partialmethod(_get_file_path, "_trace_suffix")
 
+    def log_matches(self, pattern: re.Pattern) -> collections.abc.Iterator[re.Match]:
+        """Search every line of every log file for the pattern, and yield the matches."""
+        for stem in self.thread_stems:
+            if fn := self.logfile(stem):
+                with open(fn, encoding="utf-8") as f:
+                    for line in f:
+                        if m := pattern.search(line):
+                            yield m
+
+    # Every profile ends with a footer, the last two words of which are the
+    # footer's offset from the start of the profile and a magic number.
+    _footer = struct.Struct(">14Q")
+    _footer_magic = 0x48504352554E736D
+
+    def profile_count(self, stem) -> int:
+        """Count the profiles in the profile file for the given stem.
+
+        Usually there is one, but hpcrun can write all the threads of a process
+        to a single file.
+        """
+        data = self.profile(stem).read_bytes()
+        count, end = 0, len(data)
+        while end > 0:
+            if end < self._footer.size:
+                raise PredictableFailureError(f"Truncated profile in {stem}")
+            words = self._footer.unpack_from(data, end - self._footer.size)
+            if words[13] != self._footer_magic or words[12] > end - self._footer.size:
+                raise PredictableFailureError(f"Invalid profile footer in {stem}")
+            end -= self._footer.size + words[12]
+            count += 1
+        return count
+
+    # A node container ends with the offset of its index, the number of
+    # entries in the index and a magic number. Each entry is the offset and
+    # size of a file's data followed by its name.
+    _node_suffix = ".hpcnode"
+    _node_trailer = struct.Struct(">3Q")
+    _node_entry = struct.Struct(">QQI")
+    _node_magic = 0x4850434E4F44456D
+
+    @functools.cached_property
+    def node_entries(self) -> list[str]:
+        """List the names of the files held in node containers."""
+        names = []
+        for fn in self.basedir.glob("*" + self._node_suffix):
+            data = fn.read_bytes()
+            if len(data) < self._node_trailer.size:
+                raise PredictableFailureError(f"Truncated node container {fn.name}")
+            offset, count, magic = self._node_trailer.unpack_from(
+                data, len(data) - self._node_trailer.size
+            )
+            if magic != self._node_magic:
+                raise PredictableFailureError(f"Incomplete node container {fn.name}")
+            for _ in range(count):
+                *_, namelen = self._node_entry.unpack_from(data, offset)
+                offset += self._node_entry.size
+                names.append(data[offset : offset + namelen].decode())
+                offset += namelen
+        return names
+
     def __str__(self):
         return f"{self.__class__.__name__}({self.basedir}, {len(self.thread_stems)} threads)"
 
@@ -87,13 +149,20 @@ class Measurements:
         procs: int = 1,
         threads_per_proc: int | collections.abc.Collection[int] = 1,
         traces: bool = False,
+        process_profile: bool = False,
     ):
-        threads = [
-            procs * tpp
-            for tpp in (
-                threads_per_proc if not isinstance(threads_per_proc, int) else [threads_per_proc]
-            )
-        ]
+        if isinstance(threads_per_proc, int):
+            threads_per_proc = [threads_per_proc]
+        if process_profile:
+            # One profile file per process, holding the profiles of its threads
+            for t in self.thread_stems:
+                if self.profile(t) and self.profile_count(t) not in threads_per_proc:
+                    raise PredictableFailureError(
+                        f"Expected {' or '.join(map(str, threads_per_proc))} profiles in {t}"
+                        f", got {self.profile_count(t)}"
+                    )
+            threads_per_proc = [1]
+        threads = [procs * tpp for tpp in threads_per_proc]
         for trial in threads:
             if len(self.thread_stems) == trial:
                 break
@@ -335,3 +404,33 @@ def hpcstruct(
             yield sfile
 
     return ctx()
+
+
+def hpcquery(
+    db: Database | Path | str,
+    *args: str,
+    timeout: int | None = None,
+    env=None,
+) -> list[list[str]]:
+    if isinstance(db, Database):
+        db = db.basedir
+
+    if "HPCTOOLKIT_APP_HPCQUERY" not in os.environ:
+        raise RuntimeError("hpcquery not available, cannot continue! Run under meson devenv!")
+    hpcquery = os.environ["HPCTOOLKIT_APP_HPCQUERY"]
+
+    if env is not None:
+        env = collections.ChainMap(env, os.environ)
+
+    proc = _subproc_run(
+        "hpcquery",
+        [hpcquery, db, *list(args)],
+        timeout=timeout,
+        env=env,
+        stdout=subprocess.PIPE,
+        encoding="utf-8",
+    )
+    if proc.returncode != 0:
+        raise PredictableFailureError("hpcquery returned a non-zero exit code!")
+
+    return [line.split("\t") for line in proc.stdout.splitlines()]
@@ -0,0 +1,44 @@
+import collections.abc
+import contextlib
+import statistics
+import subprocess
+import time
+import typing
+
+T = typing.TypeVar("T")
+U = typing.TypeVar("U")
+
+
+def timed_runs(
+    run: collections.abc.Callable[[], typing.ContextManager[T]],
+    repeat: int,
+    inspect: collections.abc.Callable[[T], U],
+) -> tuple[float, list[U]]:
+    """Enter the context manager returned by run repeat times. Returns the median
+    wall-clock time it took to enter, and what inspect returned for the value of each
+    context. inspect is called before the context exits, outside of the timed region.
+    """
+    times, results = [], []
+    for _ in range(repeat):
+        start = time.perf_counter()
+        with run() as value:
+            times.append(time.perf_counter() - start)
+            results.append(inspect(value))
+    return statistics.median(times), results
+
+
+def median_time(run: collections.abc.Callable[[], typing.ContextManager], repeat: int) -> float:
+    """Enter the context manager returned by run repeat times, and return the median
+    wall-clock time it took to enter.
+    """
+    return timed_runs(run, repeat, lambda _: None)[0]
+
+
+def median_runtime(cmd: collections.abc.Sequence[str], repeat: int) -> float:
+    """Run cmd unmeasured repeat times, and return its median wall-clock time."""
+    return median_time(lambda: contextlib.nullcontext(subprocess.run(cmd, check=True)), repeat)
+
+
+def overhead(base: float, t: float) -> float:
+    """Return how much longer t is than base, in percent of base."""
+    return (t - base) / base * 100.0
@@ -0,0 +1,169 @@
+// Checks of the bounded single-producer channel in lib/prof-lean/ringchannel.c:
+//
+//   - a full channel accepts only as many elements as it has room for, and
+//     peek stops where the ring wraps around, so batches split across the
+//     end of the ring come back in order over two peeks;
+//   - many producers, each with its own channel, feed one consumer that
+//     drains every channel in batches, the shape of the GPU trace channels
+//     served by one tracing thread. every producer's elements must arrive
+//     complete and in order.
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "ringchannel.h"
+
+#define PRODUCERS 16
+#define CAPACITY 1024
+#define BATCH 64
+#define ITEMS (1 << 18)
+
+typedef struct {
+  uint64_t seq;
+  uint64_t payload[4];
+} item_t;
+
+#define CHECK(cond)                                                  \
+  do {                                                               \
+    if (!(cond)) {                                                   \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__,         \
+              __LINE__, #cond);                                      \
+      exit(1);                                                       \
+    }                                                                \
+  } while (0)
+
+static ringchannel_t rings[PRODUCERS];
+
+
+static void
+check_bounds(void)
+{
+  enum { SMALL = 8 };
+  ringchannel_t ch;
+  item_t slots[SMALL];
+  item_t batch[SMALL + 4];
+  void *first;
+
+  ringchannel_init(&ch, slots, SMALL, sizeof(item_t));
+  CHECK(ringchannel_capacity(&ch) == SMALL);
+  CHECK(ringchannel_peek(&ch, &first, SMALL) == 0);
+
+  // overfill: only the first SMALL elements fit
+  for (uint64_t i = 0; i < SMALL + 4; i++) batch[i].seq = i;
+  CHECK(ringchannel_produce(&ch, batch, SMALL + 4) == SMALL);
+  CHECK(ringchannel_produce(&ch, batch, 1) == 0);
+
+  // free 5 slots, then wrap a batch of 5 around the end of the ring
+  CHECK(ringchannel_peek(&ch, &first, 5) == 5);
+  for (uint64_t i = 0; i < 5; i++) CHECK(((item_t *) first)[i].seq == i);
+  ringchannel_consume(&ch, 5);
+  for (uint64_t i = 0; i < 5; i++) batch[i].seq = SMALL + i;
+  CHECK(ringchannel_produce(&ch, batch, 5) == 5);
+
+  // the first peek ends at the wraparound, the second picks up from slot 0
+  uint64_t expected = 5;
+  CHECK(ringchannel_peek(&ch, &first, SMALL) == SMALL - 5);
+  for (size_t i = 0; i < SMALL - 5; i++) {
+    CHECK(((item_t *) first)[i].seq == expected++);
+  }
+  ringchannel_consume(&ch, SMALL - 5);
+  CHECK(ringchannel_peek(&ch, &first, SMALL) == 5);
+  CHECK(first == (void *) &slots[0]);
+  for (size_t i = 0; i < 5; i++) CHECK(((item_t *) first)[i].seq == expected++);
+  ringchannel_consume(&ch, 5);
+  CHECK(ringchannel_peek(&ch, &first, SMALL) == 0);
+}
+
+
+static void *
+produce(void *arg)
+{
+  ringchannel_t *ch = (ringchannel_t *) arg;
+  item_t batch[BATCH / 4] = { { 0 } };
+  uint64_t seq = 0;
+  while (seq < ITEMS) {
+    // vary the batch size so that batches straddle the end of the ring
+    size_t n = 1 + seq % (BATCH / 4);
+    if (n > ITEMS - seq) n = ITEMS - seq;
+    for (size_t i = 0; i < n; i++) batch[i].seq = seq + i;
+    size_t sent = 0;
+    while (sent < n) {
+      size_t k = ringchannel_produce(ch, batch + sent, n - sent);
+      if (k == 0) sched_yield();
+      sent += k;
+    }
+    seq += n;
+  }
+  return NULL;
+}
+
+
+static size_t
+drain(int i, uint64_t *expected)
+{
+  size_t consumed = 0;
+  void *first;
+  size_t n;
+  while ((n = ringchannel_peek(&rings[i], &first, BATCH)) > 0) {
+    item_t *items = (item_t *) first;
+    for (size_t j = 0; j < n; j++) {
+      CHECK(items[j].seq == expected[i]);
+      expected[i]++;
+    }
+    ringchannel_consume(&rings[i], n);
+    consumed += n;
+  }
+  return consumed;
+}
+
+
+static void
+check_many_producers(void)
+{
+  pthread_t threads[PRODUCERS];
+  uint64_t expected[PRODUCERS] = { 0 };
+  struct timespec start, end;
+
+  for (int i = 0; i < PRODUCERS; i++) {
+    ringchannel_init(&rings[i], malloc(CAPACITY * sizeof(item_t)),
+                     CAPACITY, sizeof(item_t));
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int i = 0; i < PRODUCERS; i++) {
+    CHECK(pthread_create(&threads[i], NULL, produce, &rings[i]) == 0);
+  }
+
+  uint64_t consumed = 0;
+  while (consumed < (uint64_t) PRODUCERS * ITEMS) {
+    uint64_t before = consumed;
+    for (int i = 0; i < PRODUCERS; i++) consumed += drain(i, expected);
+    if (consumed == before) sched_yield();
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  for (int i = 0; i < PRODUCERS; i++) {
+    pthread_join(threads[i], NULL);
+    CHECK(expected[i] == ITEMS);
+    void *first;
+    CHECK(ringchannel_peek(&rings[i], &first, BATCH) == 0);
+    free(rings[i].slots);
+  }
+
+  double secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+  printf("%d producers: %lu elements in %.3f s, %.1f M elements/s\n",
+         PRODUCERS, (unsigned long) consumed, secs, consumed / secs * 1e-6);
+}
+
+
+int
+main(void)
+{
+  check_bounds();
+  check_many_producers();
+  return 0;
+}
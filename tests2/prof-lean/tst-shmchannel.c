@@ -0,0 +1,164 @@
+// Checks of the shared-memory channel in lib/prof-lean/shmchannel.c:
+//
+//   - many producer processes send numbered messages through one channel
+//     in anonymous shared memory to the parent, which checks that each
+//     producer's messages arrive complete and in order;
+//   - a producer that dies between claiming a slot and publishing it
+//     leaves a stalled slot, which the consumer can discard and move past.
+
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "shmchannel.h"
+
+#define PRODUCERS 8
+#define CAPACITY 256
+#define MSG_SIZE 4096
+#define ITEMS (1 << 14)
+
+typedef struct {
+  uint64_t producer;
+  uint64_t seq;
+  char payload[MSG_SIZE - 2 * sizeof(uint64_t)];
+} msg_t;
+
+#define CHECK(cond)                                                  \
+  do {                                                               \
+    if (!(cond)) {                                                   \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__,         \
+              __LINE__, #cond);                                      \
+      exit(1);                                                       \
+    }                                                                \
+  } while (0)
+
+
+static shmchannel_t *
+new_channel(void)
+{
+  size_t size = shmchannel_size(CAPACITY, sizeof(msg_t));
+  shmchannel_t *ch = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  CHECK(ch != MAP_FAILED);
+  shmchannel_init(ch, CAPACITY, sizeof(msg_t));
+  return ch;
+}
+
+
+static void
+send(shmchannel_t *ch, uint64_t producer, uint64_t seq)
+{
+  uint64_t ticket;
+  msg_t *msg;
+  while ((msg = shmchannel_claim(ch, &ticket, getpid())) == NULL) sched_yield();
+  msg->producer = producer;
+  msg->seq = seq;
+  memset(msg->payload, (int) (seq & 0xff), sizeof(msg->payload));
+  CHECK(shmchannel_publish(ch, ticket) == 0);
+}
+
+
+static void
+test_ordering(void)
+{
+  shmchannel_t *ch = new_channel();
+  for (uint64_t p = 0; p < PRODUCERS; p++) {
+    if (fork() == 0) {
+      for (uint64_t i = 0; i < ITEMS; i++) send(ch, p, i);
+      _exit(0);
+    }
+  }
+
+  uint64_t expected[PRODUCERS] = { 0 };
+  for (uint64_t consumed = 0; consumed < (uint64_t) PRODUCERS * ITEMS; ) {
+    msg_t *msg = shmchannel_peek(ch);
+    if (msg == NULL) {
+      sched_yield();
+      continue;
+    }
+    CHECK(msg->producer < PRODUCERS);
+    CHECK(msg->seq == expected[msg->producer]);
+    expected[msg->producer]++;
+    for (size_t i = 0; i < sizeof(msg->payload); i += 512)
+      CHECK(msg->payload[i] == (char) (msg->seq & 0xff));
+    shmchannel_release(ch);
+    consumed++;
+  }
+
+  for (int p = 0; p < PRODUCERS; p++) {
+    int status;
+    CHECK(wait(&status) > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  }
+  CHECK(shmchannel_empty(ch));
+}
+
+
+static void
+test_stalled_producer(void)
+{
+  shmchannel_t *ch = new_channel();
+  uint64_t ticket;
+  int32_t owner;
+
+  // A producer claims a slot and dies without publishing it.
+  pid_t pid = fork();
+  if (pid == 0) {
+    CHECK(shmchannel_claim(ch, &ticket, getpid()) != NULL);
+    _exit(0);
+  }
+  int status;
+  CHECK(waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+  // Messages sent after it are held up behind the claimed slot.
+  send(ch, 1, 0);
+  CHECK(shmchannel_peek(ch) == NULL);
+  CHECK(!shmchannel_empty(ch));
+  CHECK(shmchannel_stalled(ch, &ticket, &owner));
+  CHECK(ticket == 0 && owner == pid);
+
+  // Discarding it releases them.
+  CHECK(shmchannel_discard(ch) == 0);
+  msg_t *msg = shmchannel_peek(ch);
+  CHECK(msg != NULL && msg->producer == 1 && msg->seq == 0);
+  shmchannel_release(ch);
+  CHECK(shmchannel_empty(ch));
+  CHECK(!shmchannel_stalled(ch, &ticket, &owner));
+
+  // A live producer whose slot was discarded fails to publish, and the
+  // slot is reused intact on the next lap.
+  uint64_t late;
+  CHECK(shmchannel_claim(ch, &late, getpid()) != NULL);
+  CHECK(shmchannel_stalled(ch, &ticket, &owner) && ticket == late && owner == getpid());
+  CHECK(shmchannel_discard(ch) == 0);
+  CHECK(shmchannel_publish(ch, late) == -1);
+  CHECK(shmchannel_empty(ch));
+  for (uint64_t i = 0; i < 2 * CAPACITY; i++) {
+    send(ch, 2, i);
+    msg = shmchannel_peek(ch);
+    CHECK(msg != NULL && msg->producer == 2 && msg->seq == i);
+    shmchannel_release(ch);
+  }
+
+  // A slot published before the consumer gives up on it is not discarded.
+  send(ch, 3, 0);
+  CHECK(!shmchannel_stalled(ch, &ticket, &owner));
+  CHECK(shmchannel_discard(ch) == -1);
+  msg = shmchannel_peek(ch);
+  CHECK(msg != NULL && msg->producer == 3);
+  shmchannel_release(ch);
+  CHECK(shmchannel_empty(ch));
+}
+
+
+int
+main(void)
+{
+  test_ordering();
+  test_stalled_producer();
+  return 0;
+}
@@ -0,0 +1,281 @@
+// Checks of the size-class allocator in lib/prof-lean/sizeclass.c:
+//
+//   - each thread allocates blocks of mixed sizes from its own heap, frees
+//     half of them itself and hands the other half to its neighbour, which
+//     frees them as remote frees. every block is filled with a pattern that
+//     is checked before it is freed, so a block handed out twice is caught.
+//     the same traffic is then timed against malloc and free.
+//   - a signal handler frees blocks into, and allocates from, the heap of
+//     the thread it interrupts, as hpcrun's sample handlers may.
+
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <time.h>
+
+#include "ringchannel.h"
+#include "sizeclass.h"
+
+#define THREADS 4
+#define ROUNDS 2000
+#define BLOCKS 256
+
+#define SIGNAL_BLOCKS 512
+
+#define CHECK(cond)                                                  \
+  do {                                                               \
+    if (!(cond)) {                                                   \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__,         \
+              __LINE__, #cond);                                      \
+      abort();                                                       \
+    }                                                                \
+  } while (0)
+
+typedef struct {
+  void *ptr;
+  size_t size;
+  unsigned char tag;
+} handoff_t;
+
+static sizeclass_heap_t heaps[THREADS];
+static ringchannel_t handoffs[THREADS];
+static int use_malloc;
+
+
+static void *
+test_map(size_t size)
+{
+  void *addr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  return addr == MAP_FAILED ? NULL : addr;
+}
+
+
+static void
+test_unmap(void *addr, size_t size)
+{
+  munmap(addr, size);
+}
+
+
+static void
+check(handoff_t *h)
+{
+  unsigned char *p = (unsigned char *) h->ptr;
+  for (size_t i = 0; i < h->size; i++) CHECK(p[i] == h->tag);
+}
+
+
+static void
+release(int self, handoff_t *h)
+{
+  check(h);
+  if (use_malloc) free(h->ptr);
+  else sizeclass_free(&heaps[self], h->ptr);
+}
+
+
+static size_t
+drain(int self)
+{
+  void *first;
+  size_t n = ringchannel_peek(&handoffs[self], &first, BLOCKS);
+  handoff_t *items = (handoff_t *) first;
+  for (size_t i = 0; i < n; i++) release(self, &items[i]);
+  ringchannel_consume(&handoffs[self], n);
+  return n;
+}
+
+
+static void *
+worker(void *arg)
+{
+  int self = (int) (intptr_t) arg;
+  int next = (self + 1) % THREADS;
+  unsigned int seed = self + 1;
+  handoff_t blocks[BLOCKS];
+  size_t received = 0;
+
+  for (int r = 0; r < ROUNDS; r++) {
+    for (int i = 0; i < BLOCKS; i++) {
+      // mostly small blocks, with the occasional large one
+      size_t size = (rand_r(&seed) % 256 == 0) ? 1 + rand_r(&seed) % 8192
+                                              : 1 + rand_r(&seed) % 256;
+      blocks[i].size = size;
+      blocks[i].tag = (unsigned char) rand_r(&seed);
+      blocks[i].ptr = use_malloc ? malloc(size) : sizeclass_alloc(&heaps[self], size);
+      CHECK(blocks[i].ptr != NULL);
+      CHECK(use_malloc || sizeclass_usable_size(blocks[i].ptr) >= size);
+      memset(blocks[i].ptr, blocks[i].tag, size);
+    }
+    for (int i = 0; i < BLOCKS; i += 2) release(self, &blocks[i]);
+
+    // hand the odd blocks to the next thread
+    size_t sent = 0;
+    while (sent < BLOCKS / 2) {
+      handoff_t batch[BLOCKS / 2];
+      size_t n = 0;
+      for (int i = 1 + 2 * (int) sent; i < BLOCKS; i += 2) batch[n++] = blocks[i];
+      size_t k = ringchannel_produce(&handoffs[next], batch, n);
+      sent += k;
+      received += drain(self);
+      if (k < n) sched_yield();
+    }
+  }
+
+  while (received < (size_t) ROUNDS * BLOCKS / 2) {
+    size_t n = drain(self);
+    received += n;
+    if (n == 0) sched_yield();
+  }
+  return NULL;
+}
+
+
+static void
+run(const char *name)
+{
+  pthread_t threads[THREADS];
+  struct timespec start, end;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int i = 0; i < THREADS; i++) {
+    pthread_create(&threads[i], NULL, worker, (void *) (intptr_t) i);
+  }
+  for (int i = 0; i < THREADS; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  double secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+  double ops = 2.0 * THREADS * ROUNDS * BLOCKS;
+  printf("%-10s %d threads: %.0f allocs and frees in %.3f s, %.1f ns per operation\n",
+         name, THREADS, ops, secs, secs * 1e9 / ops);
+}
+
+
+static void
+test_cross_thread(void)
+{
+  for (int i = 0; i < THREADS; i++) {
+    sizeclass_heap_init(&heaps[i], test_map, test_unmap);
+    ringchannel_init(&handoffs[i], malloc(1024 * sizeof(handoff_t)),
+                     1024, sizeof(handoff_t));
+  }
+
+  run("sizeclass");
+
+  sizeclass_stats_t stats = { 0 };
+  for (int i = 0; i < THREADS; i++) {
+    sizeclass_heap_collect(&heaps[i]);
+    sizeclass_heap_stats(&heaps[i], &stats);
+  }
+  printf("sizeclass  allocs %zu, frees %zu (remote %zu), %zu bytes mapped, "
+         "%zu bytes in use\n", stats.allocs, stats.frees, stats.remote_frees,
+         stats.bytes_mapped, stats.bytes_in_use);
+  CHECK(stats.allocs == stats.frees && stats.bytes_in_use == 0);
+  CHECK(stats.remote_frees == (size_t) THREADS * ROUNDS * BLOCKS / 2);
+
+  use_malloc = 1;
+  run("malloc");
+  use_malloc = 0;
+}
+
+
+static sizeclass_heap_t signal_heap;
+static void *signal_blocks[SIGNAL_BLOCKS];
+static volatile sig_atomic_t signal_next = 0;
+static volatile sig_atomic_t signal_allocs = 0;
+
+
+static void
+signal_handler(int sig)
+{
+  // free one of the blocks set aside for the handler, then try an
+  // allocation of our own
+  if (signal_next < SIGNAL_BLOCKS) {
+    sizeclass_free(&signal_heap, signal_blocks[signal_next]);
+    signal_next = signal_next + 1;
+  }
+  void *p = sizeclass_alloc(&signal_heap, 48);
+  if (p != NULL) {
+    memset(p, 0xee, 48);
+    sizeclass_free(&signal_heap, p);
+    signal_allocs = signal_allocs + 1;
+  }
+}
+
+
+static void
+test_signal_reentry(void)
+{
+  sizeclass_heap_init(&signal_heap, test_map, test_unmap);
+  for (int i = 0; i < SIGNAL_BLOCKS; i++) {
+    signal_blocks[i] = sizeclass_alloc(&signal_heap, 1 + i % 512);
+    CHECK(signal_blocks[i] != NULL);
+  }
+
+  struct sigaction sa;
+  memset(&sa, 0, sizeof sa);
+  sa.sa_handler = signal_handler;
+  sigemptyset(&sa.sa_mask);
+  CHECK(sigaction(SIGPROF, &sa, NULL) == 0);
+  struct itimerval timer = { { 0, 20 }, { 0, 20 } };
+  CHECK(setitimer(ITIMER_PROF, &timer, NULL) == 0);
+
+  // allocate and free on the heap while the handler interrupts us
+  unsigned int seed = 42;
+  handoff_t blocks[BLOCKS];
+  while (signal_next < SIGNAL_BLOCKS) {
+    for (int i = 0; i < BLOCKS; i++) {
+      size_t size = 1 + rand_r(&seed) % 1024;
+      blocks[i].size = size;
+      blocks[i].tag = (unsigned char) rand_r(&seed);
+      blocks[i].ptr = sizeclass_alloc(&signal_heap, size);
+      CHECK(blocks[i].ptr != NULL);
+      memset(blocks[i].ptr, blocks[i].tag, size);
+    }
+    for (int i = 0; i < BLOCKS; i++) {
+      check(&blocks[i]);
+      sizeclass_free(&signal_heap, blocks[i].ptr);
+    }
+  }
+
+  memset(&timer, 0, sizeof timer);
+  CHECK(setitimer(ITIMER_PROF, &timer, NULL) == 0);
+
+  sizeclass_stats_t stats = { 0 };
+  sizeclass_heap_collect(&signal_heap);
+  sizeclass_heap_stats(&signal_heap, &stats);
+  printf("signals    allocs %zu, frees %zu (deferred %zu), %d in the handler\n",
+         stats.allocs, stats.frees, stats.remote_frees, (int) signal_allocs);
+  CHECK(stats.allocs == stats.frees && stats.bytes_in_use == 0);
+}
+
+
+int
+main(void)
+{
+  // every usable size covers the request, and sizes do not shrink
+  sizeclass_heap_t heap;
+  sizeclass_heap_init(&heap, test_map, test_unmap);
+  size_t last = 0;
+  for (size_t size = 1; size <= SIZECLASS_MAX; size++) {
+    void *p = sizeclass_alloc(&heap, size);
+    CHECK(p != NULL && ((uintptr_t) p & 15) == 0);
+    size_t usable = sizeclass_usable_size(p);
+    CHECK(usable >= size && usable >= last);
+    last = usable;
+    sizeclass_free(&heap, p);
+  }
+
+  test_cross_thread();
+  test_signal_reentry();
+  return 0;
+}